@@ -0,0 +1,166 @@
+/********************************************************************************//**
+\file      InnoML_Bench_bench_biquad.cpp
+\brief     Benchmark of the biquad cascade of LOWPASS and HIGHPASS (first-order sections, scalar, SSE2, AVX2).
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#include <stdio.h>		// for printf
+#include <stdlib.h>		// for rand
+#include <string.h>		// for memcmp
+#include <math.h>		// for tan
+#include <chrono>		// for timing
+#include <vector>
+#include "InnoML_simd.h"	// for the kernels (static build)
+
+#define FRAMES			4096
+#define ITERATIONS		500
+#define ORDER			3		// highpass of the custom washout of main_filter (2nd and 3rd order)
+
+static const char* s_level_names[IM_SIMD_COUNT] = { "scalar", "sse2", "avx2" };
+
+static double elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// first-order highpass { b0, b1, a1 } (section_setup of the processor)
+static void highpass(double* s, double cutoff, double rate)
+{
+	double k = tan(3.14159265358979323846 * cutoff / rate);
+	s[0] = 1.0 / (1.0 + k);
+	s[1] = -s[0];
+	s[2] = (k - 1.0) / (k + 1.0);
+}
+
+// channel c is order 2 or 3 with cutoffs 0.5 .. 2 Hz
+static void setup(IM_SIMD_BIQUAD* cascade, double sections[][ORDER][3], int* orders, int channels, double rate)
+{
+	im_biquad_reset(cascade);
+	for(int c=0; c<channels; c++) {
+		orders[c] = (c % 2) ? 2 : 3;
+		for(int i=0; i<orders[c]; i++)
+			highpass(sections[c][i], 0.5 + 0.25 * (c + i), rate);
+		for(int i=0; i * 2 < orders[c]; i++) {
+			float first[3] = { (float)sections[c][i * 2][0], (float)sections[c][i * 2][1], (float)sections[c][i * 2][2] };
+			float second[3] = { 1, 0, 0 };
+			if(i * 2 + 1 < orders[c]) {
+				for(int k=0; k<3; k++)
+					second[k] = (float)sections[c][i * 2 + 1][k];
+			}
+			im_biquad_set(cascade, i, c, first, second);
+		}
+	}
+	cascade->nSections = 2;
+}
+
+// the previous processor: first-order sections one after another (float)
+static double bench_sections(double sections[][ORDER][3], const int* orders, int channels, const std::vector<float>& input, std::vector<float>& output)
+{
+	std::vector<float> data(input);
+	double ns = 0;
+	for(int n=0; n<ITERATIONS; n++) {
+		float x1[IM_FORMAT_CHANNELS_MAX][ORDER] = {{0}}, y1[IM_FORMAT_CHANNELS_MAX][ORDER] = {{0}};
+		float coef[IM_FORMAT_CHANNELS_MAX][ORDER][3];
+		for(int c=0; c<channels; c++) {
+			for(int i=0; i<orders[c]; i++) {
+				for(int k=0; k<3; k++)
+					coef[c][i][k] = (float)sections[c][i][k];
+			}
+		}
+		memcpy(&data[0], &input[0], sizeof(float) * data.size());
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for(int f=0; f<FRAMES; f++) {
+			float* frame = &data[f * channels];
+			for(int c=0; c<channels; c++) {
+				float x = frame[c];
+				for(int i=0; i<orders[c]; i++) {
+					float y = coef[c][i][0] * x + coef[c][i][1] * x1[c][i] - coef[c][i][2] * y1[c][i];
+					x1[c][i] = x;
+					y1[c][i] = y;
+					x = y;
+				}
+				frame[c] = x;
+			}
+		}
+		ns += elapsed_ns(start);
+	}
+	output = data;
+	return ns / ((double)ITERATIONS * FRAMES);
+}
+
+// largest error of the cascade from the sections in double
+static double max_error(double sections[][ORDER][3], const int* orders, int channels, const std::vector<float>& input, const std::vector<float>& output)
+{
+	double x1[IM_FORMAT_CHANNELS_MAX][ORDER] = {{0}}, y1[IM_FORMAT_CHANNELS_MAX][ORDER] = {{0}};
+	double error = 0;
+	for(int f=0; f<FRAMES; f++) {
+		for(int c=0; c<channels; c++) {
+			double x = input[f * channels + c];
+			for(int i=0; i<orders[c]; i++) {
+				double y = sections[c][i][0] * x + sections[c][i][1] * x1[c][i] - sections[c][i][2] * y1[c][i];
+				x1[c][i] = x;
+				y1[c][i] = y;
+				x = y;
+			}
+			error = fmax(error, fabs(x - output[f * channels + c]));
+		}
+	}
+	return error;
+}
+
+static double bench_level(const IM_SIMD_KERNELS* kernels, const IM_SIMD_BIQUAD* setup, int channels, const std::vector<float>& input, std::vector<float>& output)
+{
+	std::vector<float> data(input);
+	double ns = 0;
+	for(int n=0; n<ITERATIONS; n++) {
+		IM_SIMD_BIQUAD cascade = *setup;
+		memcpy(&data[0], &input[0], sizeof(float) * data.size());
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		kernels->biquad(&data[0], FRAMES, channels, &cascade);
+		ns += elapsed_ns(start);
+	}
+	output = data;
+	return ns / ((double)ITERATIONS * FRAMES);
+}
+
+int main(int argc, char *argv[])
+{
+	const double rates[] = {50, 200, 1000};
+	const int channels[] = {3, 6, 8};
+
+	printf("HIGHPASS order 2/3 per channel (%d frames, ns per frame)\n", FRAMES);
+	printf("%-6s %-9s %-10s %10s %8s %12s\n", "rate", "channels", "engine", "ns", "exact", "max error");
+	for(int r=0; r<3; r++) {
+		for(int i=0; i<3; i++) {
+			double sections[IM_FORMAT_CHANNELS_MAX][ORDER][3];
+			int orders[IM_FORMAT_CHANNELS_MAX];
+			IM_SIMD_BIQUAD cascade;
+			setup(&cascade, sections, orders, channels[i], rates[r]);
+
+			std::vector<float> input(FRAMES * channels[i]);
+			srand(1);
+			for(size_t k=0; k<input.size(); k++)
+				input[k] = (float)(rand() % 65536 - 32768);
+
+			std::vector<float> reference;
+			double ns = bench_sections(sections, orders, channels[i], input, reference);
+			printf("%-6.0f %-9d %-10s %10.3f %8s %12.4f\n", rates[r], channels[i], "sections", ns, "-",
+				max_error(sections, orders, channels[i], input, reference));
+			for(int level=IM_SIMD_SCALAR; level<IM_SIMD_COUNT; level++) {
+				const IM_SIMD_KERNELS* kernels = im_simd_kernels((IM_SIMD_LEVEL)level);
+				if(kernels == 0) {
+					printf("%-6.0f %-9d %-10s %10s %8s %12s\n", rates[r], channels[i], s_level_names[level], "-", "-", "-");
+					continue;
+				}
+				std::vector<float> output;
+				double ns = bench_level(kernels, &cascade, channels[i], input, output);
+				if(level == IM_SIMD_SCALAR)
+					reference = output;
+				bool exact = memcmp(&reference[0], &output[0], sizeof(float) * output.size()) == 0;
+				printf("%-6.0f %-9d %-10s %10.3f %8s %12.4f\n", rates[r], channels[i], s_level_names[level], ns, exact ? "yes" : "NO",
+					max_error(sections, orders, channels[i], input, output));
+			}
+		}
+	}
+	return 0;
+}
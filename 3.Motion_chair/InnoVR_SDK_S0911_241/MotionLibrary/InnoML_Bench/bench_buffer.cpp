@@ -0,0 +1,94 @@
+/********************************************************************************//**
+\file      InnoML_Bench_bench_buffer.cpp
+\brief     Benchmark of motion buffer enqueue/dequeue (single thread and producer/consumer).
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#include <stdio.h>		// for printf
+#include <string.h>		// for memset
+#include <atomic>		// for producer/consumer
+#include <chrono>		// for timing
+#include <thread>		// for producer/consumer
+#include <InnoML.h>		// for motion
+
+#define SAMPLE_RATE		1000	// 1 kHz telemetry
+#define SAMPLE_COUNT	64		// ring size (frames)
+#define ITERATIONS		1000000
+
+static double elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// enqueue + dequeue of one sample on the same thread
+static double bench_single(int channels)
+{
+	IMBuffer buffer = imCreateBuffer(SAMPLE_RATE, IM_FORMAT_DATA_S16, channels, SAMPLE_COUNT);
+	int16 sample[IM_FORMAT_CHANNELS_MAX];
+	int16 out[IM_FORMAT_CHANNELS_MAX];
+	const int size = sizeof(int16) * channels;
+	memset(sample, 0, sizeof(sample));
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(int i=0; i<ITERATIONS; i++) {
+		sample[0] = (int16)i;
+		imBufferEnqueue(buffer, sample, size);
+		imBufferDequeue(buffer, out, size);
+	}
+	double ns = elapsed_ns(start) / ITERATIONS;
+	imDeleteBuffer(buffer);
+	return ns;
+}
+
+// one producer thread and one consumer thread (game thread -> mixer)
+static double bench_threads(int channels, bool* ordered)
+{
+	IMBuffer buffer = imCreateBuffer(SAMPLE_RATE, IM_FORMAT_DATA_S16, channels, SAMPLE_COUNT);
+	const int size = sizeof(int16) * channels;
+	std::atomic<bool> ok(true);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::thread consumer([&]() {
+		int16 out[IM_FORMAT_CHANNELS_MAX];
+		int16 expect = 0;
+		for(int i=0; i<ITERATIONS; ) {
+			if(imBufferDequeue(buffer, out, size) == 0) {
+				std::this_thread::yield(); // empty (the producer may share the core)
+				continue;
+			}
+			if(out[0] != expect)
+				ok = false;
+			expect++;
+			i++;
+		}
+	});
+	int16 sample[IM_FORMAT_CHANNELS_MAX];
+	memset(sample, 0, sizeof(sample));
+	for(int i=0; i<ITERATIONS; ) {
+		sample[0] = (int16)i;
+		if(imBufferEnqueue(buffer, sample, size))
+			i++;
+		else
+			std::this_thread::yield(); // full
+	}
+	consumer.join();
+	double ns = elapsed_ns(start) / ITERATIONS;
+	*ordered = ok;
+	imDeleteBuffer(buffer);
+	return ns;
+}
+
+int main(int argc, char *argv[])
+{
+	const int channels[] = {3, 6, 8};
+
+	printf("IMBuffer enqueue+dequeue (S16, ring %d frames, %d samples)\n", SAMPLE_COUNT, ITERATIONS);
+	printf("%-10s %16s %20s %8s\n", "channels", "1 thread (ns)", "2 threads (ns)", "order");
+	for(int i=0; i<3; i++) {
+		bool ordered = false;
+		double single = bench_single(channels[i]);
+		double threads = bench_threads(channels[i], &ordered);
+		printf("%-10d %16.1f %20.1f %8s\n", channels[i], single, threads, ordered ? "ok" : "FAIL");
+	}
+	return 0;
+}
@@ -0,0 +1,182 @@
+/********************************************************************************//**
+\file      InnoML_Bench_bench_cache.cpp
+\brief     Check and benchmark of the cache of imBufferConvert (imSetConvertCache) : hits and misses, the copy of
+           a hit, the key of the frames and the loop points, the LRU eviction in the budget and the cost of a hit
+           against the conversion.
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#include <stdio.h>		// for printf
+#include <math.h>		// for sin
+#include <chrono>		// for timing
+#include <vector>
+#include <InnoML.h>		// for motion
+
+#define SRC_RATE		200
+#define DST_RATE		1000
+#define CHANNELS		6
+#define FRAMES			(SRC_RATE * 60)	// 1 minute
+#define TAPS			16
+#define ITERATIONS		20
+
+static double elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// frames of a sine per 'seed', queued after 'shift' frames so the ring wraps
+static IMBuffer create_source(int seed, int shift)
+{
+	std::vector<int16> samples(FRAMES * CHANNELS);
+	for(int f=0; f<FRAMES; f++) {
+		for(int c=0; c<CHANNELS; c++)
+			samples[f * CHANNELS + c] = (int16)(8000 * sin(0.01 * f * (seed + 1) + c));
+	}
+	IMBuffer buffer = imCreateBuffer(SRC_RATE, IM_FORMAT_DATA_S16, CHANNELS, FRAMES);
+	if(shift) {
+		std::vector<int16> skip(shift * CHANNELS, 0);
+		imBufferEnqueue(buffer, &skip[0], (int32)(skip.size() * sizeof(int16)));
+		imBufferDequeue(buffer, &skip[0], (int32)(skip.size() * sizeof(int16)));
+	}
+	imBufferEnqueue(buffer, &samples[0], (int32)(samples.size() * sizeof(int16)));
+	return buffer;
+}
+
+typedef struct {
+	std::vector<int16> frames;
+	int32		loop_begin;
+	int32		loop_end;
+	bool		hit;
+} CONVERTED;
+
+static IMBuffer s_desired;
+static IMFilter s_filter;
+
+// converts and dequeues the result (a hit when the hits of the cache grow)
+static CONVERTED convert(IMBuffer buffer)
+{
+	IM_CONVERT_CACHE_INFO before, after;
+	imGetConvertCacheInfo(&before);
+	IMBuffer adjusted = 0;
+	imBufferConvert(buffer, &adjusted, s_desired, s_filter);
+	imGetConvertCacheInfo(&after);
+
+	CONVERTED result;
+	result.hit = after.nHits == before.nHits + 1 && after.nMisses == before.nMisses;
+	result.loop_begin = result.loop_end = -1;
+	if(adjusted) {
+		imBufferGetLoop(adjusted, &result.loop_begin, &result.loop_end);
+		result.frames.resize(imBufferGetQueuedCount(adjusted) * CHANNELS);
+		if(!result.frames.empty())
+			imBufferDequeue(adjusted, &result.frames[0], (int32)(result.frames.size() * sizeof(int16)));
+		imDeleteBuffer(adjusted);
+	}
+	return result;
+}
+
+static bool same(const CONVERTED& a, const CONVERTED& b)
+{
+	return !a.frames.empty() && a.frames == b.frames && a.loop_begin == b.loop_begin && a.loop_end == b.loop_end;
+}
+
+static bool report(const char* name, bool passed)
+{
+	printf("%-44s %6s\n", name, passed ? "yes" : "NO");
+	return passed;
+}
+
+int main(int argc, char *argv[])
+{
+	s_desired = imCreateBuffer(DST_RATE, IM_FORMAT_DATA_S16, CHANNELS, 1);
+	s_filter = imCreateFilter(IM_FILTER_RESAMPLE);
+	IM_FILTER_RESAMPLE_PARAMS params = { TAPS, 0.9f };
+	imFilterSetParams(s_filter, &params, sizeof(params));
+	IMBuffer a = create_source(0, 0);
+	IMBuffer b = create_source(1, 0);
+	IMBuffer c = create_source(2, 0);
+	bool passed = true;
+
+	printf("CONVERT CACHE (%d -> %d Hz, %d channels, %d frames, %d taps)\n", SRC_RATE, DST_RATE, CHANNELS, FRAMES, TAPS);
+	printf("%-44s %6s\n", "check", "passed");
+
+	// a miss, then a hit of the same frames (the ring of the second source wraps)
+	imSetConvertCache(64 << 20);
+	const CONVERTED miss = convert(a);
+	const CONVERTED hit = convert(a);
+	passed = report("miss then hit", !miss.hit && hit.hit && same(miss, hit)) && passed;
+	IMBuffer wrapped = create_source(0, FRAMES / 3);
+	const CONVERTED hit_wrapped = convert(wrapped);
+	passed = report("hit of the same frames in a wrapped ring", hit_wrapped.hit && same(miss, hit_wrapped)) && passed;
+	imDeleteBuffer(wrapped);
+	const CONVERTED other = convert(b);
+	passed = report("miss of other frames", !other.hit && other.frames != miss.frames) && passed;
+
+	// a hit is a copy : consuming it and changing its loop points leave the cached frames
+	IMBuffer adjusted = 0;
+	imBufferConvert(a, &adjusted, s_desired, s_filter);
+	imBufferSetLoop(adjusted, 10, 20);
+	imBufferDequeue(adjusted, 0, imBufferGetQueuedCount(adjusted) * CHANNELS * (int32)sizeof(int16));
+	imDeleteBuffer(adjusted);
+	const CONVERTED copy = convert(a);
+	passed = report("hit after the last hit was consumed", copy.hit && same(miss, copy)) && passed;
+
+	// the loop points are keyed (and converted to the output rate)
+	imBufferSetLoop(a, 100, 500);
+	const CONVERTED looped = convert(a);
+	const CONVERTED looped_hit = convert(a);
+	passed = report("miss of new loop points", !looped.hit && looped.frames == miss.frames
+		&& looped.loop_begin == 100 * DST_RATE / SRC_RATE && looped.loop_end == 500 * DST_RATE / SRC_RATE) && passed;
+	passed = report("hit of the same loop points", looped_hit.hit && same(looped, looped_hit)) && passed;
+	imBufferSetLoop(a, 0, 0);
+	passed = report("hit after the loop points are cleared", convert(a).hit) && passed;
+
+	// LRU : a budget of 2.5 entries keeps the 2 most recently used
+	IM_CONVERT_CACHE_INFO info;
+	imSetConvertCache(0);
+	imSetConvertCache(64 << 20);
+	convert(a);
+	imGetConvertCacheInfo(&info);
+	const int32 entry = (int32)info.nSize;
+	imSetConvertCache(entry * 5 / 2);
+	convert(b);
+	const bool a_used = convert(a).hit; // a is more recent than b
+	imGetConvertCacheInfo(&info);
+	const uint32 evictions = info.nEvictions;
+	convert(c);
+	imGetConvertCacheInfo(&info);
+	const bool evicted = info.nEvictions == evictions + 1 && info.nEntries == 2 && info.nSize <= info.nBudget;
+	const bool a_kept = convert(a).hit;
+	const bool b_evicted = !convert(b).hit;
+	passed = report("LRU eviction in the budget", a_used && evicted && a_kept && b_evicted) && passed;
+
+	// cost of a hit against a miss (the cache is cleared before each miss)
+	double miss_ns = 0, hit_ns = 0;
+	imSetConvertCache(64 << 20);
+	for(int i=0; i<ITERATIONS; i++) {
+		imSetConvertCache(0);
+		imSetConvertCache(64 << 20);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		imBufferConvert(a, &adjusted, s_desired, s_filter);
+		miss_ns += elapsed_ns(start);
+		imDeleteBuffer(adjusted);
+		start = std::chrono::steady_clock::now();
+		imBufferConvert(a, &adjusted, s_desired, s_filter);
+		hit_ns += elapsed_ns(start);
+		imDeleteBuffer(adjusted);
+	}
+	miss_ns /= ITERATIONS;
+	hit_ns /= ITERATIONS;
+	imGetConvertCacheInfo(&info);
+	printf("\n%-12s %12s %12s %10s\n", "", "miss (ms)", "hit (ms)", "speedup");
+	printf("%-12s %12.3f %12.3f %10.1f\n", "convert", miss_ns / 1e6, hit_ns / 1e6, miss_ns / hit_ns);
+	printf("(hits %u, misses %u, evictions %u)\n", info.nHits, info.nMisses, info.nEvictions);
+	passed = passed && hit_ns < miss_ns;
+
+	imSetConvertCache(0);
+	imDeleteBuffer(a);
+	imDeleteBuffer(b);
+	imDeleteBuffer(c);
+	imDeleteFilter(s_filter);
+	imDeleteBuffer(s_desired);
+	return passed ? 0 : 1;
+}
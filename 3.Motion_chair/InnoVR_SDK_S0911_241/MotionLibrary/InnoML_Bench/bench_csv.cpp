@@ -0,0 +1,268 @@
+/********************************************************************************//**
+\file      InnoML_Bench_bench_csv.cpp
+\brief     Benchmark of IMotion_LoadCSV over the motion data files against the previous loader
+           (read, copy of each line, sscanf/strtod, float vector, quantization pass),
+           and of imLoadBuffer of the csv files against the binary motion files (mapped).
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#include <stdio.h>		// for printf
+#include <stdlib.h>		// for strtod
+#include <string.h>		// for memcmp
+#include <math.h>		// for sin
+#include <chrono>		// for timing
+#include <filesystem>	// for the motion data files
+#include <string>
+#include <vector>
+#include <IMotion_csv.h>
+#include <InnoML.h>
+
+#define MOTION_DATA		"../../MotionData"
+#define LONG_TRACK		"bench_csv_long.csv"	// 10 minutes at 1 kHz
+#define BINARY_DIR		"bench_csv_imb"
+#define BUDGET_NS		100e6	// per loader and file
+
+static double elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// the previous loader
+static bool reference_is_text(const uint8* data, int size)
+{
+	for(int i=0; i<size; i++) {
+		uint8 c = data[i];
+		if(c >= 0x80 || (c < 0x20 && c != '\t' && c != '\r' && c != '\n'))
+			return false;
+	}
+	return true;
+}
+
+static bool reference_parse_time(const char* text, char** end, double* msec)
+{
+	int hh, mm, ss, cc, n = 0;
+	if(sscanf(text, "%d-%d-%d-%d%n", &hh, &mm, &ss, &cc, &n) == 4) {
+		*msec = ((hh * 60.0 + mm) * 60.0 + ss) * 1000.0 + cc * 10.0;
+		*end = (char*)text + n;
+		return true;
+	}
+	*msec = strtod(text, end);
+	return *end != text;
+}
+
+static int reference_load_raw(const void* data, int size, IM_FORMAT* format, uint8** motion_buf, uint32* motion_len)
+{
+	if(size <= 0 || !reference_is_text((const uint8*)data, size))
+		return 0;
+	const char* text = (const char*)data;
+	const char* text_end = text + size;
+	std::vector<float> values;
+	double time[2] = {0, 0};
+	int rows = 0, channels = 0;
+	char line[1024];
+
+	while(text < text_end) {
+		const char* eol = text;
+		while(eol < text_end && *eol != '\n')
+			eol++;
+		int len = MOTION_MIN((int)(eol - text), 1023);
+		memcpy(line, text, len);
+		line[len] = 0;
+		text = eol + 1;
+
+		char* p = line;
+		double msec;
+		if(!reference_parse_time(p, &p, &msec))
+			continue;
+		float frame[IM_FORMAT_CHANNELS_MAX];
+		int count = 0;
+		while(*p == ',' && count < IM_FORMAT_CHANNELS_MAX) {
+			char* next;
+			double value = strtod(p + 1, &next);
+			if(next == p + 1)
+				break;
+			frame[count++] = (float)value;
+			p = next;
+		}
+		if(rows == 0) {
+			if(count == 0)
+				continue;
+			channels = count;
+		}
+		for(int i=count; i<channels; i++)
+			frame[i] = 0;
+		if(rows < 2)
+			time[rows] = msec;
+		values.insert(values.end(), frame, frame + channels);
+		rows++;
+	}
+	if(rows == 0)
+		return 0;
+
+	int sample_rate = IM_FORMAT_SAMPLE_RATE_DEFAULT;
+	if(rows > 1 && time[1] > time[0])
+		sample_rate = (int)(1000.0 / (time[1] - time[0]) + 0.5);
+	memset(format, 0, sizeof(*format));
+	format->nSampleRate = sample_rate;
+	format->nChannels = channels;
+	format->nBlockAlign = channels * sizeof(int16);
+	*motion_len = rows * format->nBlockAlign;
+	*motion_buf = (uint8*)malloc(*motion_len);
+	for(size_t i=0; i<values.size(); i++) {
+		float value = MOTION_CLAMP(values[i] * (32767.0f / 100.0f), -32768.0f, 32767.0f);
+		int16 v = (int16)lrintf(value);
+		memcpy(*motion_buf + i * sizeof(int16), &v, sizeof(v));
+	}
+	return 1;
+}
+
+static int reference_load(const char* filename, IM_FORMAT* format, uint8** motion_buf, uint32* motion_len)
+{
+	FILE* fp = fopen(filename, "rb");
+	if(fp == 0)
+		return 0;
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	std::vector<char> data(size > 0 ? size : 1);
+	size_t read = (size > 0) ? fread(&data[0], 1, size, fp) : 0;
+	fclose(fp);
+	return reference_load_raw(&data[0], (int)read, format, motion_buf, motion_len);
+}
+
+static void write_long_track(const char* filename)
+{
+	FILE* fp = fopen(filename, "wb");
+	if(fp == 0)
+		return;
+	for(int f=0; f<600000; f++) {
+		fprintf(fp, "%d", f);
+		for(int c=0; c<6; c++)
+			fprintf(fp, ",%.7g", 90.0 * sin(f * 0.001 * (c + 1)));
+		fprintf(fp, "\n");
+	}
+	fclose(fp);
+}
+
+// ns per load within the budget
+template<class LOAD> static double bench_load(LOAD load, const char* filename, int* result)
+{
+	double ns = 0;
+	int n = 0;
+	do {
+		IM_FORMAT format;
+		uint8* motion = 0;
+		uint32 motion_len = 0;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		*result = load(filename, &format, &motion, &motion_len);
+		ns += elapsed_ns(start);
+		free(motion);
+		n++;
+	} while(ns < BUDGET_NS && n < 1000);
+	return ns / n;
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<std::string> files;
+	std::error_code error;
+	for(std::filesystem::recursive_directory_iterator it(argc > 1 ? argv[1] : MOTION_DATA, error), end; !error && it != end; it.increment(error)) {
+		if(it->is_regular_file() && it->path().extension() == ".csv")
+			files.push_back(it->path().string());
+	}
+	write_long_track(LONG_TRACK);
+	files.push_back(LONG_TRACK);
+
+	printf("CSV LOAD (us per file, the same frames and format as the previous loader)\n");
+	printf("%-48s %10s %8s %12s %12s %8s %8s\n", "file", "bytes", "frames", "previous", "mmap", "speedup", "same");
+	bool passed = true;
+	double total[2] = {0, 0};
+	for(size_t i=0; i<files.size(); i++) {
+		const char* filename = files[i].c_str();
+		IM_FORMAT format[2];
+		uint8* motion[2] = {0, 0};
+		uint32 motion_len[2] = {0, 0};
+		int result[2];
+		result[0] = reference_load(filename, &format[0], &motion[0], &motion_len[0]);
+		result[1] = IMotion_LoadCSV(filename, &format[1], &motion[1], &motion_len[1], 0);
+		bool same = (result[0] == result[1]);
+		if(same && result[0]) {
+			same = motion_len[0] == motion_len[1] && format[0].nSampleRate == format[1].nSampleRate && format[0].nChannels == format[1].nChannels
+				&& memcmp(motion[0], motion[1], motion_len[0]) == 0;
+		}
+		passed = passed && same;
+		const int frames = result[1] ? (int)(motion_len[1] / format[1].nBlockAlign) : 0;
+		free(motion[0]);
+		IMotion_FreeCSV(motion[1]);
+
+		int dummy;
+		double ns[2];
+		ns[0] = bench_load(reference_load, filename, &dummy);
+		ns[1] = bench_load([](const char* name, IM_FORMAT* f, uint8** m, uint32* l) { return IMotion_LoadCSV(name, f, m, l, 0); }, filename, &dummy);
+		total[0] += ns[0];
+		total[1] += ns[1];
+		std::error_code size_error;
+		printf("%-48s %10d %8s %12.1f %12.1f %7.1fx %8s\n", filename, (int)std::filesystem::file_size(filename, size_error),
+			result[1] ? std::to_string(frames).c_str() : "(binary)", ns[0] / 1000, ns[1] / 1000, ns[0] / ns[1], same ? "yes" : "NO");
+	}
+	printf("%-48s %10s %8s %12.1f %12.1f %7.1fx\n", "total", "", "", total[0] / 1000, total[1] / 1000, total[0] / total[1]);
+
+	// the same files converted to binary motion files
+	std::filesystem::create_directories(BINARY_DIR, error);
+	printf("\nBUFFER LOAD (us per imLoadBuffer, the same frames from the csv and the binary file)\n");
+	printf("%-48s %10s %8s %12s %12s %8s %8s\n", "file", "bytes", "frames", "csv", "binary", "speedup", "same");
+	total[0] = total[1] = 0;
+	for(size_t i=0; i<files.size(); i++) {
+		const char* filename = files[i].c_str();
+		IM_FORMAT format;
+		uint8* motion = 0;
+		uint32 motion_len = 0;
+		if(!IMotion_LoadCSV(filename, &format, &motion, &motion_len, 0))
+			continue;
+		std::string binary = (std::filesystem::path(BINARY_DIR) / std::filesystem::path(files[i]).stem()).string() + ".imb";
+		int saved = IMotion_SaveMotion(binary.c_str(), &format, motion, motion_len, 0, 0);
+		IMotion_FreeCSV(motion);
+		if(!saved)
+			continue;
+
+		IMBuffer buffer[2] = { imLoadBuffer(filename), imLoadBuffer(binary.c_str()) };
+		bool same = buffer[0] && buffer[1] && imBufferGetQueuedCount(buffer[0]) == imBufferGetQueuedCount(buffer[1]);
+		const int frames = same ? imBufferGetQueuedCount(buffer[0]) : 0;
+		if(same) {
+			std::vector<uint8> data[2];
+			for(int b=0; b<2; b++) {
+				data[b].resize(frames * format.nBlockAlign);
+				imBufferDequeue(buffer[b], &data[b][0], (int32)data[b].size());
+			}
+			same = (data[0] == data[1]);
+		}
+		passed = passed && same;
+		for(int b=0; b<2; b++) {
+			if(buffer[b])
+				imDeleteBuffer(buffer[b]);
+		}
+
+		double ns[2] = {0, 0};
+		const char* names[2] = { filename, binary.c_str() };
+		for(int b=0; b<2; b++) {
+			int n = 0;
+			do {
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				IMBuffer loaded = imLoadBuffer(names[b]);
+				ns[b] += elapsed_ns(start);
+				imDeleteBuffer(loaded);
+				n++;
+			} while(ns[b] < BUDGET_NS && n < 1000);
+			ns[b] /= n;
+		}
+		total[0] += ns[0];
+		total[1] += ns[1];
+		std::error_code size_error;
+		printf("%-48s %10d %8d %12.1f %12.1f %7.1fx %8s\n", filename, (int)std::filesystem::file_size(binary, size_error),
+			frames, ns[0] / 1000, ns[1] / 1000, ns[0] / ns[1], same ? "yes" : "NO");
+	}
+	printf("%-48s %10s %8s %12.1f %12.1f %7.1fx\n", "total", "", "", total[0] / 1000, total[1] / 1000, total[0] / total[1]);
+	std::filesystem::remove_all(BINARY_DIR, error);
+	remove(LONG_TRACK);
+	return passed ? 0 : 1;
+}
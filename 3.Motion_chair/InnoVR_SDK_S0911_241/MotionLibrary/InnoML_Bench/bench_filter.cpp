@@ -0,0 +1,365 @@
+/********************************************************************************//**
+\file      InnoML_Bench_bench_filter.cpp
+\brief     Benchmark of fused (tile by tile) and stage by stage filter chains.
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#include <stdio.h>		// for printf
+#include <stdlib.h>		// for abs
+#include <math.h>		// for sin, fabs, lrint
+#include <string.h>		// for memcpy, memcmp
+#include <chrono>		// for timing
+#include <vector>
+#include "InnoML_internal.h"	// for the filter program (static build)
+
+#define SAMPLE_RATE		200
+#define TOTAL_FRAMES	(1<<20)	// frames processed per measurement
+
+static double elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// NOISE -> WASHOUT -> SCALE -> RATELIMIT (create_washout_filter of main_telemetry)
+static IMFilter create_washout_filter()
+{
+	IMFilter noise_filter = imCreateFilter(IM_FILTER_NOISE);
+	IM_FILTER_NOISE_PARAMS noise_params[] = {50,100,20,50,1,100};
+	imFilterSetParams(noise_filter, noise_params, sizeof(IM_FILTER_NOISE_PARAMS), 6);
+	IMFilter washout = imCreateFilter(IM_FILTER_WASHOUT);
+	IM_FILTER_WASHOUT_PARAMS washout_params[] = {5,5,5,10,10,5};
+	imFilterSetParams(washout, washout_params, sizeof(IM_FILTER_WASHOUT_PARAMS), 6);
+	IMFilter scaler = imCreateFilter(IM_FILTER_SCALE);
+	IM_FILTER_SCALE_PARAMS scaler_params[] = {2,0.5f,0.4f,1.2f,1,1};
+	imFilterSetParams(scaler, scaler_params, sizeof(IM_FILTER_SCALE_PARAMS), 6);
+	IMFilter limiter = imCreateFilter(IM_FILTER_RATELIMIT);
+
+	IMFilter filter = imCreateFilter();
+	imFilterAppend(filter, noise_filter);
+	imFilterAppend(filter, washout);
+	imFilterAppend(filter, scaler);
+	imFilterAppend(filter, limiter);
+	imDeleteFilter(noise_filter);
+	imDeleteFilter(washout);
+	imDeleteFilter(scaler);
+	imDeleteFilter(limiter);
+	return filter;
+}
+
+// LOWPASS -> KINEMATICS (3 DOF to 6 axes) -> LIMIT
+static IMFilter create_platform_filter()
+{
+	IMFilter lowpass = imCreateFilter(IM_FILTER_LOWPASS);
+	IMFilter kinematics = imCreateFilter(IM_FILTER_KINEMATICS);
+	IMFilter limit = imCreateFilter(IM_FILTER_LIMIT);
+
+	IMFilter filter = imCreateFilter();
+	imFilterAppend(filter, lowpass);
+	imFilterAppend(filter, kinematics);
+	imFilterAppend(filter, limit);
+	imDeleteFilter(lowpass);
+	imDeleteFilter(kinematics);
+	imDeleteFilter(limit);
+	return filter;
+}
+
+// LOWPASS (surge, sway) -> TILT -> RATELIMIT (roll, pitch), the tilt-coordination of main_filter
+static IMFilter create_tilt_chain()
+{
+	IMFilter lowpass = imCreateFilter(IM_FILTER_LOWPASS);
+	IM_FILTER_LOWPASS_PARAMS lowpass_params[] = {{2,{2,2}},{2,{2,2}},{0},{0},{0},{0}};
+	imFilterSetParams(lowpass, lowpass_params, sizeof(IM_FILTER_LOWPASS_PARAMS), 6);
+	IMFilter tilt = imCreateFilter(IM_FILTER_TILT);
+	IMFilter limiter = imCreateFilter(IM_FILTER_RATELIMIT);
+	IM_FILTER_RATELIMIT_PARAMS limiter_params[] = {0,0,0,1,1,0};
+	imFilterSetParams(limiter, limiter_params, sizeof(IM_FILTER_RATELIMIT_PARAMS), 6);
+
+	IMFilter filter = imCreateFilter();
+	imFilterAppend(filter, lowpass);
+	imFilterAppend(filter, tilt);
+	imFilterAppend(filter, limiter);
+	imDeleteFilter(lowpass);
+	imDeleteFilter(tilt);
+	imDeleteFilter(limiter);
+	return filter;
+}
+
+// the same tilt-coordination as one stage (1 per msec = 90000/32767 degree/sec)
+static IMFilter create_tilt()
+{
+	IMFilter filter = imCreateFilter(IM_FILTER_TILT);
+	IM_FILTER_TILT_PARAMS params[] = {{2, 2, 0, 90000.0f / MOTION_MAX_16, 90}, {2, 2, 0, 90000.0f / MOTION_MAX_16, 90}};
+	imFilterSetParams(filter, params, sizeof(IM_FILTER_TILT_PARAMS), 2);
+	return filter;
+}
+
+// ns per frame of the chain over buffers of 'frames' frames (sine input unless 'source' is given)
+static double bench_program(IMFilter filter, int channels, int frames, int tile, std::vector<float>& result, const std::vector<float>* source = 0)
+{
+	IM_FORMAT format;
+	im_format_set(&format, IM_FORMAT_TYPE_DOF, SAMPLE_RATE, channels, IM_FORMAT_DATA_S16);
+	MotionFilterProgram program;
+	program.m_tile_frames = tile;
+	{
+		IM_API_LOCK();
+		program.Build(im_lookup<MotionFilter>(filter), &format, &format);
+	}
+
+	std::vector<float> input(frames * channels);
+	std::vector<float> data(frames * IM_FORMAT_CHANNELS_MAX);
+	for(int f=0; f<frames; f++) {
+		for(int c=0; c<channels; c++)
+			input[f * channels + c] = source ? (*source)[(f * channels + c) % source->size()] : (float)(sin(f * 0.01 + c) * 16000.0);
+	}
+
+	const int loops = (TOTAL_FRAMES + frames - 1) / frames;
+	int out_channels = channels;
+	double ns = 0;
+	for(int i=0; i<loops; i++) {
+		memcpy(&data[0], &input[0], sizeof(float) * input.size());
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		out_channels = program.Process(&data[0], frames);
+		ns += elapsed_ns(start);
+	}
+	result.assign(data.begin(), data.begin() + frames * out_channels);
+	return ns / ((double)loops * frames);
+}
+
+static void bench_chain(const char* name, IMFilter filter, int channels)
+{
+	const int frames[] = {256, 4096, 65536};
+
+	printf("%s (%d channels, %d Hz)\n", name, channels, SAMPLE_RATE);
+	printf("%-10s %16s %16s %8s\n", "frames", "stages (ns)", "fused (ns)", "output");
+	for(int i=0; i<3; i++) {
+		std::vector<float> staged, fused;
+		double staged_ns = bench_program(filter, channels, frames[i], 0, staged);
+		double fused_ns = bench_program(filter, channels, frames[i], IM_FILTER_TILE_FRAMES, fused);
+		printf("%-10d %16.2f %16.2f %8s\n", frames[i], staged_ns, fused_ns, (staged == fused) ? "same" : "DIFF");
+	}
+	printf("\n");
+}
+
+// sustained surge steps (0.3 g for 2 seconds) and a slow sway, the chain against the fused stage
+static void bench_tilt()
+{
+	const int frames[] = {256, 4096, 65536};
+	std::vector<float> source(SAMPLE_RATE * 4 * 6, 0.0f);
+	for(int f=0; f<SAMPLE_RATE * 4; f++) {
+		source[f * 6 + IM_DOF_SURGE] = (f < SAMPLE_RATE * 2) ? 0.3f * IM_SAMPLE_FULL_SCALE : 0.0f;
+		source[f * 6 + IM_DOF_SWAY] = (float)(sin(f * 0.02) * 0.2 * IM_SAMPLE_FULL_SCALE);
+	}
+	IMFilter chain = create_tilt_chain();
+	IMFilter tilt = create_tilt();
+
+	printf("LOWPASS > TILT > RATELIMIT against TILT (6 channels, %d Hz)\n", SAMPLE_RATE);
+	printf("%-10s %16s %16s %10s\n", "frames", "chain (ns)", "tilt (ns)", "max diff");
+	for(int i=0; i<3; i++) {
+		std::vector<float> chained, fused;
+		double chain_ns = bench_program(chain, 6, frames[i], IM_FILTER_TILE_FRAMES, chained, &source);
+		double tilt_ns = bench_program(tilt, 6, frames[i], IM_FILTER_TILE_FRAMES, fused, &source);
+		double diff = 0;
+		for(size_t k=0; k<chained.size(); k++)
+			diff = fmax(diff, fabs(chained[k] - fused[k]));
+		printf("%-10d %16.2f %16.2f %10.4f\n", frames[i], chain_ns, tilt_ns, diff);
+	}
+	printf("\n");
+	imDeleteFilter(chain);
+	imDeleteFilter(tilt);
+}
+
+// the last roll and pitch of a constant surge and sway through imBufferConvert (the program is built and reset there)
+static void tilt_convert(int order, int16* roll, int16* pitch)
+{
+	const int frames = SAMPLE_RATE * 2;
+	std::vector<int16> samples(frames * 6, 0);
+	for(int f=0; f<frames; f++)
+		samples[f * 6 + IM_DOF_SURGE] = samples[f * 6 + IM_DOF_SWAY] = 8000;
+	IMBuffer buffer = imCreateBuffer(SAMPLE_RATE, IM_FORMAT_DATA_S16, 6, frames);
+	imBufferEnqueue(buffer, &samples[0], (int32)(samples.size() * sizeof(int16)));
+	IMFilter tilt = imCreateFilter(IM_FILTER_TILT);
+	IM_FILTER_TILT_PARAMS params[] = {{order, 2, 0, 0, 90}, {order, 2, 0, 0, 90}};
+	imFilterSetParams(tilt, params, sizeof(IM_FILTER_TILT_PARAMS), 2);
+	IMBuffer adjusted = 0;
+	imBufferConvert(buffer, &adjusted, buffer, tilt);
+	*roll = *pitch = 0;
+	if(adjusted && imBufferGetQueuedCount(adjusted) == frames) {
+		imBufferDequeue(adjusted, &samples[0], (int32)(samples.size() * sizeof(int16)));
+		*roll = samples[(frames - 1) * 6 + IM_DOF_ROLL];
+		*pitch = samples[(frames - 1) * 6 + IM_DOF_PITCH];
+	}
+	if(adjusted)
+		imDeleteBuffer(adjusted);
+	imDeleteBuffer(buffer);
+	imDeleteFilter(tilt);
+}
+
+// TILT with its low-pass settles to the tilt of the unfiltered force
+static bool check_tilt_convert()
+{
+	printf("TILT through imBufferConvert (constant surge and sway, last roll and pitch after 2 seconds)\n");
+	printf("%-10s %10s %10s\n", "order", "roll", "pitch");
+	int16 roll[4], pitch[4];
+	bool passed = true;
+	for(int order=0; order<=3; order++) {
+		tilt_convert(order, &roll[order], &pitch[order]);
+		passed = passed && roll[order] != 0 && abs(roll[order] - roll[0]) <= 1 && abs(pitch[order] - pitch[0]) <= 1;
+		printf("%-10d %10d %10d\n", order, roll[order], pitch[order]);
+	}
+	printf("%s\n\n", passed ? "same" : "DIFF");
+	return passed;
+}
+
+// the full update of every sample (covariance propagation per sample and channel)
+static double bench_kalman(const int* covariance, int channels, int frames, std::vector<float>& result)
+{
+	std::vector<float> input(frames * channels), data(frames * channels);
+	for(int f=0; f<frames; f++) {
+		for(int c=0; c<channels; c++)
+			input[f * channels + c] = (float)(sin(f * 0.01 + c) * 16000.0);
+	}
+	const int loops = (TOTAL_FRAMES + frames - 1) / frames;
+	float x[IM_FORMAT_CHANNELS_MAX], p[IM_FORMAT_CHANNELS_MAX];
+	for(int c=0; c<channels; c++) {
+		x[c] = input[c];
+		p[c] = 1.0f;
+	}
+	double ns = 0;
+	for(int i=0; i<loops; i++) {
+		memcpy(&data[0], &input[0], sizeof(float) * input.size());
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for(int f=0; f<frames; f++) {
+			float* frame = &data[f * channels];
+			for(int c=0; c<channels; c++) {
+				if(covariance[c] == 0)
+					continue;
+				p[c] += 1.0f;
+				float k = p[c] / (p[c] + covariance[c]);
+				x[c] += k * (frame[c] - x[c]);
+				p[c] *= 1.0f - k;
+				frame[c] = x[c];
+			}
+		}
+		ns += elapsed_ns(start);
+	}
+	result = data;
+	return ns / ((double)loops * frames);
+}
+
+// NOISE alone : steady-state gain of the stage against the full update
+static void bench_noise(int channels)
+{
+	const int frames[] = {256, 4096, 65536};
+	const int covariance[IM_FORMAT_CHANNELS_MAX] = {50,100,20,50,1,100,7,51};
+	IMFilter noise = imCreateFilter(IM_FILTER_NOISE);
+	IM_FILTER_NOISE_PARAMS params[IM_FORMAT_CHANNELS_MAX];
+	for(int c=0; c<IM_FORMAT_CHANNELS_MAX; c++)
+		params[c].nCovariance = covariance[c];
+	imFilterSetParams(noise, params, sizeof(IM_FILTER_NOISE_PARAMS), channels);
+
+	printf("NOISE (%d channels, %d Hz)\n", channels, SAMPLE_RATE);
+	printf("%-10s %16s %16s %12s\n", "frames", "full (ns)", "steady (ns)", "max diff");
+	for(int i=0; i<3; i++) {
+		std::vector<float> full, steady;
+		double full_ns = bench_kalman(covariance, channels, frames[i], full);
+		double steady_ns = bench_program(noise, channels, frames[i], 0, steady);
+		double diff = 0;
+		for(size_t k=0; k<full.size(); k++)
+			diff = fmax(diff, fabs(full[k] - steady[k]));
+		printf("%-10d %16.2f %16.2f %12.4f\n", frames[i], full_ns, steady_ns, diff);
+	}
+	printf("\n");
+	imDeleteFilter(noise);
+}
+
+// the previous mean : the window summed for every sample
+static double bench_resum(int count, int channels, const std::vector<float>& input, std::vector<float>& result)
+{
+	const int frames = (int)input.size() / channels;
+	const int loops = (TOTAL_FRAMES + frames - 1) / frames;
+	float history[16][IM_FORMAT_CHANNELS_MAX] = {{0}};
+	int index = 0, filled = 0;
+	std::vector<float> data(input.size());
+	double ns = 0;
+	for(int i=0; i<loops; i++) {
+		memcpy(&data[0], &input[0], sizeof(float) * input.size());
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for(int f=0; f<frames; f++) {
+			float* frame = &data[f * channels];
+			for(int c=0; c<channels; c++)
+				history[index][c] = frame[c];
+			if(filled < 16)
+				filled++;
+			int n = MOTION_MIN(count, filled);
+			for(int c=0; c<channels && n > 1; c++) {
+				float sum = 0;
+				for(int k=0; k<n; k++)
+					sum += history[(index + 16 - k) % 16][c];
+				frame[c] = sum / n;
+			}
+			index = (index + 1) % 16;
+		}
+		ns += elapsed_ns(start);
+	}
+	result = data;
+	return ns / ((double)loops * frames);
+}
+
+// MEAN alone by nCount : running sums against the window sums (S16 samples)
+static void bench_mean(int channels)
+{
+	const int frames = 4096;
+	std::vector<float> input(frames * channels);
+	for(int f=0; f<frames; f++) {
+		for(int c=0; c<channels; c++)
+			input[f * channels + c] = (float)lrint(sin(f * 0.01 + c) * 16000.0 + ((f * 7919 + c * 104729) % 401 - 200));
+	}
+
+	printf("MEAN (%d channels, %d frames, S16 samples)\n", channels, frames);
+	printf("%-10s %16s %16s %8s\n", "nCount", "window (ns)", "running (ns)", "output");
+	for(int count=1; count<=16; count++) {
+		IMFilter mean = imCreateFilter(IM_FILTER_MEAN);
+		IM_FILTER_MEAN_PARAMS params = { count };
+		imFilterSetParams(mean, &params, sizeof(IM_FILTER_MEAN_PARAMS), 1);
+
+		IM_FORMAT format;
+		im_format_set(&format, IM_FORMAT_TYPE_DOF, SAMPLE_RATE, channels, IM_FORMAT_DATA_S16);
+		MotionFilterProgram program;
+		{
+			IM_API_LOCK();
+			program.Build(im_lookup<MotionFilter>(mean), &format, &format);
+		}
+		const int loops = (TOTAL_FRAMES + frames - 1) / frames;
+		std::vector<float> data(frames * IM_FORMAT_CHANNELS_MAX), window;
+		double ns = 0;
+		for(int i=0; i<loops; i++) {
+			memcpy(&data[0], &input[0], sizeof(float) * input.size());
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			program.Process(&data[0], frames);
+			ns += elapsed_ns(start);
+		}
+		double window_ns = bench_resum(count, channels, input, window);
+		bool same = memcmp(&window[0], &data[0], sizeof(float) * input.size()) == 0;
+		printf("%-10d %16.2f %16.2f %8s\n", count, window_ns, ns / ((double)loops * frames), same ? "same" : "DIFF");
+		imDeleteFilter(mean);
+	}
+	printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+	IMFilter washout = create_washout_filter();
+	IMFilter platform = create_platform_filter();
+
+	bench_chain("NOISE > WASHOUT > SCALE > RATELIMIT", washout, 6);
+	bench_chain("LOWPASS > KINEMATICS > LIMIT", platform, 3);
+	bench_tilt();
+	const bool passed = check_tilt_convert();
+	bench_noise(3);
+	bench_noise(6);
+	bench_mean(6);
+
+	imDeleteFilter(washout);
+	imDeleteFilter(platform);
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,183 @@
+/********************************************************************************//**
+\file      InnoML_Bench_bench_kinematics.cpp
+\brief     Benchmark of the KINEMATICS kernels (scalar, SSE2, AVX2) against the per pose solve with sinf/cosf,
+           of the stage in place by channel count, and of the forward kinematics on a trajectory at the mixer rate.
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#include <stdio.h>		// for printf
+#include <stdlib.h>		// for rand
+#include <string.h>		// for memcmp
+#include <math.h>		// for sinf, cosf, sqrtf
+#include <chrono>		// for timing
+#include <vector>
+#include "InnoML_filter.h"	// for the platform and the kernels (static build)
+
+#define POSES			4096
+#define ITERATIONS		200
+#define TRAJECTORY		10000	// 10 seconds at 1 kHz
+
+static const char* s_level_names[IM_SIMD_COUNT] = { "scalar", "sse2", "avx2" };
+
+static double elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// the previous stage : one pose at a time (interleaved frames)
+static void reference(const IM_SIMD_KINEMATICS* k, const float* pose, float* axis, int count)
+{
+	for(int f=0; f<count; f++, pose+=IM_DOF_COUNT, axis+=IM_DOF_COUNT) {
+		float sr = sinf(pose[IM_DOF_ROLL]), cr = cosf(pose[IM_DOF_ROLL]);
+		float sp = sinf(pose[IM_DOF_PITCH]), cp = cosf(pose[IM_DOF_PITCH]);
+		float sy = sinf(pose[IM_DOF_YAW]), cy = cosf(pose[IM_DOF_YAW]);
+		float r[3][3] = {
+			{ cy*cp, cy*sp*sr - sy*cr, cy*sp*cr + sy*sr },
+			{ sy*cp, sy*sp*sr + cy*cr, sy*sp*cr - cy*sr },
+			{ -sp,   cp*sr,            cp*cr },
+		};
+		float t[3] = { pose[IM_DOF_SURGE], pose[IM_DOF_SWAY], pose[IM_DOF_HEAVE] + k->fHeight };
+		for(int i=0; i<IM_DOF_COUNT; i++) {
+			const float p[3] = { k->fPlatform[0][i], k->fPlatform[1][i], 0 };
+			const float b[3] = { k->fBase[0][i], k->fBase[1][i], 0 };
+			float d[3];
+			for(int j=0; j<3; j++)
+				d[j] = r[j][0]*p[0] + r[j][1]*p[1] + r[j][2]*p[2] + t[j] - b[j];
+			axis[i] = (sqrtf(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]) - k->fNeutral[i]) * k->fLengthScale;
+		}
+	}
+}
+
+// axes of random poses of 'channels' channels through imBufferConvert, in one call or one frame at a time (S16 samples)
+static std::vector<int16> convert_poses(int channels, int count, bool per_frame)
+{
+	std::vector<int16> poses(count * channels);
+	srand(2);
+	for(size_t i=0; i<poses.size(); i++)
+		poses[i] = (int16)(rand() % 40000 - 20000);
+	IMFilter kinematics = imCreateFilter(IM_FILTER_KINEMATICS);
+	IMBuffer desired = imCreateBuffer(1000, IM_FORMAT_DATA_S16, IM_DOF_COUNT, 1);
+	std::vector<int16> axes;
+	for(int first=0; first<count; first+=(per_frame ? 1 : count)) {
+		const int frames = per_frame ? 1 : count;
+		IMBuffer buffer = imCreateBuffer(1000, IM_FORMAT_DATA_S16, channels, frames);
+		imBufferEnqueue(buffer, &poses[first * channels], frames * channels * (int32)sizeof(int16));
+		IMBuffer adjusted = 0;
+		imBufferConvert(buffer, &adjusted, desired, kinematics);
+		const int32 converted = adjusted ? imBufferGetQueuedCount(adjusted) : 0;
+		axes.resize(axes.size() + converted * IM_DOF_COUNT);
+		if(converted > 0)
+			imBufferDequeue(adjusted, &axes[axes.size() - converted * IM_DOF_COUNT], converted * IM_DOF_COUNT * (int32)sizeof(int16));
+		if(adjusted)
+			imDeleteBuffer(adjusted);
+		imDeleteBuffer(buffer);
+	}
+	imDeleteBuffer(desired);
+	imDeleteFilter(kinematics);
+	return axes;
+}
+
+int main(int argc, char *argv[])
+{
+	// 800 mm platform (stroke 200 mm)
+	MotionKinematics platform;
+	platform.Setup(800);
+	const IM_SIMD_KINEMATICS& k = platform.m_kinematics;
+
+	// random poses in the working range (+-100 mm, +-18 degree)
+	std::vector<float> frames(POSES * IM_DOF_COUNT), pose(POSES * IM_DOF_COUNT);
+	srand(1);
+	for(int f=0; f<POSES; f++) {
+		for(int i=0; i<IM_DOF_COUNT; i++) {
+			float value = (float)(rand() % 65536 - 32768) / 32768.0f;
+			frames[f * IM_DOF_COUNT + i] = value * ((i < IM_DOF_ROLL) ? 100.0f : (float)(18.0 * IM_PI / 180.0));
+			pose[i * POSES + f] = frames[f * IM_DOF_COUNT + i];
+		}
+	}
+
+	std::vector<float> expected(POSES * IM_DOF_COUNT), axis(POSES * IM_DOF_COUNT), first;
+	double ns = 0;
+	for(int n=0; n<ITERATIONS; n++) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		reference(&k, &frames[0], &expected[0], POSES);
+		ns += elapsed_ns(start);
+	}
+
+	printf("KINEMATICS (%d poses, ns per pose, max diff in samples against sinf/cosf)\n", POSES);
+	printf("%-8s %12s %12s %8s\n", "solver", "ns", "max diff", "exact");
+	printf("%-8s %12.2f %12s %8s\n", "pose", ns / ((double)ITERATIONS * POSES), "-", "-");
+	bool passed = true;
+	for(int level=IM_SIMD_SCALAR; level<IM_SIMD_COUNT; level++) {
+		const IM_SIMD_KERNELS* kernels = im_simd_kernels((IM_SIMD_LEVEL)level);
+		if(kernels == 0) {
+			printf("%-8s %12s\n", s_level_names[level], "-");
+			continue;
+		}
+		ns = 0;
+		for(int n=0; n<ITERATIONS; n++) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			kernels->kinematics(&k, &pose[0], &axis[0], POSES, POSES);
+			ns += elapsed_ns(start);
+		}
+		// short and odd counts take the tails
+		for(int count=1; count<=19; count++)
+			kernels->kinematics(&k, &pose[0], &axis[0], count, POSES);
+		double diff = 0;
+		for(int f=0; f<POSES; f++) {
+			for(int i=0; i<IM_DOF_COUNT; i++)
+				diff = fmax(diff, fabs(axis[i * POSES + f] - expected[f * IM_DOF_COUNT + i]));
+		}
+		if(level == IM_SIMD_SCALAR)
+			first = axis;
+		bool exact = memcmp(&first[0], &axis[0], sizeof(float) * axis.size()) == 0;
+		printf("%-8s %12.2f %12.4f %8s\n", s_level_names[level], ns / ((double)ITERATIONS * POSES), diff, exact ? "yes" : "NO");
+		passed = passed && exact;
+	}
+
+	// the stage in place : 3 channels are expanded, 6~8 channels are packed to the axes
+	printf("\nKINEMATICS stage (200 random poses through imBufferConvert, in one call against one frame at a time)\n");
+	printf("%-8s %12s %8s\n", "channels", "axes", "same");
+	const int channels[] = { 3, 6, 7, 8 };
+	for(int i=0; i<4; i++) {
+		std::vector<int16> batch = convert_poses(channels[i], 200, false), single = convert_poses(channels[i], 200, true);
+		int different = (batch.size() == single.size() && !batch.empty()) ? 0 : -1;
+		for(size_t n=0; different >= 0 && n<batch.size(); n++)
+			different += (batch[n] != single[n]);
+		printf("%-8d %12zu %8s\n", channels[i], batch.size(), different == 0 ? "yes" : "NO");
+		passed = passed && different == 0;
+	}
+
+	// forward kinematics of the axes of a washout-like trajectory (working range)
+	std::vector<float> poses(TRAJECTORY * IM_DOF_COUNT), axes(TRAJECTORY * IM_DOF_COUNT), soa(IM_DOF_COUNT);
+	for(int f=0; f<TRAJECTORY; f++) {
+		const double t = f / 1000.0;
+		for(int i=0; i<IM_DOF_COUNT; i++) {
+			double value = 0.6 * sin(2 * IM_PI * (0.3 + i * 0.17) * t + i) + 0.2 * sin(2 * IM_PI * (2.0 + i * 0.5) * t);
+			poses[f * IM_DOF_COUNT + i] = (float)(value * IM_SAMPLE_FULL_SCALE);
+			soa[i] = poses[f * IM_DOF_COUNT + i] * platform.m_scale[i];
+		}
+		im_simd()->kinematics(&k, &soa[0], &axes[f * IM_DOF_COUNT], 1, 1);
+	}
+	MotionKinematics forward;
+	forward.Setup(800);
+	float measured[IM_DOF_COUNT];
+	int iterations = 0, failed = 0;
+	double diff = 0;
+	ns = 0;
+	for(int f=0; f<TRAJECTORY; f++) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		int n = forward.Solve(&axes[f * IM_DOF_COUNT], measured);
+		ns += elapsed_ns(start);
+		if(n < 0)
+			failed++;
+		else
+			iterations += n;
+		for(int i=0; i<IM_DOF_COUNT; i++)
+			diff = fmax(diff, fabs(measured[i] - poses[f * IM_DOF_COUNT + i]));
+	}
+	printf("\nforward KINEMATICS (%d poses at 1 kHz, warm started)\n", TRAJECTORY);
+	printf("ns per pose %.1f, iterations %.2f, not converged %d, max diff %.4f samples\n",
+		ns / TRAJECTORY, (double)iterations / TRAJECTORY, failed, diff);
+	passed = passed && failed == 0;
+	return passed ? 0 : 1;
+}
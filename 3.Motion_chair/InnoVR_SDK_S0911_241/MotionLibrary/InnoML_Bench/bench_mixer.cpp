@@ -0,0 +1,162 @@
+/********************************************************************************//**
+\file      InnoML_Bench_bench_mixer.cpp
+\brief     Benchmark of the mixer tick by the number of playing sources (mixing kernel and engine).
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#include <stdio.h>		// for printf
+#include <stdlib.h>		// for rand
+#include <string.h>		// for memcmp
+#include <math.h>		// for sin
+#include <chrono>		// for timing
+#include <vector>
+#include "InnoML_internal.h"	// for the mixer (static build)
+#include "InnoML_simd.h"		// for the kernels (static build)
+
+#define SAMPLE_RATE		200
+#define CHANNELS		6
+#define TICK_FRAMES		16		// master samples per tick
+#define EFFECT_FRAMES	256		// frames of an effect (looped)
+#define TICKS			200
+
+static const char* s_level_names[IM_SIMD_COUNT] = { "scalar", "sse2", "avx2" };
+
+static double elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// the previous mixer: every source is added with a saturation
+static double bench_clamped(const std::vector<float>& sources, int count, const float* gains, std::vector<float>& mix)
+{
+	const int size = TICK_FRAMES * CHANNELS;
+	double ns = 0;
+	for(int t=0; t<TICKS; t++) {
+		mix.assign(size, 0.0f);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for(int s=0; s<count; s++) {
+			const float* src = &sources[s * size];
+			for(int i=0; i<size; i++)
+				mix[i] = MOTION_CLAMP(mix[i] + src[i] * gains[s], IM_SAMPLE_MIN, IM_SAMPLE_MAX);
+		}
+		ns += elapsed_ns(start);
+	}
+	return ns / TICKS;
+}
+
+// wide accumulation and a single saturation
+static double bench_wide(const IM_SIMD_KERNELS* kernels, const std::vector<float>& sources, int count, const float* gains, std::vector<float>& mix)
+{
+	const int size = TICK_FRAMES * CHANNELS;
+	float lower[IM_FORMAT_CHANNELS_MAX], upper[IM_FORMAT_CHANNELS_MAX];
+	for(int c=0; c<IM_FORMAT_CHANNELS_MAX; c++) {
+		lower[c] = IM_SAMPLE_MIN;
+		upper[c] = IM_SAMPLE_MAX;
+	}
+	double ns = 0;
+	for(int t=0; t<TICKS; t++) {
+		mix.assign(size, 0.0f);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for(int s=0; s<count; s++)
+			kernels->mix(&mix[0], &sources[s * size], size, gains[s]);
+		kernels->limit(&mix[0], TICK_FRAMES, CHANNELS, lower, upper);
+		ns += elapsed_ns(start);
+	}
+	return ns / TICKS;
+}
+
+// collision and vibration effects (imSourcePlay looped, volume 10..100)
+static IMBuffer create_effect(int index)
+{
+	IMBuffer buffer = imCreateBuffer(SAMPLE_RATE, IM_FORMAT_DATA_S16, CHANNELS, EFFECT_FRAMES);
+	int16 frame[CHANNELS];
+	for(int f=0; f<EFFECT_FRAMES; f++) {
+		for(int c=0; c<CHANNELS; c++)
+			frame[c] = (int16)(sin((f + index) * (0.05 + c * 0.01)) * 3000.0);
+		imBufferEnqueue(buffer, frame, sizeof(frame));
+	}
+	return buffer;
+}
+
+// ns per MotionContext::Tick with 'count' playing sources
+static double bench_engine(int count)
+{
+	IMBuffer master = imCreateBuffer(SAMPLE_RATE, IM_FORMAT_DATA_S16, CHANNELS, TICK_FRAMES);
+	IMContext ctx = imCreateContext(master);
+	imSetContext(ctx);
+
+	std::vector<IMBuffer> buffers;
+	std::vector<IMSource> sources;
+	for(int i=0; i<count; i++) {
+		buffers.push_back(create_effect(i));
+		sources.push_back(imCreateSource(buffers.back()));
+		imSourceSetVolume(sources.back(), 10 + i % 91);
+		imSourcePlay(sources.back(), IM_LOOP_INFINITE);
+	}
+
+	double ns = 0;
+	{
+		IM_API_LOCK();
+		MotionContext* context = im_lookup<MotionContext>(ctx);
+		context->Tick(); // warm up (decoders and vectors)
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for(int t=0; t<TICKS; t++)
+			context->Tick();
+		ns = elapsed_ns(start) / TICKS;
+		context->m_notify.clear();
+	}
+
+	imStopAllSources();
+	for(int i=0; i<count; i++) {
+		imDeleteSource(sources[i]);
+		imDeleteBuffer(buffers[i]);
+	}
+	imDestroyContext(ctx);
+	imDeleteBuffer(master);
+	return ns;
+}
+
+int main(int argc, char *argv[])
+{
+	const int counts[] = {1, 8, 32, 128, 512};
+	const int size = TICK_FRAMES * CHANNELS;
+
+	std::vector<float> sources(512 * size);
+	float gains[512];
+	srand(1);
+	for(size_t i=0; i<sources.size(); i++)
+		sources[i] = (float)(rand() % 8192 - 4096);
+	for(int s=0; s<512; s++)
+		gains[s] = (10 + s % 91) / 100.0f;
+
+	printf("mixing kernel (%d frames x %d channels per tick, ns per tick)\n", TICK_FRAMES, CHANNELS);
+	printf("%-8s %12s", "sources", "clamped");
+	for(int level=IM_SIMD_SCALAR; level<IM_SIMD_COUNT; level++)
+		printf(" %12s", s_level_names[level]);
+	printf(" %8s\n", "exact");
+	for(int i=0; i<5; i++) {
+		std::vector<float> reference, mix;
+		printf("%-8d %12.0f", counts[i], bench_clamped(sources, counts[i], gains, mix));
+		bool exact = true;
+		for(int level=IM_SIMD_SCALAR; level<IM_SIMD_COUNT; level++) {
+			const IM_SIMD_KERNELS* kernels = im_simd_kernels((IM_SIMD_LEVEL)level);
+			if(kernels == 0) {
+				printf(" %12s", "-");
+				continue;
+			}
+			printf(" %12.0f", bench_wide(kernels, sources, counts[i], gains, mix));
+			if(level == IM_SIMD_SCALAR)
+				reference = mix;
+			exact = exact && memcmp(&reference[0], &mix[0], sizeof(float) * size) == 0;
+		}
+		printf(" %8s\n", exact ? "yes" : "NO");
+	}
+
+	printf("\nengine tick (%d Hz, %d frames, looped S16 effects, ns per tick)\n", SAMPLE_RATE, TICK_FRAMES);
+	printf("%-8s %12s %12s\n", "sources", "tick", "per source");
+	for(int i=0; i<5; i++) {
+		double ns = bench_engine(counts[i]);
+		printf("%-8d %12.0f %12.1f\n", counts[i], ns, ns / counts[i]);
+	}
+	return 0;
+}
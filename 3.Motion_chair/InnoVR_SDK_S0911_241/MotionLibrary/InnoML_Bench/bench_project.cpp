@@ -0,0 +1,233 @@
+/********************************************************************************//**
+\file      InnoML_Bench_bench_project.cpp
+\brief     Benchmark of IMotion_LoadProject over the QEditor projects of the motion data and a long synthetic
+           timeline at several sample rates, with the checks of the keys against a csv of the key values, of the
+           high rate against the timeline rate, of imLoadBuffer against IMotion_LoadProject, and of the length
+           of the projects without a timeline end.
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#include <stdio.h>		// for printf
+#include <stdlib.h>		// for abs
+#include <string.h>		// for memcmp
+#include <math.h>		// for sin
+#include <chrono>		// for timing
+#include <filesystem>	// for the motion data files
+#include <string>
+#include <vector>
+#include <IMotion_csv.h>
+#include <InnoML.h>
+
+#define MOTION_DATA		"../../MotionData"
+#define LONG_PROJECT	"bench_project_long.qep"	// 1 hour of 6 layers
+#define KEYS_TRACK		"bench_project_keys.csv"	// the key values of the long project
+#define UNIT_RATE		50		// QEditor timeline units per second
+#define LAYERS			6
+#define SECONDS			3600
+#define KEY_UNITS		10		// units between the keys
+#define CLIP_KEYS		100
+#define BUDGET_NS		100e6	// per file and rate
+
+static double elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double key_value(int key, int layer)
+{
+	return floor(400.0 * sin(key * 0.37 + layer)) / 10;
+}
+
+// clips of CLIP_KEYS keys, sine and linear clips in turn, and a csv of the values at the times of the keys
+static void write_long_project(const char* filename, const char* keys)
+{
+	FILE* fp = fopen(filename, "wb");
+	FILE* csv = fopen(keys, "wb");
+	if(fp == 0 || csv == 0) {
+		if(fp)
+			fclose(fp);
+		if(csv)
+			fclose(csv);
+		return;
+	}
+	const int key_count = SECONDS * UNIT_RATE / KEY_UNITS;
+	fprintf(fp, "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<QEProject version=\"0.7\">\n");
+	fprintf(fp, "\t<Project limit_data=\"1\" middle_time_intact=\"1\" time_way=\"1\" lock=\"0\"/>\n");
+	fprintf(fp, "\t<Timeline start=\"0\" end=\"%d\"/>\n", SECONDS * UNIT_RATE);
+	for(int l=0; l<LAYERS; l++) {
+		fprintf(fp, "\t<Layer name=\"Layer%d\" joy=\"%d\" max=\"100\" min=\"-100\">\n", l, l);
+		for(int k=0; k<key_count; k++) {
+			if(k % CLIP_KEYS == 0)
+				fprintf(fp, "\t\t<Clip start=\"%d\" linear=\"%d\">\n", k * KEY_UNITS, (k / CLIP_KEYS) & 1);
+			fprintf(fp, "\t\t\t<Cycle arrow=\"%d\" data=\"%g\" ratio=\"%d\" size=\"%d\"/>\n", k & 3, key_value(k, l), KEY_UNITS, KEY_UNITS);
+			if(k % CLIP_KEYS == CLIP_KEYS - 1 || k == key_count - 1)
+				fprintf(fp, "\t\t</Clip>\n");
+		}
+		fprintf(fp, "\t</Layer>\n");
+	}
+	fprintf(fp, "</QEProject>\n");
+	for(int k=0; k<key_count; k++) {
+		fprintf(csv, "%d", k * KEY_UNITS * 1000 / UNIT_RATE);
+		for(int l=0; l<LAYERS; l++)
+			fprintf(csv, ",%g", key_value(k, l));
+		fprintf(csv, "\n");
+	}
+	fclose(fp);
+	fclose(csv);
+}
+
+typedef struct {
+	int					result;
+	IM_FORMAT			format;
+	std::vector<int16>	frames;
+} PROJECT;
+
+static PROJECT compile(const char* filename, uint32 sample_rate)
+{
+	PROJECT project;
+	uint8* motion = 0;
+	uint32 motion_len = 0;
+	project.result = IMotion_LoadProject(filename, &project.format, &motion, &motion_len, sample_rate);
+	if(project.result)
+		project.frames.assign((const int16*)motion, (const int16*)(motion + motion_len));
+	IMotion_FreeCSV(motion);
+	return project;
+}
+
+// the frames of the high rate at the times of the timeline rate, within a quantization step (the sine is rotated)
+static bool same_at_unit_times(const PROJECT& unit, const PROJECT& high)
+{
+	const uint32 channels = unit.format.nChannels;
+	const uint32 step = high.format.nSampleRate / unit.format.nSampleRate;
+	if(!unit.result || !high.result || high.format.nChannels != channels || high.frames.size() != unit.frames.size() * step)
+		return false;
+	for(size_t f=0; f<unit.frames.size() / channels; f++) {
+		for(uint32 c=0; c<channels; c++) {
+			if(abs(unit.frames[f * channels + c] - high.frames[f * step * channels + c]) > 1)
+				return false;
+		}
+	}
+	return true;
+}
+
+// the frames of imLoadBuffer without a context (the timeline rate) against IMotion_LoadProject
+static bool same_as_buffer(const char* filename, const PROJECT& unit)
+{
+	IMBuffer buffer = imLoadBuffer(filename);
+	if(buffer == 0)
+		return false;
+	int32 sample_rate = 0, format = 0, channels = 0, samples = 0;
+	imBufferGetFormat(buffer, &sample_rate, &format, &channels, &samples);
+	std::vector<int16> frames(unit.frames.size());
+	bool same = (uint32)sample_rate == unit.format.nSampleRate && (uint32)channels == unit.format.nChannels
+		&& imBufferGetQueuedCount(buffer) * channels == (int32)frames.size();
+	if(same) {
+		imBufferDequeue(buffer, &frames[0], (int32)(frames.size() * sizeof(int16)));
+		same = (frames == unit.frames);
+	}
+	imDeleteBuffer(buffer);
+	return same;
+}
+
+// the frames of the long project at the times of the keys against the csv of the key values
+static bool same_as_keys(const PROJECT& unit, const char* keys)
+{
+	IM_FORMAT format;
+	uint8* motion = 0;
+	uint32 motion_len = 0;
+	if(!IMotion_LoadCSV(keys, &format, &motion, &motion_len, 0))
+		return false;
+	const int16* key = (const int16*)motion;
+	const uint32 channels = unit.format.nChannels;
+	const size_t key_count = motion_len / format.nBlockAlign;
+	bool same = unit.result && format.nChannels == channels && key_count * KEY_UNITS == unit.frames.size() / channels;
+	for(size_t k=0; same && k<key_count; k++)
+		same = memcmp(&unit.frames[k * KEY_UNITS * channels], &key[k * channels], channels * sizeof(int16)) == 0;
+	IMotion_FreeCSV(motion);
+	return same;
+}
+
+// projects without <Timeline end> : the frames end at the last rendered key (units of the keys and the hold of the last key)
+static bool check_length()
+{
+	static const struct {
+		const char*	project;
+		int			units;
+	} s_projects[] = {
+		{ "<QEProject><Layer><Clip start=\"0\"><Cycle data=\"10\" size=\"5\"/><Cycle data=\"20\"/></Clip></Layer></QEProject>", 6 },
+		{ "<QEProject><Layer><Clip start=\"0\"><Cycle data=\"10\" size=\"50\"/><Cycle data=\"-10\" size=\"30\"/><Cycle data=\"0\"/></Clip></Layer>"
+			"<Layer><Clip start=\"20\"><Cycle data=\"5\" size=\"10\"/><Cycle data=\"0\"/></Clip></Layer></QEProject>", 81 },
+		{ "<QEProject><Layer><Clip start=\"100\"><Cycle data=\"10\" size=\"7\"/></Clip></Layer></QEProject>", 107 },
+	};
+	const uint32 rates[] = { UNIT_RATE, 200, 1000 };
+	bool passed = true;
+	printf("PROJECT LENGTH (no <Timeline end>, frames against the units of the keys)\n");
+	printf("%-8s %6s %10s %10s %6s\n", "project", "rate", "frames", "expected", "same");
+	for(size_t i=0; i<sizeof(s_projects) / sizeof(s_projects[0]); i++) {
+		for(size_t r=0; r<sizeof(rates) / sizeof(rates[0]); r++) {
+			IM_FORMAT format;
+			uint8* motion = 0;
+			uint32 motion_len = 0;
+			const int result = IMotion_LoadProject_RAW(s_projects[i].project, (int)strlen(s_projects[i].project), &format, &motion, &motion_len, rates[r]);
+			const uint32 frames = result ? motion_len / format.nBlockAlign : 0;
+			const uint32 expected = s_projects[i].units * rates[r] / UNIT_RATE;
+			printf("%-8zu %6u %10u %10u %6s\n", i, rates[r], frames, expected, frames == expected ? "yes" : "NO");
+			passed = passed && frames == expected;
+			IMotion_FreeCSV(motion);
+		}
+	}
+	printf("\n");
+	return passed;
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<std::string> files;
+	std::error_code error;
+	for(std::filesystem::recursive_directory_iterator it(argc > 1 ? argv[1] : MOTION_DATA, error), end; !error && it != end; it.increment(error)) {
+		if(it->is_regular_file() && it->path().extension() == ".qep")
+			files.push_back(it->path().string());
+	}
+	write_long_project(LONG_PROJECT, KEYS_TRACK);
+	files.push_back(LONG_PROJECT);
+
+	bool passed = check_length();
+	const uint32 rates[] = { UNIT_RATE, 200, 1000 };
+	printf("PROJECT COMPILE (ms per file, MB/s of the project text)\n");
+	printf("%-48s %10s %6s %6s %10s %10s %10s %10s %6s %6s %6s\n", "file", "bytes", "layers", "rate", "frames", "ms", "MB/s", "Mframes/s", "rate", "buffer", "keys");
+	for(size_t i=0; i<files.size(); i++) {
+		const char* filename = files[i].c_str();
+		std::error_code size_error;
+		const double bytes = (double)std::filesystem::file_size(filename, size_error);
+		const PROJECT unit = compile(filename, 0);
+		const bool buffer = same_as_buffer(filename, unit);
+		const bool keys = (files[i] == LONG_PROJECT) ? same_as_keys(unit, KEYS_TRACK) : true;
+		passed = passed && unit.result && buffer && keys;
+		for(size_t r=0; r<sizeof(rates) / sizeof(rates[0]); r++) {
+			const PROJECT project = compile(filename, rates[r]);
+			const bool rate = same_at_unit_times(unit, project);
+			passed = passed && rate;
+
+			double ns = 0;
+			int n = 0;
+			do {
+				IM_FORMAT format;
+				uint8* motion = 0;
+				uint32 motion_len = 0;
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				IMotion_LoadProject(filename, &format, &motion, &motion_len, rates[r]);
+				ns += elapsed_ns(start);
+				IMotion_FreeCSV(motion);
+				n++;
+			} while(ns < BUDGET_NS && n < 1000);
+			ns /= n;
+
+			const size_t frames = project.result ? project.frames.size() / project.format.nChannels : 0;
+			printf("%-48s %10.0f %6d %6u %10zu %10.3f %10.1f %10.1f %6s %6s %6s\n", r == 0 ? filename : "", bytes, (int)project.format.nChannels,
+				rates[r], frames, ns / 1e6, bytes / ns * 1e3, frames / ns * 1e3, rate ? "yes" : "NO", r ? "" : (buffer ? "yes" : "NO"), r ? "" : (keys ? "yes" : "NO"));
+		}
+	}
+	remove(LONG_PROJECT);
+	remove(KEYS_TRACK);
+	return passed ? 0 : 1;
+}
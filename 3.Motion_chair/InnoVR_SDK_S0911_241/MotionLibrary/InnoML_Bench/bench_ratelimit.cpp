@@ -0,0 +1,175 @@
+/********************************************************************************//**
+\file      InnoML_Bench_bench_ratelimit.cpp
+\brief     Fuzzed equivalence and benchmark of the RATELIMIT kernels (scalar, SSE2, AVX2) against the per channel loop.
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#include <stdio.h>		// for printf
+#include <stdlib.h>		// for rand
+#include <string.h>		// for memcmp
+#include <math.h>		// for INFINITY
+#include <chrono>		// for timing
+#include <vector>
+#include "InnoML_simd.h"	// for the kernels (static build)
+
+#define FUZZ_CASES		2000
+#define FRAMES			4096
+#define ITERATIONS		500
+
+static const char* s_level_names[IM_SIMD_COUNT] = { "scalar", "sse2", "avx2" };
+
+static double elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// the previous stage : one channel at a time with the branches (bound < 0 : bypass)
+static void reference(float* data, int frames, int channels, const float* bound, float* last)
+{
+	for(int c=0; c<channels; c++) {
+		if(bound[c] < 0)
+			continue;
+		float prev = last[c];
+		for(int f=0; f<frames; f++) {
+			float* value = data + f * channels + c;
+			float delta = *value - prev;
+			if(delta > bound[c])
+				*value = prev + bound[c];
+			else if(delta < -bound[c])
+				*value = prev - bound[c];
+			prev = *value;
+		}
+		last[c] = prev;
+	}
+}
+
+static float random_sample()
+{
+	switch(rand() % 8) {
+	case 0:		return (float)(rand() % 65536 - 32768);	// full scale steps
+	case 1:		return 0.0f;
+	case 2:		return -0.0f;
+	default:	return (float)(rand() % 2001 - 1000) * 0.37f;
+	}
+}
+
+static float random_bound()
+{
+	switch(rand() % 6) {
+	case 0:		return -1.0f;	// bypass
+	case 1:		return 0.0f;
+	case 2:		return (float)(rand() % 100) * 0.001f;
+	default:	return (float)(rand() % 4096) * 0.25f;
+	}
+}
+
+// random channels, frames, bounds and block splits : every level against the previous stage
+static bool fuzz(const IM_SIMD_KERNELS* kernels)
+{
+	srand(7);
+	for(int n=0; n<FUZZ_CASES; n++) {
+		const int channels = 1 + rand() % IM_FORMAT_CHANNELS_MAX;
+		const int frames = 1 + rand() % 300;
+		float bound[IM_FORMAT_CHANNELS_MAX], limit[IM_FORMAT_CHANNELS_MAX];
+		float last[IM_FORMAT_CHANNELS_MAX], expected_last[IM_FORMAT_CHANNELS_MAX];
+		for(int c=0; c<IM_FORMAT_CHANNELS_MAX; c++) {
+			bound[c] = random_bound();
+			limit[c] = (bound[c] < 0) ? INFINITY : bound[c];
+			last[c] = expected_last[c] = random_sample();
+		}
+		std::vector<float> data(frames * channels);
+		for(size_t i=0; i<data.size(); i++)
+			data[i] = random_sample();
+		std::vector<float> expected(data);
+		reference(&expected[0], frames, channels, bound, expected_last);
+
+		for(int f=0; f<frames; ) {
+			int block = 1 + rand() % 40;
+			if(block > frames - f)
+				block = frames - f;
+			kernels->ratelimit(&data[f * channels], block, channels, limit, last);
+			f += block;
+		}
+		for(int c=0; c<channels; c++) {
+			if(bound[c] < 0)
+				last[c] = expected_last[c]; // the bypass follows the input in the kernels
+		}
+		if(memcmp(&expected[0], &data[0], sizeof(float) * data.size()) != 0 || memcmp(expected_last, last, sizeof(float) * channels) != 0) {
+			printf("case %d : %d channels, %d frames differ\n", n, channels, frames);
+			return false;
+		}
+	}
+	return true;
+}
+
+static double bench_reference(int channels, const float* bound, const std::vector<float>& input)
+{
+	std::vector<float> data(input);
+	float last[IM_FORMAT_CHANNELS_MAX] = {0};
+	double ns = 0;
+	for(int i=0; i<ITERATIONS; i++) {
+		memcpy(&data[0], &input[0], sizeof(float) * data.size());
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		reference(&data[0], FRAMES, channels, bound, last);
+		ns += elapsed_ns(start);
+	}
+	return ns / ((double)ITERATIONS * FRAMES);
+}
+
+static double bench_level(const IM_SIMD_KERNELS* kernels, int channels, const float* bound, const std::vector<float>& input)
+{
+	std::vector<float> data(input);
+	float last[IM_FORMAT_CHANNELS_MAX] = {0};
+	double ns = 0;
+	for(int i=0; i<ITERATIONS; i++) {
+		memcpy(&data[0], &input[0], sizeof(float) * data.size());
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		kernels->ratelimit(&data[0], FRAMES, channels, bound, last);
+		ns += elapsed_ns(start);
+	}
+	return ns / ((double)ITERATIONS * FRAMES);
+}
+
+int main(int argc, char *argv[])
+{
+	const int channels[] = {3, 6, 8};
+	bool passed = true;
+
+	printf("RATELIMIT fuzzed equivalence (%d cases, random channels, frames, bounds and blocks)\n", FUZZ_CASES);
+	for(int level=IM_SIMD_SCALAR; level<IM_SIMD_COUNT; level++) {
+		const IM_SIMD_KERNELS* kernels = im_simd_kernels((IM_SIMD_LEVEL)level);
+		if(kernels == 0) {
+			printf("%-8s %s\n", s_level_names[level], "-");
+			continue;
+		}
+		bool exact = fuzz(kernels);
+		printf("%-8s %s\n", s_level_names[level], exact ? "same" : "DIFF");
+		passed = passed && exact;
+	}
+
+	// 256 per msec at 1 kHz on the full scale steps of a seat
+	float bound[IM_FORMAT_CHANNELS_MAX];
+	for(int c=0; c<IM_FORMAT_CHANNELS_MAX; c++)
+		bound[c] = 256.0f;
+	printf("\nRATELIMIT (%d frames, ns per frame)\n", FRAMES);
+	printf("%-10s %12s", "channels", "channel");
+	for(int level=IM_SIMD_SCALAR; level<IM_SIMD_COUNT; level++)
+		printf(" %12s", s_level_names[level]);
+	printf("\n");
+	for(int i=0; i<3; i++) {
+		std::vector<float> input(FRAMES * channels[i]);
+		srand(1);
+		for(size_t k=0; k<input.size(); k++)
+			input[k] = random_sample();
+		printf("%-10d %12.3f", channels[i], bench_reference(channels[i], bound, input));
+		for(int level=IM_SIMD_SCALAR; level<IM_SIMD_COUNT; level++) {
+			const IM_SIMD_KERNELS* kernels = im_simd_kernels((IM_SIMD_LEVEL)level);
+			if(kernels == 0)
+				printf(" %12s", "-");
+			else
+				printf(" %12.3f", bench_level(kernels, channels[i], bound, input));
+		}
+		printf("\n");
+	}
+	return passed ? 0 : 1;
+}
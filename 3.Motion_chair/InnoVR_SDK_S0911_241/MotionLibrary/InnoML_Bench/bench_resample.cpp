@@ -0,0 +1,112 @@
+/********************************************************************************//**
+\file      InnoML_Bench_bench_resample.cpp
+\brief     Benchmark of the rate conversion of imBufferConvert (zero-order hold and polyphase windowed-sinc)
+           with the error on a sine and the delay of a stream per configuration. The error must drop as the taps
+           grow, down to the quantization of the samples.
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#include <stdio.h>		// for printf
+#include <math.h>		// for sin
+#include <chrono>		// for timing
+#include <vector>
+#include "InnoML_filter.h"	// for the resampler (static build)
+
+#define SECONDS			20
+#define ITERATIONS		20
+#define FREQUENCY		1.5		// Hz (body motion, below the nyquist frequency of 50 Hz)
+#define AMPLITUDE		16000.0
+#define ERROR_FLOOR		2.5		// samples (rounding of the S16 input and output)
+
+static double elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int32 power_of_2(int32 count)
+{
+	int32 size = 1;
+	while(size < count)
+		size <<= 1;
+	return size;
+}
+
+// converts a sine of 'SECONDS' and returns ns per output frame (max error in samples, skipping the edges)
+static double bench_convert(int32 src_rate, int32 dst_rate, int32 taps, double* error)
+{
+	const int32 channels = IM_FORMAT_CHANNELS_DEFAULT;
+	const int32 count = src_rate * SECONDS;
+	std::vector<int16> samples(count * channels);
+	for(int32 f=0; f<count; f++) {
+		for(int32 c=0; c<channels; c++)
+			samples[f * channels + c] = (int16)lrint(AMPLITUDE * sin(2 * IM_PI * FREQUENCY * f / src_rate + c));
+	}
+	IMBuffer buffer = imCreateBuffer(src_rate, IM_FORMAT_DATA_S16, channels, power_of_2(count));
+	IMBuffer desired = imCreateBuffer(dst_rate, IM_FORMAT_DATA_S16, channels, 1);
+	IMFilter filter = imCreateFilter(IM_FILTER_RESAMPLE);
+	IM_FILTER_RESAMPLE_PARAMS params = { taps, 0.9f };
+	imFilterSetParams(filter, &params, sizeof(params));
+	imBufferEnqueue(buffer, &samples[0], (int32)(samples.size() * sizeof(int16)));
+
+	double ns = 0;
+	int32 frames = 0;
+	IMBuffer adjusted = 0;
+	for(int i=0; i<ITERATIONS; i++) {
+		if(adjusted)
+			imDeleteBuffer(adjusted);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		imBufferConvert(buffer, &adjusted, desired, filter);
+		ns += elapsed_ns(start);
+	}
+	frames = imBufferGetQueuedCount(adjusted);
+
+	std::vector<int16> out(frames * channels);
+	imBufferDequeue(adjusted, &out[0], (int32)(out.size() * sizeof(int16)));
+	const int32 edge = MOTION_MAX(src_rate, dst_rate) / 2; // half a second
+	*error = 0;
+	for(int32 f=edge; f<frames-edge; f++) {
+		for(int32 c=0; c<channels; c++) {
+			double expected = AMPLITUDE * sin(2 * IM_PI * FREQUENCY * f / dst_rate + c);
+			*error = MOTION_MAX(*error, fabs(out[f * channels + c] - expected));
+		}
+	}
+	imDeleteBuffer(adjusted);
+	imDeleteBuffer(buffer);
+	imDeleteBuffer(desired);
+	imDeleteFilter(filter);
+	return ns / ((double)ITERATIONS * frames);
+}
+
+int main(int argc, char *argv[])
+{
+	static const int32 rates[][2] = { { 60, 200 }, { 60, 50 }, { 200, 60 }, { 50, 200 }, { 1000, 60 }, { 60, 1000 } };
+	static const int32 taps[] = { 0, 4, 8, 16, 32 };
+
+	const size_t taps_count = sizeof(taps)/sizeof(taps[0]);
+	bool passed = true;
+
+	printf("RESAMPLE (%.1f Hz sine, %d channels, %d seconds, imBufferConvert)\n", FREQUENCY, IM_FORMAT_CHANNELS_DEFAULT, SECONDS);
+	printf("%-12s %6s %8s %12s %12s %12s %6s\n", "rates", "taps", "window", "ns/frame", "delay (ms)", "max error", "drops");
+	for(size_t r=0; r<sizeof(rates)/sizeof(rates[0]); r++) {
+		double last = 0;
+		for(size_t t=0; t<taps_count; t++) {
+			// the delay of a stream (inputs, sources) is half of the window
+			MotionResampler resampler;
+			IM_FILTER_RESAMPLE_PARAMS params = { taps[t], 0.9f };
+			resampler.Build(rates[r][0], rates[r][1], &params);
+			double delay = (resampler.m_taps / 2) * 1000.0 / rates[r][0];
+
+			double error;
+			double ns = bench_convert(rates[r][0], rates[r][1], taps[t], &error);
+			char name[32];
+			snprintf(name, sizeof(name), "%d->%d", rates[r][0], rates[r][1]);
+			// below the last taps or at the floor (the longest window reaches the floor)
+			bool drops = t == 0 || error < last || error <= ERROR_FLOOR;
+			drops = drops && (t + 1 < taps_count || error <= ERROR_FLOOR);
+			printf("%-12s %6d %8d %12.2f %12.1f %12.1f %6s\n", name, taps[t], resampler.m_taps, ns, delay, error, drops ? "yes" : "NO");
+			passed = passed && drops;
+			last = error;
+		}
+	}
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,88 @@
+/********************************************************************************//**
+\file      InnoML_Bench_bench_simd.cpp
+\brief     Benchmark of the SCALE, OFFSET and LIMIT kernels (scalar, SSE2, AVX2) with a bit-exact check.
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#include <stdio.h>		// for printf
+#include <stdlib.h>		// for rand
+#include <string.h>		// for memcmp
+#include <math.h>		// for NAN
+#include <chrono>		// for timing
+#include <vector>
+#include "InnoML_simd.h"	// for the kernels (static build)
+
+#define FRAMES			4099	// not a multiple of the vector groups (checks the tails)
+#define ITERATIONS		2000
+
+static const char* s_level_names[IM_SIMD_COUNT] = { "scalar", "sse2", "avx2" };
+
+static double elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// working range samples with the edge values of the clamp
+static void fill(std::vector<float>& data)
+{
+	srand(1);
+	for(size_t i=0; i<data.size(); i++)
+		data[i] = (float)(rand() % 131072 - 65536) * 0.75f;
+	data[1] = NAN;
+	data[2] = -0.0f;
+	data[3] = 0.0f;
+	data[4] = 1e30f;
+	data[5] = -1e30f;
+}
+
+// ns per frame of scale + offset + limit, and whether the result is bit-exact with the scalar kernels
+static double bench_level(const IM_SIMD_KERNELS* kernels, int channels, const std::vector<float>& input, std::vector<float>& output)
+{
+	float scale[IM_FORMAT_CHANNELS_MAX], offset[IM_FORMAT_CHANNELS_MAX], min[IM_FORMAT_CHANNELS_MAX], max[IM_FORMAT_CHANNELS_MAX];
+	for(int c=0; c<IM_FORMAT_CHANNELS_MAX; c++) {
+		scale[c] = 0.5f + c * 0.25f;
+		offset[c] = c * 100.0f - 300.0f;
+		min[c] = -32768.0f + c * 1000.0f;
+		max[c] = (c == 2) ? 0.0f : 32767.0f - c * 1000.0f;
+	}
+
+	std::vector<float> data(input.begin(), input.begin() + FRAMES * channels);
+	double ns = 0;
+	for(int i=0; i<ITERATIONS; i++) {
+		memcpy(&data[0], &input[0], sizeof(float) * data.size());
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		kernels->scale(&data[0], FRAMES, channels, scale);
+		kernels->offset(&data[0], FRAMES, channels, offset);
+		kernels->limit(&data[0], FRAMES, channels, min, max);
+		ns += elapsed_ns(start);
+	}
+	output = data;
+	return ns / ((double)ITERATIONS * FRAMES);
+}
+
+int main(int argc, char *argv[])
+{
+	const int channels[] = {3, 6, 8};
+	std::vector<float> input(FRAMES * IM_FORMAT_CHANNELS_MAX);
+	fill(input);
+
+	printf("SCALE + OFFSET + LIMIT (%d frames, ns per frame)\n", FRAMES);
+	printf("%-10s %-8s %12s %8s\n", "channels", "level", "ns", "exact");
+	for(int i=0; i<3; i++) {
+		std::vector<float> reference;
+		for(int level=IM_SIMD_SCALAR; level<IM_SIMD_COUNT; level++) {
+			const IM_SIMD_KERNELS* kernels = im_simd_kernels((IM_SIMD_LEVEL)level);
+			if(kernels == 0) {
+				printf("%-10d %-8s %12s %8s\n", channels[i], s_level_names[level], "-", "-");
+				continue;
+			}
+			std::vector<float> output;
+			double ns = bench_level(kernels, channels[i], input, output);
+			if(level == IM_SIMD_SCALAR)
+				reference = output;
+			bool exact = memcmp(&reference[0], &output[0], sizeof(float) * output.size()) == 0;
+			printf("%-10d %-8s %12.3f %8s\n", channels[i], s_level_names[level], ns, exact ? "yes" : "NO");
+		}
+	}
+	return 0;
+}
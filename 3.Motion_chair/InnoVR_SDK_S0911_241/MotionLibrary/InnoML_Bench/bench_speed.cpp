@@ -0,0 +1,182 @@
+/********************************************************************************//**
+\file      InnoML_Bench_bench_speed.cpp
+\brief     Check and benchmark of the playback speed of a source (imSourceSetSpeedFactor) : fractional speeds,
+           speed ramps, the interpolation at the loop seam and steps longer than the loop, against a reference
+           player of the play position.
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#include <stdio.h>		// for printf
+#include <math.h>		// for floor, fabs
+#include <chrono>		// for timing
+#include <vector>
+#include "InnoML_internal.h"	// for the mixer (static build)
+
+#define SAMPLE_RATE		100
+#define TICK_FRAMES		10		// master samples per tick
+#define FRAME_VALUE		10		// value of a source frame per frame index (a ramp is interpolated exactly)
+#define TOLERANCE		0.01
+
+static double elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+typedef struct {
+	int			frames;			/**< frames of the buffer */
+	int			loop_begin;
+	int			loop_end;		/**< 0 : no loop points */
+	int			loop_count;
+	float		speed;
+	int			ticks;
+} PLAY_CASE;
+
+typedef struct {
+	std::vector<float> out;
+	int			loops;			/**< IM_END_OF_LOOP */
+	int			ends;			/**< IM_END_OF_STREAM */
+	uint64		pos_max;		/**< play position (32.32) */
+	double		ns;				/**< per tick */
+} PLAY_RESULT;
+
+static void on_state(void* obj, uint32 state)
+{
+	PLAY_RESULT* result = (PLAY_RESULT*)obj;
+	if(state == IM_END_OF_LOOP)
+		result->loops++;
+	else if(state == IM_END_OF_STREAM)
+		result->ends++;
+}
+
+static IMBuffer create_ramp(int frames)
+{
+	std::vector<int16> samples(frames);
+	for(int f=0; f<frames; f++)
+		samples[f] = (int16)(f * FRAME_VALUE);
+	IMBuffer buffer = imCreateBuffer(SAMPLE_RATE, IM_FORMAT_DATA_S16, 1, frames);
+	imBufferEnqueue(buffer, &samples[0], frames * (int32)sizeof(int16));
+	return buffer;
+}
+
+// ticks of the mixer of a context, the source with a speed 'ramp' (msec) from 1 to the speed of the case when 'ramp' > 0
+static PLAY_RESULT play(const PLAY_CASE& c, int ramp, bool* ramp_reached)
+{
+	IMBuffer master = imCreateBuffer(SAMPLE_RATE, IM_FORMAT_DATA_S16, 1, TICK_FRAMES);
+	IMContext ctx = imCreateContext(master);
+	imSetContext(ctx);
+	IMBuffer buffer = create_ramp(c.frames);
+	if(c.loop_end)
+		imBufferSetLoop(buffer, c.loop_begin, c.loop_end);
+	IMSource source = imCreateSource(buffer);
+	PLAY_RESULT result;
+	result.loops = result.ends = 0;
+	result.pos_max = 0;
+	imSourcePlay(source, c.loop_count, on_state, &result);
+	imSourceSetSpeedFactor(source, ramp ? 1.0f : c.speed, 0);
+	if(ramp)
+		imSourceSetSpeedFactor(source, c.speed, ramp);
+
+	const int ramp_frames = ramp * SAMPLE_RATE / 1000;
+	uint64 step_last = 0;
+	bool monotonic = true;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(int t=0; t<c.ticks; t++) {
+		IM_API_LOCK();
+		MotionContext* context = im_lookup<MotionContext>(ctx);
+		MotionSource* motion_source = im_lookup<MotionSource>(source);
+		context->Tick();
+		result.out.insert(result.out.end(), context->m_mix.begin(), context->m_mix.end());
+		for(size_t i=0; i<context->m_notify.size(); i++)
+			context->m_notify[i].func(context->m_notify[i].obj, context->m_notify[i].state);
+		context->m_notify.clear();
+		result.pos_max = MOTION_MAX(result.pos_max, motion_source->m_pos);
+		if(ramp && (t + 1) * TICK_FRAMES <= ramp_frames) {
+			monotonic = monotonic && motion_source->m_step > step_last;
+			step_last = motion_source->m_step;
+		}
+		else if(ramp && ramp_reached && (t + 1) * TICK_FRAMES == ramp_frames + TICK_FRAMES)
+			*ramp_reached = monotonic && motion_source->m_ramp == 0 && motion_source->m_step == motion_source->m_step_target;
+	}
+	result.ns = elapsed_ns(start) / c.ticks;
+
+	imStopAllSources();
+	imDeleteSource(source);
+	imDeleteBuffer(buffer);
+	imDestroyContext(ctx);
+	imDeleteBuffer(master);
+	return result;
+}
+
+// the reference player : the position in double, the loops passed by a step, the seam toward the loop begin
+static bool same_as_reference(const PLAY_CASE& c, const PLAY_RESULT& result, double* error)
+{
+	const int loop_begin = c.loop_end ? c.loop_begin : 0, loop_end = c.loop_end ? c.loop_end : c.frames;
+	const int length = loop_end - loop_begin;
+	double pos = 0;
+	int loops = 0;
+	*error = 0;
+	for(size_t f=0; f<result.out.size(); f++) {
+		bool looping = c.loop_count == IM_LOOP_INFINITE || loops < c.loop_count;
+		int index = (int)floor(pos);
+		if(looping && index >= loop_end) {
+			int k = (index - loop_begin) / length;
+			if(c.loop_count != IM_LOOP_INFINITE)
+				k = MOTION_MIN(k, c.loop_count - loops);
+			loops += k;
+			pos -= (double)k * length;
+			index = (int)floor(pos);
+			looping = c.loop_count == IM_LOOP_INFINITE || loops < c.loop_count;
+		}
+		if(index >= c.frames)
+			break; // (the rest of the ticks is silence)
+		const int next = (looping && index + 1 == loop_end) ? loop_begin : MOTION_MIN(index + 1, c.frames - 1);
+		const double t = pos - index;
+		const double expected = (index + (next - index) * t) * FRAME_VALUE;
+		*error = fmax(*error, fabs(result.out[f] - expected));
+		pos += c.speed;
+	}
+	return *error < TOLERANCE && (c.loop_count == IM_LOOP_INFINITE || result.loops == MOTION_MIN(loops, c.loop_count));
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct {
+		const char*	name;
+		PLAY_CASE	c;
+	} s_cases[] = {
+		{ "fraction 0.37",			{ 1000, 0, 0, 0, 0.37f, 200 } },
+		{ "fraction 2.71",			{ 3000, 0, 0, 0, 2.71f, 100 } },
+		{ "seam 0.5",				{ 30, 10, 30, IM_LOOP_INFINITE, 0.5f, 40 } },
+		{ "seam 0.3 x3",			{ 60, 20, 40, 3, 0.3f, 100 } },
+		{ "step 7.5 > loop 3 x5",	{ 40, 10, 13, 5, 7.5f, 10 } },
+		{ "step 64 > loop 5 inf",	{ 40, 10, 15, IM_LOOP_INFINITE, 64.0f, 100 } },
+	};
+	bool passed = true;
+	printf("SPEED (1 channel ramp at %d Hz, the mixed frames against the reference player)\n", SAMPLE_RATE);
+	printf("%-24s %10s %8s %10s %12s %10s %6s\n", "case", "frames", "loops", "max pos", "max error", "ns/tick", "same");
+	for(size_t i=0; i<sizeof(s_cases) / sizeof(s_cases[0]); i++) {
+		const PLAY_CASE& c = s_cases[i].c;
+		PLAY_RESULT result = play(c, 0, 0);
+		double error;
+		bool same = same_as_reference(c, result, &error);
+		// the position stays within a step past the loop (or the buffer) whatever the step
+		const int end = (c.loop_end && c.loop_count == IM_LOOP_INFINITE) ? c.loop_end : c.frames;
+		same = same && (double)result.pos_max / ((uint64)1 << IM_SOURCE_PHASE_BITS) <= end + c.speed;
+		printf("%-24s %10zu %8d %10.1f %12.5f %10.1f %6s\n", s_cases[i].name, result.out.size(), result.loops,
+			(double)result.pos_max / ((uint64)1 << IM_SOURCE_PHASE_BITS), error, result.ns, same ? "yes" : "NO");
+		passed = passed && same;
+	}
+
+	// ramp from 1 to 3 over 500 msec : the step grows every frame and reaches the target at the end of the ramp
+	PLAY_CASE c = { 3000, 0, 0, 0, 3.0f, 60 };
+	bool reached = false;
+	PLAY_RESULT result = play(c, 500, &reached);
+	const int after = 500 * SAMPLE_RATE / 1000 + TICK_FRAMES;
+	bool constant = true;
+	for(size_t f=after + 1; f<result.out.size(); f++)
+		constant = constant && fabs(result.out[f] - result.out[f - 1] - 3.0 * FRAME_VALUE) < TOLERANCE;
+	printf("\n%-24s %10s %10s\n", "ramp 1 -> 3 (500 ms)", "target", "speed");
+	printf("%-24s %10s %10s\n", "", reached ? "yes" : "NO", constant ? "yes" : "NO");
+	passed = passed && reached && constant;
+	return passed ? 0 : 1;
+}
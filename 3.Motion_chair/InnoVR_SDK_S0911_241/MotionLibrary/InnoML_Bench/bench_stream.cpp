@@ -0,0 +1,144 @@
+/********************************************************************************//**
+\file      InnoML_Bench_bench_stream.cpp
+\brief     Benchmark of imLoadBufferStream against imLoadBuffer on a long track (time to the first playable
+           frame and memory), and of the playback of the stream against the loaded buffer (loops included).
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#include <stdio.h>		// for printf
+#include <string.h>		// for memcmp
+#include <math.h>		// for sin
+#include <chrono>		// for timing
+#include <thread>		// for the wait of the decoder
+#include <vector>
+#include <IMotion_csv.h>
+#include "InnoML_internal.h"	// for the mixer (static build)
+
+#define LONG_TRACK		"bench_stream_long.csv"	// 10 minutes at 1 kHz
+#define BINARY_TRACK	"bench_stream_long.imb"
+#define SAMPLE_RATE		1000
+#define CHANNELS		6
+#define SECONDS			600
+#define TICK_FRAMES		10		// master samples per tick
+#define PLAY_SECONDS	60		// compared playback
+#define LOOP_BEGIN		2000	// frames
+#define LOOP_END		7000
+#define LOOP_COUNT		3
+
+static double elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void write_long_track(const char* filename)
+{
+	FILE* fp = fopen(filename, "wb");
+	if(fp == 0)
+		return;
+	for(int f=0; f<SAMPLE_RATE*SECONDS; f++) {
+		fprintf(fp, "%d", f);
+		for(int c=0; c<CHANNELS; c++)
+			fprintf(fp, ",%.7g", 90.0 * sin(f * 0.001 * (c + 1)));
+		fprintf(fp, "\n");
+	}
+	fclose(fp);
+}
+
+static void on_loop(void* obj, uint32 state)
+{
+	if(state == IM_END_OF_LOOP)
+		(*(int*)obj)++;
+}
+
+// plays the buffer for PLAY_SECONDS and returns the mixed frames (a stream is waited for like a real-time mixer would be)
+static std::vector<float> play(IMBuffer buffer, bool stream, int* loops, int* waits, double* ms)
+{
+	IMBuffer master = imCreateBuffer(SAMPLE_RATE, IM_FORMAT_DATA_S16, CHANNELS, TICK_FRAMES);
+	IMContext ctx = imCreateContext(master);
+	imSetContext(ctx);
+	IMSource source = imCreateSource(buffer);
+	imBufferSetLoop(buffer, LOOP_BEGIN, LOOP_END);
+	*loops = 0;
+	*waits = 0;
+	imSourcePlay(source, LOOP_COUNT, on_loop, loops);
+
+	std::vector<float> out;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(int t=0; t<SAMPLE_RATE*PLAY_SECONDS/TICK_FRAMES; t++) {
+		IM_STREAM_INFO info;
+		while(stream && imBufferGetStreamInfo(buffer, &info) == IM_OK && info.nQueued < TICK_FRAMES * 2 && !info.bEnded) {
+			(*waits)++;
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+		IM_API_LOCK();
+		MotionContext* context = im_lookup<MotionContext>(ctx);
+		context->Tick();
+		out.insert(out.end(), context->m_mix.begin(), context->m_mix.end());
+		for(size_t i=0; i<context->m_notify.size(); i++)
+			context->m_notify[i].func(context->m_notify[i].obj, context->m_notify[i].state);
+		context->m_notify.clear();
+	}
+	*ms = elapsed_ns(start) / 1e6;
+
+	imStopAllSources();
+	imDeleteSource(source);
+	imDestroyContext(ctx);
+	imDeleteBuffer(master);
+	return out;
+}
+
+int main(int argc, char *argv[])
+{
+	write_long_track(LONG_TRACK);
+	IM_FORMAT format;
+	uint8* motion = 0;
+	uint32 motion_len = 0;
+	if(!IMotion_LoadCSV(LONG_TRACK, &format, &motion, &motion_len, 0) || !IMotion_SaveMotion(BINARY_TRACK, &format, motion, motion_len, 0, 0)) {
+		printf("can not write the long track\n");
+		return 1;
+	}
+	IMotion_FreeCSV(motion);
+
+	const char* files[] = { LONG_TRACK, BINARY_TRACK };
+	bool passed = true;
+	printf("LOAD (%d seconds at %d Hz, %d channels : ms until the buffer can be played, KB of the frames in memory)\n", SECONDS, SAMPLE_RATE, CHANNELS);
+	printf("%-24s %12s %10s %12s %10s %8s\n", "file", "load (ms)", "KB", "stream (ms)", "KB", "faster");
+	for(int i=0; i<2; i++) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		IMBuffer loaded = imLoadBuffer(files[i]);
+		double load_ms = elapsed_ns(start) / 1e6;
+		start = std::chrono::steady_clock::now();
+		IMBuffer streamed = imLoadBufferStream(files[i]);
+		double stream_ms = elapsed_ns(start) / 1e6;
+
+		IM_STREAM_INFO info;
+		imBufferGetStreamInfo(streamed, &info);
+		const double load_kb = (double)imBufferGetQueuedCount(loaded) * format.nBlockAlign / 1024;
+		const double stream_kb = (double)info.nCapacity * format.nBlockAlign / 1024;
+		printf("%-24s %12.3f %10.0f %12.3f %10.0f %7.0fx\n", files[i], load_ms, load_kb, stream_ms, stream_kb, load_ms / stream_ms);
+		passed = passed && loaded && streamed;
+		imDeleteBuffer(loaded);
+		imDeleteBuffer(streamed);
+	}
+
+	printf("\nPLAYBACK (%d seconds, loop %d..%d frames x %d, the stream against the loaded buffer tick by tick)\n", PLAY_SECONDS, LOOP_BEGIN, LOOP_END, LOOP_COUNT);
+	printf("%-24s %10s %10s %10s %10s %10s %8s\n", "file", "load (ms)", "stream", "loops", "waits", "underruns", "same");
+	for(int i=0; i<2; i++) {
+		IMBuffer loaded = imLoadBuffer(files[i]);
+		IMBuffer streamed = imLoadBufferStream(files[i]);
+		int loops[2], waits[2];
+		double ms[2];
+		std::vector<float> reference = play(loaded, false, &loops[0], &waits[0], &ms[0]);
+		std::vector<float> out = play(streamed, true, &loops[1], &waits[1], &ms[1]);
+		IM_STREAM_INFO info;
+		imBufferGetStreamInfo(streamed, &info);
+		const bool same = reference.size() == out.size() && memcmp(&reference[0], &out[0], out.size() * sizeof(float)) == 0 && loops[0] == loops[1];
+		printf("%-24s %10.1f %10.1f %10d %10d %10u %8s\n", files[i], ms[0], ms[1], loops[1], waits[1], info.nUnderruns, same ? "yes" : "NO");
+		passed = passed && same && loops[1] == LOOP_COUNT;
+		imDeleteBuffer(loaded);
+		imDeleteBuffer(streamed);
+	}
+	remove(LONG_TRACK);
+	remove(BINARY_TRACK);
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,66 @@
+/********************************************************************************//**
+\file      InnoML_Bench_bench_timing.cpp
+\brief     Check of the mixer deadlines (imGetTimingInfo) of a running context with and without IM_CFG_PRECISE_TIMER :
+           the ticks of a few seconds against the elapsed time at the master buffer rate.
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#include <stdio.h>		// for printf
+#include <math.h>		// for fabs
+#include <chrono>		// for timing
+#include <thread>		// for sleep_for
+#include <InnoML.h>		// for motion
+
+#define SECONDS			2
+#define TOLERANCE		0.02	// ticks per expected ticks (the start and the stop of the mixer thread)
+
+static double elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// runs a context of the emulator for 'SECONDS' and gets its timing (elapsed seconds from imStart to imStop)
+static IM_TIMING_INFO run(int32 rate, int32 samples, bool precise, double* elapsed)
+{
+	IM_DEVICE_DESC desc;
+	imGetDescription(&desc, 1);
+	desc.nOptions = precise ? (desc.nOptions | IM_CFG_PRECISE_TIMER) : (desc.nOptions & ~IM_CFG_PRECISE_TIMER);
+	IMBuffer master = imCreateBuffer(rate, IM_FORMAT_DATA_S16, IM_FORMAT_CHANNELS_DEFAULT, samples);
+	IMContext ctx = imCreateContext(master, 0, &desc);
+	imSetContext(ctx);
+
+	IM_TIMING_INFO info;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	imStart(0, 0, 0, IM_DEVICE_MOVE_NONE);
+	std::this_thread::sleep_for(std::chrono::seconds(SECONDS));
+	imStop(IM_DEVICE_MOVE_NONE);
+	*elapsed = elapsed_ns(start) / 1e9;
+	imGetTimingInfo(&info);
+
+	imDestroyContext(ctx);
+	imDeleteBuffer(master);
+	return info;
+}
+
+int main(int argc, char *argv[])
+{
+	static const int32 configs[][2] = { { 1000, 1 }, { 1000, 10 }, { 200, 1 } };	// rate, samples per period
+	bool passed = true;
+
+	printf("MIXER TIMING (%d seconds per run, ticks against elapsed x rate / samples)\n", SECONDS);
+	printf("%-8s %8s %8s %10s %10s %8s %10s %10s %10s %10s %6s\n", "timer", "rate", "period", "ticks", "expected",
+		"missed", "late (us)", "avg (us)", "max (us)", "jitter", "same");
+	for(size_t i=0; i<sizeof(configs) / sizeof(configs[0]); i++) {
+		for(int p=0; p<2; p++) {
+			double elapsed;
+			const IM_TIMING_INFO info = run(configs[i][0], configs[i][1], p == 1, &elapsed);
+			const double expected = elapsed * configs[i][0] / configs[i][1];
+			// the skipped ticks are counted as missed
+			const bool same = fabs(info.nTicks + info.nMissed - expected) <= TOLERANCE * expected;
+			printf("%-8s %8d %8u %10u %10.0f %8u %10d %10d %10d %10d %6s\n", p ? "precise" : "sleep", configs[i][0], info.nPeriod,
+				info.nTicks, expected, info.nMissed, info.dLateness, info.dLatenessAvg, info.dLatenessMax, info.dJitterMax, same ? "yes" : "NO");
+			passed = passed && same;
+		}
+	}
+	return passed ? 0 : 1;
+}
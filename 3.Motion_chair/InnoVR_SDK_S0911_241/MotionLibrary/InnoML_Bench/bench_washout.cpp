@@ -0,0 +1,163 @@
+/********************************************************************************//**
+\file      InnoML_Bench_bench_washout.cpp
+\brief     Benchmark of the classical washout (IM_FILTER_CLASSIC) against the hand-built chains of main_filter : the
+           tilt-coordination of surge and sway, and their onset cue (high-pass -> acceleration to position).
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#include <stdio.h>		// for printf
+#include <math.h>		// for fabs
+#include <string.h>		// for memcpy
+#include <chrono>		// for timing
+#include <vector>
+#include "InnoML_internal.h"	// for the filter program (static build)
+
+#define CHANNELS		6
+#define BLOCK_FRAMES	256
+#define TOTAL_FRAMES	(1<<20)	// frames processed per measurement
+#define TOLERANCE		1e-3	// max diff of a channel per peak (float rounding of the two discretizations)
+
+static double elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// HIGHPASS -> INTEGRAL -> LOWPASS -> TILT (custom washout of main_filter), surge and sway tilted
+// HIGHPASS -> INTEGRAL ('onset'), surge and sway as acceleration -> position like heave
+static IMFilter create_chain(bool onset)
+{
+	IMFilter highpass = imCreateFilter(IM_FILTER_HIGHPASS);
+	IM_FILTER_HIGHPASS_PARAMS highpass_params[] = {{0},{0},{3,{1}},{2,{1}},{2,{1}},{0}};
+	IM_FILTER_INTEGRAL_PARAMS integrator_params[] = {0,0,2,1,1,0};
+	if(onset) {
+		highpass_params[IM_DOF_SURGE].nOrder = highpass_params[IM_DOF_SWAY].nOrder = 2;
+		highpass_params[IM_DOF_SURGE].fCutoffFrequency[0] = highpass_params[IM_DOF_SWAY].fCutoffFrequency[0] = 1;
+		integrator_params[IM_DOF_SURGE].nOrder = integrator_params[IM_DOF_SWAY].nOrder = 2;
+	}
+	imFilterSetParams(highpass, highpass_params, sizeof(IM_FILTER_HIGHPASS_PARAMS), 6);
+	IMFilter integrator = imCreateFilter(IM_FILTER_INTEGRAL);
+	imFilterSetParams(integrator, integrator_params, sizeof(IM_FILTER_INTEGRAL_PARAMS), 6);
+
+	IMFilter filter = imCreateFilter();
+	imFilterAppend(filter, highpass);
+	imFilterAppend(filter, integrator);
+	imDeleteFilter(highpass);
+	imDeleteFilter(integrator);
+	if(!onset) {
+		IMFilter lowpass = imCreateFilter(IM_FILTER_LOWPASS);
+		IM_FILTER_LOWPASS_PARAMS lowpass_params[] = {{2,{0.5f}},{2,{0.5f}},{0},{0},{0},{0}};
+		imFilterSetParams(lowpass, lowpass_params, sizeof(IM_FILTER_LOWPASS_PARAMS), 6);
+		IMFilter tilt = imCreateFilter(IM_FILTER_TILT);
+		imFilterAppend(filter, lowpass);
+		imFilterAppend(filter, tilt);
+		imDeleteFilter(lowpass);
+		imDeleteFilter(tilt);
+	}
+	return filter;
+}
+
+// the same washouts as one block
+static IMFilter create_classic(bool onset)
+{
+	IMFilter filter = imCreateFilter(IM_FILTER_CLASSIC);
+	IM_FILTER_CLASSIC_PARAMS params[] = {
+		{0, 1, 0, 2, 0.5f},	// surge : tilt only
+		{0, 1, 0, 2, 0.5f},	// sway : tilt only
+		{3, 1, 2, 0, 0},	// heave : acceleration -> position
+		{2, 1, 1, 0, 0},	// roll : angular velocity -> angle
+		{2, 1, 1, 0, 0},	// pitch : angular velocity -> angle
+		{0, 1, 0, 0, 0},	// yaw : unfiltered
+	};
+	if(onset) {
+		const IM_FILTER_CLASSIC_PARAMS translation = {2, 1, 2, 0, 0};	// acceleration -> position
+		params[IM_DOF_SURGE] = params[IM_DOF_SWAY] = translation;
+	}
+	imFilterSetParams(filter, params, sizeof(IM_FILTER_CLASSIC_PARAMS), 6);
+	return filter;
+}
+
+static void build(MotionFilterProgram* program, IMFilter filter, int rate)
+{
+	IM_FORMAT format;
+	im_format_set(&format, IM_FORMAT_TYPE_DOF, rate, CHANNELS, IM_FORMAT_DATA_S16);
+	IM_API_LOCK();
+	program->Build(im_lookup<MotionFilter>(filter), &format, &format);
+}
+
+// 1 second steps of surge (0.3 g), sway (-0.2 g), heave and roll rate, then 2 seconds of washout
+static void step_input(std::vector<float>& data, int rate)
+{
+	const int frames = rate * 3;
+	data.assign(frames * CHANNELS, 0.0f);
+	for(int f=0; f<rate; f++) {
+		data[f * CHANNELS + IM_DOF_SURGE] = 0.3f * IM_SAMPLE_FULL_SCALE;
+		data[f * CHANNELS + IM_DOF_SWAY] = -0.2f * IM_SAMPLE_FULL_SCALE;
+		data[f * CHANNELS + IM_DOF_HEAVE] = 8000.0f;
+		data[f * CHANNELS + IM_DOF_ROLL] = 4000.0f;
+	}
+}
+
+static double bench(IMFilter filter, int rate)
+{
+	MotionFilterProgram program;
+	build(&program, filter, rate);
+	// the step pattern repeated over the blocks
+	std::vector<float> step, input(BLOCK_FRAMES * 16 * CHANNELS), data(BLOCK_FRAMES * IM_FORMAT_CHANNELS_MAX);
+	step_input(step, rate);
+	for(size_t i=0; i<input.size(); i++)
+		input[i] = step[i % step.size()];
+	double ns = 0;
+	for(int done=0; done<TOTAL_FRAMES; done+=BLOCK_FRAMES) {
+		int offset = (done * CHANNELS) % (int)input.size();
+		memcpy(&data[0], &input[offset], sizeof(float) * BLOCK_FRAMES * CHANNELS);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		program.Process(&data[0], BLOCK_FRAMES);
+		ns += elapsed_ns(start);
+	}
+	return ns / TOTAL_FRAMES;
+}
+
+int main(int argc, char *argv[])
+{
+	const int rates[] = {50, 200};
+	static const char* names[CHANNELS] = { "surge", "sway", "heave", "roll", "pitch", "yaw" };
+	static const char* washouts[2] = { "tilt", "onset" };
+	bool passed = true;
+
+	for(int w=0; w<2; w++) {
+		IMFilter chain = create_chain(w == 1);
+		IMFilter classic = create_classic(w == 1);
+		for(int r=0; r<2; r++) {
+			// step responses
+			MotionFilterProgram a, b;
+			build(&a, chain, rates[r]);
+			build(&b, classic, rates[r]);
+			std::vector<float> input, chain_out, classic_out;
+			step_input(input, rates[r]);
+			chain_out = input;
+			classic_out = input;
+			chain_out.resize(input.size() + IM_FORMAT_CHANNELS_MAX);
+			classic_out.resize(input.size() + IM_FORMAT_CHANNELS_MAX);
+			const int frames = (int)input.size() / CHANNELS;
+			a.Process(&chain_out[0], frames);
+			b.Process(&classic_out[0], frames);
+
+			printf("step response of the %s washout (%d Hz, 3 s)\n", washouts[w], rates[r]);
+			printf("%-8s %12s %12s %6s\n", "channel", "peak", "max diff", "same");
+			for(int c=0; c<CHANNELS; c++) {
+				double peak = 0, diff = 0;
+				for(int f=0; f<frames; f++) {
+					peak = fmax(peak, fabs(chain_out[f * CHANNELS + c]));
+					diff = fmax(diff, fabs(chain_out[f * CHANNELS + c] - classic_out[f * CHANNELS + c]));
+				}
+				const bool same = diff <= TOLERANCE * fmax(peak, 1.0);
+				printf("%-8s %12.2f %12.4f %6s\n", names[c], peak, diff, same ? "yes" : "NO");
+				passed = passed && same;
+			}
+			printf("ns per frame : chain %.2f, classic %.2f\n\n", bench(chain, rates[r]), bench(classic, rates[r]));
+		}
+		imDeleteFilter(chain);
+		imDeleteFilter(classic);
+	}
+	return passed ? 0 : 1;
+}
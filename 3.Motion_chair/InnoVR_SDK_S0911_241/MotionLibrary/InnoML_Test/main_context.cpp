@@ -55,7 +55,8 @@ int main(int argc, char *argv[])
 	/*
 	Motion Resampling
 	For resampling, the number of context samples must be at least resample_rate ()
-	resample_rate = DST_SAMPLES / SRC_SAMPLES (x1, x2, x4, ...)
+	resample_rate = DST_SAMPLES / SRC_SAMPLES (any ratio : x2, x1/2, 60 -> 50, 60 -> 200, ...)
+	The resampler is tuned by IM_FILTER_RESAMPLE in the filter of imBufferConvert or the input.
 	*/
 	if(1) // Buffer Resample Test - rate(2x), duration (1sec)
 	{
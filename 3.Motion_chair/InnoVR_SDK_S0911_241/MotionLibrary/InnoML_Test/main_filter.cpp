@@ -320,18 +320,15 @@ int main(int argc, char *argv[])
 		IMFilter integrator = imCreateFilter(IM_FILTER_INTEGRAL);
 		IM_FILTER_INTEGRAL_PARAMS integrator_params[] = {0,0,2,1,1,0}; 
 		imFilterSetParams(integrator, integrator_params, sizeof(IM_FILTER_INTEGRAL_PARAMS), 6);	
-		// 2nd LPF (surge/sway acceleration)
-		IMFilter lowpass_filter = imCreateFilter(IM_FILTER_LOWPASS);
-		IM_FILTER_LOWPASS_PARAMS lowpass_params[] = {{5,2},{5,2},{0},{0},{0},{0}};
-		imFilterSetParams(lowpass_filter, lowpass_params, sizeof(IM_FILTER_LOWPASS_PARAMS), 6);
-		// tilt-coordination (add special force to pitch/roll)
+		// tilt-coordination (3rd LPF of surge/sway acceleration, add special force to pitch/roll)
 		IMFilter tilt_coordinator = imCreateFilter(IM_FILTER_TILT);
+		IM_FILTER_TILT_PARAMS tilt_params[] = {{3,2,0,0,90},{3,2,0,0,90}};
+		imFilterSetParams(tilt_coordinator, tilt_params, sizeof(IM_FILTER_TILT_PARAMS), 2);
 
 		// simulate cues of initial acceleration (translational and rotational)
 		imFilterAppend(custom_classical_washout, highpass_filter);	
 		imFilterAppend(custom_classical_washout, integrator);		
 		// simulate sustaining accelerations (G-Force)
-		imFilterAppend(custom_classical_washout, lowpass_filter);	
 		imFilterAppend(custom_classical_washout, tilt_coordinator);	
 		}
 
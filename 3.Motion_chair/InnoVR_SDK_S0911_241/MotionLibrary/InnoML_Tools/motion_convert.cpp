@@ -0,0 +1,350 @@
+/********************************************************************************//**
+\file      InnoML_Tools_motion_convert.cpp
+\brief     Batch converter of motion files (csv, or QEditor projects) to binary motion files (imb) that imLoadBuffer maps without a copy.
+           The files are converted by a pool of threads, optionally to another sample rate, channel count and data
+           format through a filter chain (imBufferConvert), and the throughput is reported.
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#include <stdio.h>		// for printf
+#include <stdlib.h>		// for atoi
+#include <string.h>		// for strcmp
+#include <algorithm>	// for sort
+#include <atomic>
+#include <chrono>		// for the throughput
+#include <filesystem>	// for the input and output paths
+#include <string>
+#include <thread>
+#include <vector>
+#include <IMotion_csv.h>
+#include <InnoML.h>
+
+/**
+ * Built-in filters of the command line. (the fields of the params structure in order, i : int32, f : float)
+ */
+static const struct {
+	const char*		name;
+	IM_FILTER_TYPE	type;
+	const char*		fields;
+} s_filters[] = {
+	{ "noise",		IM_FILTER_NOISE,		"i" },
+	{ "mean",		IM_FILTER_MEAN,			"i" },
+	{ "highpass",	IM_FILTER_HIGHPASS,		"ifff" },
+	{ "lowpass",	IM_FILTER_LOWPASS,		"ifff" },
+	{ "integral",	IM_FILTER_INTEGRAL,		"i" },
+	{ "tilt",		IM_FILTER_TILT,			"iffff" },
+	{ "scale",		IM_FILTER_SCALE,		"f" },
+	{ "offset",		IM_FILTER_OFFSET,		"f" },
+	{ "limit",		IM_FILTER_LIMIT,		"ii" },
+	{ "ratelimit",	IM_FILTER_RATELIMIT,	"i" },
+	{ "washout",	IM_FILTER_WASHOUT,		"f" },
+	{ "kinematics",	IM_FILTER_KINEMATICS,	"i" },
+	{ "resample",	IM_FILTER_RESAMPLE,		"if" },
+	{ "classic",	IM_FILTER_CLASSIC,		"ifiif" },
+};
+
+typedef struct {
+	int				filter;			/**< index in s_filters */
+	int				count;			/**< fields given (the others are the defaults) */
+	uint8			params[64];
+} FILTER_SPEC;
+
+typedef struct {
+	std::filesystem::path input;
+	std::filesystem::path output;
+	uint64			bytes;			/**< input file size */
+} CONVERT_JOB;
+
+typedef struct {
+	std::string		output_dir;
+	int				loop_msec[2];
+	int				sample_rate;	/**< 0 : the rate of the file */
+	int				channels;		/**< 0 : the channels of the file */
+	int				data_format;	/**< 0 : the data format of the file */
+	std::vector<FILTER_SPEC> filters;
+	bool			quiet;
+} CONVERT_OPTIONS;
+
+static void usage()
+{
+	printf("usage : motion_convert [options] <file.csv | file.qep | dir> ...\n");
+	printf("  -o  output directory (default : next to the input, a directory keeps its tree)\n");
+	printf("  -l  <begin>,<end> loop points in milliseconds\n");
+	printf("  -j  <threads> (default : the hardware threads)\n");
+	printf("  -r  <rate> sample rate of the output\n");
+	printf("  -c  <channels> channels of the output\n");
+	printf("  -d  <s8|s16|s32|f32|f64> data format of the output\n");
+	printf("  -f  <filter>[:<param>,...] filter of the chain, in order (params of all channels, the missing ones are the defaults)\n");
+	printf("      ");
+	for(size_t i=0; i<sizeof(s_filters) / sizeof(s_filters[0]); i++)
+		printf("%s%s", i ? " " : "", s_filters[i].name);
+	printf("\n  -q  no line per file\n");
+}
+
+static bool parse_filter(const char* text, FILTER_SPEC* spec)
+{
+	const char* colon = strchr(text, ':');
+	const size_t len = colon ? (size_t)(colon - text) : strlen(text);
+	memset(spec, 0, sizeof(*spec));
+	spec->filter = -1;
+	for(size_t i=0; i<sizeof(s_filters) / sizeof(s_filters[0]); i++) {
+		if(strlen(s_filters[i].name) == len && strncmp(s_filters[i].name, text, len) == 0)
+			spec->filter = (int)i;
+	}
+	if(spec->filter < 0)
+		return false;
+
+	const char* fields = s_filters[spec->filter].fields;
+	const char* p = colon;
+	while(p && fields[spec->count]) {
+		char* end;
+		uint8* field = spec->params + spec->count * 4;
+		if(fields[spec->count] == 'i') {
+			int32 value = (int32)strtol(p + 1, &end, 10);
+			memcpy(field, &value, sizeof(value));
+		}
+		else {
+			float value = strtof(p + 1, &end);
+			memcpy(field, &value, sizeof(value));
+		}
+		if(end == p + 1)
+			return false;
+		spec->count++;
+		p = (*end == ',') ? end : 0;
+		if(*end != ',' && *end != 0)
+			return false;
+	}
+	return p == 0;
+}
+
+static int parse_data_format(const char* text)
+{
+	static const struct { const char* name; int format; } formats[] = {
+		{ "s8", IM_FORMAT_DATA_S8 }, { "s16", IM_FORMAT_DATA_S16 }, { "s32", IM_FORMAT_DATA_S32 },
+		{ "f32", IM_FORMAT_DATA_F32 }, { "f64", IM_FORMAT_DATA_F64 },
+	};
+	for(size_t i=0; i<sizeof(formats) / sizeof(formats[0]); i++) {
+		if(strcmp(formats[i].name, text) == 0)
+			return formats[i].format;
+	}
+	return 0;
+}
+
+/**
+ * This function creates the filter chain of a worker. (0 : no filter)
+ */
+static IMFilter create_chain(const std::vector<FILTER_SPEC>& specs)
+{
+	if(specs.empty())
+		return 0;
+	IMFilter chain = imCreateFilter(IM_FILTER_DEFAULT);
+	for(size_t i=0; i<specs.size(); i++) {
+		const FILTER_SPEC& spec = specs[i];
+		const int32 size = (int32)strlen(s_filters[spec.filter].fields) * 4;
+		uint8 params[sizeof(spec.params)];
+		IMFilter filter = imCreateFilter(s_filters[spec.filter].type);
+		if(filter == 0 || imFilterGetParams(filter, params, size, 1) != IM_OK) {
+			imDeleteFilter(filter);
+			imDeleteFilter(chain);
+			return 0;
+		}
+		memcpy(params, spec.params, spec.count * 4);
+		imFilterSetParams(filter, params, size, 1);
+		imFilterAppend(chain, filter);
+		imDeleteFilter(filter); // the chain holds it
+	}
+	return chain;
+}
+
+/**
+ * This function loads a motion file. (a project is compiled at the output rate rather than resampled from the timeline rate)
+ */
+static IMBuffer load_file(const std::filesystem::path& input, const CONVERT_OPTIONS& options)
+{
+	if(input.extension() != ".qep")
+		return imLoadBuffer(input.string().c_str());
+	IM_FORMAT format;
+	uint8* motion = 0;
+	uint32 motion_len = 0;
+	if(!IMotion_LoadProject(input.string().c_str(), &format, &motion, &motion_len, options.sample_rate))
+		return 0;
+	IMBuffer buffer = imCreateBufferFromFormat(&format, motion_len / format.nBlockAlign, 1);
+	if(buffer)
+		imBufferEnqueue(buffer, motion, motion_len);
+	IMotion_FreeCSV(motion);
+	return buffer;
+}
+
+/**
+ * This function converts a motion file and writes the binary motion file. (returns the bytes written, 0 : failed)
+ */
+static uint64 convert_file(const CONVERT_JOB& job, const CONVERT_OPTIONS& options, IMFilter chain, std::vector<uint8>& data)
+{
+	const std::string input = job.input.string(), output = job.output.string();
+	IMBuffer buffer = load_file(job.input, options);
+	if(buffer == 0) {
+		printf("%s : not a motion file (or encrypted)\n", input.c_str());
+		return 0;
+	}
+	IM_FORMAT format;
+	imBufferGetInfo(buffer, &format, 0, 0);
+	const int32 frames = imBufferGetQueuedCount(buffer);
+	int32 loop_begin = (int32)((int64)options.loop_msec[0] * format.nSampleRate / 1000);
+	int32 loop_end = (int32)MOTION_MIN((int64)options.loop_msec[1] * format.nSampleRate / 1000, (int64)frames);
+	if(loop_begin < loop_end)
+		imBufferSetLoop(buffer, loop_begin, loop_end);
+
+	// conversion to the output format through the chain (compiled once by the thread)
+	if(options.sample_rate || options.channels || options.data_format || chain) {
+		IMBuffer desired = imCreateBuffer(options.sample_rate ? options.sample_rate : format.nSampleRate,
+			options.data_format ? options.data_format : format.nDataFormat, options.channels ? options.channels : format.nChannels, 1);
+		IMBuffer converted = 0;
+		imBufferConvert(buffer, &converted, desired, chain);
+		imDeleteBuffer(desired);
+		imDeleteBuffer(buffer);
+		buffer = converted;
+		if(buffer == 0) {
+			printf("%s : can not convert to the output format\n", input.c_str());
+			return 0;
+		}
+		imBufferGetInfo(buffer, &format, 0, 0);
+	}
+
+	const int32 size = imBufferGetQueuedCount(buffer) * format.nBlockAlign;
+	data.resize(size > 0 ? size : 1);
+	imBufferDequeue(buffer, &data[0], size);
+	imBufferGetLoop(buffer, &loop_begin, &loop_end);
+	imDeleteBuffer(buffer);
+
+	std::error_code error;
+	std::filesystem::create_directories(job.output.parent_path(), error);
+	if(!IMotion_SaveMotion(output.c_str(), &format, &data[0], (uint32)size, loop_begin, loop_end)) {
+		printf("%s : can not write %s\n", input.c_str(), output.c_str());
+		return 0;
+	}
+	if(!options.quiet)
+		printf("%s -> %s (%u Hz, %u channels, %u frames)\n", input.c_str(), output.c_str(), format.nSampleRate, format.nChannels, size / format.nBlockAlign);
+	const uint64 written = std::filesystem::file_size(job.output, error);
+	return error ? 1 : written;
+}
+
+/**
+ * This function adds the jobs of an input. (the csv files of a directory and its subdirectories : a project is
+ * converted when it is named, as it is saved next to the csv that QEditor renders from it)
+ */
+static void add_jobs(const char* input, const std::string& output_dir, std::vector<CONVERT_JOB>& jobs)
+{
+	std::filesystem::path root(input);
+	std::error_code error;
+	std::vector<std::filesystem::path> files;
+	if(std::filesystem::is_directory(root, error)) {
+		for(std::filesystem::recursive_directory_iterator it(root, error), end; !error && it != end; it.increment(error)) {
+			if(it->is_regular_file() && it->path().extension() == ".csv")
+				files.push_back(it->path());
+		}
+	}
+	else
+		files.push_back(root);
+
+	for(size_t i=0; i<files.size(); i++) {
+		CONVERT_JOB job;
+		job.input = files[i];
+		if(output_dir.empty())
+			job.output = files[i].parent_path() / files[i].stem();
+		else if(files[i] == root)
+			job.output = std::filesystem::path(output_dir) / files[i].stem();
+		else
+			job.output = std::filesystem::path(output_dir) / files[i].lexically_relative(root).parent_path() / files[i].stem();
+		job.output += ".imb";
+		job.bytes = std::filesystem::file_size(files[i], error);
+		if(error)
+			job.bytes = 0;
+		jobs.push_back(job);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<const char*> inputs;
+	CONVERT_OPTIONS options;
+	options.loop_msec[0] = options.loop_msec[1] = 0;
+	options.sample_rate = options.channels = options.data_format = 0;
+	options.quiet = false;
+	int threads = (int)std::thread::hardware_concurrency();
+	bool valid = true;
+	for(int i=1; i<argc && valid; i++) {
+		if(strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			options.output_dir = argv[++i];
+		else if(strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+			sscanf(argv[++i], "%d,%d", &options.loop_msec[0], &options.loop_msec[1]);
+		else if(strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+			threads = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+			valid = (options.sample_rate = atoi(argv[++i])) > 0;
+		else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+			valid = (options.channels = atoi(argv[++i])) > 0 && options.channels <= IM_FORMAT_CHANNELS_MAX;
+		else if(strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+			valid = (options.data_format = parse_data_format(argv[++i])) != 0;
+		else if(strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+			FILTER_SPEC spec;
+			valid = parse_filter(argv[++i], &spec);
+			options.filters.push_back(spec);
+		}
+		else if(strcmp(argv[i], "-q") == 0)
+			options.quiet = true;
+		else if(argv[i][0] == '-')
+			valid = false;
+		else
+			inputs.push_back(argv[i]);
+	}
+	if(!valid || inputs.empty()) {
+		usage();
+		return 1;
+	}
+
+	// the largest files first, so a thread does not end the batch with a long file
+	std::vector<CONVERT_JOB> jobs;
+	for(size_t i=0; i<inputs.size(); i++)
+		add_jobs(inputs[i], options.output_dir, jobs);
+	std::stable_sort(jobs.begin(), jobs.end(), [](const CONVERT_JOB& a, const CONVERT_JOB& b) { return a.bytes > b.bytes; });
+	if((size_t)threads > jobs.size())
+		threads = (int)jobs.size();
+	if(threads < 1)
+		threads = 1;
+	IMFilter chain = create_chain(options.filters); // the params are checked once
+	if(!options.filters.empty() && chain == 0) {
+		printf("can not create the filter chain\n");
+		return 1;
+	}
+	imDeleteFilter(chain);
+
+	std::atomic<size_t> next(0);
+	std::atomic<int> failed(0);
+	std::atomic<uint64> bytes_in(0), bytes_out(0);
+	std::vector<std::thread> pool;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(int t=0; t<threads; t++) {
+		pool.push_back(std::thread([&]() {
+			IMFilter chain = create_chain(options.filters);
+			std::vector<uint8> data;
+			for(size_t i=next++; i<jobs.size(); i=next++) {
+				uint64 written = convert_file(jobs[i], options, chain, data);
+				if(written == 0) {
+					failed++;
+					continue;
+				}
+				bytes_in += jobs[i].bytes;
+				bytes_out += written;
+			}
+			imDeleteFilter(chain);
+		}));
+	}
+	for(size_t t=0; t<pool.size(); t++)
+		pool[t].join();
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	const int converted = (int)jobs.size() - failed;
+	printf("%d files converted, %d failed, %d threads : %.3f s, %.1f files/s, %.1f MB/s read, %.1f MB/s written\n",
+		converted, failed.load(), threads, seconds, converted / seconds, bytes_in / seconds / 1e6, bytes_out / seconds / 1e6);
+	return failed ? 1 : 0;
+}
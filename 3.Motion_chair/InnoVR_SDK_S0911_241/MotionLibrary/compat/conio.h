@@ -0,0 +1,31 @@
+/********************************************************************************//**
+\file      conio.h
+\brief     Minimal console shim to build the InnoML samples on POSIX systems.
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#ifndef INNO_ML_COMPAT_CONIO_H
+#define INNO_ML_COMPAT_CONIO_H
+
+#include <poll.h>
+#include <stdio.h>
+#include <unistd.h>
+
+/**
+ * This function checks whether the standard input is readable. (line buffered, end of file is a key)
+ */
+static inline int kbhit()
+{
+	struct pollfd fd;
+	fd.fd = STDIN_FILENO;
+	fd.events = POLLIN;
+	fd.revents = 0;
+	return (poll(&fd, 1, 0) > 0) ? 1 : 0;
+}
+
+static inline int getch()
+{
+	return getchar();
+}
+
+#endif // INNO_ML_COMPAT_CONIO_H
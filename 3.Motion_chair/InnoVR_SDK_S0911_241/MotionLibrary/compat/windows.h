@@ -0,0 +1,145 @@
+/********************************************************************************//**
+\file      windows.h
+\brief     Minimal Win32 shim to build the InnoML samples on POSIX systems.
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#ifndef INNO_ML_COMPAT_WINDOWS_H
+#define INNO_ML_COMPAT_WINDOWS_H
+
+#if defined(_WIN32)
+#	error "use the platform windows.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef void*			HANDLE;
+typedef unsigned long	DWORD;
+typedef int				BOOL;
+
+#define INFINITE				0xFFFFFFFF
+#define INVALID_HANDLE_VALUE	((HANDLE)(long)-1)
+#define PAGE_READWRITE			0x04
+#define FILE_MAP_ALL_ACCESS		0xF001F
+
+/**
+ * Kernel object behind a HANDLE (semaphore or named shared memory).
+ */
+typedef struct {
+	int		type;		/**< 1 : semaphore, 2 : file mapping */
+	sem_t	sem;
+	int		fd;
+	size_t	size;
+	char	name[256];
+} COMPAT_HANDLE;
+
+static inline void Sleep(DWORD msec)
+{
+	struct timespec ts;
+	ts.tv_sec = msec / 1000;
+	ts.tv_nsec = (long)(msec % 1000) * 1000000L;
+	while(nanosleep(&ts, &ts) == -1 && errno == EINTR) {}
+}
+
+static inline DWORD timeGetTime()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (DWORD)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+static inline DWORD GetLastError()
+{
+	return (DWORD)errno;
+}
+
+static inline HANDLE CreateSemaphore(void* attributes, long initial, long maximum, const char* name)
+{
+	COMPAT_HANDLE* handle = (COMPAT_HANDLE*)calloc(1, sizeof(COMPAT_HANDLE));
+	handle->type = 1;
+	if(sem_init(&handle->sem, 0, (unsigned int)initial) != 0) {
+		free(handle);
+		return NULL;
+	}
+	return handle;
+}
+
+static inline BOOL ReleaseSemaphore(HANDLE h, long count, long* previous)
+{
+	COMPAT_HANDLE* handle = (COMPAT_HANDLE*)h;
+	for(long i=0; i<count; i++)
+		sem_post(&handle->sem);
+	return 1;
+}
+
+static inline DWORD WaitForSingleObject(HANDLE h, DWORD msec)
+{
+	COMPAT_HANDLE* handle = (COMPAT_HANDLE*)h;
+	if(msec == INFINITE) {
+		while(sem_wait(&handle->sem) == -1 && errno == EINTR) {}
+		return 0;
+	}
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += msec / 1000;
+	ts.tv_nsec += (long)(msec % 1000) * 1000000L;
+	if(ts.tv_nsec >= 1000000000L) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000L;
+	}
+	return (sem_timedwait(&handle->sem, &ts) == 0) ? 0 : 0x102; // WAIT_TIMEOUT
+}
+
+static inline HANDLE CreateFileMapping(HANDLE file, void* attributes, DWORD protect, DWORD size_high, DWORD size_low, const char* name)
+{
+	COMPAT_HANDLE* handle = (COMPAT_HANDLE*)calloc(1, sizeof(COMPAT_HANDLE));
+	handle->type = 2;
+	handle->size = size_low;
+	snprintf(handle->name, sizeof(handle->name), "/%s", name ? name : "compat");
+	handle->fd = shm_open(handle->name, O_RDWR | O_CREAT, 0600);
+	if(handle->fd < 0 || ftruncate(handle->fd, handle->size) != 0) {
+		if(handle->fd >= 0)
+			close(handle->fd);
+		free(handle);
+		return NULL;
+	}
+	return handle;
+}
+
+static inline void* MapViewOfFile(HANDLE h, DWORD access, DWORD offset_high, DWORD offset_low, size_t bytes)
+{
+	COMPAT_HANDLE* handle = (COMPAT_HANDLE*)h;
+	void* view = mmap(NULL, handle->size, PROT_READ | PROT_WRITE, MAP_SHARED, handle->fd, 0);
+	return (view == MAP_FAILED) ? NULL : view;
+}
+
+static inline BOOL UnmapViewOfFile(const void* view)
+{
+	// the mapping size is not known here, the view is released with the process
+	return 1;
+}
+
+static inline BOOL CloseHandle(HANDLE h)
+{
+	COMPAT_HANDLE* handle = (COMPAT_HANDLE*)h;
+	if(handle == NULL)
+		return 0;
+	if(handle->type == 1)
+		sem_destroy(&handle->sem);
+	else if(handle->type == 2) {
+		close(handle->fd);
+		shm_unlink(handle->name);
+	}
+	free(handle);
+	return 1;
+}
+
+#endif // INNO_ML_COMPAT_WINDOWS_H
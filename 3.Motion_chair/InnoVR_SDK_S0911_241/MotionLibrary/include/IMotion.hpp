@@ -10,7 +10,9 @@
 #include "IMotion_types.h"
 
 #ifndef IM_DRIVER_STATIC_LIB
-#	ifdef IM_DRIVER_EXPORTS
+#	if !defined(_WIN32)
+#		define IM_DRIVER_DLL_API __attribute__((visibility("default")))
+#	elif defined(IM_DRIVER_EXPORTS)
 #		define IM_DRIVER_DLL_API __declspec(dllexport)
 #	else
 #		define IM_DRIVER_DLL_API __declspec(dllimport)
@@ -14,7 +14,9 @@ extern "C"{
 #endif	
 	
 #ifndef IM_DRIVER_STATIC_LIB
-#	ifdef IM_DRIVER_EXPORTS
+#	if !defined(_WIN32)
+#		define IM_DRIVER_DLL_API __attribute__((visibility("default")))
+#	elif defined(IM_DRIVER_EXPORTS)
 #		define IM_DRIVER_DLL_API __declspec(dllexport)
 #	else
 #		define IM_DRIVER_DLL_API __declspec(dllimport)
@@ -44,6 +46,99 @@ IM_DRIVER_DLL_API int IMotion_FreeCSV(uint8 * motion_buf);
  */
 IM_DRIVER_DLL_API int IMotion_SaveCSV(const char* filename, const IM_FORMAT* format, const uint8 * motion_buf, uint32 motion_len, const char* key);
 
+/**
+ *  \name IM_MOTION_FILE_*
+ *
+ *  Declare the binary motion file layout. (little-endian, ".imb")
+ *  (The header is followed by the interleaved samples at nDataOffset, so a mapped file is used as the
+ *   frames of a motion buffer without a copy.)
+ */
+#define IM_MOTION_FILE_MAGIC		"IMMB"
+#define IM_MOTION_FILE_VERSION		1
+#define IM_MOTION_FILE_ALIGN		64		/**< alignment of the samples in the file */
+
+typedef struct {
+	char		cMagic[4];		/**< IM_MOTION_FILE_MAGIC */
+	uint32		nVersion;		/**< IM_MOTION_FILE_VERSION */
+	IM_FORMAT	format;			/**< format of the samples */
+	uint32		nFrames;		/**< frames of the samples */
+	uint32		nLoopBegin;		/**< first frame of the loop */
+	uint32		nLoopEnd;		/**< end frame of the loop (0 : no loop points) */
+	uint32		nDataOffset;	/**< offset of the samples from the start of the file (IM_MOTION_FILE_ALIGN) */
+	uint32		nReserved[5];
+} IM_MOTION_FILE_HEADER;
+
+/**
+ * Binary motion file in memory. (See IMotion_MapMotion)
+ */
+typedef struct {
+	IM_MOTION_FILE_HEADER header;
+	uint8*		pData;			/**< samples (nFrames * nBlockAlign bytes, copy-on-write if mapped) */
+	void*		pMemory;		/**< mapping or allocation of the file (0 : memory of the caller) */
+	uint32		nMemorySize;
+	int32		bMapped;
+} IM_MOTION_FILE;
+
+/**
+ * This function checks the header of the binary motion file memory and points the samples in it.
+ * (Note, the memory of the caller is not copied, IMotion_UnmapMotion does not free it.)
+ */
+IM_DRIVER_DLL_API int IMotion_ParseMotion(const void* data, int size, IM_MOTION_FILE* file);
+
+/**
+ * This function maps the binary motion file of the file name. (The samples are paged in when they are read.)
+ */
+IM_DRIVER_DLL_API int IMotion_MapMotion(const char* filename, IM_MOTION_FILE* file);
+
+/**
+ * This function unmaps the binary motion file.
+ */
+IM_DRIVER_DLL_API int IMotion_UnmapMotion(IM_MOTION_FILE* file);
+
+/**
+ * This function saves motion data as a binary motion file name. (loop_end 0 : no loop points)
+ */
+IM_DRIVER_DLL_API int IMotion_SaveMotion(const char* filename, const IM_FORMAT* format, const uint8 * motion_buf, uint32 motion_len, uint32 loop_begin, uint32 loop_end);
+
+/**
+ * Reader of a motion file in parts. (See IMotion_OpenMotion)
+ */
+typedef struct IM_MOTION_READER IM_MOTION_READER;
+
+/**
+ * This function opens a motion file (csv, binary) to read its frames in parts.
+ * (Note, 'frames' gets 0 for a csv file, its length is known at its end. The loop points are those of a binary motion file.)
+ */
+IM_DRIVER_DLL_API IM_MOTION_READER* IMotion_OpenMotion(const char* filename, IM_FORMAT* format, uint32 * frames, uint32 * loop_begin, uint32 * loop_end, const char* key);
+
+/**
+ * This function reads the next frames (up to 'frames') and returns the frames read. (0 : end of the file, -1 : error)
+ */
+IM_DRIVER_DLL_API int IMotion_ReadMotion(IM_MOTION_READER* reader, uint8 * motion_buf, uint32 frames);
+
+/**
+ * This function moves the reader to a frame.
+ * (Note, a csv file parses the rows before the frame again from the closest seek point, every 4096 frames read so far.)
+ */
+IM_DRIVER_DLL_API int IMotion_SeekMotion(IM_MOTION_READER* reader, uint32 frame);
+
+/**
+ * This function closes the reader.
+ */
+IM_DRIVER_DLL_API int IMotion_CloseMotion(IM_MOTION_READER* reader);
+
+/**
+ * This function compiles a QEditor project (.qep) to motion data at the sample rate. (0 : the timeline rate, 50 Hz)
+ * (Note, the layers are the channels in their order, the keys of the clips are interpolated at the sample rate.
+ *  Free the motion data with IMotion_FreeCSV.)
+ */
+IM_DRIVER_DLL_API int IMotion_LoadProject(const char* filename, IM_FORMAT* format, uint8 ** motion_buf, uint32 * motion_len, uint32 sample_rate);
+
+/**
+ * This function compiles a QEditor project from the file memory.
+ */
+IM_DRIVER_DLL_API int IMotion_LoadProject_RAW(const void* data, int size, IM_FORMAT* format, uint8 ** motion_buf, uint32 * motion_len, uint32 sample_rate);
+
 #ifdef __cplusplus
 }
 #endif
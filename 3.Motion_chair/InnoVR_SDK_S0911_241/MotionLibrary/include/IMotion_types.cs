@@ -189,6 +189,70 @@ namespace InnoMotion
             }
         }
 
+        /**
+         * Motion mixer timing structure 
+         * (Note, this structure is used to obtain the deadline statistics of the mixer thread since start.)
+         * (Note, this structure can only be used in InnoML.)
+         */
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        public struct IM_TIMING_INFO
+        {
+            public UInt32 nPeriod;      /**< Mixer period (us). */
+            public UInt32 nTicks;       /**< Mixer ticks. */
+            public UInt32 nMissed;      /**< Deadlines missed by more than a period (skipped ticks). */
+            public Int32 dLateness;     /**< Lateness of the last tick (us). */
+            public Int32 dLatenessAvg;  /**< Mean lateness (us). */
+            public Int32 dLatenessMax;  /**< Max lateness (us). */
+            public Int32 dJitterMax;    /**< Max change of the lateness from a tick to the next (us). */
+        }
+
+        /**
+         * Buffer conversion cache structure 
+         * (Note, this structure is used to obtain the state and the statistics of the cache of imBufferConvert.)
+         * (Note, this structure can only be used in InnoML.)
+         */
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        public struct IM_CONVERT_CACHE_INFO
+        {
+            public UInt32 nBudget;      /**< Memory budget (bytes, 0 : disabled). */
+            public UInt32 nSize;        /**< Memory of the cached buffers (bytes). */
+            public UInt32 nEntries;     /**< Cached buffers. */
+            public UInt32 nHits;        /**< Conversions returned from the cache. */
+            public UInt32 nMisses;      /**< Conversions not found in the cache. */
+            public UInt32 nEvictions;   /**< Least recently used buffers removed for the budget. */
+        }
+
+        /**
+         * Motion stream structure 
+         * (Note, this structure is used to obtain the state of the decoder of a stream buffer (imLoadBufferStream).)
+         * (Note, this structure can only be used in InnoML.)
+         */
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        public struct IM_STREAM_INFO
+        {
+            public UInt32 nFrames;      /**< Frames of the file (0 : not known before the end of a csv file). */
+            public UInt32 nCapacity;    /**< Frames of the ring. */
+            public UInt32 nQueued;      /**< Frames decoded ahead of the source. */
+            public UInt32 nUnderruns;   /**< Mixer periods that held the last frame for the decoder. */
+            public Int32 bEnded;        /**< The decoder reached the end of the stream. */
+        }
+
+        /**
+         * Motion platform pose structure 
+         * (Note, this structure is used to obtain the commanded and the measured pose of the platform (IM_DOF_TYPE order, working range).)
+         * (Note, the measured pose of a device driven by axes (IM_FILTER_KINEMATICS) is solved from the axis encoders by the forward kinematics.)
+         * (Note, this structure can only be used in InnoML.)
+         */
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        public struct IM_POSE_INFO
+        {
+            [MarshalAs(UnmanagedType.ByValArray, SizeConst = 6)]
+            public Int32[] dCmd;        /**< Commanded Pose. */
+            [MarshalAs(UnmanagedType.ByValArray, SizeConst = 6)]
+            public Int32[] dEnc;        /**< Measured Pose. */
+            public Int32 nIterations;   /**< Newton iterations of the forward kinematics (0 : not solved, -1 : not converged). */
+        }
+
         /**
          * Motion filter params structure 
          * (Note, These structures are used to set filter parameters for each channel of motion buffer.)
@@ -333,6 +397,44 @@ namespace InnoMotion
             }
         }
 
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        public struct IM_FILTER_CLASSIC_PARAMS
+        {
+            public Int32 nHighpassOrder;	/**< high-pass order of the onset cue (0~3, default 2) */
+            public float fHighpassCutoff;	/**< high-pass cutoff frequency (default 5) */
+            public Int32 nIntegralOrder;	/**< 2 : acceleration -> position, 1 : angular velocity -> angle (0~2, default 0) */
+            public Int32 nTiltOrder;		/**< low-pass order of the tilt path of surge and sway (0~3, default 0 : off) */
+            public float fTiltCutoff;		/**< tilt low-pass cutoff frequency (default 5) */
+
+            public IM_FILTER_CLASSIC_PARAMS(Int32 highpassOrder = 2, float highpassCutoff = 5, Int32 integralOrder = 0, Int32 tiltOrder = 0, float tiltCutoff = 5)
+            {
+                nHighpassOrder = highpassOrder;
+                fHighpassCutoff = highpassCutoff;
+                nIntegralOrder = integralOrder;
+                nTiltOrder = tiltOrder;
+                fTiltCutoff = tiltCutoff;
+            }
+        }
+
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        public struct IM_FILTER_TILT_PARAMS
+        {
+            public Int32 nOrder;			/**< low-pass order of the sustained acceleration (0~3, default 0 : off) */
+            public float fCutoffFrequency;	/**< low-pass cutoff frequency (default 5) */
+            public float fThreshold;		/**< force threshold (working range, default 0) */
+            public float fRateMax;			/**< max tilt rate (degree/sec, default 0 : off, about 3 is under the rotation threshold) */
+            public float fAngleMax;			/**< max tilt angle (degree, default 90) */
+
+            public IM_FILTER_TILT_PARAMS(Int32 order = 0, float cutoffFrequency = 5, float threshold = 0, float rateMax = 0, float angleMax = 90)
+            {
+                nOrder = order;
+                fCutoffFrequency = cutoffFrequency;
+                fThreshold = threshold;
+                fRateMax = rateMax;
+                fAngleMax = angleMax;
+            }
+        }
+
         [StructLayout(LayoutKind.Sequential, Pack = 1)]
         public struct IM_FILTER_KINEMATICS_PARAMS
         {
@@ -366,6 +468,19 @@ namespace InnoMotion
             }
         }
 
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        public struct IM_FILTER_RESAMPLE_PARAMS
+        {
+            public Int32 nTaps;		/**< filter length in periods of the lower rate (0 : zero-order hold, 2~32, default 4) */
+            public float fCutoff;	/**< cutoff frequency, ratio of the lower nyquist frequency (0.1~1, default 0.9) */
+
+            public IM_FILTER_RESAMPLE_PARAMS(Int32 taps = 4, float cutoff = 0.9f)
+            {
+                nTaps = taps;
+                fCutoff = cutoff;
+            }
+        }
+
         [StructLayout(LayoutKind.Sequential, Pack = 1)]
         public struct IM_FILTER
         {
@@ -438,7 +553,7 @@ namespace InnoMotion
             IM_FILTER_HIGHPASS,		/**< high-pass filter (needs IM_FILTER_HIGHPASS_PARAMS) */
             IM_FILTER_LOWPASS,		/**< low-pass filter (needs IM_FILTER_LOWPASS_PARAMS) */
             IM_FILTER_INTEGRAL,		/**< integrator (needs IM_FILTER_INTEGRAL_PARAMS)  */
-            IM_FILTER_TILT,			/**< tilt-coordinator (need not PARAMS) */
+            IM_FILTER_TILT,			/**< tilt-coordinator (IM_FILTER_TILT_PARAMS, the defaults tilt the unfiltered force) */
             IM_FILTER_SCALE,		/**< Increase or decrease the range of motion by a given value (needs IM_FILTER_SCALE_PARAMS) */
             IM_FILTER_OFFSET,		/**< Moves the motion range by the given value (needs IM_FILTER_OFFSET_PARAMS) */
             IM_FILTER_COMBINE,		/**< Combines two channel values into the specified operation mode (needs IM_FILTER_COMBINE_PARAMS) */
@@ -448,8 +563,9 @@ namespace InnoMotion
             IM_FILTER_KINEMATICS,	/**< kinematics (needs IM_FILTER_KINEMATICS_PARAMS) */
             IM_FILTER_FORMAT,		/**< data type converter (need IM_FILTER_FORMAT_PARAMS) */
             IM_FILTER_CHANNEL,		/**< channel mapper (needs IM_FILTER_CHANNEL_PARAMS) */
-            IM_FILTER_RESAMPLE,		/**< reserved */
+            IM_FILTER_RESAMPLE,		/**< rate converter of the stream (IM_FILTER_RESAMPLE_PARAMS) */
             IM_FILTER_CUSTOM,		/**< custom filter (needs user filter function) */
+            IM_FILTER_CLASSIC,		/**< classical washout in one pass (needs IM_FILTER_CLASSIC_PARAMS) */
             IM_FILTER_COUNT,		/**< the number of supported filter types */
         }
 
@@ -504,6 +620,7 @@ namespace InnoMotion
             public const int IM_CFG_EMUL_MODE     = 0x4;    // reserved
             public const int IM_CFG_ASYNC_MODE    = 0x8;    // asynchronous device running mode (check "bBusy")
             public const int IM_CFG_FORCE_PROFILE = 0x10;   // force device settings to profile (check "IMotion.ini")
+            public const int IM_CFG_PRECISE_TIMER = 0x20;   // busy-wait the end of each mixer period (check imGetTimingInfo)
             #endregion
 
             /**
@@ -43,8 +43,13 @@ typedef unsigned short	uint16;
 typedef short int		int16;
 typedef unsigned int	uint32;
 typedef int				int32;
+#if defined(_MSC_VER)
 typedef unsigned __int64 uint64;
 typedef __int64			int64;
+#else
+typedef unsigned long long uint64;
+typedef long long		int64;
+#endif
 
 /**
  *  \name common macro
@@ -111,6 +116,7 @@ typedef enum {
 #define IM_CFG_EMUL_MODE		0x4	// reserved
 #define IM_CFG_ASYNC_MODE		0x8	// asynchronous device running mode (check "bBusy")
 #define IM_CFG_FORCE_PROFILE	0x10// force device settings to profile (check "IMotion.ini")
+#define IM_CFG_PRECISE_TIMER	0x20// busy-wait the end of each mixer period (check imGetTimingInfo)
 
 /**
  *  \name IM_CFG_DEVICE_*
@@ -328,6 +334,60 @@ typedef struct {
 	int32		bAlarmResetOn;	/**< Reset Alarm. */
 } IM_DIAGNOSTIC_AXIS_INFO;
 
+/**
+ * Motion mixer timing structure 
+ * (Note, this structure is used to obtain the deadline statistics of the mixer thread since start.)
+ * (Note, this structure can only be used in InnoML.)
+ */
+typedef struct {
+	uint32		nPeriod;		/**< Mixer period (us). */
+	uint32		nTicks;			/**< Mixer ticks. */
+	uint32		nMissed;		/**< Deadlines missed by more than a period (skipped ticks). */
+	int32		dLateness;		/**< Lateness of the last tick (us). */
+	int32		dLatenessAvg;	/**< Mean lateness (us). */
+	int32		dLatenessMax;	/**< Max lateness (us). */
+	int32		dJitterMax;		/**< Max change of the lateness from a tick to the next (us). */
+} IM_TIMING_INFO;
+
+/**
+ * Buffer conversion cache structure 
+ * (Note, this structure is used to obtain the state and the statistics of the cache of imBufferConvert.)
+ * (Note, this structure can only be used in InnoML.)
+ */
+typedef struct {
+	uint32		nBudget;		/**< Memory budget (bytes, 0 : disabled). */
+	uint32		nSize;			/**< Memory of the cached buffers (bytes). */
+	uint32		nEntries;		/**< Cached buffers. */
+	uint32		nHits;			/**< Conversions returned from the cache. */
+	uint32		nMisses;		/**< Conversions not found in the cache. */
+	uint32		nEvictions;		/**< Least recently used buffers removed for the budget. */
+} IM_CONVERT_CACHE_INFO;
+
+/**
+ * Motion stream structure 
+ * (Note, this structure is used to obtain the state of the decoder of a stream buffer (imLoadBufferStream).)
+ * (Note, this structure can only be used in InnoML.)
+ */
+typedef struct {
+	uint32		nFrames;		/**< Frames of the file (0 : not known before the end of a csv file). */
+	uint32		nCapacity;		/**< Frames of the ring. */
+	uint32		nQueued;		/**< Frames decoded ahead of the source. */
+	uint32		nUnderruns;		/**< Mixer periods that held the last frame for the decoder. */
+	int32		bEnded;			/**< The decoder reached the end of the stream. */
+} IM_STREAM_INFO;
+
+/**
+ * Motion platform pose structure 
+ * (Note, this structure is used to obtain the commanded and the measured pose of the platform (IM_DOF_TYPE order, working range).)
+ * (Note, the measured pose of a device driven by axes (IM_FILTER_KINEMATICS) is solved from the axis encoders by the forward kinematics.)
+ * (Note, this structure can only be used in InnoML.)
+ */
+typedef struct {
+	int32		dCmd[IM_DOF_COUNT];	/**< Commanded Pose. */
+	int32		dEnc[IM_DOF_COUNT];	/**< Measured Pose. */
+	int32		nIterations;		/**< Newton iterations of the forward kinematics (0 : not solved, -1 : not converged). */
+} IM_POSE_INFO;
+
 /**
  * Declare prototype of motion source callback function.
  * (Note, this callback is used to detect notification of motion source playback completion.)
@@ -369,7 +429,7 @@ typedef enum {
 	IM_FILTER_HIGHPASS,		/**< high-pass filter (needs IM_FILTER_HIGHPASS_PARAMS) */
 	IM_FILTER_LOWPASS,		/**< low-pass filter (needs IM_FILTER_LOWPASS_PARAMS) */
 	IM_FILTER_INTEGRAL,		/**< integrator (needs IM_FILTER_INTEGRAL_PARAMS)  */
-	IM_FILTER_TILT,			/**< tilt-coordinator (need not PARAMS) */
+	IM_FILTER_TILT,			/**< tilt-coordinator (IM_FILTER_TILT_PARAMS, the defaults tilt the unfiltered force) */
 	IM_FILTER_SCALE,		/**< Increase or decrease the range of motion by a given value (needs IM_FILTER_SCALE_PARAMS) */
 	IM_FILTER_OFFSET,		/**< Moves the motion range by the given value (needs IM_FILTER_OFFSET_PARAMS) */
 	IM_FILTER_COMBINE,		/**< Combines two channel values into the specified operation mode (needs IM_FILTER_COMBINE_PARAMS) */
@@ -379,8 +439,9 @@ typedef enum {
 	IM_FILTER_KINEMATICS,	/**< kinematics (needs IM_FILTER_KINEMATICS_PARAMS) */
 	IM_FILTER_FORMAT,		/**< data type converter (need IM_FILTER_FORMAT_PARAMS) */
 	IM_FILTER_CHANNEL,		/**< channel mapper (needs IM_FILTER_CHANNEL_PARAMS) */
-	IM_FILTER_RESAMPLE,		/**< reserved */	
+	IM_FILTER_RESAMPLE,		/**< rate converter of the stream (IM_FILTER_RESAMPLE_PARAMS) */	
 	IM_FILTER_CUSTOM,		/**< custom filter (needs user filter function) */
+	IM_FILTER_CLASSIC,		/**< classical washout in one pass (needs IM_FILTER_CLASSIC_PARAMS) */
 	IM_FILTER_COUNT,		/**< the number of supported filter types */
 } IM_FILTER_TYPE;
 
@@ -464,6 +525,30 @@ typedef struct {
 	float		fCutoffFrequency;/**< cutoff frequency (default 5) */
 } IM_FILTER_WASHOUT_PARAMS;
 
+/**
+ * Classical washout params of a channel. (high-pass onset cue -> integrals, and the tilt-coordination of surge/sway)
+ * (The defaults are IM_FILTER_WASHOUT. A channel without high-pass and integral is unfiltered, or 0 if its tilt path is on.)
+ */
+typedef struct {
+	int32		nHighpassOrder;	/**< high-pass order of the onset cue (0~3, default 2) */
+	float		fHighpassCutoff;/**< high-pass cutoff frequency (default 5) */
+	int32		nIntegralOrder;	/**< 2 : acceleration -> position, 1 : angular velocity -> angle (0~2, default 0) */
+	int32		nTiltOrder;		/**< low-pass order of the tilt path of surge and sway (0~3, default 0 : off) */
+	float		fTiltCutoff;	/**< tilt low-pass cutoff frequency (default 5) */
+} IM_FILTER_CLASSIC_PARAMS;
+
+/**
+ * Tilt-coordination params of surge (pitch) and sway (roll). (sustained acceleration low-pass -> tilt angle -> tilt rate limit)
+ * (The threshold is subtracted from the low-passed force, so the small forces are not tilted.)
+ */
+typedef struct {
+	int32		nOrder;			/**< low-pass order of the sustained acceleration (0~3, default 0 : off) */
+	float		fCutoffFrequency;/**< low-pass cutoff frequency (default 5) */
+	float		fThreshold;		/**< force threshold (working range, default 0) */
+	float		fRateMax;		/**< max tilt rate (degree/sec, default 0 : off, about 3 is under the rotation threshold) */
+	float		fAngleMax;		/**< max tilt angle (degree, default 90) */
+} IM_FILTER_TILT_PARAMS;
+
 typedef struct {
 	int32		nVersion;		/**< kinematics version (700/800/1000) */	
 } IM_FILTER_KINEMATICS_PARAMS;
@@ -476,6 +561,19 @@ typedef struct {
 	int32		nAxis;			/**< source axis number (1~255) */
 } IM_FILTER_CHANNEL_PARAMS;
 
+/**
+ * Rate conversion params of a filter chain. (polyphase windowed-sinc of the rational ratio of the rates)
+ * (The filter spans nTaps periods of the lower rate, so a stream is delayed by about nTaps/2 of them.
+ *  imBufferConvert compensates the delay. A chain without IM_FILTER_RESAMPLE uses the defaults.
+ *  Limits : the ratio of the rates reduced to dst/src must have a dst term of 4096 or less (e.g. 1000 -> 60 is
+ *  3/50), other ratios use zero-order hold whatever nTaps. The phase table holds up to 1M coefficients
+ *  (dst term x window), so a longer window of a large decimation is shortened to fit.)
+ */
+typedef struct {
+	int32		nTaps;			/**< filter length in periods of the lower rate (0 : zero-order hold, 2~32, default 4) */
+	float		fCutoff;		/**< cutoff frequency, ratio of the lower nyquist frequency (0.1~1, default 0.9) */
+} IM_FILTER_RESAMPLE_PARAMS;
+
 #ifdef __cplusplus
 }
 #endif
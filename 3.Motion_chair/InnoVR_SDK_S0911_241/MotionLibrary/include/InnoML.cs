@@ -61,6 +61,15 @@ namespace InnoMotion
             [DllImport(DLLName, CallingConvention = CallingConvention.Cdecl)]
             extern public static Int32 imGetDiagnostic([Out] IM_DIAGNOSTIC_AXIS_INFO[] axis = null, Int32 count = 1);
 
+            [DllImport(DLLName, CallingConvention = CallingConvention.Cdecl)]
+            extern public static Int32 imGetTimingInfo(out IM_TIMING_INFO info);
+
+            [DllImport(DLLName, CallingConvention = CallingConvention.Cdecl)]
+            extern public static Int32 imGetPose(out IM_POSE_INFO info);
+
+            [DllImport(DLLName, CallingConvention = CallingConvention.Cdecl)]
+            extern public static Int32 imSetPoseBuffer(Int32 buffer);
+
             [DllImport(DLLName, CallingConvention = CallingConvention.Cdecl)]
             extern public static Int32 imGetPlayingSourceCount();
 
@@ -98,15 +107,33 @@ namespace InnoMotion
             [DllImport(DLLName, CallingConvention = CallingConvention.Cdecl)]
             extern public static Int32 imLoadBufferMemory(byte[] data, Int32 size, string key = null);
 
+            [DllImport(DLLName, CallingConvention = CallingConvention.Cdecl)]
+            extern public static Int32/*IMBuffer*/ imLoadBufferStream(string url, Int32 frames = 0, string key = null);
+
+            [DllImport(DLLName, CallingConvention = CallingConvention.Cdecl)]
+            extern public static Int32 imBufferGetStreamInfo(Int32 buffer/*IMBuffer*/, out IM_STREAM_INFO info);
+
             [DllImport(DLLName, CallingConvention = CallingConvention.Cdecl)]
             extern public static float imBufferConvert(Int32 buffer, ref Int32 adjusted_buffer, Int32 desired_buffer = 0, Int32 filter = 0);
 
+            [DllImport(DLLName, CallingConvention = CallingConvention.Cdecl)]
+            extern public static Int32 imSetConvertCache(Int32 budget);
+
+            [DllImport(DLLName, CallingConvention = CallingConvention.Cdecl)]
+            extern public static Int32 imGetConvertCacheInfo(out IM_CONVERT_CACHE_INFO info);
+
             [DllImport(DLLName, CallingConvention = CallingConvention.Cdecl)]
             extern public static Int32 imBufferGetSize(Int32 buffer/*IMBuffer*/);
 
             [DllImport(DLLName, CallingConvention = CallingConvention.Cdecl)]
             extern public static Int32 imBufferGetDuration(Int32 buffer/*IMBuffer*/);
 
+            [DllImport(DLLName, CallingConvention = CallingConvention.Cdecl)]
+            extern public static Int32 imBufferSetLoop(Int32 buffer/*IMBuffer*/, Int32 begin, Int32 end);
+
+            [DllImport(DLLName, CallingConvention = CallingConvention.Cdecl)]
+            extern public static Int32 imBufferGetLoop(Int32 buffer/*IMBuffer*/, ref Int32 begin, ref Int32 end);
+
             [DllImport(DLLName, CallingConvention = CallingConvention.Cdecl)]
             extern public static Int32 imBufferGetFormat(
                 Int32 buffer,         // IMBuffer  
@@ -192,6 +219,9 @@ namespace InnoMotion
             [DllImport(DLLName, CallingConvention = CallingConvention.Cdecl)]
             extern public static Int32 imSourceSetSpeed(Int32 source, Int32 speed);
 
+            [DllImport(DLLName, CallingConvention = CallingConvention.Cdecl)]
+            extern public static Int32 imSourceSetSpeedFactor(Int32 source /*IMSource*/, float speed, Int32 ramp = 0);
+
             [DllImport(DLLName, CallingConvention = CallingConvention.Cdecl)]
             extern public static Int32 imSourceGetPosition(Int32 source /*IMSource*/);
 
@@ -14,7 +14,9 @@ extern "C"{
 #endif
 	
 #ifndef INNO_ML_STATIC_BUILD
-#	ifdef INNO_ML_EXPORTS
+#	if !defined(_WIN32)
+#		define IM_API __attribute__((visibility("default")))
+#	elif defined(INNO_ML_EXPORTS)
 #		define IM_API __declspec(dllexport)
 #	else
 #		define IM_API __declspec(dllimport)
@@ -101,6 +103,24 @@ IM_API int32		imGetProfile(IM_DEVICE_DESC* desc IMDEFAULT(0), uint32 devid IMDEF
  */
 IM_API int32		imGetDiagnostic(IM_DIAGNOSTIC_AXIS_INFO* axis IMDEFAULT(0), int32 count IMDEFAULT(1));
 
+/**
+ * This function obtains the deadline statistics (lateness, jitter, missed ticks) of the active motion context's mixer.
+ * (Note, the mixer runs on absolute deadlines at the master buffer rate. Use IM_CFG_PRECISE_TIMER to busy-wait the end of each period.)
+ */
+IM_API int32		imGetTimingInfo(IM_TIMING_INFO* info);
+
+/**
+ * This function obtains the commanded and the measured platform pose of the active motion context.
+ * (Note, the forward kinematics of a device driven by axes runs once per mixer tick, from the pose of the previous tick.)
+ */
+IM_API int32		imGetPose(IM_POSE_INFO* info);
+
+/**
+ * This function sets the buffer that receives the measured pose of the active motion context, one frame per mixer tick.
+ * (Note, the frames are mapped to the channels of the buffer. The frames that do not fit in the buffer are dropped. 0 stops the stream.)
+ */
+IM_API int32		imSetPoseBuffer(IMBuffer buffer);
+
 /**
  * This function gets the number of motion sources that are currently playing.
  */
@@ -149,6 +169,8 @@ IM_API IMBuffer		imCreateBufferFromFormat(const IM_FORMAT* format IMDEFAULT(0),
 
 /**
  * This function creates a motion buffer object from the motion file name.
+ * (Note, a binary motion file (IMotion_SaveMotion) is mapped and used without a copy.)
+ * (Note, a QEditor project (.qep) is compiled at the master sample rate of the current context, or at its timeline rate without a context.)
  */
 IM_API IMBuffer		imLoadBuffer(const char* url, const char* key IMDEFAULT(0));
 
@@ -157,11 +179,38 @@ IM_API IMBuffer		imLoadBuffer(const char* url, const char* key IMDEFAULT(0));
  */
 IM_API IMBuffer		imLoadBufferMemory(const void* data, int32 size, const char* key IMDEFAULT(0));
 
+/**
+ * This function creates a motion buffer object that streams the motion file name. ('frames' of the ring, 0 : 2 seconds)
+ * (Note, the file is decoded a chunk at a time by a background thread, so the buffer can be played after the first chunk
+ *  and its memory is the ring whatever the length of the file. The frames are consumed by the source that plays the
+ *  buffer (one source at a time), it can not be queued, dequeued, locked or converted.)
+ */
+IM_API IMBuffer		imLoadBufferStream(const char* url, int32 frames IMDEFAULT(0), const char* key IMDEFAULT(0));
+
+/**
+ * This function obtains the state of the decoder of a buffer of imLoadBufferStream.
+ */
+IM_API int32		imBufferGetStreamInfo(IMBuffer buffer, IM_STREAM_INFO* info);
+
 /**
  * This function creates a new motion buffer object that is converted to the desired buffer format.
+ * (Note, with imSetConvertCache the same frames, format and filter return a new copy of the cached frames without converting them again.)
+ * (Note, the conversions of different threads run in parallel, and a thread reuses the filter chain it compiled for the same filter params and formats.
+ *  A filter chain with a custom filter converts one call at a time.)
  */
 IM_API float		imBufferConvert(IMBuffer buffer, IMBuffer* adjusted_buffer, IMBuffer desired_buffer IMDEFAULT(0), IMFilter filter IMDEFAULT(0));
 
+/**
+ * This function sets the memory budget (bytes) of the cache of imBufferConvert. (0 : disabled, the default)
+ * (Note, the least recently used buffers are removed to fit in the budget. Filters with a user function are not cached.)
+ */
+IM_API int32		imSetConvertCache(int32 budget);
+
+/**
+ * This function obtains the state and the hit/miss counters of the cache of imBufferConvert.
+ */
+IM_API int32		imGetConvertCacheInfo(IM_CONVERT_CACHE_INFO* info);
+
 /**
  * This function adds motion data to the motion buffer object.
  */
@@ -210,6 +259,17 @@ IM_API int32		imBufferGetFormat(IMBuffer buffer, int32* sample_rate, int32* form
  */
 IM_API int32		imBufferGetInfo(IMBuffer buffer, IM_FORMAT* format, int32* samples IMDEFAULT(0), int32* buffers IMDEFAULT(0));
 
+/**
+ * This function sets the loop points (samples) of the motion sources that play the motion buffer.
+ * (Note, a looping source plays [0..end) and then [begin..end) again, the last loop plays to the end of the buffer. end 0 : the whole buffer.)
+ */
+IM_API int32		imBufferSetLoop(IMBuffer buffer, int32 begin, int32 end);
+
+/**
+ * This function gets the loop points (samples) of the motion buffer. (Binary motion files carry their loop points.)
+ */
+IM_API int32		imBufferGetLoop(IMBuffer buffer, int32* begin, int32* end);
+
 /**
  * This function gets the number of motion samples stored in the motion data.
  */
@@ -272,10 +332,16 @@ IM_API int32		imSourceSetVolume(IMSource source, int32 volume);
 
 /**
  * This function sets the playback speed of this motion source.
- * (Range [25 | 50 | 100 | 200 | 400])
+ * (Percent of the normal speed, range [1..6400], e.g. 25 | 50 | 100 | 200 | 400)
  */
 IM_API int32		imSourceSetSpeed(IMSource source, int32 speed);
 
+/**
+ * This function sets the playback speed factor of this motion source, reached linearly over the ramp time (msec).
+ * (Range (0..64], 1 : normal speed. The frames between two motion samples are interpolated.)
+ */
+IM_API int32		imSourceSetSpeedFactor(IMSource source, float speed, int32 ramp IMDEFAULT(0));
+
 /**
  * This function gets the current play time of the motion source.
  * (See also imBufferGetDuration)
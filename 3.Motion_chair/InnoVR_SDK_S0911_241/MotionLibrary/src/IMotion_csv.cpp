@@ -0,0 +1,996 @@
+/********************************************************************************//**
+\file      IMotion_csv.cpp
+\brief     Motion file (csv, binary) loaders of the InnoML reference engine.
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#include <IMotion_csv.h>
+#include "InnoML_format.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#if defined(__linux__)
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+/**
+ *  \name IM_CSV_*
+ *
+ *  Declare the motion file layout.
+ *  (Each row is "timestamp,value,value,...". The timestamp is "HH-MM-SS-CC" or milliseconds,
+ *   and the values are percent of the stroke (-100 ~ 100), quantized to signed 16-bit samples.)
+ */
+#define IM_CSV_FULL_SCALE	100.0f
+#define IM_CSV_DIGITS_MAX	19		/**< significant digits of a number (the rest only scales it) */
+#define IM_CSV_MAP_MIN		65536	/**< smaller files are read (a mapping costs more than the copy) */
+
+static inline bool csv_is_digit(char c)
+{
+	return (uint8)(c - '0') < 10;
+}
+
+/**
+ * This function parses a decimal number like strtod without the locale, and returns the end of the
+ * number or 0. (The digits are accumulated in an integer that is scaled once by an exact power of ten.)
+ */
+static const char* csv_parse_number(const char* p, const char* end, double* value)
+{
+	static const double s_pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	uint64 mantissa = 0;
+	int digits = 0, scale = 0;
+	bool negative = false, any = false;
+
+	while(p < end && (*p == ' ' || *p == '\t'))
+		p++;
+	if(p < end && (*p == '-' || *p == '+'))
+		negative = (*p++ == '-');
+	for(; p < end && csv_is_digit(*p); p++, any = true) {
+		if(digits < IM_CSV_DIGITS_MAX) {
+			mantissa = mantissa * 10 + (uint64)(*p - '0');
+			digits += (mantissa != 0);
+		}
+		else {
+			scale++;
+		}
+	}
+	if(p < end && *p == '.') {
+		for(p++; p < end && csv_is_digit(*p); p++, any = true) {
+			if(digits < IM_CSV_DIGITS_MAX) {
+				mantissa = mantissa * 10 + (uint64)(*p - '0');
+				digits += (mantissa != 0);
+				scale--;
+			}
+		}
+	}
+	if(!any)
+		return 0;
+	if(p < end && (*p == 'e' || *p == 'E')) {
+		const char* q = p + 1;
+		bool exp_negative = false;
+		if(q < end && (*q == '-' || *q == '+'))
+			exp_negative = (*q++ == '-');
+		if(q < end && csv_is_digit(*q)) {
+			int exp = 0;
+			for(; q < end && csv_is_digit(*q); q++)
+				exp = MOTION_MIN(exp * 10 + (*q - '0'), 10000);
+			scale += exp_negative ? -exp : exp;
+			p = q;
+		}
+	}
+
+	double v = (double)mantissa;
+	if(scale < 0)
+		v = (scale >= -22) ? v / s_pow10[-scale] : v / pow(10.0, -scale);
+	else if(scale > 0)
+		v = (scale <= 22) ? v * s_pow10[scale] : v * pow(10.0, scale);
+	*value = negative ? -v : v;
+	return p;
+}
+
+/**
+ * This function parses the timestamp of a row ("HH-MM-SS-CC" or milliseconds) and returns its end or 0.
+ */
+static const char* csv_parse_time(const char* p, const char* end, double* msec)
+{
+	int part[4];
+	const char* q = p;
+	while(q < end && (*q == ' ' || *q == '\t'))
+		q++;
+	int i = 0;
+	for(; i<4; i++) {
+		if(i > 0) {
+			if(q >= end || *q != '-')
+				break;
+			q++;
+		}
+		if(q >= end || !csv_is_digit(*q))
+			break;
+		part[i] = 0;
+		for(; q < end && csv_is_digit(*q); q++)
+			part[i] = MOTION_MIN(part[i] * 10 + (*q - '0'), 100000000);
+	}
+	if(i == 4) {
+		*msec = ((part[0] * 60.0 + part[1]) * 60.0 + part[2]) * 1000.0 + part[3] * 10.0;
+		return q;
+	}
+	return csv_parse_number(p, end, msec);
+}
+
+/**
+ * This function parses a row and returns the start of the next row, or 0 if the row has a binary byte.
+ * ('count' gets the values of the row, -1 for a row without a timestamp : an empty line or a header.
+ *  The bytes that are not part of a number are checked for the text on the way to the end of the row.)
+ */
+static inline const char* csv_parse_row(const char* text, const char* end, double* msec, float* frame, int* count)
+{
+	const char* p = csv_parse_time(text, end, msec);
+	int n = -1;
+	if(p) {
+		double value;
+		const char* next;
+		n = 0;
+		while(p < end && *p == ',' && n < IM_FORMAT_CHANNELS_MAX && (next = csv_parse_number(p + 1, end, &value)) != 0) {
+			frame[n++] = (float)value;
+			p = next;
+		}
+	}
+	else {
+		p = text; // empty line or header
+	}
+	*count = n;
+
+	// rest of the row
+	for(; p < end && *p != '\n'; p++) {
+		uint8 c = (uint8)*p;
+		if(c >= 0x80 || (c < 0x20 && c != '\t' && c != '\r'))
+			return 0; // encrypted or binary
+	}
+	return (p < end) ? p + 1 : end;
+}
+
+/**
+ * This function quantizes the values of a row to a frame. (the missing channels are 0)
+ */
+static inline void csv_store_frame(uint8* out, const float* frame, int count, uint32 channels)
+{
+	const float scale = IM_SAMPLE_FULL_SCALE / IM_CSV_FULL_SCALE;
+	for(uint32 i=0; i<channels; i++)
+		im_sample_store(out + i * sizeof(int16), IM_FORMAT_DATA_S16, (i < (uint32)count) ? frame[i] * scale : 0.0f);
+}
+
+/**
+ * This function gets the sample rate of the timestamps of the first two rows.
+ */
+static int csv_sample_rate(uint32 rows, const double* time)
+{
+	int sample_rate = IM_FORMAT_SAMPLE_RATE_DEFAULT;
+	if(rows > 1 && time[1] > time[0])
+		sample_rate = (int)(1000.0 / (time[1] - time[0]) + 0.5);
+	return (sample_rate < 1) ? IM_FORMAT_SAMPLE_RATE_DEFAULT : sample_rate;
+}
+
+/**
+ * The file is parsed in one pass : each row is parsed in place and quantized into the output buffer.
+ * (An encrypted or binary file stops at its first binary byte.)
+ */
+IM_DRIVER_DLL_API int IMotion_LoadCSV_RAW(const void* data, int size, IM_FORMAT* format, uint8 ** motion_buf, uint32 * motion_len, const char* key)
+{
+	if(data == 0 || size <= 0 || format == 0 || motion_buf == 0 || motion_len == 0)
+		return 0;
+	if(key)
+		return 0; // encrypted files are not supported by the reference engine
+
+	const char* text = (const char*)data;
+	const char* text_end = text + size;
+	double time[2] = {0, 0};
+	uint32 rows = 0, capacity = 0, channels = 0, block = 0;
+	uint8* motion = 0;
+
+	while(text < text_end) {
+		const char* row = text;
+		double msec = 0;
+		float frame[IM_FORMAT_CHANNELS_MAX];
+		int count;
+		text = csv_parse_row(row, text_end, &msec, frame, &count);
+		if(text == 0) {
+			free(motion);
+			return 0;
+		}
+		if(count < 0 || (count == 0 && rows == 0))
+			continue;
+		if(rows == 0) {
+			// the first row sets the channels, the frames of the file are estimated from its length
+			channels = (uint32)count;
+			block = channels * sizeof(int16);
+			capacity = (uint32)(size / (text - row)) + 16;
+		}
+		if(rows == capacity) {
+			capacity *= 2;
+			uint8* grown = (uint8*)realloc(motion, (size_t)capacity * block);
+			if(grown == 0) {
+				free(motion);
+				return 0;
+			}
+			motion = grown;
+		}
+		else if(motion == 0) {
+			motion = (uint8*)malloc((size_t)capacity * block);
+			if(motion == 0)
+				return 0;
+		}
+		if(rows < 2)
+			time[rows] = msec;
+		csv_store_frame(motion + (size_t)rows * block, frame, count, channels);
+		rows++;
+	}
+	if(rows == 0)
+		return 0;
+
+	im_format_set(format, IM_FORMAT_TYPE_DOF, csv_sample_rate(rows, time), channels, IM_FORMAT_DATA_S16);
+	*motion_len = rows * format->nBlockAlign;
+	uint8* shrunk = (uint8*)realloc(motion, *motion_len);
+	*motion_buf = shrunk ? shrunk : motion;
+	return 1;
+}
+
+/**
+ * This function maps a file and calls the loader of the file memory. (Small files and other platforms read it into memory.)
+ */
+template<class LOAD> static int motion_load_file(const char* filename, LOAD load)
+{
+	if(filename == 0)
+		return 0;
+#if defined(__linux__)
+	int fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+		return 0;
+	struct stat st;
+	if(fstat(fd, &st) != 0 || st.st_size <= 0 || st.st_size > 0x7FFFFFFF) {
+		close(fd);
+		return 0;
+	}
+	const size_t size = (size_t)st.st_size;
+	if(size < IM_CSV_MAP_MIN) {
+		std::vector<char> data(size);
+		ssize_t read_size = read(fd, &data[0], size);
+		close(fd);
+		return (read_size > 0) ? load(&data[0], (int)read_size) : 0;
+	}
+	void* data = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(data == MAP_FAILED)
+		return 0;
+	madvise(data, size, MADV_SEQUENTIAL);
+	int result = load(data, (int)size);
+	munmap(data, size);
+	return result;
+#else
+	FILE* fp = fopen(filename, "rb");
+	if(fp == 0)
+		return 0;
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	std::vector<char> data(size > 0 ? size : 1);
+	size_t read = (size > 0) ? fread(&data[0], 1, size, fp) : 0;
+	fclose(fp);
+	return load(&data[0], (int)read);
+#endif
+}
+
+/**
+ * The file is mapped and parsed in place.
+ */
+IM_DRIVER_DLL_API int IMotion_LoadCSV(const char* filename, IM_FORMAT* format, uint8 ** motion_buf, uint32 * motion_len, const char* key)
+{
+	return motion_load_file(filename, [&](const void* data, int size) {
+		return IMotion_LoadCSV_RAW(data, size, format, motion_buf, motion_len, key);
+	});
+}
+
+IM_DRIVER_DLL_API int IMotion_FreeCSV(uint8 * motion_buf)
+{
+	free(motion_buf);
+	return 1;
+}
+
+IM_DRIVER_DLL_API int IMotion_SaveCSV(const char* filename, const IM_FORMAT* format, const uint8 * motion_buf, uint32 motion_len, const char* key)
+{
+	if(filename == 0 || format == 0 || motion_buf == 0 || key)
+		return 0;
+	if(!im_format_is_valid(format->nDataFormat) || format->nSampleRate == 0 || format->nChannels == 0)
+		return 0;
+	FILE* fp = fopen(filename, "wb");
+	if(fp == 0)
+		return 0;
+
+	const uint32 bytes = MOTION_SAMPLE_BYTE(format->nDataFormat);
+	const uint32 block = format->nChannels * bytes;
+	const uint32 frames = motion_len / block;
+	for(uint32 f=0; f<frames; f++) {
+		fprintf(fp, "%u", (uint32)((uint64)f * 1000 / format->nSampleRate));
+		for(uint32 c=0; c<format->nChannels; c++) {
+			float value = im_sample_load(motion_buf + f * block + c * bytes, format->nDataFormat);
+			fprintf(fp, ",%g", value * (IM_CSV_FULL_SCALE / IM_SAMPLE_FULL_SCALE));
+		}
+		fprintf(fp, "\n");
+	}
+	fclose(fp);
+	return 1;
+}
+
+/************************************
+ * Binary motion file
+ ************************************/
+/**
+ * This function checks the header of a binary motion file of 'size' bytes.
+ */
+static bool motion_check_header(const IM_MOTION_FILE_HEADER* header, uint64 size)
+{
+	if(memcmp(header->cMagic, IM_MOTION_FILE_MAGIC, sizeof(header->cMagic)) != 0 || header->nVersion != IM_MOTION_FILE_VERSION)
+		return false;
+
+	const IM_FORMAT& format = header->format;
+	if(!im_format_is_valid(format.nDataFormat) || format.nChannels < 1 || format.nChannels > IM_FORMAT_CHANNELS_MAX || format.nSampleRate < 1)
+		return false;
+	if(format.nBlockAlign != format.nChannels * MOTION_SAMPLE_BYTE(format.nDataFormat))
+		return false;
+	if(header->nDataOffset < sizeof(IM_MOTION_FILE_HEADER) || header->nFrames == 0
+		|| (uint64)header->nDataOffset + (uint64)header->nFrames * format.nBlockAlign > size)
+		return false; // truncated
+	if(header->nLoopEnd && (header->nLoopEnd > header->nFrames || header->nLoopBegin >= header->nLoopEnd))
+		return false;
+	return true;
+}
+
+IM_DRIVER_DLL_API int IMotion_ParseMotion(const void* data, int size, IM_MOTION_FILE* file)
+{
+	if(data == 0 || file == 0 || size < (int)sizeof(IM_MOTION_FILE_HEADER))
+		return 0;
+	memset(file, 0, sizeof(*file));
+	const IM_MOTION_FILE_HEADER* header = (const IM_MOTION_FILE_HEADER*)data;
+	if(!motion_check_header(header, (uint64)size))
+		return 0;
+
+	file->header = *header;
+	file->pData = (uint8*)data + header->nDataOffset;
+	return 1;
+}
+
+IM_DRIVER_DLL_API int IMotion_MapMotion(const char* filename, IM_MOTION_FILE* file)
+{
+	if(filename == 0 || file == 0)
+		return 0;
+#if defined(__linux__)
+	int fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+		return 0;
+	// the header is checked before the mapping (a csv file is not mapped)
+	IM_MOTION_FILE_HEADER header;
+	struct stat st;
+	if(pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) || memcmp(header.cMagic, IM_MOTION_FILE_MAGIC, sizeof(header.cMagic)) != 0
+		|| fstat(fd, &st) != 0 || st.st_size > 0x7FFFFFFF) {
+		close(fd);
+		return 0;
+	}
+	// private writable mapping : the file is never written, a motion buffer that is refilled copies the pages it writes
+	const size_t size = (size_t)st.st_size;
+	void* data = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(data == MAP_FAILED)
+		return 0;
+	madvise(data, size, MADV_SEQUENTIAL);
+	if(!IMotion_ParseMotion(data, (int)size, file)) {
+		munmap(data, size);
+		return 0;
+	}
+	file->pMemory = data;
+	file->nMemorySize = (uint32)size;
+	file->bMapped = 1;
+	return 1;
+#else
+	FILE* fp = fopen(filename, "rb");
+	if(fp == 0)
+		return 0;
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	void* data = (size > 0) ? malloc(size) : 0;
+	size_t read = data ? fread(data, 1, size, fp) : 0;
+	fclose(fp);
+	if(data == 0 || !IMotion_ParseMotion(data, (int)read, file)) {
+		free(data);
+		return 0;
+	}
+	file->pMemory = data;
+	file->nMemorySize = (uint32)read;
+	file->bMapped = 0;
+	return 1;
+#endif
+}
+
+IM_DRIVER_DLL_API int IMotion_UnmapMotion(IM_MOTION_FILE* file)
+{
+	if(file == 0)
+		return 0;
+#if defined(__linux__)
+	if(file->pMemory && file->bMapped)
+		munmap(file->pMemory, file->nMemorySize);
+	else
+#endif
+		free(file->pMemory);
+	memset(file, 0, sizeof(*file));
+	return 1;
+}
+
+IM_DRIVER_DLL_API int IMotion_SaveMotion(const char* filename, const IM_FORMAT* format, const uint8 * motion_buf, uint32 motion_len, uint32 loop_begin, uint32 loop_end)
+{
+	if(filename == 0 || format == 0 || motion_buf == 0)
+		return 0;
+	if(!im_format_is_valid(format->nDataFormat) || format->nSampleRate == 0 || format->nChannels == 0 || format->nChannels > IM_FORMAT_CHANNELS_MAX)
+		return 0;
+
+	IM_MOTION_FILE_HEADER header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.cMagic, IM_MOTION_FILE_MAGIC, sizeof(header.cMagic));
+	header.nVersion = IM_MOTION_FILE_VERSION;
+	im_format_set(&header.format, format->nType, format->nSampleRate, format->nChannels, format->nDataFormat);
+	header.nFrames = motion_len / header.format.nBlockAlign;
+	header.nLoopBegin = loop_end ? loop_begin : 0;
+	header.nLoopEnd = loop_end;
+	header.nDataOffset = (sizeof(header) + IM_MOTION_FILE_ALIGN - 1) / IM_MOTION_FILE_ALIGN * IM_MOTION_FILE_ALIGN;
+	if(header.nFrames == 0 || (loop_end && (loop_end > header.nFrames || loop_begin >= loop_end)))
+		return 0;
+
+	FILE* fp = fopen(filename, "wb");
+	if(fp == 0)
+		return 0;
+	static const uint8 s_padding[IM_MOTION_FILE_ALIGN] = { 0 };
+	const size_t bytes = (size_t)header.nFrames * header.format.nBlockAlign;
+	bool written = fwrite(&header, sizeof(header), 1, fp) == 1
+		&& fwrite(s_padding, 1, header.nDataOffset - sizeof(header), fp) == header.nDataOffset - sizeof(header)
+		&& fwrite(motion_buf, 1, bytes, fp) == bytes;
+	written = (fclose(fp) == 0) && written;
+	if(!written)
+		remove(filename);
+	return written ? 1 : 0;
+}
+
+/************************************
+ * Motion file reader
+ ************************************/
+#define IM_READER_CHUNK		65536	/**< bytes read at a time from a csv file */
+#define IM_READER_INDEX		4096	/**< frames between the seek points of a csv file */
+
+/**
+ * Reader of a motion file in parts.
+ * (A csv file is read into a window of IM_READER_CHUNK bytes and its complete rows are parsed, the rest
+ *  of the window is kept for the next read. The offsets of every IM_READER_INDEX frames are recorded on
+ *  the way, so a seek parses the rows from the closest seek point before the frame.)
+ */
+struct IM_MOTION_READER {
+	FILE*		fp;
+	IM_FORMAT	format;
+	bool		binary;
+	uint32		frames;			/**< frames of the file (0 : not known yet, csv) */
+	uint32		frame;			/**< next frame */
+	uint32		data_offset;	/**< offset of the samples (binary) */
+	uint32		channels;		/**< channels of the first row (csv, 0 : not parsed yet) */
+	double		time[2];		/**< timestamps of the first two rows (csv) */
+	std::vector<char> text;		/**< window of the file (csv) */
+	uint32		begin;			/**< unparsed bytes of the window */
+	uint32		end;
+	uint64		offset;			/**< file offset of the window */
+	bool		eof;
+	std::vector<uint64> index;	/**< file offsets of the frames i * IM_READER_INDEX */
+};
+
+static int reader_read_csv(IM_MOTION_READER* reader, uint8* motion_buf, uint32 frames)
+{
+	uint32 done = 0;
+	while(done < frames) {
+		// complete rows of the window (the last row of the file may have no line end)
+		const char* base = &reader->text[0];
+		const char* p = base + reader->begin;
+		const char* limit = base + reader->end;
+		if(!reader->eof) {
+			while(limit > p && limit[-1] != '\n')
+				limit--;
+		}
+		while(p < limit && done < frames) {
+			const char* row = p;
+			double msec = 0;
+			float frame[IM_FORMAT_CHANNELS_MAX];
+			int count;
+			p = csv_parse_row(row, limit, &msec, frame, &count);
+			if(p == 0)
+				return -1;
+			if(count < 0 || (count == 0 && reader->frame == 0))
+				continue;
+			if(reader->channels == 0)
+				reader->channels = (uint32)count; // the first row sets the channels
+			if(reader->frame < 2)
+				reader->time[reader->frame] = msec;
+			if(reader->frame % IM_READER_INDEX == 0 && reader->frame / IM_READER_INDEX == reader->index.size())
+				reader->index.push_back(reader->offset + (uint64)(row - base));
+			csv_store_frame(motion_buf + (size_t)done * reader->channels * sizeof(int16), frame, count, reader->channels);
+			reader->frame++;
+			done++;
+		}
+		reader->begin = (uint32)(p - base);
+		if(done == frames || (reader->eof && reader->begin >= reader->end))
+			break;
+
+		// the rest of the window moves to the front, a row longer than the window grows it
+		const uint32 rest = reader->end - reader->begin;
+		if(rest && reader->begin)
+			memmove(&reader->text[0], &reader->text[reader->begin], rest);
+		reader->offset += reader->begin;
+		reader->begin = 0;
+		reader->end = rest;
+		if(reader->text.size() < (size_t)rest + IM_READER_CHUNK)
+			reader->text.resize((size_t)rest + IM_READER_CHUNK);
+		size_t read = fread(&reader->text[rest], 1, reader->text.size() - rest, reader->fp);
+		reader->end += (uint32)read;
+		reader->eof = (read == 0);
+	}
+	if(reader->eof && reader->begin >= reader->end && reader->frames == 0)
+		reader->frames = reader->frame;
+	return (int)done;
+}
+
+static bool reader_seek_csv(IM_MOTION_READER* reader, uint32 frame)
+{
+	// from the closest seek point, the rows before the frame are parsed again
+	const size_t point = reader->index.empty() ? 0 : MOTION_MIN((size_t)(frame / IM_READER_INDEX), reader->index.size() - 1);
+	const uint64 offset = reader->index.empty() ? 0 : reader->index[point];
+	if(fseek(reader->fp, (long)offset, SEEK_SET) != 0)
+		return false;
+	reader->offset = offset;
+	reader->begin = reader->end = 0;
+	reader->eof = false;
+	reader->frame = reader->index.empty() ? 0 : (uint32)point * IM_READER_INDEX;
+
+	uint8 skip[IM_FORMAT_CHANNELS_MAX * sizeof(int16) * 64];
+	while(reader->frame < frame) {
+		int read = reader_read_csv(reader, skip, MOTION_MIN(frame - reader->frame, (uint32)64));
+		if(read <= 0)
+			return false;
+	}
+	return true;
+}
+
+IM_DRIVER_DLL_API IM_MOTION_READER* IMotion_OpenMotion(const char* filename, IM_FORMAT* format, uint32* frames, uint32* loop_begin, uint32* loop_end, const char* key)
+{
+	if(filename == 0 || format == 0 || key)
+		return 0;
+	FILE* fp = fopen(filename, "rb");
+	if(fp == 0)
+		return 0;
+	IM_MOTION_READER* reader = new IM_MOTION_READER();
+	reader->fp = fp;
+
+	// binary motion file
+	IM_MOTION_FILE_HEADER header;
+	if(fread(&header, sizeof(header), 1, fp) == 1 && memcmp(header.cMagic, IM_MOTION_FILE_MAGIC, sizeof(header.cMagic)) == 0) {
+		fseek(fp, 0, SEEK_END);
+		long size = ftell(fp);
+		if(size < 0 || !motion_check_header(&header, (uint64)size) || fseek(fp, (long)header.nDataOffset, SEEK_SET) != 0) {
+			IMotion_CloseMotion(reader);
+			return 0;
+		}
+		reader->binary = true;
+		reader->format = header.format;
+		reader->frames = header.nFrames;
+		reader->data_offset = header.nDataOffset;
+		*format = reader->format;
+		if(frames) *frames = header.nFrames;
+		if(loop_begin) *loop_begin = header.nLoopBegin;
+		if(loop_end) *loop_end = header.nLoopEnd;
+		return reader;
+	}
+
+	// csv : the first two rows set the format
+	uint8 first[IM_FORMAT_CHANNELS_MAX * sizeof(int16) * 2];
+	fseek(fp, 0, SEEK_SET);
+	reader->text.resize(IM_READER_CHUNK);
+	int rows = reader_read_csv(reader, first, 1);
+	if(rows == 1)
+		rows += reader_read_csv(reader, first + reader->channels * sizeof(int16), 1);
+	if(rows <= 0 || !reader_seek_csv(reader, 0)) {
+		IMotion_CloseMotion(reader);
+		return 0;
+	}
+	im_format_set(&reader->format, IM_FORMAT_TYPE_DOF, csv_sample_rate((uint32)rows, reader->time), reader->channels, IM_FORMAT_DATA_S16);
+	*format = reader->format;
+	if(frames) *frames = reader->frames;
+	if(loop_begin) *loop_begin = 0;
+	if(loop_end) *loop_end = 0;
+	return reader;
+}
+
+IM_DRIVER_DLL_API int IMotion_ReadMotion(IM_MOTION_READER* reader, uint8 * motion_buf, uint32 frames)
+{
+	if(reader == 0 || motion_buf == 0)
+		return -1;
+	if(!reader->binary)
+		return reader_read_csv(reader, motion_buf, frames);
+	frames = MOTION_MIN(frames, reader->frames - reader->frame);
+	size_t read = frames ? fread(motion_buf, reader->format.nBlockAlign, frames, reader->fp) : 0;
+	reader->frame += (uint32)read;
+	return (read == frames) ? (int)read : -1;
+}
+
+IM_DRIVER_DLL_API int IMotion_SeekMotion(IM_MOTION_READER* reader, uint32 frame)
+{
+	if(reader == 0 || (reader->frames && frame > reader->frames))
+		return 0;
+	if(!reader->binary)
+		return reader_seek_csv(reader, frame) ? 1 : 0;
+	if(fseek(reader->fp, (long)(reader->data_offset + (uint64)frame * reader->format.nBlockAlign), SEEK_SET) != 0)
+		return 0;
+	reader->frame = frame;
+	return 1;
+}
+
+IM_DRIVER_DLL_API int IMotion_CloseMotion(IM_MOTION_READER* reader)
+{
+	if(reader == 0)
+		return 0;
+	if(reader->fp)
+		fclose(reader->fp);
+	delete reader;
+	return 1;
+}
+
+/************************************
+ * QEditor project
+ ************************************/
+/**
+ *  \name IM_QEP_*
+ *
+ *  Declare the QEditor project layout. (".qep", XML)
+ *  (<QEProject> has a <Timeline start end> and a <Layer max min> per channel, in the order of the csv columns
+ *   that QEditor saves. A layer has <Clip start linear> of <Cycle arrow data size> keys : the data is the value
+ *   at the time of the key, and a quarter of a sine wave (arrow 0, 2 : from the axis, 1, 3 : to the axis) or a
+ *   line goes to the next key in 'size' units. The last key of a clip has no size and holds for one unit.
+ *   The times are in timeline units, the values are csv values limited to the layer range by <Project limit_data>.)
+ */
+#define IM_QEP_UNIT_RATE	50		/**< timeline units per second */
+
+/**
+ * Tag of a project. (the text is not copied : the name and the attributes point into the file memory)
+ */
+typedef struct {
+	const char*	name;
+	int			name_len;
+	const char*	attrs;			/**< attributes text up to the end of the tag */
+	const char*	attrs_end;
+	bool		end;			/**< </name> */
+	bool		empty;			/**< <name/> (no end tag follows) */
+} IM_QEP_TAG;
+
+/**
+ * Pull parser of the tags of a project. (one pass over the file memory, no tree is built)
+ * (Declarations, comments, CDATA and text are skipped. Only white space is allowed outside the root
+ *  element, so a file that is not XML stops at its first byte.)
+ */
+typedef struct {
+	const char*	p;
+	const char*	end;
+	int			depth;			/**< open elements */
+	IM_QEP_TAG	tag;
+} IM_QEP_PARSER;
+
+static inline bool qep_is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static const char* qep_find(const char* p, const char* end, const char* token)
+{
+	const size_t len = strlen(token);
+	while(p < end && (p = (const char*)memchr(p, token[0], end - p)) != 0) {
+		if((size_t)(end - p) >= len && memcmp(p, token, len) == 0)
+			return p;
+		p++;
+	}
+	return 0;
+}
+
+/**
+ * This function gets the next tag. (1 : a tag, 0 : the end of the file, -1 : not a well-formed project)
+ */
+static int qep_next(IM_QEP_PARSER* parser)
+{
+	const char* p = parser->p;
+	const char* end = parser->end;
+	for(;;) {
+		if(parser->depth == 0) {
+			while(p < end && qep_is_space(*p))
+				p++;
+			if(p == end)
+				return 0;
+			if(*p != '<')
+				return -1;
+		}
+		else if((p = (const char*)memchr(p, '<', end - p)) == 0)
+			return -1; // an element is not closed
+		p++;
+
+		// declaration, comment, CDATA or DOCTYPE
+		const char* close = 0;
+		if(p < end && *p == '?')
+			close = "?>";
+		else if(end - p >= 3 && memcmp(p, "!--", 3) == 0)
+			close = "-->";
+		else if(end - p >= 8 && memcmp(p, "![CDATA[", 8) == 0)
+			close = "]]>";
+		else if(p < end && *p == '!')
+			close = ">";
+		if(close) {
+			if((p = qep_find(p, end, close)) == 0)
+				return -1;
+			p += strlen(close);
+			continue;
+		}
+
+		IM_QEP_TAG& tag = parser->tag;
+		tag.end = (p < end && *p == '/');
+		if(tag.end)
+			p++;
+		tag.name = p;
+		while(p < end && !qep_is_space(*p) && *p != '/' && *p != '>')
+			p++;
+		tag.name_len = (int)(p - tag.name);
+		tag.attrs = p;
+		char quote = 0;
+		for(; p < end && (quote || *p != '>'); p++) {
+			if(quote ? *p == quote : (*p == '"' || *p == '\''))
+				quote = quote ? 0 : *p;
+		}
+		if(p == end || tag.name_len == 0)
+			return -1;
+		tag.empty = !tag.end && p[-1] == '/';
+		tag.attrs_end = tag.empty ? p - 1 : p;
+		parser->p = p + 1;
+		if(tag.end && --parser->depth < 0)
+			return -1;
+		if(!tag.end && !tag.empty)
+			parser->depth++;
+		return 1;
+	}
+}
+
+static inline bool qep_is(const IM_QEP_TAG* tag, const char* name)
+{
+	return (size_t)tag->name_len == strlen(name) && memcmp(tag->name, name, tag->name_len) == 0;
+}
+
+/**
+ * This function gets the number of an attribute, or the default if the tag does not have it.
+ * (The attributes that are read are numbers, so the entities are not decoded.)
+ */
+static double qep_number(const IM_QEP_TAG* tag, const char* name, double value)
+{
+	const size_t len = strlen(name);
+	const char* p = tag->attrs;
+	const char* end = tag->attrs_end;
+	for(;;) {
+		while(p < end && qep_is_space(*p))
+			p++;
+		const char* key = p;
+		while(p < end && *p != '=' && !qep_is_space(*p))
+			p++;
+		const char* key_end = p;
+		while(p < end && qep_is_space(*p))
+			p++;
+		if(p >= end || *p != '=')
+			return value;
+		for(p++; p < end && qep_is_space(*p); p++)
+			;
+		if(p >= end || (*p != '"' && *p != '\''))
+			return value;
+		const char* text = p + 1;
+		const char* text_end = (const char*)memchr(text, *p, end - text);
+		if(text_end == 0)
+			return value;
+		if((size_t)(key_end - key) == len && memcmp(key, name, len) == 0) {
+			double parsed;
+			return csv_parse_number(text, text_end, &parsed) ? parsed : value;
+		}
+		p = text_end + 1;
+	}
+}
+
+/**
+ * Key of a clip waiting for the next key.
+ */
+typedef struct {
+	int			arrow;
+	float		data;
+	double		size;			/**< units to the next key (0 : the last key) */
+} IM_QEP_KEY;
+
+/**
+ * Compiler of the layers into interleaved frames. (IM_FORMAT_CHANNELS_MAX samples per frame, packed to the layers at the end)
+ */
+typedef struct {
+	uint32		sample_rate;
+	double		start;			/**< timeline start (units) */
+	uint32		frames;			/**< frames of the timeline (0 : up to the last clip) */
+	uint32		rendered;		/**< end of the rendered frames (the samples grow ahead of it) */
+	std::vector<int16> samples;
+	int			layers;
+	int			channel;		/**< channel of the layer (-1 : outside a layer or over the channels) */
+	bool		limit;
+	float		min;
+	float		max;
+	bool		clip;			/**< inside a clip */
+	bool		linear;
+	double		time;			/**< time of the waiting key (units) */
+	bool		waiting;
+	IM_QEP_KEY	key;
+} IM_QEP_COMPILER;
+
+/**
+ * This function renders the frames of a layer whose times are in a segment of 'units' from 'time'.
+ * (The value goes from 'from' to 'to' along a line, or a quarter sine wave that is rotated from frame
+ *  to frame. shape 0 : line, 1 : from the axis, 2 : to the axis, 3 : hold 'from')
+ */
+static void qep_render(IM_QEP_COMPILER* c, double time, double units, float from, float to, int shape)
+{
+	// frames f of the times start + f * IM_QEP_UNIT_RATE / rate in [time, time + units)
+	const double rate = (double)c->sample_rate / IM_QEP_UNIT_RATE;
+	int64 first = (int64)ceil((time - c->start) * rate);
+	int64 last = (int64)ceil((time + units - c->start) * rate);
+	if(first < 0)
+		first = 0;
+	if(c->frames && last > (int64)c->frames)
+		last = c->frames;
+	if(last <= first || units <= 0)
+		return;
+	if(c->samples.size() < (size_t)last * IM_FORMAT_CHANNELS_MAX)
+		c->samples.resize(MOTION_MAX((size_t)last, c->samples.size() / IM_FORMAT_CHANNELS_MAX * 2) * IM_FORMAT_CHANNELS_MAX, 0);
+	c->rendered = MOTION_MAX(c->rendered, (uint32)last);
+
+	const double x = ((c->start + first / rate) - time) / units;
+	const double dx = 1.0 / (rate * units);
+	const double step_cos = cos(dx * IM_PI / 2), step_sin = sin(dx * IM_PI / 2);
+	double co = cos(x * IM_PI / 2), si = sin(x * IM_PI / 2);
+
+	// u = k_line * (x + n * dx) + k_sin * sin + k_cos * cos + k_one of the shape, and the value in samples from + (to - from) * u
+	const double k_line = (shape == 0), k_sin = (shape == 1), k_cos = -(shape == 2), k_one = (shape == 2);
+	const float scale = IM_SAMPLE_FULL_SCALE / IM_CSV_FULL_SCALE;
+	const float base = from * scale, delta = (to - from) * scale;
+	const float low = c->limit ? c->min * scale : IM_SAMPLE_MIN, high = c->limit ? c->max * scale : IM_SAMPLE_MAX;
+	int16* out = &c->samples[(size_t)first * IM_FORMAT_CHANNELS_MAX + c->channel];
+	for(int64 n=0; n<last-first; n++, out += IM_FORMAT_CHANNELS_MAX) {
+		const double u = k_line * (x + n * dx) + k_sin * si + k_cos * co + k_one;
+		const float value = base + delta * (float)u;
+		im_sample_store((uint8*)out, IM_FORMAT_DATA_S16, MOTION_CLAMP(value, low, high));
+		const double rotated = co * step_cos - si * step_sin;
+		si = si * step_cos + co * step_sin;
+		co = rotated;
+	}
+}
+
+/**
+ * This function ends the segment of the waiting key at the next key, or at the end of the clip (next 0).
+ */
+static void qep_segment(IM_QEP_COMPILER* c, const IM_QEP_KEY* next)
+{
+	const IM_QEP_KEY& key = c->key;
+	if(next)
+		qep_render(c, c->time, key.size, key.data, next->data, c->linear ? 0 : 1 + (key.arrow & 1));
+	else
+		qep_render(c, c->time, key.size > 0 ? key.size : 1, key.data, key.data, 3);
+	c->time += key.size;
+}
+
+/**
+ * The project is parsed in one pass and each segment of a clip is rendered at the sample rate when its next key is read.
+ */
+IM_DRIVER_DLL_API int IMotion_LoadProject_RAW(const void* data, int size, IM_FORMAT* format, uint8 ** motion_buf, uint32 * motion_len, uint32 sample_rate)
+{
+	if(data == 0 || size <= 0 || format == 0 || motion_buf == 0 || motion_len == 0)
+		return 0;
+	IM_QEP_PARSER parser;
+	parser.p = (const char*)data;
+	parser.end = parser.p + size;
+	parser.depth = 0;
+	if(size >= 3 && memcmp(parser.p, "\xEF\xBB\xBF", 3) == 0)
+		parser.p += 3;
+
+	IM_QEP_COMPILER c;
+	c.sample_rate = sample_rate ? sample_rate : IM_QEP_UNIT_RATE;
+	c.start = 0;
+	c.frames = 0;
+	c.rendered = 0;
+	c.layers = 0;
+	c.channel = -1;
+	c.limit = true;
+	c.min = c.max = 0;
+	c.clip = c.waiting = c.linear = false;
+	c.time = 0;
+
+	int result;
+	bool root = false;
+	while((result = qep_next(&parser)) > 0) {
+		const IM_QEP_TAG* tag = &parser.tag;
+		if(!root) {
+			if(tag->end || !qep_is(tag, "QEProject"))
+				return 0;
+			root = true;
+		}
+		else if(tag->end) {
+			if(qep_is(tag, "Clip") && c.clip) {
+				if(c.waiting)
+					qep_segment(&c, 0);
+				c.clip = c.waiting = false;
+			}
+			else if(qep_is(tag, "Layer"))
+				c.channel = -1;
+		}
+		else if(qep_is(tag, "Project"))
+			c.limit = qep_number(tag, "limit_data", 1) != 0;
+		else if(qep_is(tag, "Timeline")) {
+			c.start = qep_number(tag, "start", 0);
+			const double end = qep_number(tag, "end", 0);
+			if(end > c.start) {
+				c.frames = (uint32)ceil((end - c.start) * c.sample_rate / IM_QEP_UNIT_RATE);
+				c.samples.resize((size_t)c.frames * IM_FORMAT_CHANNELS_MAX, 0);
+			}
+		}
+		else if(qep_is(tag, "Layer")) {
+			c.channel = (c.layers < IM_FORMAT_CHANNELS_MAX && !tag->empty) ? c.layers : -1;
+			c.layers++;
+			c.max = (float)qep_number(tag, "max", IM_CSV_FULL_SCALE);
+			c.min = (float)qep_number(tag, "min", -c.max);
+		}
+		else if(qep_is(tag, "Clip") && c.channel >= 0 && !tag->empty) {
+			c.clip = true;
+			c.waiting = false;
+			c.linear = qep_number(tag, "linear", 0) != 0;
+			c.time = qep_number(tag, "start", 0);
+		}
+		else if(qep_is(tag, "Cycle") && c.clip) {
+			IM_QEP_KEY key;
+			key.arrow = (int)qep_number(tag, "arrow", 0);
+			key.data = (float)qep_number(tag, "data", 0);
+			key.size = MOTION_MAX(qep_number(tag, "size", 0), 0.0);
+			if(c.waiting)
+				qep_segment(&c, &key);
+			c.key = key;
+			c.waiting = true;
+		}
+	}
+	if(result < 0 || !root || c.layers == 0)
+		return 0;
+
+	const uint32 frames = c.frames ? c.frames : c.rendered;
+	const uint32 channels = (uint32)MOTION_MIN(c.layers, IM_FORMAT_CHANNELS_MAX);
+	if(frames == 0)
+		return 0;
+	c.samples.resize((size_t)frames * IM_FORMAT_CHANNELS_MAX, 0);
+	im_format_set(format, IM_FORMAT_TYPE_DOF, c.sample_rate, channels, IM_FORMAT_DATA_S16);
+	uint8* motion = (uint8*)malloc((size_t)frames * format->nBlockAlign);
+	if(motion == 0)
+		return 0;
+	for(uint32 f=0; f<frames; f++)
+		memcpy(motion + (size_t)f * format->nBlockAlign, &c.samples[(size_t)f * IM_FORMAT_CHANNELS_MAX], format->nBlockAlign);
+	*motion_buf = motion;
+	*motion_len = frames * format->nBlockAlign;
+	return 1;
+}
+
+IM_DRIVER_DLL_API int IMotion_LoadProject(const char* filename, IM_FORMAT* format, uint8 ** motion_buf, uint32 * motion_len, uint32 sample_rate)
+{
+	return motion_load_file(filename, [&](const void* data, int size) {
+		return IMotion_LoadProject_RAW(data, size, format, motion_buf, motion_len, sample_rate);
+	});
+}
@@ -0,0 +1,978 @@
+/********************************************************************************//**
+\file      InnoML_buffer.cpp
+\brief     Motion buffer objects (IMBuffer) of the InnoML reference engine.
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#include "InnoML_internal.h"
+#include <IMotion_csv.h>
+#include <algorithm>
+#include <list>
+#include <unordered_map>
+#include <stdlib.h>
+#if defined(__linux__)
+#	include <sys/mman.h>
+#	include <unistd.h>
+#endif
+
+/**
+ * These functions allocate the ring memory.
+ * (On Linux the ring is a memfd mapped twice back-to-back, so any region of up to the ring size
+ *  starting inside the first mapping is contiguous. Otherwise the ring is a plain allocation.)
+ */
+static uint32 ring_page_frames(uint32 block)
+{
+#if defined(__linux__)
+	uint32 page = (uint32)sysconf(_SC_PAGESIZE), a = page, b = block;
+	while(b) { uint32 t = a % b; a = b; b = t; }
+	return page / a; // frames of the smallest page multiple
+#else
+	return 1;
+#endif
+}
+
+static uint8* ring_map(uint32 bytes, bool* mirrored)
+{
+	*mirrored = false;
+#if defined(__linux__)
+	int fd = memfd_create("InnoML_buffer", MFD_CLOEXEC);
+	if(fd >= 0) {
+		uint8* base = (uint8*)mmap(0, (size_t)bytes * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(base != MAP_FAILED) {
+			if(ftruncate(fd, bytes) == 0
+				&& mmap(base, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED
+				&& mmap(base + bytes, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED) {
+				close(fd);
+				*mirrored = true;
+				return base;
+			}
+			munmap(base, (size_t)bytes * 2);
+		}
+		close(fd);
+	}
+#endif
+	return (uint8*)calloc(bytes, 1);
+}
+
+static void ring_unmap(uint8* data, uint32 bytes, bool mirrored)
+{
+#if defined(__linux__)
+	if(mirrored) {
+		munmap(data, (size_t)bytes * 2);
+		return;
+	}
+#endif
+	free(data);
+}
+
+MotionBuffer::MotionBuffer()
+	: MotionObject(IM_OBJECT_BUFFER), m_samples(0), m_buffers(0), m_capacity(0), m_size(0), m_bytes(0), m_data(0), m_mirrored(false), m_loop_begin(0), m_loop_end(0), m_stream(0), m_shared(0), m_mirror_count(0),
+	m_lock_data(0), m_lock_frames(0), m_lock_flags(0), m_locked(false), m_head(0), m_tail(0)
+{
+	memset(&m_format, 0, sizeof(m_format));
+	memset(&m_file, 0, sizeof(m_file));
+}
+
+MotionBuffer::~MotionBuffer()
+{
+	delete m_stream; // the decoder thread writes the ring
+	SetShared(0);
+	for(size_t i=0; i<m_mirrors.size(); i++)
+		m_mirrors[i]->m_shared = 0;
+	if(m_file.pMemory)
+		IMotion_UnmapMotion(&m_file);
+	else if(m_data)
+		ring_unmap(m_data, m_bytes, m_mirrored);
+}
+
+bool MotionBuffer::Create(const IM_FORMAT* format, int32 samples, int32 buffers)
+{
+	if(!im_format_is_valid(format->nDataFormat) || format->nChannels < 1 || format->nChannels > IM_FORMAT_CHANNELS_MAX)
+		return false;
+	if(format->nSampleRate < 1 || samples < 1 || buffers < 1)
+		return false;
+
+	im_format_set(&m_format, format->nType, format->nSampleRate, format->nChannels, format->nDataFormat);
+	m_samples = samples;
+	m_buffers = buffers;
+	m_capacity = (uint32)samples * (uint32)buffers;
+	const uint32 page = ring_page_frames(m_format.nBlockAlign);
+	m_size = (m_capacity + page - 1) / page * page;
+	m_bytes = m_size * m_format.nBlockAlign;
+	m_data = ring_map(m_bytes, &m_mirrored);
+	return m_data != 0;
+}
+
+/**
+ * The frames of a binary motion file are the ring of a full buffer, so the file is not copied.
+ * (The buffer takes the file. Frames enqueued after a dequeue are written to private pages of the mapping.)
+ */
+bool MotionBuffer::Wrap(IM_MOTION_FILE* file)
+{
+	const IM_MOTION_FILE_HEADER& header = file->header;
+	im_format_set(&m_format, header.format.nType, header.format.nSampleRate, header.format.nChannels, header.format.nDataFormat);
+	m_samples = (int32)header.nFrames;
+	m_buffers = 1;
+	m_capacity = header.nFrames;
+	m_size = header.nFrames;
+	m_bytes = m_size * m_format.nBlockAlign;
+	m_data = file->pData;
+	m_mirrored = false;
+	m_loop_begin = header.nLoopBegin;
+	m_loop_end = header.nLoopEnd;
+	m_file = *file;
+	memset(file, 0, sizeof(*file));
+	m_head.store(0, std::memory_order_relaxed);
+	m_tail.store(Advance(0, m_size), std::memory_order_release);
+	return true;
+}
+
+/**
+ * These functions copy frames into and out of the ring at a ring index. (two copies at most, one if mirrored)
+ */
+static void ring_write(const MotionBuffer* buffer, uint32 index, const uint8* src, uint32 frames)
+{
+	const uint32 block = buffer->m_format.nBlockAlign;
+	const uint32 offset = buffer->Offset(index);
+	const uint32 first = buffer->m_mirrored ? frames : MOTION_MIN(frames, buffer->m_size - offset);
+	memcpy(buffer->m_data + offset * block, src, first * block);
+	memcpy(buffer->m_data, src + first * block, (frames - first) * block);
+}
+
+static void ring_read(const MotionBuffer* buffer, uint32 index, uint8* dst, uint32 frames)
+{
+	const uint32 block = buffer->m_format.nBlockAlign;
+	const uint32 offset = buffer->Offset(index);
+	const uint32 first = buffer->m_mirrored ? frames : MOTION_MIN(frames, buffer->m_size - offset);
+	memcpy(dst, buffer->m_data + offset * block, first * block);
+	memcpy(dst + first * block, buffer->m_data, (frames - first) * block);
+}
+
+int32 MotionBuffer::Enqueue(const void* data, int32 size)
+{
+	if(data == 0 || size <= 0 || m_locked)
+		return 0;
+	const uint32 block = m_format.nBlockAlign;
+	const uint32 head = m_head.load(std::memory_order_acquire);
+	const uint32 tail = m_tail.load(std::memory_order_relaxed);
+	const uint32 frames = MOTION_MIN((uint32)size / block, m_capacity - Distance(head, tail));
+	if(frames == 0)
+		return 0;
+	ring_write(this, tail, (const uint8*)data, frames);
+	m_tail.store(Advance(tail, frames), std::memory_order_release);
+
+	if(m_mirror_count.load(std::memory_order_relaxed)) {
+		IM_API_LOCK();
+		for(size_t i=0; i<m_mirrors.size(); i++)
+			m_mirrors[i]->Enqueue(data, frames * block);
+	}
+	return frames * block;
+}
+
+int32 MotionBuffer::Dequeue(void* data, int32 size)
+{
+	if(size <= 0 || m_locked)
+		return 0;
+	const uint32 block = m_format.nBlockAlign;
+	const uint32 tail = m_tail.load(std::memory_order_acquire);
+	const uint32 head = m_head.load(std::memory_order_relaxed);
+	const uint32 frames = MOTION_MIN((uint32)size / block, Distance(head, tail));
+	if(frames == 0)
+		return 0;
+	if(data)
+		ring_read(this, head, (uint8*)data, frames);
+	m_head.store(Advance(head, frames), std::memory_order_release);
+	return frames * block;
+}
+
+int32 MotionBuffer::Read(uint32 offset, void* data, int32 frames) const
+{
+	const uint32 tail = m_tail.load(std::memory_order_acquire);
+	const uint32 head = m_head.load(std::memory_order_relaxed);
+	const uint32 queued = Distance(head, tail);
+	if(offset >= queued || frames <= 0)
+		return 0;
+	frames = (int32)MOTION_MIN((uint32)frames, queued - offset);
+	ring_read(this, Advance(head, offset), (uint8*)data, frames);
+	return frames;
+}
+
+void* MotionBuffer::Lock(int32 size, uint32 flags)
+{
+	if(m_locked || size < 0)
+		return 0;
+	if(flags & IM_BUFFER_LOCK_DISCARD)
+		Clear();
+
+	const uint32 block = m_format.nBlockAlign;
+	const bool write = (flags & IM_BUFFER_LOCK_WRITE) != 0;
+	const uint32 avail = write ? GetFreeCount() : GetQueuedCount();
+	const uint32 frames = size ? (uint32)size / block : avail;
+	if(frames == 0 || frames > avail)
+		return 0;
+
+	const uint32 index = write ? m_tail.load(std::memory_order_relaxed) : m_head.load(std::memory_order_relaxed);
+	const uint32 start = Offset(index);
+	if(m_mirrored || start + frames <= m_size) {
+		// the ring memory itself (contiguous across the wrap when mirrored)
+		m_lock_data = m_data + start * block;
+	}
+	else {
+		// the region wraps the ring, so it is staged in a linear copy
+		m_staging.resize(frames * block);
+		m_lock_data = &m_staging[0];
+		if(!write)
+			ring_read(this, index, m_lock_data, frames);
+	}
+	m_lock_frames = frames;
+	m_lock_flags = flags;
+	m_locked = true;
+	return m_lock_data;
+}
+
+int32 MotionBuffer::Unlock()
+{
+	if(!m_locked)
+		return IM_FAIL;
+
+	const uint32 block = m_format.nBlockAlign;
+	if(m_lock_flags & IM_BUFFER_LOCK_WRITE) {
+		const uint32 tail = m_tail.load(std::memory_order_relaxed);
+		if(m_staging.size() && m_lock_data == &m_staging[0])
+			ring_write(this, tail, m_lock_data, m_lock_frames);
+		m_locked = false;
+		if(!(m_lock_flags & IM_BUFFER_LOCK_PEEK)) {
+			m_tail.store(Advance(tail, m_lock_frames), std::memory_order_release);
+			for(size_t i=0; i<m_mirrors.size(); i++)
+				m_mirrors[i]->Enqueue(m_lock_data, m_lock_frames * block);
+		}
+	}
+	else {
+		m_locked = false;
+		if(!(m_lock_flags & IM_BUFFER_LOCK_PEEK))
+			m_head.store(Advance(m_head.load(std::memory_order_relaxed), m_lock_frames), std::memory_order_release);
+	}
+	m_lock_data = 0;
+	m_lock_frames = 0;
+	return IM_OK;
+}
+
+void MotionBuffer::Clear()
+{
+	m_head.store(m_tail.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+int32 MotionBuffer::SetShared(MotionBuffer* shared)
+{
+	if(shared == this)
+		return IM_FAIL;
+	MotionBuffer* old = m_shared;
+	if(m_shared) {
+		std::vector<MotionBuffer*>& mirrors = m_shared->m_mirrors;
+		mirrors.erase(std::remove(mirrors.begin(), mirrors.end(), this), mirrors.end());
+	}
+	m_shared = shared;
+	if(m_shared)
+		m_shared->m_mirrors.push_back(this);
+	if(old)
+		old->m_mirror_count = (int32)old->m_mirrors.size();
+	if(m_shared)
+		m_shared->m_mirror_count = (int32)m_shared->m_mirrors.size();
+	return IM_OK;
+}
+
+MotionBuffer* im_buffer_create(const IM_FORMAT* format, int32 samples, int32 buffers)
+{
+	MotionBuffer* buffer = new MotionBuffer();
+	if(!buffer->Create(format, samples, buffers)) {
+		delete buffer;
+		return 0;
+	}
+	im_object_register(buffer);
+	return buffer;
+}
+
+/**
+ * This function gets the sample rate of a compiled project. (the master of the current context, 0 : the timeline rate)
+ */
+static uint32 load_sample_rate()
+{
+	IM_API_LOCK();
+	MotionContext* context = im_context_current();
+	return context ? context->m_master->m_format.nSampleRate : 0;
+}
+
+static IMBuffer load_buffer(int32 result, const IM_FORMAT* format, uint8* motion, uint32 motion_len)
+{
+	if(!result || motion == 0)
+		return 0;
+	MotionBuffer* buffer = im_buffer_create(format, motion_len / format->nBlockAlign, 1);
+	if(buffer)
+		buffer->Enqueue(motion, motion_len);
+	IMotion_FreeCSV(motion);
+	return buffer ? buffer->m_handle : 0;
+}
+
+/**
+ * Cache of the converted buffers of imBufferConvert. (LRU list of the entries in the memory budget)
+ * (An entry is keyed by the hash of the source frames, the two formats and the flattened filter chain,
+ *  the key is compared in full on a hit. The cached buffer is private to the cache : a miss caches a copy of
+ *  the converted buffer and a hit returns a new copy of the cached frames and loop points, so the callers can
+ *  dequeue, lock or loop their buffers.)
+ */
+typedef struct {
+	uint64		nSamples;		/**< hash of the source frames */
+	uint64		nFilter;		/**< hash of the filter chain */
+	uint64		nFrames;		/**< source frames (64 bits, the key has no padding) */
+	IM_FORMAT	src;
+	IM_FORMAT	dst;
+	uint32		nLoopBegin;
+	uint32		nLoopEnd;
+} IM_CONVERT_KEY;
+
+typedef struct {
+	IM_CONVERT_KEY key;
+	uint64		nHash;
+	MotionBuffer* buffer;
+	uint32		nBytes;
+	float		fRatio;
+} IM_CONVERT_ENTRY;
+
+typedef std::list<IM_CONVERT_ENTRY> IM_CONVERT_LIST;
+
+static IM_CONVERT_LIST s_cache;	/**< most recently used first */
+static std::unordered_map<uint64, IM_CONVERT_LIST::iterator> s_cache_index;
+static IM_CONVERT_CACHE_INFO s_cache_info;
+
+#define IM_HASH_BASIS	0xcbf29ce484222325ULL	/**< FNV-1a 64 */
+#define IM_HASH_PRIME	0x100000001b3ULL
+
+static uint64 hash_bytes(uint64 hash, const void* data, size_t size)
+{
+	const uint8* p = (const uint8*)data;
+	for(size_t i=0; i<size; i++)
+		hash = (hash ^ p[i]) * IM_HASH_PRIME;
+	return hash;
+}
+
+#define IM_HASH_ROTL(x, r)	(((x) << (r)) | ((x) >> (64 - (r))))
+
+/**
+ * This function hashes a 64 bits word. (the body of MurmurHash3 x64, every bit of the word reaches every bit of the hash)
+ */
+static uint64 hash_word(uint64 hash, uint64 word)
+{
+	word *= 0x87c37b91114253d5ULL;
+	word = IM_HASH_ROTL(word, 31);
+	word *= 0x4cf5ad432745937fULL;
+	hash ^= word;
+	return IM_HASH_ROTL(hash, 27) * 5 + 0x52dce729;
+}
+
+/**
+ * This function hashes the bytes of two spans (the queued frames of a ring that wraps) a word at a time.
+ * (The words are aligned to the bytes of the whole sequence, so the hash does not depend on the wrap.)
+ */
+static uint64 hash_spans(uint64 hash, const uint8* a, size_t a_size, const uint8* b, size_t b_size)
+{
+	uint64 word;
+	size_t i = 0;
+	for(; i+8<=a_size; i+=8) {
+		memcpy(&word, a + i, 8);
+		hash = hash_word(hash, word);
+	}
+	const size_t tail = a_size - i;
+	if(tail) { // the word across the wrap
+		uint8 bytes[8];
+		const size_t head = MOTION_MIN(8 - tail, b_size);
+		memcpy(bytes, a + i, tail);
+		memcpy(bytes + tail, b, head);
+		if(tail + head < 8) {
+			hash = hash_bytes(hash, bytes, tail + head);
+		}
+		else {
+			memcpy(&word, bytes, 8);
+			hash = hash_word(hash, word);
+		}
+		b += head;
+		b_size -= head;
+	}
+	for(i=0; i+8<=b_size; i+=8) {
+		memcpy(&word, b + i, 8);
+		hash = hash_word(hash, word);
+	}
+	hash = hash_bytes(hash, b + i, b_size - i);
+	// final mix (fmix64)
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ULL;
+	return hash ^ (hash >> 33);
+}
+
+/**
+ * This function hashes the stages of a filter chain in order. (Groups are flattened like the chain build,
+ * returns false for a user filter function, its output is not known from the params.)
+ */
+static bool hash_filter(const MotionFilter* filter, uint64* hash)
+{
+	if(filter->m_type == IM_FILTER_DEFAULT) {
+		for(size_t i=0; i<filter->m_children.size(); i++) {
+			if(!hash_filter(filter->m_children[i], hash))
+				return false;
+		}
+		return true;
+	}
+	if(filter->m_type == IM_FILTER_CUSTOM)
+		return false;
+	*hash = hash_bytes(*hash, &filter->m_type, sizeof(filter->m_type));
+	*hash = hash_bytes(*hash, &filter->m_param_count, sizeof(filter->m_param_count));
+	if(filter->m_param_count)
+		*hash = hash_bytes(*hash, &filter->m_params[0], filter->m_params.size());
+	return true;
+}
+
+/**
+ * This function copies the queued frames and the loop points of a buffer to a new buffer.
+ */
+static MotionBuffer* buffer_copy(const MotionBuffer* buffer)
+{
+	const uint32 frames = buffer->GetQueuedCount();
+	MotionBuffer* copy = im_buffer_create(&buffer->m_format, frames > 0 ? frames : 1, 1);
+	if(copy == 0)
+		return 0;
+	if(frames > 0) {
+		void* data = copy->Lock(frames * buffer->m_format.nBlockAlign, IM_BUFFER_LOCK_WRITE);
+		if(data == 0) {
+			im_object_release(copy);
+			return 0;
+		}
+		buffer->Read(0, data, frames);
+		copy->Unlock();
+	}
+	copy->m_loop_begin = buffer->m_loop_begin;
+	copy->m_loop_end = buffer->m_loop_end;
+	return copy;
+}
+
+static void cache_erase(IM_CONVERT_LIST::iterator it)
+{
+	s_cache_info.nSize -= it->nBytes;
+	s_cache_info.nEntries--;
+	s_cache_index.erase(it->nHash);
+	MotionBuffer* buffer = it->buffer;
+	s_cache.erase(it);
+	im_object_release(buffer);
+}
+
+static void cache_trim(uint32 budget)
+{
+	while(!s_cache.empty() && s_cache_info.nSize > budget) {
+		cache_erase(--s_cache.end());
+		s_cache_info.nEvictions++;
+	}
+}
+
+static bool cache_key(const MotionBuffer* src, const IM_FORMAT* dst, const MotionFilter* filter, IM_CONVERT_KEY* key, uint64* hash)
+{
+	memset(key, 0, sizeof(*key));
+	key->nFilter = IM_HASH_BASIS;
+	if(filter && !hash_filter(filter, &key->nFilter))
+		return false;
+	key->nFrames = src->GetQueuedCount();
+	key->src = src->m_format;
+	key->dst = *dst;
+	key->nLoopBegin = src->m_loop_begin;
+	key->nLoopEnd = src->m_loop_end;
+	// the queued frames in one span, or two when the ring wraps and is not mirrored
+	const uint32 frames = (uint32)key->nFrames;
+	const uint32 first = src->m_mirrored ? frames : MOTION_MIN(frames, src->m_size - src->Offset(src->m_head.load(std::memory_order_relaxed)));
+	const size_t align = src->m_format.nBlockAlign;
+	key->nSamples = hash_spans(IM_HASH_BASIS, frames ? src->GetFrame(0) : 0, first * align, src->m_data, (frames - first) * align);
+	*hash = hash_bytes(IM_HASH_BASIS, key, sizeof(*key));
+	return true;
+}
+
+static MotionBuffer* cache_find(const IM_CONVERT_KEY* key, uint64 hash, float* ratio)
+{
+	std::unordered_map<uint64, IM_CONVERT_LIST::iterator>::iterator found = s_cache_index.find(hash);
+	if(found == s_cache_index.end() || memcmp(&found->second->key, key, sizeof(*key)) != 0)
+		return 0;
+	IM_CONVERT_LIST::iterator it = found->second;
+	s_cache.splice(s_cache.begin(), s_cache, it);
+	*ratio = it->fRatio;
+	return buffer_copy(it->buffer);
+}
+
+static void cache_insert(const IM_CONVERT_KEY* key, uint64 hash, MotionBuffer* buffer, float ratio)
+{
+	std::unordered_map<uint64, IM_CONVERT_LIST::iterator>::iterator found = s_cache_index.find(hash);
+	if(found != s_cache_index.end())
+		cache_erase(found->second); // a collision or a stale entry
+
+	if(buffer->m_bytes > s_cache_info.nBudget)
+		return;
+	IM_CONVERT_ENTRY entry;
+	entry.key = *key;
+	entry.nHash = hash;
+	entry.buffer = buffer_copy(buffer);
+	if(entry.buffer == 0)
+		return;
+	entry.nBytes = entry.buffer->m_bytes;
+	entry.fRatio = ratio;
+	s_cache.push_front(entry);
+	s_cache_index[hash] = s_cache.begin();
+	s_cache_info.nSize += entry.nBytes;
+	s_cache_info.nEntries++;
+	cache_trim(s_cache_info.nBudget);
+}
+
+/**
+ * Compiled filter chains of imBufferConvert per thread. (most recently used first)
+ * (A chain is compiled on a flattened copy of its filters, so the conversion runs without the api lock
+ *  and the next conversion of the same chain and formats on the thread reuses the compiled stages and
+ *  the phase table of the resampler. A chain with a user filter function is compiled for each call.)
+ */
+#define IM_CONVERT_GRAPHS	8	/**< per thread */
+
+typedef struct {
+	uint64			nFilter;		/**< hash of the filter chain */
+	IM_FORMAT		src;
+	IM_FORMAT		dst;
+	float			fRatio;
+	MotionFilter*	chain;			/**< copy of the filter chain (0 : no filter) */
+	MotionConverter* converter;
+} IM_CONVERT_GRAPH;
+
+typedef std::list<IM_CONVERT_GRAPH> IM_CONVERT_GRAPH_LIST;
+
+static void graph_erase(IM_CONVERT_GRAPH_LIST& graphs, IM_CONVERT_GRAPH_LIST::iterator it)
+{
+	delete it->converter; // the stages refer to the copied filters
+	im_object_release(it->chain);
+	graphs.erase(it);
+}
+
+class MotionConvertGraphs
+{
+public:
+	~MotionConvertGraphs()
+	{
+		while(!m_graphs.empty())
+			graph_erase(m_graphs, m_graphs.begin());
+	}
+
+	IM_CONVERT_GRAPH_LIST m_graphs;
+};
+
+static thread_local MotionConvertGraphs s_graphs;
+
+/**
+ * This function copies the stages of a filter chain to a group. (flattened like the chain build)
+ */
+static void graph_copy(const MotionFilter* filter, MotionFilter* group)
+{
+	if(filter->m_type == IM_FILTER_DEFAULT) {
+		for(size_t i=0; i<filter->m_children.size(); i++)
+			graph_copy(filter->m_children[i], group);
+		return;
+	}
+	MotionFilter* copy = new MotionFilter();
+	copy->Create(filter->m_type, 0, 0);
+	copy->m_params = filter->m_params;
+	copy->m_param_count = filter->m_param_count;
+	group->m_children.push_back(copy);
+}
+
+/**
+ * This function gets the compiled chain of the thread, or compiles a copy of the chain. (0 : not supported)
+ * (The filter chain must not have a user filter function, see hash_filter.)
+ */
+static MotionConverter* graph_find(MotionFilter* filter, uint64 hash, const IM_FORMAT* src, const IM_FORMAT* dst, float* ratio)
+{
+	IM_CONVERT_GRAPH_LIST& graphs = s_graphs.m_graphs;
+	for(IM_CONVERT_GRAPH_LIST::iterator it=graphs.begin(); it!=graphs.end(); ++it) {
+		if(it->nFilter == hash && memcmp(&it->src, src, sizeof(*src)) == 0 && memcmp(&it->dst, dst, sizeof(*dst)) == 0) {
+			graphs.splice(graphs.begin(), graphs, it);
+			*ratio = it->fRatio;
+			return it->converter;
+		}
+	}
+
+	IM_CONVERT_GRAPH graph;
+	graph.nFilter = hash;
+	graph.src = *src;
+	graph.dst = *dst;
+	graph.chain = 0;
+	if(filter) {
+		graph.chain = new MotionFilter();
+		graph_copy(filter, graph.chain);
+	}
+	graph.converter = new MotionConverter();
+	graph.fRatio = graph.converter->Build(graph.chain, src, dst);
+	graphs.push_front(graph);
+	if(graph.fRatio == 0) {
+		graph_erase(graphs, graphs.begin());
+		return 0;
+	}
+	while(graphs.size() > IM_CONVERT_GRAPHS)
+		graph_erase(graphs, --graphs.end());
+	*ratio = graph.fRatio;
+	return graph.converter;
+}
+
+/************************************
+ * @section IMBuffer (Motion Buffer)
+ ************************************/
+IM_API IMBuffer imCreateBuffer(int32 sample_rate, int32 format, int32 channels, int32 samples, int32 buffers, int32 type)
+{
+	IM_FORMAT fmt;
+	im_format_set(&fmt, type, sample_rate ? sample_rate : IM_FORMAT_SAMPLE_RATE_DEFAULT,
+		channels ? channels : IM_FORMAT_CHANNELS_DEFAULT, format ? format : IM_FORMAT_DATA_DEFAULT);
+	return imCreateBufferFromFormat(&fmt, samples, buffers);
+}
+
+IM_API IMBuffer imCreateBufferFromFormat(const IM_FORMAT* format, int32 samples, int32 buffers)
+{
+	IM_FORMAT fmt;
+	if(format)
+		fmt = *format;
+	else
+		im_format_set(&fmt, IM_FORMAT_TYPE_DEFAULT, IM_FORMAT_SAMPLE_RATE_DEFAULT, IM_FORMAT_CHANNELS_DEFAULT, IM_FORMAT_DATA_DEFAULT);
+
+	IM_API_LOCK();
+	MotionBuffer* buffer = im_buffer_create(&fmt, samples ? samples : IM_FORMAT_SAMPLES_DEFAULT, buffers ? buffers : IM_FORMAT_BUFFERS_DEFAULT);
+	return buffer ? buffer->m_handle : 0;
+}
+
+IM_API IMBuffer imLoadBuffer(const char* url, const char* key)
+{
+	// binary motion file : the mapped frames are the buffer
+	IM_MOTION_FILE file;
+	if(key == 0 && IMotion_MapMotion(url, &file)) {
+		IM_API_LOCK();
+		MotionBuffer* buffer = new MotionBuffer();
+		buffer->Wrap(&file);
+		return im_object_register(buffer);
+	}
+
+	IM_FORMAT format;
+	uint8* motion = 0;
+	uint32 motion_len = 0;
+	int result = IMotion_LoadCSV(url, &format, &motion, &motion_len, key);
+	if(!result && key == 0) // QEditor project (no csv row)
+		result = IMotion_LoadProject(url, &format, &motion, &motion_len, load_sample_rate());
+
+	IM_API_LOCK();
+	return load_buffer(result, &format, motion, motion_len);
+}
+
+IM_API IMBuffer imLoadBufferStream(const char* url, int32 frames, const char* key)
+{
+	if(frames < 0)
+		return 0;
+	MotionStream* stream = new MotionStream();
+	if(!stream->Open(url, key)) {
+		delete stream;
+		return 0;
+	}
+
+	// the ring holds whole chunks (two at least : one decoded while the other is played)
+	IM_API_LOCK();
+	const IM_FORMAT& format = stream->m_format;
+	if(frames == 0)
+		frames = (int32)((uint64)format.nSampleRate * IM_STREAM_RING_MSEC / 1000);
+	const int32 chunks = MOTION_MAX((frames + IM_STREAM_CHUNK_FRAMES - 1) / IM_STREAM_CHUNK_FRAMES, 2);
+	MotionBuffer* buffer = new MotionBuffer();
+	if(!buffer->Create(&format, IM_STREAM_CHUNK_FRAMES, chunks)) {
+		delete buffer;
+		delete stream;
+		return 0;
+	}
+	buffer->m_loop_begin = stream->m_file_loop_begin;
+	buffer->m_loop_end = stream->m_file_loop_end;
+	buffer->m_stream = stream;
+	stream->Restart(buffer, 0);
+	return im_object_register(buffer);
+}
+
+IM_API int32 imBufferGetStreamInfo(IMBuffer buffer, IM_STREAM_INFO* info)
+{
+	IM_API_LOCK();
+	MotionBuffer* obj = im_lookup<MotionBuffer>(buffer);
+	if(obj == 0 || obj->m_stream == 0 || info == 0)
+		return IM_FAIL;
+	const MotionStream* stream = obj->m_stream;
+	info->nFrames = stream->m_frames.load();
+	info->nCapacity = obj->m_capacity;
+	info->nQueued = obj->GetQueuedCount();
+	info->nUnderruns = stream->m_underruns;
+	info->bEnded = (stream->m_end.load() != IM_STREAM_END_NONE);
+	return IM_OK;
+}
+
+IM_API IMBuffer imLoadBufferMemory(const void* data, int32 size, const char* key)
+{
+	// binary motion file : the frames are copied (the memory belongs to the caller)
+	IM_MOTION_FILE file;
+	if(key == 0 && IMotion_ParseMotion(data, size, &file)) {
+		IM_API_LOCK();
+		const IM_MOTION_FILE_HEADER& header = file.header;
+		MotionBuffer* buffer = im_buffer_create(&header.format, (int32)header.nFrames, 1);
+		if(buffer == 0)
+			return 0;
+		buffer->Enqueue(file.pData, (int32)(header.nFrames * header.format.nBlockAlign));
+		buffer->m_loop_begin = header.nLoopBegin;
+		buffer->m_loop_end = header.nLoopEnd;
+		return buffer->m_handle;
+	}
+
+	IM_FORMAT format;
+	uint8* motion = 0;
+	uint32 motion_len = 0;
+	int result = IMotion_LoadCSV_RAW(data, size, &format, &motion, &motion_len, key);
+	if(!result && key == 0)
+		result = IMotion_LoadProject_RAW(data, size, &format, &motion, &motion_len, load_sample_rate());
+
+	IM_API_LOCK();
+	return load_buffer(result, &format, motion, motion_len);
+}
+
+IM_API float imBufferConvert(IMBuffer buffer, IMBuffer* adjusted_buffer, IMBuffer desired_buffer, IMFilter filter)
+{
+	std::unique_lock<std::recursive_mutex> lock(im_api_lock());
+	MotionBuffer* src = im_lookup<MotionBuffer>(buffer);
+	if(src == 0 || src->m_stream || adjusted_buffer == 0)
+		return 0;
+
+	IM_FORMAT format = src->m_format;
+	MotionBuffer* desired = im_lookup<MotionBuffer>(desired_buffer);
+	MotionContext* context = im_context_current();
+	if(desired)
+		format = desired->m_format;
+	else if(context)
+		format = context->m_master->m_format;
+
+	// the cached result of the same frames, formats and filter chain
+	MotionFilter* chain = im_lookup<MotionFilter>(filter);
+	IM_CONVERT_KEY key;
+	uint64 hash = 0;
+	bool cached = s_cache_info.nBudget > 0 && cache_key(src, &format, chain, &key, &hash);
+	if(cached) {
+		float ratio;
+		MotionBuffer* hit = cache_find(&key, hash, &ratio);
+		if(hit) {
+			s_cache_info.nHits++;
+			*adjusted_buffer = hit->m_handle;
+			return ratio;
+		}
+		s_cache_info.nMisses++;
+	}
+
+	// the compiled chain of the thread converts without the api lock (a user filter function converts under it)
+	MotionConverter local;
+	MotionConverter* converter = &local;
+	uint64 filter_hash = IM_HASH_BASIS;
+	const bool unlocked = chain == 0 || hash_filter(chain, &filter_hash);
+	float ratio = 0;
+	if(unlocked)
+		converter = graph_find(chain, filter_hash, &src->m_format, &format, &ratio);
+	else
+		ratio = local.Build(chain, &src->m_format, &format);
+	if(converter == 0 || ratio == 0)
+		return 0;
+
+	// output frames of the whole queue (the source buffer is not consumed)
+	// (aligned to the input without the delay of the resampler, the last frame is held at the end)
+	const uint32 queued = src->GetQueuedCount();
+	const int32 frames = (int32)((uint64)queued * converter->m_resampler.m_up / converter->m_resampler.m_down);
+	converter->Reset(true);
+	MotionBuffer* dst = im_buffer_create(&format, frames > 0 ? frames : 1, 1);
+	if(dst == 0)
+		return 0;
+	if(src->m_loop_end) { // loop points at the output rate
+		const MotionResampler& resampler = converter->m_resampler;
+		dst->m_loop_begin = (uint32)((uint64)src->m_loop_begin * resampler.m_up / resampler.m_down);
+		dst->m_loop_end = (uint32)MOTION_MIN((uint64)src->m_loop_end * resampler.m_up / resampler.m_down, (uint64)frames);
+		if(dst->m_loop_begin >= dst->m_loop_end)
+			dst->m_loop_begin = dst->m_loop_end = 0;
+	}
+
+	const int32 chunk = 256;
+	std::vector<float> out(chunk * format.nChannels);
+	std::vector<uint8> data(chunk * format.nBlockAlign);
+	uint32 offset = 0;
+	int32 done = 0;
+	im_object_retain(src);
+	if(unlocked)
+		lock.unlock();
+	while(done < frames) {
+		int32 n = converter->Pull(src, false, &offset, &out[0], std::min(chunk, frames - done), true);
+		if(n <= 0)
+			break;
+		im_frames_store(&out[0], &data[0], &format, n);
+		dst->Enqueue(&data[0], n * format.nBlockAlign);
+		done += n;
+	}
+	if(unlocked)
+		lock.lock();
+	im_object_release(src);
+	if(cached)
+		cache_insert(&key, hash, dst, ratio);
+	*adjusted_buffer = dst->m_handle;
+	return ratio;
+}
+
+IM_API int32 imSetConvertCache(int32 budget)
+{
+	IM_API_LOCK();
+	if(budget < 0)
+		return IM_FAIL;
+	s_cache_info.nBudget = (uint32)budget;
+	cache_trim(s_cache_info.nBudget);
+	return IM_OK;
+}
+
+IM_API int32 imGetConvertCacheInfo(IM_CONVERT_CACHE_INFO* info)
+{
+	IM_API_LOCK();
+	if(info == 0)
+		return IM_FAIL;
+	*info = s_cache_info;
+	return IM_OK;
+}
+
+IM_API int32 imBufferEnqueue(IMBuffer buffer, const void* data, int32 size)
+{
+	// producer side of the ring (no api lock, the decoder of a stream buffer)
+	MotionBuffer* obj = im_acquire<MotionBuffer>(buffer);
+	if(obj == 0)
+		return 0;
+	int32 result = obj->m_stream ? 0 : obj->Enqueue(data, size);
+	im_object_release(obj);
+	return result;
+}
+
+IM_API int32 imBufferDequeue(IMBuffer buffer, void* data, int32 size)
+{
+	// consumer side of the ring (no api lock, the source of a stream buffer)
+	MotionBuffer* obj = im_acquire<MotionBuffer>(buffer);
+	if(obj == 0)
+		return 0;
+	int32 result = obj->m_stream ? 0 : obj->Dequeue(data, size);
+	im_object_release(obj);
+	return result;
+}
+
+IM_API void* imBufferLock(IMBuffer buffer, int32 size, uint32 flags)
+{
+	IM_API_LOCK();
+	MotionBuffer* obj = im_lookup<MotionBuffer>(buffer);
+	return (obj && obj->m_stream == 0) ? obj->Lock(size, flags) : 0;
+}
+
+IM_API int32 imBufferUnlock(IMBuffer buffer)
+{
+	IM_API_LOCK();
+	MotionBuffer* obj = im_lookup<MotionBuffer>(buffer);
+	return obj ? obj->Unlock() : IM_FAIL;
+}
+
+IM_API int32 imBufferSetSharedBuffer(IMBuffer buffer, IMBuffer shared_buffer)
+{
+	IM_API_LOCK();
+	MotionBuffer* obj = im_lookup<MotionBuffer>(buffer);
+	MotionBuffer* shared = im_lookup<MotionBuffer>(shared_buffer);
+	if(obj == 0 || (shared_buffer && shared == 0) || obj->m_stream || (shared && shared->m_stream))
+		return IM_FAIL;
+	return obj->SetShared(shared);
+}
+
+IM_API int32 imBufferGetSize(IMBuffer buffer)
+{
+	MotionBuffer* obj = im_acquire<MotionBuffer>(buffer);
+	if(obj == 0)
+		return 0;
+	int32 size = (int32)(obj->GetQueuedCount() * obj->m_format.nBlockAlign);
+	im_object_release(obj);
+	return size;
+}
+
+IM_API int32 imBufferGetDuration(IMBuffer buffer)
+{
+	IM_API_LOCK();
+	MotionBuffer* obj = im_lookup<MotionBuffer>(buffer);
+	if(obj == 0)
+		return 0;
+	const uint32 frames = obj->m_stream ? obj->m_stream->m_frames.load() : obj->GetQueuedCount();
+	return (int32)((uint64)frames * 1000 / obj->m_format.nSampleRate);
+}
+
+IM_API int32 imBufferGetFormat(IMBuffer buffer, int32* sample_rate, int32* format, int32* channels, int32* samples)
+{
+	IM_API_LOCK();
+	MotionBuffer* obj = im_lookup<MotionBuffer>(buffer);
+	if(obj == 0)
+		return IM_FAIL;
+	if(sample_rate) *sample_rate = obj->m_format.nSampleRate;
+	if(format) *format = obj->m_format.nDataFormat;
+	if(channels) *channels = obj->m_format.nChannels;
+	if(samples) *samples = obj->m_samples;
+	return IM_OK;
+}
+
+IM_API int32 imBufferGetInfo(IMBuffer buffer, IM_FORMAT* format, int32* samples, int32* buffers)
+{
+	IM_API_LOCK();
+	MotionBuffer* obj = im_lookup<MotionBuffer>(buffer);
+	if(obj == 0)
+		return IM_FAIL;
+	if(format) *format = obj->m_format;
+	if(samples) *samples = obj->m_samples;
+	if(buffers) *buffers = obj->m_buffers;
+	return IM_OK;
+}
+
+IM_API int32 imBufferSetLoop(IMBuffer buffer, int32 begin, int32 end)
+{
+	IM_API_LOCK();
+	MotionBuffer* obj = im_lookup<MotionBuffer>(buffer);
+	if(obj == 0 || begin < 0 || end < 0 || (end && begin >= end))
+		return IM_FAIL;
+	obj->m_loop_begin = end ? (uint32)begin : 0;
+	obj->m_loop_end = (uint32)end;
+	return IM_OK;
+}
+
+IM_API int32 imBufferGetLoop(IMBuffer buffer, int32* begin, int32* end)
+{
+	IM_API_LOCK();
+	MotionBuffer* obj = im_lookup<MotionBuffer>(buffer);
+	if(obj == 0)
+		return IM_FAIL;
+	if(begin)
+		*begin = (int32)obj->m_loop_begin;
+	if(end)
+		*end = (int32)obj->m_loop_end;
+	return IM_OK;
+}
+
+IM_API int32 imBufferGetQueuedCount(IMBuffer buffer)
+{
+	MotionBuffer* obj = im_acquire<MotionBuffer>(buffer);
+	if(obj == 0)
+		return 0;
+	int32 count = (int32)obj->GetQueuedCount();
+	im_object_release(obj);
+	return count;
+}
+
+IM_API int32 imDeleteBuffer(IMBuffer buffer)
+{
+	IM_API_LOCK();
+	MotionBuffer* obj = im_lookup<MotionBuffer>(buffer);
+	if(obj == 0)
+		return IM_FAIL;
+	im_object_release(obj);
+	return IM_OK;
+}
@@ -0,0 +1,618 @@
+/********************************************************************************//**
+\file      InnoML_context.cpp
+\brief     Motion contexts (IMContext) and the mixer of the InnoML reference engine.
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#include "InnoML_internal.h"
+#include "InnoML_simd.h"
+#include <algorithm>
+#include <chrono>
+
+static std::vector<MotionContext*> s_contexts;
+static MotionContext* s_current = 0;
+
+/**
+ * Headless device description. (Devices are emulated, no driver is loaded.)
+ */
+static const IM_DEVICE_DESC s_emulator_desc = {
+	IM_DEVICE_ID_DEFAULT, 0, 0, IM_BIT_MASK_DEFAULT, IM_VERSION_NUMBER, IM_CFG_EMUL_MODE, 0x76543210,
+	"InnoML Emulator", "Headless motion device (reference engine)", "127.0.0.1", "",
+};
+
+MotionContext* im_context_current()
+{
+	return s_current;
+}
+
+MotionContext::MotionContext()
+	: MotionObject(IM_OBJECT_CONTEXT), m_master(0), m_id(0), m_filter(0), m_volume(100), m_callback(0), m_streamer_obj(0),
+	m_shared(0), m_running(false), m_frames_sent(0), m_lateness_sum(0), m_pose_buffer(0)
+{
+	memset(&m_desc, 0, sizeof(m_desc));
+	memset(m_output, 0, sizeof(m_output));
+	memset(&m_timing, 0, sizeof(m_timing));
+	memset(&m_pose, 0, sizeof(m_pose));
+}
+
+MotionContext::~MotionContext()
+{
+	for(size_t i=0; i<m_sources.size(); i++) {
+		m_sources[i]->m_context = 0;
+		im_object_release(m_sources[i]);
+	}
+	for(size_t i=0; i<m_inputs.size(); i++) {
+		m_inputs[i]->m_context = 0;
+		im_object_release(m_inputs[i]);
+	}
+	im_object_release(m_pose_buffer);
+	im_object_release(m_filter);
+	im_object_release(m_master);
+}
+
+bool MotionContext::Create(MotionBuffer* master, uint32 id, const IM_DEVICE_DESC* desc)
+{
+	if(id > IM_DEVICE_ID_MAX)
+		return false;
+	if(master == 0) {
+		IM_FORMAT format;
+		im_format_set(&format, IM_FORMAT_TYPE_DEFAULT, IM_FORMAT_SAMPLE_RATE_DEFAULT, IM_FORMAT_CHANNELS_DEFAULT, IM_FORMAT_DATA_DEFAULT);
+		master = im_buffer_create(&format, IM_FORMAT_SAMPLES_DEFAULT, IM_FORMAT_BUFFERS_DEFAULT);
+		if(master == 0)
+			return false;
+	}
+	else {
+		im_object_retain(master);
+	}
+	m_master = master;
+	m_id = id ? id : IM_DEVICE_ID_DEFAULT;
+
+	m_desc = desc ? *desc : s_emulator_desc;
+	m_name = m_desc.szName ? m_desc.szName : s_emulator_desc.szName;
+	m_detail = m_desc.szDetail ? m_desc.szDetail : s_emulator_desc.szDetail;
+	m_ipaddress = m_desc.szIPAddress ? m_desc.szIPAddress : s_emulator_desc.szIPAddress;
+	m_filtername = m_desc.szFilter ? m_desc.szFilter : "";
+	m_desc.nId = m_id;
+	m_desc.szName = m_name.c_str();
+	m_desc.szDetail = m_detail.c_str();
+	m_desc.szIPAddress = m_ipaddress.c_str();
+	m_desc.szFilter = m_filtername.c_str();
+	return true;
+}
+
+int32 MotionContext::Start(IMotionInputCallback callback, const void* streamer_obj, MotionContext* shared, uint32 flags)
+{
+	if(m_running)
+		return IM_OK;
+	if(shared == this)
+		return IM_FAIL;
+	if(!m_program.Build(m_filter, &m_master->m_format, &m_master->m_format))
+		return IM_FAIL;
+
+	m_callback = callback;
+	m_streamer_obj = (void*)streamer_obj;
+	m_shared = shared;
+	memset(m_output, 0, sizeof(m_output));
+	m_frames_sent = 0;
+	memset(&m_timing, 0, sizeof(m_timing));
+	m_timing.nPeriod = (uint32)((int64)m_master->m_samples * 1000000 / m_master->m_format.nSampleRate);
+	m_lateness_sum = 0;
+	memset(&m_pose, 0, sizeof(m_pose));
+	m_kinematics.Reset();
+
+	if(m_desc.nOptions & IM_CFG_DEBUG_MODE)
+		im_log(m_id, "start (%u Hz, %u channels, %d samples)", m_master->m_format.nSampleRate, m_master->m_format.nChannels, m_master->m_samples);
+
+	im_object_retain(this); // released by the mixer thread
+	m_running = true;
+	m_thread = std::thread(&MotionContext::Run, this);
+	return IM_OK;
+}
+
+std::thread MotionContext::Stop(uint32 flags)
+{
+	if(m_running && (m_desc.nOptions & IM_CFG_DEBUG_MODE))
+		im_log(m_id, "stop (%llu frames sent)", (unsigned long long)m_frames_sent);
+	m_running = false;
+	m_shared = 0;
+	return std::move(m_thread);
+}
+
+int32 MotionContext::SetFilter(MotionFilter* filter)
+{
+	im_object_retain(filter);
+	im_object_release(m_filter);
+	m_filter = filter;
+	if(m_running && !m_program.Build(m_filter, &m_master->m_format, &m_master->m_format))
+		return IM_FAIL;
+	return IM_OK;
+}
+
+int32 MotionContext::Play(MotionSource* source)
+{
+	if(source->m_context && source->m_context != this)
+		source->m_context->StopSource(source);
+	if(source->Prepare(&m_master->m_format) != IM_OK)
+		return IM_FAIL;
+
+	// replaying a playing source restarts it (a stream that was played is decoded again from the start)
+	MotionStream* stream = source->m_buffer->m_stream;
+	if(stream && !stream->IsPristine(source->m_loop_count))
+		stream->Restart(source->m_buffer, source->m_loop_count);
+	source->m_stream_base = 0;
+	source->m_pos = 0;
+	source->m_frame = IM_SOURCE_FRAME_NONE;
+	source->m_loops = 0;
+	source->m_decoded = 0;
+	source->m_converter.Reset();
+	if(source->m_context != this) {
+		im_object_retain(source);
+		source->m_context = this;
+		m_sources.push_back(source);
+	}
+	return IM_OK;
+}
+
+int32 MotionContext::StopSource(MotionSource* source)
+{
+	std::vector<MotionSource*>::iterator it = std::find(m_sources.begin(), m_sources.end(), source);
+	if(it == m_sources.end())
+		return IM_FAIL;
+	m_sources.erase(it);
+	source->m_context = 0;
+	im_object_release(source);
+	return IM_OK;
+}
+
+int32 MotionContext::StartInput(MotionInput* input)
+{
+	if(input->m_context && input->m_context != this)
+		input->m_context->StopInput(input);
+	if(input->m_callback == 0 && input->Prepare(&m_master->m_format) != IM_OK)
+		return IM_FAIL;
+	if(input->m_context != this) {
+		im_object_retain(input);
+		input->m_context = this;
+		m_inputs.push_back(input);
+	}
+	return IM_OK;
+}
+
+int32 MotionContext::StopInput(MotionInput* input)
+{
+	std::vector<MotionInput*>::iterator it = std::find(m_inputs.begin(), m_inputs.end(), input);
+	if(it == m_inputs.end())
+		return IM_FAIL;
+	m_inputs.erase(it);
+	input->m_context = 0;
+	im_object_release(input);
+	return IM_OK;
+}
+
+int32 MotionContext::GetDiagnostic(IM_DIAGNOSTIC_AXIS_INFO* axis, int32 count) const
+{
+	for(int32 i=0; axis && i<count; i++) {
+		memset(&axis[i], 0, sizeof(axis[i]));
+		axis[i].bBusy = m_running ? 1 : 0;
+		axis[i].bServoOn = m_running ? 1 : 0;
+		if(i < (int32)m_master->m_format.nChannels)
+			axis[i].dCmd = (int32)m_output[i];
+		axis[i].dEnc = axis[i].dCmd;
+	}
+	return IM_DISCONNECTED; // emulation mode
+}
+
+int32 MotionContext::GetTimingInfo(IM_TIMING_INFO* info) const
+{
+	if(info == 0)
+		return IM_FAIL;
+	*info = m_timing;
+	return IM_OK;
+}
+
+int32 MotionContext::SetPoseBuffer(MotionBuffer* buffer)
+{
+	im_object_retain(buffer);
+	im_object_release(m_pose_buffer);
+	m_pose_buffer = buffer;
+	return IM_OK;
+}
+
+/**
+ * The pose of a device driven by axes is solved from the encoders by the forward kinematics of the last
+ * KINEMATICS filter of the context (or the default platform), and its command is the input of that filter.
+ * A device driven by poses solves its own kinematics, so its encoders are the pose.
+ */
+void MotionContext::Measure(const float* encoder)
+{
+	const IM_FORMAT& format = m_master->m_format;
+	const int32 type = m_program.IsEmpty() ? format.nType : m_program.m_out.nType;
+	float command[IM_DOF_COUNT], measured[IM_DOF_COUNT];
+	if(type == IM_FORMAT_TYPE_AXIS && format.nChannels >= IM_DOF_COUNT) {
+		const MotionKinematics* platform = m_program.GetKinematics();
+		const int32 version = platform ? platform->m_version : 0;
+		if(m_kinematics.m_version != version)
+			m_kinematics.Setup(version);
+		m_pose.nIterations = m_kinematics.Solve(encoder, measured);
+		memcpy(command, platform ? platform->m_command : measured, sizeof(command));
+	}
+	else {
+		int32 map[IM_FORMAT_CHANNELS_MAX];
+		im_channel_map(format.nChannels, IM_DOF_COUNT, map);
+		for(int32 i=0; i<IM_DOF_COUNT; i++) {
+			command[i] = (map[i] >= 0) ? m_output[map[i]] : 0.0f;
+			measured[i] = (map[i] >= 0) ? encoder[map[i]] : 0.0f;
+		}
+		m_pose.nIterations = 0;
+	}
+	for(int32 i=0; i<IM_DOF_COUNT; i++) {
+		m_pose.dCmd[i] = (int32)command[i];
+		m_pose.dEnc[i] = (int32)measured[i];
+	}
+
+	if(m_pose_buffer) {
+		const IM_FORMAT& stream = m_pose_buffer->m_format;
+		int32 map[IM_FORMAT_CHANNELS_MAX];
+		float frame[IM_FORMAT_CHANNELS_MAX];
+		im_channel_map(IM_DOF_COUNT, stream.nChannels, map);
+		im_frames_remap(measured, IM_DOF_COUNT, frame, stream.nChannels, map, 1);
+		m_stream.resize(stream.nBlockAlign);
+		im_frames_store(frame, &m_stream[0], &stream, 1);
+		m_pose_buffer->Enqueue(&m_stream[0], (int32)m_stream.size()); // dropped if full
+	}
+}
+
+void MotionContext::Tick()
+{
+	const IM_FORMAT& format = m_master->m_format;
+	const int32 channels = format.nChannels;
+	const int32 frames = m_master->m_samples;
+
+	m_mix.assign(frames * channels, 0.0f);
+	m_work.resize(frames * IM_FORMAT_CHANNELS_MAX);
+
+	// 1. direct positioning (frames queued in the master buffer or by the shared context)
+	int32 queued = MOTION_MIN((int32)m_master->GetQueuedCount(), frames);
+	if(queued > 0) {
+		m_stream.resize(queued * format.nBlockAlign);
+		m_master->Dequeue(&m_stream[0], (int32)m_stream.size());
+		im_frames_load(&m_stream[0], &format, &m_mix[0], queued);
+	}
+
+	// 2. sources
+	for(size_t i=0; i<m_sources.size(); ) {
+		MotionSource* source = m_sources[i];
+		if(source->Mix(&m_mix[0], frames, channels, 1.0f, m_notify) == IM_END_OF_STREAM)
+			StopSource(source);
+		else
+			i++;
+	}
+
+	// 3. inputs
+	for(size_t i=0; i<m_inputs.size(); i++)
+		m_inputs[i]->Mix(&m_mix[0], frames, channels, &format);
+
+	// 4. context stream callback
+	if(m_callback) {
+		m_stream.assign(frames * format.nBlockAlign, 0);
+		int32 size = m_callback(m_streamer_obj, &m_stream[0], (int32)m_stream.size());
+		int32 count = MOTION_CLAMP(size, 0, (int32)m_stream.size()) / (int32)format.nBlockAlign;
+		im_frames_load(&m_stream[0], &format, &m_work[0], count);
+		if(count > 0)
+			im_simd()->mix(&m_mix[0], &m_work[0], count * channels, 1.0f);
+	}
+
+	// 5. saturated sum (the sources and inputs are added unclamped), master volume and context filter
+	float lower[IM_FORMAT_CHANNELS_MAX], upper[IM_FORMAT_CHANNELS_MAX];
+	for(int32 c=0; c<IM_FORMAT_CHANNELS_MAX; c++) {
+		lower[c] = IM_SAMPLE_MIN;
+		upper[c] = IM_SAMPLE_MAX;
+	}
+	im_simd()->limit(&m_mix[0], frames, channels, lower, upper);
+	if(m_volume != 100) {
+		const float gain = m_volume / 100.0f;
+		for(size_t i=0; i<m_mix.size(); i++)
+			m_mix[i] *= gain;
+	}
+	if(!m_program.IsEmpty()) {
+		m_mix.resize(frames * IM_FORMAT_CHANNELS_MAX);
+		int32 out_channels = m_program.Process(&m_mix[0], frames);
+		if(out_channels != channels) {
+			int32 map[IM_FORMAT_CHANNELS_MAX];
+			im_channel_map(out_channels, channels, map);
+			im_frames_remap(&m_mix[0], out_channels, &m_mix[0], channels, map, frames);
+		}
+		m_mix.resize(frames * channels);
+	}
+	im_simd()->limit(&m_mix[0], frames, channels, lower, upper);
+
+	// 6. device output (the last frame is the axis command of the emulated device)
+	memcpy(m_output, &m_mix[(frames - 1) * channels], sizeof(float) * channels);
+	m_frames_sent += frames;
+
+	// 7. platform pose (the encoders of the emulated device follow the commands)
+	Measure(m_output);
+
+	for(size_t i=0; i<s_contexts.size(); i++) {
+		MotionContext* context = s_contexts[i];
+		if(context->m_shared != this || !context->m_running)
+			continue;
+		const IM_FORMAT& shared = context->m_master->m_format;
+		int32 map[IM_FORMAT_CHANNELS_MAX];
+		im_channel_map(channels, shared.nChannels, map);
+		m_work.resize(frames * IM_FORMAT_CHANNELS_MAX);
+		im_frames_remap(&m_mix[0], channels, &m_work[0], shared.nChannels, map, frames);
+		m_stream.resize(frames * shared.nBlockAlign);
+		im_frames_store(&m_work[0], &m_stream[0], &shared, frames);
+		context->m_master->Enqueue(&m_stream[0], (int32)m_stream.size());
+	}
+}
+
+#define IM_MIXER_SPIN_US	1000	/**< busy-wait tail of IM_CFG_PRECISE_TIMER (us) */
+
+/**
+ * The mixer runs on absolute deadlines of the monotonic clock, so the time spent mixing and in listeners
+ * does not drift the period. A tick that is late by more than a period is skipped (counted as missed)
+ * instead of being mixed in a burst.
+ */
+
+void MotionContext::Run()
+{
+	typedef std::chrono::steady_clock clock;
+	const std::chrono::nanoseconds period((int64)m_master->m_samples * 1000000000 / m_master->m_format.nSampleRate);
+	const std::chrono::microseconds spin((m_desc.nOptions & IM_CFG_PRECISE_TIMER) ? IM_MIXER_SPIN_US : 0);
+	std::vector<IM_NOTIFY> notify;
+	clock::time_point deadline = clock::now();
+
+	while(m_running) {
+		clock::time_point now = clock::now();
+		int64 late = std::chrono::duration_cast<std::chrono::microseconds>(now - deadline).count();
+		uint32 missed = 0;
+		if(now - deadline >= period) {
+			missed = (uint32)((now - deadline) / period);
+			deadline += period * missed;
+		}
+		{
+			IM_API_LOCK();
+			if(!m_running)
+				break;
+			if(m_timing.nTicks > 0)
+				m_timing.dJitterMax = MOTION_MAX(m_timing.dJitterMax, abs((int32)late - m_timing.dLateness));
+			m_timing.nTicks++;
+			m_timing.nMissed += missed;
+			m_timing.dLateness = (int32)late;
+			m_timing.dLatenessMax = MOTION_MAX(m_timing.dLatenessMax, (int32)late);
+			m_lateness_sum += late;
+			m_timing.dLatenessAvg = (int32)(m_lateness_sum / m_timing.nTicks);
+			Tick();
+			notify.swap(m_notify);
+		}
+		// listeners may call the api, so they are called after mixing
+		for(size_t i=0; i<notify.size(); i++)
+			notify[i].func(notify[i].obj, notify[i].state);
+		notify.clear();
+
+		deadline += period;
+		std::this_thread::sleep_until(deadline - spin);
+		while(clock::now() < deadline) {}
+	}
+
+	IM_API_LOCK();
+	im_object_release(this);
+}
+
+/************************************
+ * @section IMContext (Motion Device Context)
+ ************************************/
+static int32 context_stop(MotionContext* context, uint32 flags)
+{
+	std::thread thread;
+	{
+		IM_API_LOCK();
+		thread = context->Stop(flags);
+	}
+	if(thread.joinable()) {
+		if(thread.get_id() == std::this_thread::get_id())
+			thread.detach(); // stopped by a listener of the mixer thread
+		else
+			thread.join();
+	}
+	return IM_OK;
+}
+
+IM_API IMContext imCreateContext(IMBuffer buffer, uint32 id, const IM_DEVICE_DESC* desc)
+{
+	IM_API_LOCK();
+	MotionBuffer* master = im_lookup<MotionBuffer>(buffer);
+	if(buffer && (master == 0 || master->m_stream))
+		return 0;
+	MotionContext* context = new MotionContext();
+	if(!context->Create(master, id, desc)) {
+		delete context;
+		return 0;
+	}
+	s_contexts.push_back(context);
+	return im_object_register(context);
+}
+
+IM_API int32 imSetContext(IMContext ctx, uint32 flags)
+{
+	IM_API_LOCK();
+	MotionContext* context = im_lookup<MotionContext>(ctx);
+	if(ctx && context == 0)
+		return IM_FAIL;
+	s_current = context;
+	return IM_OK;
+}
+
+IM_API IMContext imGetContext()
+{
+	IM_API_LOCK();
+	return s_current ? s_current->m_handle : 0;
+}
+
+IM_API IMBuffer imGetBuffer()
+{
+	IM_API_LOCK();
+	return s_current ? s_current->m_master->m_handle : 0;
+}
+
+IM_API int32 imSetFilter(IMFilter filter)
+{
+	IM_API_LOCK();
+	MotionFilter* obj = im_lookup<MotionFilter>(filter);
+	if(s_current == 0 || (filter && obj == 0))
+		return IM_FAIL;
+	return s_current->SetFilter(obj);
+}
+
+IM_API IMFilter imGetFilter()
+{
+	IM_API_LOCK();
+	return (s_current && s_current->m_filter) ? s_current->m_filter->m_handle : 0;
+}
+
+IM_API int32 imStart(IMotionInputCallback callback, const void* streamer_obj, IMContext shared_context, uint32 flags)
+{
+	IM_API_LOCK();
+	MotionContext* shared = im_lookup<MotionContext>(shared_context);
+	if(s_current == 0 || (shared_context && shared == 0))
+		return IM_FAIL;
+	return s_current->Start(callback, streamer_obj, shared, flags);
+}
+
+IM_API int32 imStop(uint32 flags)
+{
+	MotionContext* context;
+	{
+		IM_API_LOCK();
+		context = s_current;
+		if(context == 0)
+			return IM_FAIL;
+		im_object_retain(context);
+	}
+	int32 result = context_stop(context, flags);
+
+	IM_API_LOCK();
+	im_object_release(context);
+	return result;
+}
+
+IM_API int32 imGetDescriptionCount()
+{
+	return 1;
+}
+
+IM_API int32 imGetDescription(IM_DEVICE_DESC* desc, int32 count)
+{
+	if(desc == 0 || count < 1)
+		return IM_FAIL;
+	desc[0] = s_emulator_desc;
+	return IM_OK;
+}
+
+IM_API int32 imGetProfile(IM_DEVICE_DESC* desc, uint32 devid)
+{
+	IM_API_LOCK();
+	if(desc == 0)
+		return IM_FAIL;
+	if(devid) {
+		for(size_t i=0; i<s_contexts.size(); i++) {
+			if(s_contexts[i]->m_id == devid) {
+				*desc = s_contexts[i]->m_desc;
+				return IM_OK;
+			}
+		}
+		return IM_FAIL;
+	}
+	if(s_current == 0)
+		return IM_FAIL;
+	*desc = s_current->m_desc;
+	return IM_OK;
+}
+
+IM_API int32 imGetDiagnostic(IM_DIAGNOSTIC_AXIS_INFO* axis, int32 count)
+{
+	IM_API_LOCK();
+	if(s_current == 0)
+		return IM_DISCONNECTED;
+	return s_current->GetDiagnostic(axis, count);
+}
+
+IM_API int32 imGetTimingInfo(IM_TIMING_INFO* info)
+{
+	IM_API_LOCK();
+	if(s_current == 0)
+		return IM_FAIL;
+	return s_current->GetTimingInfo(info);
+}
+
+IM_API int32 imGetPose(IM_POSE_INFO* info)
+{
+	IM_API_LOCK();
+	if(s_current == 0 || info == 0)
+		return IM_FAIL;
+	*info = s_current->m_pose;
+	return IM_OK;
+}
+
+IM_API int32 imSetPoseBuffer(IMBuffer buffer)
+{
+	IM_API_LOCK();
+	MotionBuffer* obj = im_lookup<MotionBuffer>(buffer);
+	if(s_current == 0 || (buffer && (obj == 0 || obj->m_stream)))
+		return IM_FAIL;
+	return s_current->SetPoseBuffer(obj);
+}
+
+IM_API int32 imGetPlayingSourceCount()
+{
+	IM_API_LOCK();
+	return s_current ? (int32)s_current->m_sources.size() : 0;
+}
+
+IM_API int32 imSetMasterVolume(int32 volume)
+{
+	IM_API_LOCK();
+	if(s_current == 0 || volume < 0)
+		return IM_FAIL;
+	s_current->m_volume = volume;
+	return IM_OK;
+}
+
+IM_API int32 imStopAllSources()
+{
+	IM_API_LOCK();
+	if(s_current == 0)
+		return IM_FAIL;
+	while(!s_current->m_sources.empty())
+		s_current->StopSource(s_current->m_sources.back());
+	return IM_OK;
+}
+
+IM_API int32 imDestroyContext(IMContext ctx, uint32 flags)
+{
+	MotionContext* context;
+	{
+		IM_API_LOCK();
+		context = im_lookup<MotionContext>(ctx);
+		if(context == 0)
+			return IM_FAIL;
+	}
+	context_stop(context, flags);
+
+	IM_API_LOCK();
+	if(s_current == context)
+		s_current = 0;
+	for(size_t i=0; i<s_contexts.size(); i++) {
+		if(s_contexts[i]->m_shared == context)
+			s_contexts[i]->m_shared = 0;
+	}
+	s_contexts.erase(std::remove(s_contexts.begin(), s_contexts.end(), context), s_contexts.end());
+	while(!context->m_sources.empty())
+		context->StopSource(context->m_sources.back());
+	while(!context->m_inputs.empty())
+		context->StopInput(context->m_inputs.back());
+	im_object_release(context);
+	return IM_OK;
+}
@@ -0,0 +1,698 @@
+/********************************************************************************//**
+\file      InnoML_filter.cpp
+\brief     Motion filter objects (IMFilter), filter chains and stream converters.
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#include "InnoML_internal.h"
+#include <algorithm>
+
+/**
+ * This function gets the size of the built-in filter params and fills the defaults.
+ * (Filters without params return 0.)
+ */
+static uint32 filter_default_params(IM_FILTER_TYPE type, std::vector<uint8>& defaults)
+{
+	union {
+		IM_FILTER_NOISE_PARAMS		noise;
+		IM_FILTER_MEAN_PARAMS		mean;
+		IM_FILTER_HIGHPASS_PARAMS	highpass;
+		IM_FILTER_LOWPASS_PARAMS	lowpass;
+		IM_FILTER_INTEGRAL_PARAMS	integral;
+		IM_FILTER_SCALE_PARAMS		scale;
+		IM_FILTER_OFFSET_PARAMS		offset;
+		IM_FILTER_COMBINE_PARAMS	combine;
+		IM_FILTER_LIMIT_PARAMS		limit;
+		IM_FILTER_RATELIMIT_PARAMS	ratelimit;
+		IM_FILTER_WASHOUT_PARAMS	washout;
+		IM_FILTER_CLASSIC_PARAMS	classic;
+		IM_FILTER_TILT_PARAMS		tilt;
+		IM_FILTER_KINEMATICS_PARAMS	kinematics;
+		IM_FILTER_FORMAT_PARAMS		format;
+		IM_FILTER_CHANNEL_PARAMS	channel;
+		IM_FILTER_RESAMPLE_PARAMS	resample;
+	} params;
+	uint32 size = 0;
+
+	memset(&params, 0, sizeof(params));
+	switch(type) {
+	case IM_FILTER_NOISE:
+		params.noise.nCovariance = 5;
+		size = sizeof(params.noise);
+		break;
+	case IM_FILTER_MEAN:
+		params.mean.nCount = 4;
+		size = sizeof(params.mean);
+		break;
+	case IM_FILTER_HIGHPASS:
+		params.highpass.nOrder = 1;
+		params.highpass.fCutoffFrequency[0] = params.highpass.fCutoffFrequency[1] = params.highpass.fCutoffFrequency[2] = 5;
+		size = sizeof(params.highpass);
+		break;
+	case IM_FILTER_LOWPASS:
+		params.lowpass.nOrder = 1;
+		params.lowpass.fCutoffFrequency[0] = params.lowpass.fCutoffFrequency[1] = params.lowpass.fCutoffFrequency[2] = 5;
+		size = sizeof(params.lowpass);
+		break;
+	case IM_FILTER_INTEGRAL:
+		params.integral.nOrder = 1;
+		size = sizeof(params.integral);
+		break;
+	case IM_FILTER_SCALE:
+		params.scale.fScaleFactor = 1;
+		size = sizeof(params.scale);
+		break;
+	case IM_FILTER_OFFSET:
+		size = sizeof(params.offset);
+		break;
+	case IM_FILTER_COMBINE:
+		params.combine.nAxis1 = 1;
+		params.combine.nAxis2 = 2;
+		size = sizeof(params.combine);
+		break;
+	case IM_FILTER_LIMIT:
+		params.limit.nMin = MOTION_MIN_16;
+		params.limit.nMax = MOTION_MAX_16;
+		size = sizeof(params.limit);
+		break;
+	case IM_FILTER_RATELIMIT:
+		params.ratelimit.nRateMax = 256;
+		size = sizeof(params.ratelimit);
+		break;
+	case IM_FILTER_WASHOUT:
+		params.washout.fCutoffFrequency = 5;
+		size = sizeof(params.washout);
+		break;
+	case IM_FILTER_CLASSIC:
+		params.classic.nHighpassOrder = 2;
+		params.classic.fHighpassCutoff = 5;
+		params.classic.fTiltCutoff = 5;
+		size = sizeof(params.classic);
+		break;
+	case IM_FILTER_TILT:
+		params.tilt.fCutoffFrequency = 5;
+		params.tilt.fAngleMax = 90;
+		size = sizeof(params.tilt);
+		break;
+	case IM_FILTER_KINEMATICS:
+		params.kinematics.nVersion = 700;
+		size = sizeof(params.kinematics);
+		break;
+	case IM_FILTER_FORMAT:
+		params.format.nDataFormat = IM_FORMAT_DATA_DEFAULT;
+		size = sizeof(params.format);
+		break;
+	case IM_FILTER_CHANNEL:
+		params.channel.nAxis = 1;
+		size = sizeof(params.channel);
+		break;
+	case IM_FILTER_RESAMPLE:
+		params.resample.nTaps = 4;
+		params.resample.fCutoff = 0.9f;
+		size = sizeof(params.resample);
+		break;
+	default:
+		break;
+	}
+	defaults.assign((const uint8*)&params, (const uint8*)&params + size);
+	return size;
+}
+
+MotionFilter::MotionFilter()
+	: MotionObject(IM_OBJECT_FILTER), m_type(IM_FILTER_DEFAULT), m_processor(0), m_processor_obj(0),
+	m_param_size(0), m_param_count(0), m_version(0), m_src(0), m_dst(0)
+{
+}
+
+MotionFilter::~MotionFilter()
+{
+	for(size_t i=0; i<m_children.size(); i++)
+		im_object_release(m_children[i]);
+	im_object_release(m_src);
+	im_object_release(m_dst);
+}
+
+bool MotionFilter::Create(IM_FILTER_TYPE type, IMotionFilterCallback processor, const void* processor_obj)
+{
+	if(type < IM_FILTER_DEFAULT || type >= IM_FILTER_COUNT)
+		return false;
+	if(type == IM_FILTER_CUSTOM && processor == 0)
+		return false;
+	m_type = type;
+	m_processor = processor;
+	m_processor_obj = (void*)processor_obj;
+	m_param_size = filter_default_params(type, m_defaults);
+	return true;
+}
+
+int32 MotionFilter::SetParams(const void* data, int32 size, int32 count)
+{
+	if(data == 0) { // reset to defaults
+		m_params.clear();
+		m_param_count = 0;
+		m_version++;
+		return IM_OK;
+	}
+	if(m_param_size == 0 || size != (int32)m_param_size || count < 0 || count > IM_FORMAT_CHANNELS_MAX)
+		return IM_FAIL;
+	if(count == 0)
+		count = 1;
+	m_params.assign((const uint8*)data, (const uint8*)data + size * count);
+	m_param_count = count;
+	m_version++;
+	return IM_OK;
+}
+
+int32 MotionFilter::GetParams(void* data, int32 size, int32 count) const
+{
+	if(data == 0 || m_param_size == 0 || size != (int32)m_param_size || count < 0 || count > IM_FORMAT_CHANNELS_MAX)
+		return IM_FAIL;
+	if(count == 0)
+		count = 1;
+	for(int32 i=0; i<count; i++) {
+		const void* param = GetParam(i);
+		memcpy((uint8*)data + i * size, param ? param : &m_defaults[0], size);
+	}
+	return IM_OK;
+}
+
+const void* MotionFilter::GetParam(int32 channel) const
+{
+	if(m_param_size == 0)
+		return 0;
+	if(m_param_count == 0)
+		return &m_defaults[0];
+	if(m_param_count == 1)
+		return &m_params[0];
+	if(channel < m_param_count)
+		return &m_params[channel * m_param_size];
+	return 0; // bypass
+}
+
+int32 MotionFilter::Append(MotionFilter* child)
+{
+	if(m_type != IM_FILTER_DEFAULT || child == 0 || child->Contains(this))
+		return IM_FAIL;
+	if((int32)m_children.size() >= IM_FILTER_PROCESSOR_MAX)
+		return IM_FAIL;
+	im_object_retain(child);
+	m_children.push_back(child);
+	m_version++;
+	return IM_OK;
+}
+
+int32 MotionFilter::Remove(MotionFilter* child)
+{
+	std::vector<MotionFilter*>::iterator it = std::find(m_children.begin(), m_children.end(), child);
+	if(it == m_children.end())
+		return IM_FAIL;
+	m_children.erase(it);
+	im_object_release(child);
+	m_version++;
+	return IM_OK;
+}
+
+bool MotionFilter::Contains(const MotionFilter* filter) const
+{
+	if(filter == this)
+		return true;
+	for(size_t i=0; i<m_children.size(); i++) {
+		if(m_children[i]->Contains(filter))
+			return true;
+	}
+	return false;
+}
+
+/************************************
+ * Filter chain
+ ************************************/
+MotionFilterStage::MotionFilterStage(MotionFilter* filter)
+	: m_filter(filter), m_version(0), m_channels(0), m_out_channels(0), m_rate(0), m_dt(0)
+{
+	im_object_retain(m_filter);
+}
+
+MotionFilterStage::~MotionFilterStage()
+{
+	im_object_release(m_filter);
+}
+
+bool MotionFilterStage::Build(IM_FORMAT* format, const IM_FORMAT* dst)
+{
+	m_channels = format->nChannels;
+	m_rate = (float)format->nSampleRate;
+	m_dt = 1.0f / m_rate;
+	return true;
+}
+
+MotionFilterProgram::MotionFilterProgram()
+	: m_tile_frames(IM_FILTER_TILE_FRAMES)
+{
+	memset(&m_src, 0, sizeof(m_src));
+	memset(&m_out, 0, sizeof(m_out));
+}
+
+MotionFilterProgram::~MotionFilterProgram()
+{
+	Clear();
+}
+
+static bool program_flatten(MotionFilter* filter, std::vector<MotionFilterStage*>& stages)
+{
+	if(filter->m_type == IM_FILTER_DEFAULT) {
+		for(size_t i=0; i<filter->m_children.size(); i++) {
+			if(!program_flatten(filter->m_children[i], stages))
+				return false;
+		}
+		return true;
+	}
+	if(stages.size() >= IM_FILTER_PROCESSOR_MAX)
+		return false;
+	MotionFilterStage* stage = im_filter_create_stage(filter);
+	if(stage == 0)
+		return false;
+	stages.push_back(stage);
+	return true;
+}
+
+bool MotionFilterProgram::Build(MotionFilter* filter, const IM_FORMAT* src, const IM_FORMAT* dst)
+{
+	Clear();
+	m_src = *src;
+	m_out = *src;
+	if(filter == 0)
+		return true;
+
+	if(!program_flatten(filter, m_stages)) {
+		Clear();
+		return false;
+	}
+	for(size_t i=0; i<m_stages.size(); i++) {
+		MotionFilterStage* stage = m_stages[i];
+		if(!stage->Build(&m_out, dst)) {
+			Clear();
+			return false;
+		}
+		stage->m_out_channels = m_out.nChannels;
+		stage->m_version = stage->m_filter->m_version;
+		stage->Setup();
+	}
+
+	// segments of fusable stages (a stage that is not fusable runs alone over the whole buffer)
+	for(size_t i=0; i<m_stages.size(); i++) {
+		MotionFilterStage* stage = m_stages[i];
+		bool fused = stage->IsFusable();
+		if(m_segments.empty() || !fused || !m_segments.back().bFused) {
+			IM_FILTER_SEGMENT segment;
+			segment.nFirst = (int32)i;
+			segment.nCount = 0;
+			segment.nChannels = stage->m_channels;
+			segment.bFused = fused;
+			m_segments.push_back(segment);
+		}
+		m_segments.back().nCount++;
+	}
+	return true;
+}
+
+void MotionFilterProgram::Clear()
+{
+	for(size_t i=0; i<m_stages.size(); i++)
+		delete m_stages[i];
+	m_stages.clear();
+	m_segments.clear();
+	m_out = m_src;
+}
+
+void MotionFilterProgram::Reset()
+{
+	for(size_t i=0; i<m_stages.size(); i++)
+		m_stages[i]->Reset();
+}
+
+const MotionKinematics* MotionFilterProgram::GetKinematics() const
+{
+	// the last platform drives the output
+	for(size_t i=m_stages.size(); i>0; i--) {
+		const MotionKinematics* kinematics = m_stages[i-1]->GetKinematics();
+		if(kinematics)
+			return kinematics;
+	}
+	return 0;
+}
+
+int32 MotionFilterProgram::Process(float* data, int32 frames)
+{
+	int32 channels = m_src.nChannels;
+	for(size_t i=0; i<m_stages.size(); i++) {
+		MotionFilterStage* stage = m_stages[i];
+		if(stage->m_version != stage->m_filter->m_version) { // params changed while running
+			stage->m_version = stage->m_filter->m_version;
+			stage->Setup();
+		}
+	}
+	for(size_t s=0; s<m_segments.size(); s++) {
+		const IM_FILTER_SEGMENT& segment = m_segments[s];
+		MotionFilterStage* const* stages = &m_stages[segment.nFirst];
+		if(segment.bFused && segment.nCount > 1 && m_tile_frames > 0 && segment.nChannels == channels) {
+			// fused : all stages on a tile, then the next tile
+			for(int32 f=0; f<frames; f+=m_tile_frames) {
+				const int32 count = MOTION_MIN(m_tile_frames, frames - f);
+				for(int32 i=0; i<segment.nCount; i++)
+					stages[i]->Process(data + f * channels, count);
+			}
+			continue;
+		}
+		for(int32 i=0; i<segment.nCount; i++)
+			channels = stages[i]->Process(data, frames);
+	}
+	return channels;
+}
+
+/************************************
+ * Resampler
+ ************************************/
+static uint32 resample_gcd(uint32 a, uint32 b)
+{
+	while(b) {
+		uint32 t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+MotionResampler::MotionResampler()
+	: m_up(1), m_down(1), m_taps(0), m_phase(1), m_index(0), m_pushed(0)
+{
+	m_history.assign(2 * IM_FORMAT_CHANNELS_MAX, 0.0f);
+}
+
+void MotionResampler::Build(uint32 src_rate, uint32 dst_rate, const IM_FILTER_RESAMPLE_PARAMS* params)
+{
+	const uint32 g = resample_gcd(src_rate, dst_rate);
+	m_up = dst_rate / g;
+	m_down = src_rate / g;
+	m_taps = 0;
+	m_table.clear();
+
+	// equal rates, a ratio without a short period or no taps : zero-order hold
+	const int32 taps = MOTION_MIN(params->nTaps, IM_RESAMPLE_TAPS_MAX);
+	if(m_up == m_down || m_up > IM_RESAMPLE_PHASES_MAX || taps <= 0) {
+		m_history.assign(2 * IM_FORMAT_CHANNELS_MAX, 0.0f);
+		Reset(false);
+		return;
+	}
+
+	// the window spans 'taps' periods of the lower rate (in input frames, within the table)
+	const double ratio = (double)dst_rate / src_rate;
+	const double cutoff = MOTION_CLAMP((double)params->fCutoff, 0.1, 1.0) * MOTION_MIN(ratio, 1.0);
+	int32 n = (int32)ceil(MOTION_MAX(taps, 2) * MOTION_MAX(1.0 / ratio, 1.0));
+	n = MOTION_MIN((n + 1) & ~1, (int32)(IM_RESAMPLE_TABLE_MAX / m_up) & ~1);
+	const double half = n / 2;
+
+	m_taps = n;
+	m_table.resize((size_t)m_up * n);
+	m_history.assign((size_t)n * 2 * IM_FORMAT_CHANNELS_MAX, 0.0f);
+	std::vector<double> coefs(n);
+	for(uint32 p=0; p<m_up; p++) {
+		float* h = &m_table[(size_t)p * n];
+		double sum = 0;
+		for(int32 k=0; k<n; k++) {
+			// distance of the input frame k from the output time
+			const double x = (k - half + 1) - (double)p / m_up;
+			const double u = IM_PI * cutoff * x;
+			const double sinc = (x == 0) ? 1.0 : sin(u) / u;
+			const double w = 0.42 + 0.5 * cos(IM_PI * x / half) + 0.08 * cos(2 * IM_PI * x / half);
+			coefs[k] = sinc * w;
+			sum += coefs[k];
+		}
+		// unity gain of every phase (a constant stays constant)
+		for(int32 k=0; k<n; k++)
+			h[k] = (float)(coefs[k] / sum);
+	}
+	Reset(false);
+}
+
+void MotionResampler::Reset(bool aligned)
+{
+	// aligned : the first output is the time of the first input (the window is filled first)
+	m_phase = aligned ? m_up * (uint32)(m_taps / 2 + 1) : m_up;
+	m_index = 0;
+	m_pushed = 0;
+}
+
+void MotionResampler::Push(const float* frame, int32 channels)
+{
+	const int32 rows = m_taps > 0 ? m_taps : 1;
+	if(m_pushed == 0) { // the stream starts from a constant
+		for(int32 i=0; i<rows*2; i++)
+			memcpy(GetRow(i), frame, sizeof(float) * channels);
+	}
+	else {
+		memcpy(GetRow(m_index), frame, sizeof(float) * channels);
+		memcpy(GetRow(m_index + rows), frame, sizeof(float) * channels);
+		m_index = (m_index + 1 < rows) ? m_index + 1 : 0;
+	}
+	m_pushed++;
+	m_phase -= m_up;
+}
+
+void MotionResampler::Hold()
+{
+	const int32 rows = m_taps > 0 ? m_taps : 1;
+	float frame[IM_FORMAT_CHANNELS_MAX];
+	memcpy(frame, GetRow(m_index + rows - 1), sizeof(frame));
+	Push(frame, IM_FORMAT_CHANNELS_MAX);
+}
+
+void MotionResampler::Render(float* frame, int32 channels)
+{
+	if(m_taps == 0) {
+		memcpy(frame, GetRow(m_index), sizeof(float) * channels);
+	}
+	else {
+		const float* h = &m_table[(size_t)m_phase * m_taps];
+		const float* rows = GetRow(m_index);
+		float acc[IM_FORMAT_CHANNELS_MAX] = { 0 };
+		for(int32 k=0; k<m_taps; k++) {
+			for(int32 c=0; c<channels; c++)
+				acc[c] += h[k] * rows[k * IM_FORMAT_CHANNELS_MAX + c];
+		}
+		memcpy(frame, acc, sizeof(float) * channels);
+	}
+	m_phase += m_down;
+}
+
+/************************************
+ * Stream converter
+ ************************************/
+MotionConverter::MotionConverter()
+	: m_load(0), m_valid(false)
+{
+	memset(&m_src, 0, sizeof(m_src));
+	memset(&m_dst, 0, sizeof(m_dst));
+	memset(m_map, 0, sizeof(m_map));
+}
+
+float MotionConverter::Build(MotionFilter* filter, const IM_FORMAT* src, const IM_FORMAT* dst)
+{
+	m_valid = false;
+	if(!m_program.Build(filter, src, dst))
+		return 0;
+	m_src = *src;
+	m_dst = *dst;
+	m_load = im_samples_loader(m_src.nDataFormat);
+	if(m_load == 0 || m_src.nSampleRate == 0 || m_dst.nSampleRate == 0)
+		return 0;
+	im_channel_map(m_program.m_out.nChannels, m_dst.nChannels, m_map);
+
+	// rate conversion params of the chain (the first RESAMPLE filter)
+	IM_FILTER_RESAMPLE_PARAMS params;
+	params.nTaps = 4;
+	params.fCutoff = 0.9f;
+	for(size_t i=0; i<m_program.m_stages.size(); i++) {
+		const MotionFilter* stage = m_program.m_stages[i]->m_filter;
+		if(stage->m_type == IM_FILTER_RESAMPLE) {
+			const void* param = stage->GetParam(0);
+			if(param)
+				memcpy(&params, param, sizeof(params));
+			break;
+		}
+	}
+	m_resampler.Build(m_src.nSampleRate, m_dst.nSampleRate, &params);
+	m_valid = true;
+	Reset();
+	return (float)((double)m_dst.nSampleRate * m_dst.nBlockAlign / ((double)m_src.nSampleRate * m_src.nBlockAlign));
+}
+
+void MotionConverter::Reset(bool aligned)
+{
+	m_program.Reset();
+	m_resampler.Reset(aligned);
+}
+
+int32 MotionConverter::Decode(const uint8* data, int32 frames, float* out)
+{
+	m_load(data, out, frames * (int32)m_src.nChannels);
+	return m_program.Process(out, frames);
+}
+
+int32 MotionConverter::Pull(MotionBuffer* src, bool consume, uint32* offset, float* out, int32 frames, bool hold)
+{
+	const int32 chunk = 256;
+	const int32 dst_channels = m_dst.nChannels;
+	uint32 pos = offset ? *offset : 0;
+	int32 produced = 0;
+	std::vector<uint8> data;
+	float frame[IM_FORMAT_CHANNELS_MAX];
+
+	if(!m_valid)
+		return 0;
+	m_work.resize(chunk * IM_FORMAT_CHANNELS_MAX);
+	while(produced < frames) {
+		// input frames needed by the remaining output frames
+		uint64 need = m_resampler.GetNeeded(frames - produced);
+		uint32 queued = src->GetQueuedCount();
+		uint32 avail = (pos < queued) ? queued - pos : 0;
+		int32 count = (int32)std::min<uint64>(std::min<uint64>(need, avail), chunk);
+		int32 channels = m_program.m_out.nChannels;
+		if(count > 0) {
+			data.resize(count * m_src.nBlockAlign);
+			src->Read(pos, &data[0], count);
+			channels = Decode(&data[0], count, &m_work[0]);
+			if(consume)
+				src->Dequeue(0, count * m_src.nBlockAlign);
+			else
+				pos += count;
+		}
+		else if(m_resampler.IsHungry()) {
+			if(!hold || m_resampler.m_pushed == 0)
+				break; // underrun
+			m_resampler.Hold(); // end of the stream : the last frame is held
+		}
+
+		int32 used = 0;
+		while(produced < frames) {
+			while(m_resampler.IsHungry() && used < count) {
+				m_resampler.Push(&m_work[used * channels], channels);
+				used++;
+			}
+			if(m_resampler.IsHungry())
+				break;
+			m_resampler.Render(frame, channels);
+			im_frames_remap(frame, channels, out + produced * dst_channels, dst_channels, m_map, 1);
+			produced++;
+		}
+	}
+	if(offset)
+		*offset = pos;
+	return produced;
+}
+
+/************************************
+ * @section IMFilter (Motion Filter)
+ ************************************/
+IM_API IMFilter imCreateFilter(IM_FILTER_TYPE type, IMotionFilterCallback processor, const void* processor_obj)
+{
+	IM_API_LOCK();
+	MotionFilter* filter = new MotionFilter();
+	if(!filter->Create(type, processor, processor_obj)) {
+		delete filter;
+		return 0;
+	}
+	return im_object_register(filter);
+}
+
+IM_API int32 imFilterSetParams(IMFilter filter, const void* data, int32 size, int32 count)
+{
+	IM_API_LOCK();
+	MotionFilter* obj = im_lookup<MotionFilter>(filter);
+	return obj ? obj->SetParams(data, size, count) : IM_FAIL;
+}
+
+IM_API int32 imFilterGetParams(IMFilter filter, void* data, int32 size, int32 count)
+{
+	IM_API_LOCK();
+	MotionFilter* obj = im_lookup<MotionFilter>(filter);
+	return obj ? obj->GetParams(data, size, count) : IM_FAIL;
+}
+
+IM_API int32 imFilterAppend(IMFilter filter, IMFilter child)
+{
+	IM_API_LOCK();
+	MotionFilter* obj = im_lookup<MotionFilter>(filter);
+	return obj ? obj->Append(im_lookup<MotionFilter>(child)) : IM_FAIL;
+}
+
+IM_API int32 imFilterRemove(IMFilter filter, IMFilter child)
+{
+	IM_API_LOCK();
+	MotionFilter* obj = im_lookup<MotionFilter>(filter);
+	return obj ? obj->Remove(im_lookup<MotionFilter>(child)) : IM_FAIL;
+}
+
+IM_API float imFilterBuild(IMFilter filter, IMBuffer src_buffer, IMBuffer dst_buffer)
+{
+	IM_API_LOCK();
+	MotionFilter* obj = im_lookup<MotionFilter>(filter);
+	MotionBuffer* src = im_lookup<MotionBuffer>(src_buffer);
+	MotionBuffer* dst = im_lookup<MotionBuffer>(dst_buffer);
+	if(obj == 0 || src == 0 || src->m_stream || (dst && dst->m_stream))
+		return 0; // a stream buffer is played by a source
+	if(dst == 0) {
+		MotionContext* context = im_context_current();
+		dst = context ? context->m_master : src;
+	}
+
+	float ratio = obj->m_converter.Build(obj, &src->m_format, &dst->m_format);
+	if(ratio == 0)
+		return 0;
+	im_object_retain(src);
+	im_object_retain(dst);
+	im_object_release(obj->m_src);
+	im_object_release(obj->m_dst);
+	obj->m_src = src;
+	obj->m_dst = dst;
+	return ratio;
+}
+
+IM_API int32 imFilterProcess(IMFilter filter, void* data, int32 size)
+{
+	IM_API_LOCK();
+	MotionFilter* obj = im_lookup<MotionFilter>(filter);
+	if(obj == 0 || obj->m_src == 0 || !obj->m_converter.IsValid())
+		return 0;
+
+	MotionConverter& converter = obj->m_converter;
+	const IM_FORMAT& format = converter.m_dst;
+	int32 frames;
+	if(data)
+		frames = size / format.nBlockAlign;
+	else
+		frames = (int32)obj->m_dst->GetFreeCount();
+	if(frames <= 0)
+		return 0;
+
+	std::vector<float> out(frames * format.nChannels);
+	frames = converter.Pull(obj->m_src, true, 0, &out[0], frames);
+	if(frames <= 0)
+		return 0;
+	if(data) {
+		im_frames_store(&out[0], (uint8*)data, &format, frames);
+		return frames * format.nBlockAlign;
+	}
+	std::vector<uint8> stream(frames * format.nBlockAlign);
+	im_frames_store(&out[0], &stream[0], &format, frames);
+	return obj->m_dst->Enqueue(&stream[0], (int32)stream.size());
+}
+
+IM_API int32 imDeleteFilter(IMFilter filter)
+{
+	IM_API_LOCK();
+	MotionFilter* obj = im_lookup<MotionFilter>(filter);
+	if(obj == 0)
+		return IM_FAIL;
+	im_object_release(obj);
+	return IM_OK;
+}
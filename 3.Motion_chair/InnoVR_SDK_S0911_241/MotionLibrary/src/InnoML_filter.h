@@ -0,0 +1,191 @@
+/********************************************************************************//**
+\file      InnoML_filter.h
+\brief     Filter chain declarations of the InnoML reference engine.
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#ifndef INNO_ML_FILTER_H
+#define INNO_ML_FILTER_H
+
+#include <InnoML.h>
+#include <vector>
+#include "InnoML_format.h"
+#include "InnoML_simd.h"
+
+class MotionBuffer;
+class MotionFilter;
+
+/**
+ * 6-6 stewart platform of the KINEMATICS filter. (poses and axes in the working range)
+ * (Solve is the forward kinematics : Newton iterations on the inverse kinematics from the previous
+ *  solution, so a pose that moved for a mixer period converges in one or two iterations.)
+ */
+class MotionKinematics
+{
+public:
+	MotionKinematics();
+
+	void			Setup(int32 version);
+	void			Reset();
+	int32			Solve(const float* axis, float* pose);
+
+	int32			m_version;		/**< nVersion of IM_FILTER_KINEMATICS_PARAMS (-1 : not set up) */
+	IM_SIMD_KINEMATICS m_kinematics;
+	float			m_scale[IM_DOF_COUNT];	/**< working range -> mm (translations), radians (rotations) */
+	float			m_command[IM_DOF_COUNT];/**< last pose of the inverse kinematics */
+	double			m_pose[IM_DOF_COUNT];	/**< last solution of the forward kinematics (mm, radians) */
+};
+
+/**
+ * Processor of one built-in filter in a filter chain.
+ * (Stages process interleaved frames in the working range, in place.
+ *  The frame stride is the channel count of the stage input.)
+ */
+class MotionFilterStage
+{
+public:
+	MotionFilterStage(MotionFilter* filter);
+	virtual ~MotionFilterStage();
+
+	/**
+	 * This function checks the input format and updates it to the output format.
+	 * (Called once by the build process, returns false if the conversion is not supported.)
+	 */
+	virtual bool	Build(IM_FORMAT* format, const IM_FORMAT* dst);
+	/**
+	 * This function (re)computes the coefficients from the filter params.
+	 */
+	virtual void	Setup() {}
+	/**
+	 * This function clears the filter state.
+	 */
+	virtual void	Reset() {}
+	/**
+	 * This function processes the frames and returns the channel count of the output.
+	 */
+	virtual int32	Process(float* data, int32 frames) = 0;
+	/**
+	 * This function checks whether the stage can run on a part of the frames at a time. (fused into tiles)
+	 */
+	virtual bool	IsFusable() const { return m_out_channels == m_channels; }
+	/**
+	 * This function gets the platform of a KINEMATICS stage.
+	 */
+	virtual const MotionKinematics* GetKinematics() const { return 0; }
+
+	MotionFilter*	m_filter;
+	uint32			m_version;
+	int32			m_channels;		/**< input channels */
+	int32			m_out_channels;	/**< output channels (set by the build process) */
+	float			m_rate;			/**< samples per second */
+	float			m_dt;			/**< sample time (sec) */
+};
+
+/**
+ * This function creates the processor of a built-in filter.
+ */
+MotionFilterStage* im_filter_create_stage(MotionFilter* filter);
+
+/**
+ * Run of consecutive stages in a filter chain.
+ */
+typedef struct {
+	int32		nFirst;			/**< first stage */
+	int32		nCount;			/**< stages */
+	int32		nChannels;		/**< channels (the same for all stages of a fused segment) */
+	bool		bFused;			/**< runs tile by tile */
+} IM_FILTER_SEGMENT;
+
+#define IM_FILTER_TILE_FRAMES	64	/**< frames of a fused tile (8 channels : 2 KB) */
+
+/**
+ * Filter chain built from a filter group.
+ * (The group tree is flattened to a list of stages. Consecutive fusable stages run tile by tile,
+ *  so the frames of a tile stay in the cache from the first stage to the last instead of each
+ *  stage walking the whole buffer. Stages that change the channel count or call a user function
+ *  run alone over the whole buffer.)
+ */
+class MotionFilterProgram
+{
+public:
+	MotionFilterProgram();
+	~MotionFilterProgram();
+
+	bool			Build(MotionFilter* filter, const IM_FORMAT* src, const IM_FORMAT* dst);
+	void			Clear();
+	void			Reset();
+	int32			Process(float* data, int32 frames);
+	bool			IsEmpty() const { return m_stages.empty(); }
+	const MotionKinematics* GetKinematics() const;
+
+	IM_FORMAT		m_src;
+	IM_FORMAT		m_out;			/**< format after the last stage */
+	std::vector<MotionFilterStage*> m_stages;
+	std::vector<IM_FILTER_SEGMENT> m_segments;
+	int32			m_tile_frames;	/**< 0 : stage by stage over the whole buffer */
+};
+
+#define IM_RESAMPLE_TAPS_MAX	32		/**< nTaps (periods of the lower rate) */
+#define IM_RESAMPLE_PHASES_MAX	4096	/**< phases of a ratio (more : zero-order hold) */
+#define IM_RESAMPLE_TABLE_MAX	(1 << 20)	/**< coefficients of the phase table (more : a shorter window) */
+
+/**
+ * Polyphase windowed-sinc resampler of the rational ratio of two rates (up / down).
+ * (An output frame at the time t of the input uses the input frames around t with the taps of the
+ *  phase of t, so the phase table is computed once and the phase advances by integers without drift.
+ *  The window and the history are sized from the ratio, so a decimation of a high rate keeps nTaps
+ *  periods of the output rate. The history is written twice, so the taps of the window are consecutive rows.)
+ */
+class MotionResampler
+{
+public:
+	MotionResampler();
+
+	void			Build(uint32 src_rate, uint32 dst_rate, const IM_FILTER_RESAMPLE_PARAMS* params);
+	void			Reset(bool aligned);
+	void			Push(const float* frame, int32 channels);
+	void			Hold();
+	void			Render(float* frame, int32 channels);
+	float*			GetRow(int32 row) { return &m_history[(size_t)row * IM_FORMAT_CHANNELS_MAX]; }
+	bool			IsHungry() const { return m_phase >= m_up; }
+	/**
+	 * This function gets the input frames needed by the next 'frames' output frames.
+	 */
+	uint64			GetNeeded(int32 frames) const { return frames > 0 ? ((uint64)m_phase + (uint64)(frames - 1) * m_down) / m_up : 0; }
+
+	uint32			m_up;			/**< output frames per 'm_down' input frames */
+	uint32			m_down;
+	int32			m_taps;			/**< input frames of a phase (0 : zero-order hold) */
+	uint32			m_phase;		/**< time of the next output after the center of the window (1/m_up input frames) */
+	int32			m_index;		/**< oldest row of the window */
+	int32			m_pushed;		/**< input frames since the reset */
+	std::vector<float> m_table;		/**< [phase][tap] */
+	std::vector<float> m_history;	/**< [row][IM_FORMAT_CHANNELS_MAX] (row i + m_taps is row i) */
+};
+
+/**
+ * Stream converter (filter chain, channel mapping and rate conversion).
+ * (Used by the sources, inputs, imFilterProcess and imBufferConvert.)
+ */
+class MotionConverter
+{
+public:
+	MotionConverter();
+
+	float			Build(MotionFilter* filter, const IM_FORMAT* src, const IM_FORMAT* dst);
+	void			Reset(bool aligned = false);
+	int32			Decode(const uint8* data, int32 frames, float* out);
+	int32			Pull(MotionBuffer* src, bool consume, uint32* offset, float* out, int32 frames, bool hold = false);
+	bool			IsValid() const { return m_valid; }
+
+	IM_FORMAT		m_src;
+	IM_FORMAT		m_dst;
+	MotionFilterProgram m_program;
+	int32			m_map[IM_FORMAT_CHANNELS_MAX];
+	MotionResampler	m_resampler;
+	IM_SAMPLES_LOAD	m_load;			/**< sample converter of the source format */
+	bool			m_valid;
+	std::vector<float> m_work;
+};
+
+#endif // INNO_ML_FILTER_H
@@ -0,0 +1,233 @@
+/********************************************************************************//**
+\file      InnoML_format.h
+\brief     Sample format helpers of the InnoML reference engine.
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#ifndef INNO_ML_FORMAT_H
+#define INNO_ML_FORMAT_H
+
+#include <InnoML.h>
+#include <string.h>
+#include <math.h>
+
+/**
+ *  \name IM_SAMPLE_*
+ *
+ *  Declare the working range of the mixer and the filters.
+ *  (Every data format is converted to 32-bit float in signed 16-bit scale, so the
+ *   built-in filter params (LIMIT, RATELIMIT, ...) have the same meaning for all formats.)
+ */
+#define IM_SAMPLE_FULL_SCALE	32767.0f
+#define IM_SAMPLE_MIN			-32768.0f
+#define IM_SAMPLE_MAX			32767.0f
+
+/**
+ * This function checks whether the data format is one of IM_FORMAT_DATA_*.
+ */
+inline bool im_format_is_valid(uint32 data_format)
+{
+	switch(data_format) {
+	case IM_FORMAT_DATA_S8:
+	case IM_FORMAT_DATA_S16:
+	case IM_FORMAT_DATA_S32:
+	case IM_FORMAT_DATA_S64:
+	case IM_FORMAT_DATA_F32:
+	case IM_FORMAT_DATA_F64:
+		return true;
+	}
+	return false;
+}
+
+/**
+ * This function fills the format structure and computes the block size.
+ */
+inline void im_format_set(IM_FORMAT* format, uint32 type, uint32 sample_rate, uint32 channels, uint32 data_format)
+{
+	format->nType = type;
+	format->nSampleRate = sample_rate;
+	format->nChannels = channels;
+	format->nDataFormat = data_format;
+	format->nBlockAlign = channels * MOTION_SAMPLE_BYTE(data_format);
+}
+
+/**
+ * This function reads one sample and converts it to the working range.
+ */
+inline float im_sample_load(const uint8* p, uint32 data_format)
+{
+	switch(data_format) {
+	case IM_FORMAT_DATA_S8: {
+		signed char v; memcpy(&v, p, sizeof(v));
+		return (float)v * 256.0f; }
+	case IM_FORMAT_DATA_S16: {
+		int16 v; memcpy(&v, p, sizeof(v));
+		return (float)v; }
+	case IM_FORMAT_DATA_S32: {
+		int32 v; memcpy(&v, p, sizeof(v));
+		return (float)((double)v * (1.0 / 65536.0)); }
+	case IM_FORMAT_DATA_S64: {
+		int64 v; memcpy(&v, p, sizeof(v));
+		return (float)((double)v * (1.0 / 281474976710656.0)); }
+	case IM_FORMAT_DATA_F32: {
+		float v; memcpy(&v, p, sizeof(v));
+		return v * IM_SAMPLE_FULL_SCALE; }
+	case IM_FORMAT_DATA_F64: {
+		double v; memcpy(&v, p, sizeof(v));
+		return (float)(v * IM_SAMPLE_FULL_SCALE); }
+	}
+	return 0;
+}
+
+/**
+ * This function converts one sample from the working range and stores it with saturation.
+ * (Integer formats are rounded to nearest even, the same as the default SSE conversion.)
+ */
+inline void im_sample_store(uint8* p, uint32 data_format, float value)
+{
+	switch(data_format) {
+	case IM_FORMAT_DATA_S8: {
+		signed char v = (signed char)lrintf(MOTION_CLAMP(value * (1.0f / 256.0f), -128.0f, 127.0f));
+		memcpy(p, &v, sizeof(v));
+		break; }
+	case IM_FORMAT_DATA_S16: {
+		int16 v = (int16)lrintf(MOTION_CLAMP(value, IM_SAMPLE_MIN, IM_SAMPLE_MAX));
+		memcpy(p, &v, sizeof(v));
+		break; }
+	case IM_FORMAT_DATA_S32: {
+		int32 v = (int32)llrint(MOTION_CLAMP((double)value * 65536.0, -2147483648.0, 2147483647.0));
+		memcpy(p, &v, sizeof(v));
+		break; }
+	case IM_FORMAT_DATA_S64: {
+		int64 v = (int64)llrint((double)value * 281474976710656.0);
+		memcpy(p, &v, sizeof(v));
+		break; }
+	case IM_FORMAT_DATA_F32: {
+		float v = MOTION_CLAMP(value * (1.0f / IM_SAMPLE_FULL_SCALE), -1.0f, 1.0f);
+		memcpy(p, &v, sizeof(v));
+		break; }
+	case IM_FORMAT_DATA_F64: {
+		double v = MOTION_CLAMP((double)value * (1.0 / IM_SAMPLE_FULL_SCALE), -1.0, 1.0);
+		memcpy(p, &v, sizeof(v));
+		break; }
+	}
+}
+
+/**
+ * These functions convert samples of one data format to and from the working range.
+ * (The data format is a template argument, so the format switch of im_sample_load/store is resolved
+ *  at compile time. The converters are selected once with im_samples_loader/storer.)
+ */
+typedef void (*IM_SAMPLES_LOAD)(const uint8* src, float* dst, int32 count);
+typedef void (*IM_SAMPLES_STORE)(const float* src, uint8* dst, int32 count);
+
+template<uint32 FORMAT> void im_samples_load(const uint8* src, float* dst, int32 count)
+{
+	const uint32 bytes = MOTION_SAMPLE_BYTE(FORMAT);
+	for(int32 i=0; i<count; i++)
+		dst[i] = im_sample_load(src + i * bytes, FORMAT);
+}
+
+template<uint32 FORMAT> void im_samples_store(const float* src, uint8* dst, int32 count)
+{
+	const uint32 bytes = MOTION_SAMPLE_BYTE(FORMAT);
+	for(int32 i=0; i<count; i++)
+		im_sample_store(dst + i * bytes, FORMAT, src[i]);
+}
+
+inline IM_SAMPLES_LOAD im_samples_loader(uint32 data_format)
+{
+	switch(data_format) {
+	case IM_FORMAT_DATA_S8:		return im_samples_load<IM_FORMAT_DATA_S8>;
+	case IM_FORMAT_DATA_S16:	return im_samples_load<IM_FORMAT_DATA_S16>;
+	case IM_FORMAT_DATA_S32:	return im_samples_load<IM_FORMAT_DATA_S32>;
+	case IM_FORMAT_DATA_S64:	return im_samples_load<IM_FORMAT_DATA_S64>;
+	case IM_FORMAT_DATA_F32:	return im_samples_load<IM_FORMAT_DATA_F32>;
+	case IM_FORMAT_DATA_F64:	return im_samples_load<IM_FORMAT_DATA_F64>;
+	}
+	return 0;
+}
+
+inline IM_SAMPLES_STORE im_samples_storer(uint32 data_format)
+{
+	switch(data_format) {
+	case IM_FORMAT_DATA_S8:		return im_samples_store<IM_FORMAT_DATA_S8>;
+	case IM_FORMAT_DATA_S16:	return im_samples_store<IM_FORMAT_DATA_S16>;
+	case IM_FORMAT_DATA_S32:	return im_samples_store<IM_FORMAT_DATA_S32>;
+	case IM_FORMAT_DATA_S64:	return im_samples_store<IM_FORMAT_DATA_S64>;
+	case IM_FORMAT_DATA_F32:	return im_samples_store<IM_FORMAT_DATA_F32>;
+	case IM_FORMAT_DATA_F64:	return im_samples_store<IM_FORMAT_DATA_F64>;
+	}
+	return 0;
+}
+
+/**
+ * This function converts interleaved frames to the working range.
+ */
+inline void im_frames_load(const uint8* src, const IM_FORMAT* format, float* dst, int32 frames)
+{
+	const int32 count = frames * (int32)format->nChannels;
+	IM_SAMPLES_LOAD load = im_samples_loader(format->nDataFormat);
+	if(load)
+		load(src, dst, count);
+	else
+		memset(dst, 0, sizeof(float) * count);
+}
+
+/**
+ * This function converts interleaved frames from the working range.
+ */
+inline void im_frames_store(const float* src, uint8* dst, const IM_FORMAT* format, int32 frames)
+{
+	IM_SAMPLES_STORE store = im_samples_storer(format->nDataFormat);
+	if(store)
+		store(src, dst, frames * (int32)format->nChannels);
+}
+
+/**
+ * This function builds the channel map between two channel layouts.
+ * (map[dst] is the source channel or -1. 3 channels are the default 3-DOF mask (heave, roll, pitch),
+ *  so they are placed on the matching DOF of a 6-DOF layout and vice versa.)
+ */
+inline void im_channel_map(int32 src_channels, int32 dst_channels, int32* map)
+{
+	for(int32 i=0; i<dst_channels; i++)
+		map[i] = (i < src_channels) ? i : -1;
+	if(src_channels == IM_FORMAT_CHANNELS_DEFAULT && dst_channels >= IM_DOF_COUNT) {
+		for(int32 i=0; i<dst_channels; i++)
+			map[i] = -1;
+		map[IM_DOF_HEAVE] = 0;
+		map[IM_DOF_ROLL] = 1;
+		map[IM_DOF_PITCH] = 2;
+	}
+	else if(src_channels >= IM_DOF_COUNT && dst_channels == IM_FORMAT_CHANNELS_DEFAULT) {
+		map[0] = IM_DOF_HEAVE;
+		map[1] = IM_DOF_ROLL;
+		map[2] = IM_DOF_PITCH;
+	}
+}
+
+/**
+ * This function copies frames between channel layouts with the channel map.
+ * (src and dst may be the same memory.)
+ */
+inline void im_frames_remap(const float* src, int32 src_channels, float* dst, int32 dst_channels, const int32* map, int32 frames)
+{
+	float frame[IM_FORMAT_CHANNELS_MAX];
+	if(dst_channels > src_channels) { // expand backwards for in-place use
+		for(int32 f=frames-1; f>=0; f--) {
+			memcpy(frame, src + f*src_channels, sizeof(float)*src_channels);
+			for(int32 c=0; c<dst_channels; c++)
+				dst[f*dst_channels + c] = (map[c] >= 0) ? frame[map[c]] : 0.0f;
+		}
+	}
+	else {
+		for(int32 f=0; f<frames; f++) {
+			memcpy(frame, src + f*src_channels, sizeof(float)*src_channels);
+			for(int32 c=0; c<dst_channels; c++)
+				dst[f*dst_channels + c] = (map[c] >= 0) ? frame[map[c]] : 0.0f;
+		}
+	}
+}
+
+#endif // INNO_ML_FORMAT_H
@@ -0,0 +1,187 @@
+/********************************************************************************//**
+\file      InnoML_input.cpp
+\brief     Motion input objects (IMInput) of the InnoML reference engine.
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#include "InnoML_internal.h"
+#include "InnoML_simd.h"
+#include <chrono>
+
+MotionInput::MotionInput()
+	: MotionObject(IM_OBJECT_INPUT), m_buffer(0), m_filter(0), m_context(0), m_callback(0), m_streamer_obj(0), m_sample_time(0)
+{
+}
+
+MotionInput::~MotionInput()
+{
+	im_object_release(m_buffer);
+	im_object_release(m_filter);
+}
+
+int32 MotionInput::SetBuffer(MotionBuffer* buffer)
+{
+	im_object_retain(buffer);
+	im_object_release(m_buffer);
+	m_buffer = buffer;
+	m_sample_time = 0;
+	if(m_context)
+		return Prepare(&m_context->m_master->m_format);
+	return IM_OK;
+}
+
+int32 MotionInput::SetFilter(MotionFilter* filter)
+{
+	im_object_retain(filter);
+	im_object_release(m_filter);
+	m_filter = filter;
+	if(m_context)
+		return Prepare(&m_context->m_master->m_format);
+	return IM_OK;
+}
+
+int32 MotionInput::Prepare(const IM_FORMAT* master)
+{
+	if(m_buffer == 0)
+		return IM_FAIL;
+	if(m_converter.Build(m_filter, &m_buffer->m_format, master) == 0)
+		return IM_FAIL;
+	return IM_OK;
+}
+
+int32 MotionInput::SendStream(const void* data, int32 size)
+{
+	if(m_buffer == 0 || data == 0)
+		return 0;
+	const IM_FORMAT& format = m_buffer->m_format;
+	if(size < (int32)format.nBlockAlign)
+		return 0;
+
+	// the stream is sampled by the wall clock at the input rate (zero-order hold between the calls)
+	const int64 period = 1000000 / format.nSampleRate;
+	const int64 now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	if(m_sample_time == 0 || now - m_sample_time > period * (int64)m_buffer->m_capacity)
+		m_sample_time = now;
+
+	int32 sent = 0;
+	while(m_sample_time <= now) {
+		if(m_buffer->Enqueue(data, format.nBlockAlign) == 0)
+			break;
+		m_sample_time += period;
+		sent += format.nBlockAlign;
+	}
+	return sent;
+}
+
+int32 MotionInput::Mix(float* mix, int32 frames, int32 channels, const IM_FORMAT* master)
+{
+	m_work.resize(frames * IM_FORMAT_CHANNELS_MAX);
+	if(m_callback) {
+		// the callback fills the stream in the master format
+		m_stream.assign(frames * master->nBlockAlign, 0);
+		int32 size = m_callback(m_streamer_obj, &m_stream[0], (int32)m_stream.size());
+		frames = MOTION_CLAMP(size, 0, (int32)m_stream.size()) / (int32)master->nBlockAlign;
+		im_frames_load(&m_stream[0], master, &m_work[0], frames);
+	}
+	else {
+		if(m_buffer == 0 || !m_converter.IsValid())
+			return 0;
+		frames = m_converter.Pull(m_buffer, true, 0, &m_work[0], frames);
+	}
+
+	if(frames > 0)
+		im_simd()->mix(mix, &m_work[0], frames * channels, 1.0f);
+	return frames;
+}
+
+/************************************
+ * @section IMInput (Motion Input)
+ ************************************/
+IM_API IMInput imCreateInput(IMBuffer buffer)
+{
+	IM_API_LOCK();
+	MotionBuffer* obj = im_lookup<MotionBuffer>(buffer);
+	if(buffer && (obj == 0 || obj->m_stream))
+		return 0;
+	MotionInput* input = new MotionInput();
+	input->SetBuffer(obj);
+	return im_object_register(input);
+}
+
+IM_API IMBuffer imInputSetBuffer(IMInput input, IMBuffer buffer)
+{
+	IM_API_LOCK();
+	MotionInput* obj = im_lookup<MotionInput>(input);
+	MotionBuffer* buf = im_lookup<MotionBuffer>(buffer);
+	if(obj == 0 || (buffer && (buf == 0 || buf->m_stream)))
+		return 0;
+	if(obj->SetBuffer(buf) != IM_OK)
+		return 0;
+	return buffer;
+}
+
+IM_API IMBuffer imInputGetBuffer(IMInput input)
+{
+	IM_API_LOCK();
+	MotionInput* obj = im_lookup<MotionInput>(input);
+	return (obj && obj->m_buffer) ? obj->m_buffer->m_handle : 0;
+}
+
+IM_API int32 imInputSetFilter(IMInput input, IMFilter filter)
+{
+	IM_API_LOCK();
+	MotionInput* obj = im_lookup<MotionInput>(input);
+	MotionFilter* flt = im_lookup<MotionFilter>(filter);
+	if(obj == 0 || (filter && flt == 0))
+		return IM_FAIL;
+	return obj->SetFilter(flt);
+}
+
+IM_API IMFilter imInputGetFilter(IMInput input)
+{
+	IM_API_LOCK();
+	MotionInput* obj = im_lookup<MotionInput>(input);
+	return (obj && obj->m_filter) ? obj->m_filter->m_handle : 0;
+}
+
+IM_API int32 imInputStart(IMInput input, IMotionInputCallback callback, const void* streamer_obj)
+{
+	IM_API_LOCK();
+	MotionInput* obj = im_lookup<MotionInput>(input);
+	MotionContext* context = im_context_current();
+	if(obj == 0 || context == 0)
+		return IM_FAIL;
+	obj->m_callback = callback;
+	obj->m_streamer_obj = (void*)streamer_obj;
+	return context->StartInput(obj);
+}
+
+IM_API int32 imInputStop(IMInput input)
+{
+	IM_API_LOCK();
+	MotionInput* obj = im_lookup<MotionInput>(input);
+	if(obj == 0)
+		return IM_FAIL;
+	if(obj->m_context)
+		return obj->m_context->StopInput(obj);
+	return IM_OK;
+}
+
+IM_API int32 imInputSendStream(IMInput input, const void* data, int32 size)
+{
+	IM_API_LOCK();
+	MotionInput* obj = im_lookup<MotionInput>(input);
+	return obj ? obj->SendStream(data, size) : 0;
+}
+
+IM_API int32 imDeleteInput(IMInput input)
+{
+	IM_API_LOCK();
+	MotionInput* obj = im_lookup<MotionInput>(input);
+	if(obj == 0)
+		return IM_FAIL;
+	if(obj->m_context)
+		obj->m_context->StopInput(obj);
+	im_object_release(obj);
+	return IM_OK;
+}
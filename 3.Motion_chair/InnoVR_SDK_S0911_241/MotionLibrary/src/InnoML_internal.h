@@ -0,0 +1,407 @@
+/********************************************************************************//**
+\file      InnoML_internal.h
+\brief     Internal object declarations of the InnoML reference engine.
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#ifndef INNO_ML_INTERNAL_H
+#define INNO_ML_INTERNAL_H
+
+#include <InnoML.h>
+#include <IMotion_csv.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "InnoML_format.h"
+#include "InnoML_filter.h"
+
+#define IM_FAIL		(-1)	/**< failure result of the status functions (IM_OK on success) */
+#define IM_CACHE_LINE	64		/**< alignment of the members written by different threads */
+
+/**
+ *  \name IM_OBJECT_*
+ *
+ *  Declare the object types behind the int32 handles.
+ */
+typedef enum {
+	IM_OBJECT_NONE = 0,
+	IM_OBJECT_CONTEXT,
+	IM_OBJECT_BUFFER,
+	IM_OBJECT_SOURCE,
+	IM_OBJECT_INPUT,
+	IM_OBJECT_FILTER,
+} IM_OBJECT_TYPE;
+
+/**
+ * Reference counted base of all handle objects.
+ * (Note, all objects are guarded by the api lock except the buffer queue of MotionBuffer.)
+ */
+class MotionObject
+{
+public:
+	MotionObject(IM_OBJECT_TYPE type) : m_type(type), m_handle(0), m_refs(1) {}
+	virtual ~MotionObject() {}
+
+	IM_OBJECT_TYPE	m_type;
+	int32			m_handle;
+	std::atomic<int32> m_refs;
+};
+
+/**
+ * This function gets the lock that serializes the api calls and the mixer threads.
+ */
+std::recursive_mutex& im_api_lock();
+
+#define IM_API_LOCK()	std::lock_guard<std::recursive_mutex> im_api_guard(im_api_lock())
+
+/**
+ * These functions manage the handle registry. (slot map with generation counted handles, lookups take no lock)
+ * (im_object_lookup needs the api lock to use the object, im_object_acquire retains the object
+ *  without the api lock, and the last im_object_release deletes the object under the api lock.)
+ */
+int32			im_object_register(MotionObject* obj);
+MotionObject*	im_object_lookup(int32 handle, IM_OBJECT_TYPE type);
+MotionObject*	im_object_acquire(int32 handle, IM_OBJECT_TYPE type);
+void			im_object_retain(MotionObject* obj);
+void			im_object_release(MotionObject* obj);
+
+template<class T> inline T* im_lookup(int32 handle)
+{
+	return static_cast<T*>(im_object_lookup(handle, (IM_OBJECT_TYPE)T::TYPE));
+}
+
+template<class T> inline T* im_acquire(int32 handle)
+{
+	return static_cast<T*>(im_object_acquire(handle, (IM_OBJECT_TYPE)T::TYPE));
+}
+
+/**
+ * This function writes the engine log. (IM_CFG_DEBUG_MODE or imSetLogFunction)
+ */
+void			im_log(uint32 id, const char* format, ...);
+
+class MotionBuffer;
+class MotionSource;
+
+#define IM_STREAM_CHUNK_FRAMES	256		/**< frames decoded at a time by a stream */
+#define IM_STREAM_RING_MSEC		2000	/**< default ring of a stream buffer */
+#define IM_STREAM_MARKS			64		/**< loop restarts queued ahead of the source */
+#define IM_STREAM_WAIT_MSEC		10		/**< wait of the decoder for room in the ring */
+#define IM_STREAM_END_NONE		0xFFFFFFFF
+
+/**
+ * Decoder of a stream buffer (imLoadBufferStream).
+ * (The decoder thread reads the motion file a chunk at a time into the ring of the buffer while the ring
+ *  has room, so the thread is the producer of the ring and the source that plays the buffer is its consumer.
+ *  The memory is the ring whatever the length of the file. At the loop end the decoder continues from the
+ *  loop begin while the source has loops left, and queues the stream frame of the restart for the source.)
+ */
+class MotionStream
+{
+public:
+	MotionStream();
+	~MotionStream();
+
+	bool			Open(const char* url, const char* key);
+	void			Restart(MotionBuffer* buffer, int32 loops);
+	void			Stop();
+	int32			Decode();
+	void			Run();
+	/**
+	 * These functions are the consumer side. (the source that plays the buffer)
+	 */
+	bool			PopMark(uint32 frame, uint32* mark);
+	void			Consume(uint32 frames);
+	bool			IsPristine(int32 loops) const { return loops == 0 && m_loops.load() == 0 && m_mark_tail.load() == 0 && m_read == 0; }
+
+	IM_MOTION_READER* m_reader;
+	IM_FORMAT		m_format;
+	uint32			m_file_loop_begin;	/**< loop points of the file (binary motion file) */
+	uint32			m_file_loop_end;
+	MotionBuffer*	m_buffer;		/**< buffer of the stream (not retained, it owns the stream) */
+	MotionSource*	m_source;		/**< source that plays the buffer (one at a time) */
+	std::atomic<uint32> m_frames;	/**< frames of the file (0 : not known yet) */
+
+	// decoder
+	uint32			m_frame;		/**< next frame of the file */
+	uint32			m_loop_begin;	/**< loop points of the buffer at the restart */
+	uint32			m_loop_end;
+	std::atomic<int32> m_loops;		/**< loops left (IM_LOOP_INFINITE) */
+	bool			m_wrapped;		/**< no frame since the last loop restart */
+	uint32			m_written;		/**< stream frames since the restart */
+	std::vector<uint8> m_chunk;
+	std::thread		m_thread;
+	std::atomic<bool> m_running;
+	std::mutex		m_mutex;
+	std::condition_variable m_wake;
+
+	// decoder -> source
+	std::atomic<uint32> m_end;		/**< stream frames of the whole stream (IM_STREAM_END_NONE : not ended yet) */
+	uint32			m_marks[IM_STREAM_MARKS];	/**< stream frames of the loop restarts */
+	std::atomic<uint32> m_mark_head;	/**< marks popped by the source (consumer) */
+	std::atomic<uint32> m_mark_tail;	/**< marks pushed by the decoder (producer) */
+
+	// source
+	uint32			m_read;			/**< stream frames consumed since the restart */
+	uint32			m_underruns;	/**< mixer periods that waited for the decoder */
+};
+
+/**
+ * Motion buffer object (IMBuffer).
+ * (Frames are kept in a single-producer/single-consumer ring, so one enqueue thread and one
+ *  dequeue thread (usually the mixer) run without the api lock. Sources play the queued frames
+ *  without consuming them.)
+ */
+class MotionBuffer : public MotionObject
+{
+public:
+	enum { TYPE = IM_OBJECT_BUFFER };
+	MotionBuffer();
+	virtual ~MotionBuffer();
+
+	bool			Create(const IM_FORMAT* format, int32 samples, int32 buffers);
+	bool			Wrap(IM_MOTION_FILE* file);
+	int32			Enqueue(const void* data, int32 size);
+	int32			Dequeue(void* data, int32 size);
+	int32			Read(uint32 offset, void* data, int32 frames) const;
+	void*			Lock(int32 size, uint32 flags);
+	int32			Unlock();
+	void			Clear();
+	int32			SetShared(MotionBuffer* shared);
+
+	/**
+	 * Ring indices run over twice the ring size, so a full ring and an empty ring differ for any size.
+	 */
+	uint32			Advance(uint32 index, uint32 frames) const { index += frames; return (index >= (m_size<<1)) ? index - (m_size<<1) : index; }
+	uint32			Distance(uint32 head, uint32 tail) const { return (tail >= head) ? tail - head : tail + (m_size<<1) - head; }
+	uint32			Offset(uint32 index) const { return (index >= m_size) ? index - m_size : index; }
+
+	const uint8*	GetFrame(uint32 index) const { return m_data + Offset(Advance(m_head.load(std::memory_order_relaxed), index)) * m_format.nBlockAlign; }
+	uint32			GetQueuedCount() const { return Distance(m_head.load(std::memory_order_acquire), m_tail.load(std::memory_order_acquire)); }
+	uint32			GetFreeCount() const { return m_capacity - GetQueuedCount(); }
+
+	IM_FORMAT		m_format;
+	int32			m_samples;		/**< samples per buffer (mixer period of the master buffer) */
+	int32			m_buffers;
+	uint32			m_capacity;		/**< maximum queued frames */
+	uint32			m_size;			/**< ring size in frames */
+	uint32			m_bytes;		/**< ring size in bytes */
+	uint8*			m_data;
+	bool			m_mirrored;		/**< the ring is mapped twice back-to-back (m_data[m_bytes + i] is m_data[i]) */
+	IM_MOTION_FILE	m_file;			/**< binary motion file of the frames (pMemory 0 : the ring is allocated) */
+	uint32			m_loop_begin;	/**< loop points of the sources (frames, m_loop_end 0 : the whole buffer) */
+	uint32			m_loop_end;
+	MotionStream*	m_stream;		/**< decoder of a stream buffer (0 : frames queued by the application) */
+	MotionBuffer*	m_shared;		/**< buffer that also queues into this buffer */
+	std::vector<MotionBuffer*> m_mirrors;
+	std::atomic<int32> m_mirror_count;
+
+	uint8*			m_lock_data;
+	uint32			m_lock_frames;
+	uint32			m_lock_flags;
+	std::atomic<bool> m_locked;
+	std::vector<uint8> m_staging;	/**< lock memory of a region that wraps a ring that is not mirrored */
+
+	alignas(IM_CACHE_LINE) std::atomic<uint32> m_head;	/**< read index (consumer) */
+	alignas(IM_CACHE_LINE) std::atomic<uint32> m_tail;	/**< write index (producer) */
+};
+
+/**
+ * Motion filter object (IMFilter).
+ */
+class MotionFilter : public MotionObject
+{
+public:
+	enum { TYPE = IM_OBJECT_FILTER };
+	MotionFilter();
+	virtual ~MotionFilter();
+
+	bool			Create(IM_FILTER_TYPE type, IMotionFilterCallback processor, const void* processor_obj);
+	int32			SetParams(const void* data, int32 size, int32 count);
+	int32			GetParams(void* data, int32 size, int32 count) const;
+	const void*		GetParam(int32 channel) const;
+	int32			Append(MotionFilter* child);
+	int32			Remove(MotionFilter* child);
+	bool			Contains(const MotionFilter* filter) const;
+
+	IM_FILTER_TYPE	m_type;
+	IMotionFilterCallback m_processor;
+	void*			m_processor_obj;
+	uint32			m_param_size;
+	int32			m_param_count;	/**< 0 : defaults, 1 : all channels, n : first n channels */
+	uint32			m_version;		/**< increased by imFilterSetParams */
+	std::vector<uint8> m_params;
+	std::vector<uint8> m_defaults;
+	std::vector<MotionFilter*> m_children;
+
+	MotionConverter	m_converter;	/**< imFilterBuild & imFilterProcess */
+	MotionBuffer*	m_src;
+	MotionBuffer*	m_dst;
+};
+
+/**
+ * Playback notification collected by the mixer and sent after mixing.
+ */
+typedef struct {
+	IMotionCallback	func;
+	void*			obj;
+	uint32			state;
+} IM_NOTIFY;
+
+class MotionContext;
+
+#define IM_SOURCE_DECODE_FRAMES	32	/**< frames decoded ahead by a source */
+#define IM_SOURCE_PHASE_BITS	32	/**< fraction bits of the play position */
+#define IM_SOURCE_FRAME_NONE	0xFFFFFFFF
+#define IM_SOURCE_SPEED_MAX		64.0f	/**< speed factor */
+
+/**
+ * Motion source object (IMSource).
+ */
+class MotionSource : public MotionObject
+{
+public:
+	enum { TYPE = IM_OBJECT_SOURCE };
+	MotionSource();
+	virtual ~MotionSource();
+
+	int32			SetBuffer(MotionBuffer* buffer);
+	int32			SetFilter(MotionFilter* filter);
+	int32			Prepare(const IM_FORMAT* master);
+	int32			Mix(float* mix, int32 frames, int32 channels, float gain, std::vector<IM_NOTIFY>& notify);
+	int32			SetSpeed(float speed, int32 ramp);
+	int32			GetPosition() const;
+	bool			Pair(uint32 index, uint32 duration, uint32 loop_begin, uint32 loop_end, int32 channels);
+	const float*	Fetch(uint32 index);
+
+	MotionBuffer*	m_buffer;
+	MotionFilter*	m_filter;
+	MotionContext*	m_context;		/**< playing context */
+	int32			m_volume;
+	float			m_speed;		/**< speed factor (1 : normal) */
+	int32			m_loop_count;
+	int32			m_loops;
+	bool			m_paused;
+	IMotionCallback	m_listener;
+	void*			m_listener_obj;
+
+	MotionConverter	m_converter;	/**< source format -> master channels */
+	uint64			m_pos;			/**< play position (source frames, 32.32) */
+	uint64			m_step;			/**< position step per master frame (32.32) */
+	uint64			m_step_target;	/**< step at the end of the speed ramp */
+	int64			m_step_delta;	/**< step change per master frame of the ramp */
+	uint32			m_ramp;			/**< master frames left of the speed ramp */
+	uint32			m_frame;		/**< source frame of m_pair[0] (IM_SOURCE_FRAME_NONE : not fetched) */
+	uint32			m_stream_base;	/**< stream frame of the first frame of the file (stream buffer) */
+	float			m_pair[2][IM_FORMAT_CHANNELS_MAX];	/**< frames around the play position */
+	uint32			m_decoded;		/**< next frame for the filter chain */
+	uint32			m_cached;		/**< decoded frames in m_frames (up to m_decoded) */
+	std::vector<float> m_frames;	/**< decoded block (master channels) */
+	std::vector<float> m_work;
+	std::vector<uint8> m_raw;
+	std::vector<float> m_render;	/**< frames of the tick (master channels) */
+};
+
+/**
+ * Motion input object (IMInput).
+ */
+class MotionInput : public MotionObject
+{
+public:
+	enum { TYPE = IM_OBJECT_INPUT };
+	MotionInput();
+	virtual ~MotionInput();
+
+	int32			SetBuffer(MotionBuffer* buffer);
+	int32			SetFilter(MotionFilter* filter);
+	int32			Prepare(const IM_FORMAT* master);
+	int32			SendStream(const void* data, int32 size);
+	int32			Mix(float* mix, int32 frames, int32 channels, const IM_FORMAT* master);
+
+	MotionBuffer*	m_buffer;
+	MotionFilter*	m_filter;
+	MotionContext*	m_context;		/**< streaming context */
+	IMotionInputCallback m_callback;
+	void*			m_streamer_obj;
+
+	MotionConverter	m_converter;	/**< input format -> master format */
+	std::vector<float> m_work;
+	std::vector<uint8> m_stream;
+	int64			m_sample_time;	/**< next sampling time of imInputSendStream (usec) */
+};
+
+/**
+ * Motion context object (IMContext) and its headless device.
+ */
+class MotionContext : public MotionObject
+{
+public:
+	enum { TYPE = IM_OBJECT_CONTEXT };
+	MotionContext();
+	virtual ~MotionContext();
+
+	bool			Create(MotionBuffer* master, uint32 id, const IM_DEVICE_DESC* desc);
+	int32			Start(IMotionInputCallback callback, const void* streamer_obj, MotionContext* shared, uint32 flags);
+	std::thread		Stop(uint32 flags);
+	int32			SetFilter(MotionFilter* filter);
+	int32			Play(MotionSource* source);
+	int32			StopSource(MotionSource* source);
+	int32			StartInput(MotionInput* input);
+	int32			StopInput(MotionInput* input);
+	int32			GetDiagnostic(IM_DIAGNOSTIC_AXIS_INFO* axis, int32 count) const;
+	int32			GetTimingInfo(IM_TIMING_INFO* info) const;
+	int32			SetPoseBuffer(MotionBuffer* buffer);
+	void			Measure(const float* encoder);
+	void			Tick();
+	void			Run();
+
+	MotionBuffer*	m_master;
+	uint32			m_id;
+	IM_DEVICE_DESC	m_desc;
+	std::string		m_name;
+	std::string		m_detail;
+	std::string		m_ipaddress;
+	std::string		m_filtername;
+
+	MotionFilter*	m_filter;
+	MotionFilterProgram m_program;
+	int32			m_volume;
+	std::vector<MotionSource*> m_sources;
+	std::vector<MotionInput*> m_inputs;
+	IMotionInputCallback m_callback;
+	void*			m_streamer_obj;
+	MotionContext*	m_shared;		/**< context whose output is queued to this master buffer */
+
+	std::thread		m_thread;
+	std::atomic<bool> m_running;
+	std::vector<float> m_mix;
+	std::vector<float> m_work;
+	std::vector<uint8> m_stream;
+	std::vector<IM_NOTIFY> m_notify;
+
+	float			m_output[IM_FORMAT_CHANNELS_MAX];	/**< last frame sent to the device */
+	uint64			m_frames_sent;
+
+	IM_TIMING_INFO	m_timing;		/**< deadline statistics of the mixer thread */
+	int64			m_lateness_sum;	/**< (us) */
+
+	MotionKinematics m_kinematics;	/**< forward kinematics of the axis encoders */
+	IM_POSE_INFO	m_pose;			/**< pose of the last tick */
+	MotionBuffer*	m_pose_buffer;	/**< measured pose stream (imSetPoseBuffer) */
+};
+
+/**
+ * This function gets the active context. (api lock required)
+ */
+MotionContext*	im_context_current();
+
+/**
+ * This function creates a buffer with the format and the ring size. (api lock required)
+ */
+MotionBuffer*	im_buffer_create(const IM_FORMAT* format, int32 samples, int32 buffers);
+
+#endif // INNO_ML_INTERNAL_H
@@ -0,0 +1,175 @@
+/********************************************************************************//**
+\file      InnoML_object.cpp
+\brief     Handle registry (slot map) and logging of the InnoML reference engine.
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#include "InnoML_internal.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <deque>
+
+/**
+ *  \name IM_HANDLE_*
+ *
+ *  Declare the handle layout of the slot map.
+ *  (A handle is the slot index and the generation of the slot. The generation changes when the
+ *   slot is reused, so a stale handle does not resolve to the new object of the slot.)
+ */
+#define IM_HANDLE_INDEX_BITS	20
+#define IM_HANDLE_INDEX_MASK	((1 << IM_HANDLE_INDEX_BITS) - 1)
+#define IM_HANDLE_GEN_MAX		((1 << (31 - IM_HANDLE_INDEX_BITS)) - 1)
+#define IM_SLOT_PAGE_BITS		10
+#define IM_SLOT_PAGE_SIZE		(1 << IM_SLOT_PAGE_BITS)
+#define IM_SLOT_PAGES			(1 << (IM_HANDLE_INDEX_BITS - IM_SLOT_PAGE_BITS))
+#define IM_SLOT_FREE_MIN		1024	/**< free slots kept before reusing one (spreads the generations) */
+
+typedef struct {
+	std::atomic<MotionObject*> obj;
+	std::atomic<int32> handle;		/**< handle of the object (0 : free) */
+	std::atomic<int32> readers;		/**< im_object_acquire calls between the slot load and the retain */
+	uint32		gen;
+} IM_SLOT;
+
+/**
+ * The slots are allocated in pages that are never moved or freed, so lookups read them without a lock.
+ * (Registering and releasing are serialized by s_slots_lock.)
+ */
+static std::atomic<IM_SLOT*> s_pages[IM_SLOT_PAGES];
+static std::mutex s_slots_lock;
+static uint32 s_slot_count = 1;		/**< slot 0 is not used, so a handle is never 0 */
+static std::deque<uint32> s_free;
+
+static IMotionDebugCallback s_log_callback = 0;
+static void* s_log_userdata = 0;
+
+std::recursive_mutex& im_api_lock()
+{
+	static std::recursive_mutex s_lock;
+	return s_lock;
+}
+
+static inline IM_SLOT* slot_get(int32 handle)
+{
+	if(handle <= 0)
+		return 0;
+	const uint32 index = (uint32)handle & IM_HANDLE_INDEX_MASK;
+	IM_SLOT* page = s_pages[index >> IM_SLOT_PAGE_BITS].load(std::memory_order_acquire);
+	return page ? &page[index & (IM_SLOT_PAGE_SIZE - 1)] : 0;
+}
+
+static IM_SLOT* slot_alloc(uint32* index)
+{
+	if(s_free.size() > IM_SLOT_FREE_MIN || (s_free.size() && s_slot_count > IM_HANDLE_INDEX_MASK)) {
+		*index = s_free.front();
+		s_free.pop_front();
+		return slot_get((int32)*index);
+	}
+	if(s_slot_count > IM_HANDLE_INDEX_MASK)
+		return 0;
+	*index = s_slot_count++;
+	std::atomic<IM_SLOT*>& page = s_pages[*index >> IM_SLOT_PAGE_BITS];
+	if(page.load(std::memory_order_relaxed) == 0) {
+		IM_SLOT* slots = new IM_SLOT[IM_SLOT_PAGE_SIZE];
+		for(int i=0; i<IM_SLOT_PAGE_SIZE; i++) {
+			slots[i].obj.store(0, std::memory_order_relaxed);
+			slots[i].handle.store(0, std::memory_order_relaxed);
+			slots[i].readers.store(0, std::memory_order_relaxed);
+			slots[i].gen = 0;
+		}
+		page.store(slots, std::memory_order_release);
+	}
+	return slot_get((int32)*index);
+}
+
+int32 im_object_register(MotionObject* obj)
+{
+	std::lock_guard<std::mutex> guard(s_slots_lock);
+	uint32 index;
+	IM_SLOT* slot = slot_alloc(&index);
+	if(slot == 0)
+		return 0; // all slots are used
+	slot->gen = (slot->gen >= IM_HANDLE_GEN_MAX) ? 1 : slot->gen + 1;
+	int32 handle = (int32)((slot->gen << IM_HANDLE_INDEX_BITS) | index);
+	obj->m_handle = handle;
+	slot->obj.store(obj, std::memory_order_relaxed);
+	slot->handle.store(handle, std::memory_order_release);
+	return handle;
+}
+
+MotionObject* im_object_lookup(int32 handle, IM_OBJECT_TYPE type)
+{
+	// objects are deleted under the api lock, so the slot is stable here
+	IM_SLOT* slot = slot_get(handle);
+	if(slot == 0 || slot->handle.load(std::memory_order_acquire) != handle)
+		return 0;
+	MotionObject* obj = slot->obj.load(std::memory_order_relaxed);
+	return (obj && obj->m_type == type) ? obj : 0;
+}
+
+MotionObject* im_object_acquire(int32 handle, IM_OBJECT_TYPE type)
+{
+	IM_SLOT* slot = slot_get(handle);
+	if(slot == 0)
+		return 0;
+	// the release of the last reference waits for the readers before deleting the object
+	slot->readers.fetch_add(1);
+	MotionObject* obj = (slot->handle.load() == handle) ? slot->obj.load() : 0;
+	if(obj && obj->m_type == type) {
+		// an object whose last reference is being released is not revived
+		int32 refs = obj->m_refs.load();
+		while(refs > 0 && !obj->m_refs.compare_exchange_weak(refs, refs + 1)) {}
+		if(refs <= 0)
+			obj = 0;
+	}
+	else {
+		obj = 0;
+	}
+	slot->readers.fetch_sub(1);
+	return obj;
+}
+
+void im_object_retain(MotionObject* obj)
+{
+	if(obj)
+		obj->m_refs.fetch_add(1);
+}
+
+void im_object_release(MotionObject* obj)
+{
+	if(obj == 0 || obj->m_refs.fetch_sub(1) != 1)
+		return;
+	IM_API_LOCK();
+	IM_SLOT* slot = slot_get(obj->m_handle);
+	if(slot && slot->obj.load(std::memory_order_relaxed) == obj) {
+		slot->handle.store(0);
+		slot->obj.store(0);
+		while(slot->readers.load() != 0)
+			std::this_thread::yield();
+		std::lock_guard<std::mutex> guard(s_slots_lock);
+		s_free.push_back((uint32)obj->m_handle & IM_HANDLE_INDEX_MASK);
+	}
+	delete obj;
+}
+
+void im_log(uint32 id, const char* format, ...)
+{
+	char message[IM_STRING_MAX];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(message, sizeof(message), format, args);
+	va_end(args);
+
+	if(s_log_callback)
+		s_log_callback(id, message, s_log_userdata);
+	else
+		fprintf(stderr, "[InnoML:%u] %s\n", id, message);
+}
+
+IM_API int32 imSetLogFunction(IMotionDebugCallback callback, void *userdata)
+{
+	IM_API_LOCK();
+	s_log_callback = callback;
+	s_log_userdata = userdata;
+	return IM_OK;
+}
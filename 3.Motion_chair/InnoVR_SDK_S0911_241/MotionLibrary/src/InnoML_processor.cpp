@@ -0,0 +1,1136 @@
+/********************************************************************************//**
+\file      InnoML_processor.cpp
+\brief     Built-in filter processors of the InnoML reference engine.
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#include "InnoML_internal.h"
+#include "InnoML_simd.h"
+
+#define IM_FILTER_ORDER_MAX		3
+
+/**
+ * First-order IIR section (bilinear transform with prewarped cutoff).
+ */
+typedef struct {
+	float	b0, b1, a1;
+	float	x1, y1;
+} IM_FILTER_SECTION;
+
+static void section_setup(IM_FILTER_SECTION* s, float cutoff, float rate, bool highpass)
+{
+	cutoff = MOTION_CLAMP(cutoff, 0.001f, rate * 0.45f);
+	float k = (float)tan(IM_PI * cutoff / rate);
+	s->a1 = (k - 1.0f) / (k + 1.0f);
+	if(highpass) {
+		s->b0 = 1.0f / (1.0f + k);
+		s->b1 = -s->b0;
+	}
+	else {
+		s->b0 = k / (1.0f + k);
+		s->b1 = s->b0;
+	}
+}
+
+static inline float section_process(IM_FILTER_SECTION* s, float x)
+{
+	float y = s->b0 * x + s->b1 * s->x1 - s->a1 * s->y1;
+	s->x1 = x;
+	s->y1 = y;
+	return y;
+}
+
+/**
+ * Stage whose processor is instantiated for a channel count.
+ * (T::Run<N> is selected by the build process for the 3-DOF and 6-DOF layouts, so the channel loops
+ *  of the common layouts are unrolled and the state is kept in locals. N = 0 is the generic processor.)
+ */
+template<class T> class UnrolledStage : public MotionFilterStage
+{
+public:
+	UnrolledStage(MotionFilter* filter) : MotionFilterStage(filter), m_kernel(0) {}
+
+	virtual bool Build(IM_FORMAT* format, const IM_FORMAT* dst)
+	{
+		MotionFilterStage::Build(format, dst);
+		switch(m_channels) {
+		case IM_FORMAT_CHANNELS_DEFAULT:	m_kernel = &T::template Run<IM_FORMAT_CHANNELS_DEFAULT>; break;
+		case IM_DOF_COUNT:					m_kernel = &T::template Run<IM_DOF_COUNT>; break;
+		default:							m_kernel = &T::template Run<0>; break;
+		}
+		return true;
+	}
+	virtual int32 Process(float* data, int32 frames)
+	{
+		return (static_cast<T*>(this)->*m_kernel)(data, frames);
+	}
+
+	int32	(T::*m_kernel)(float* data, int32 frames);
+};
+
+/************************************
+ * NOISE (kalman filter)
+ ************************************/
+#define IM_FILTER_NOISE_TOLERANCE	1e-6f	/**< relative error of the covariance at the steady state */
+
+/**
+ * Scalar kalman filter of a constant signal per channel (q = 1, r = nCovariance).
+ * (The covariance converges to the steady state of the channel, whose gain is computed by the setup.
+ *  Once all the channels are there, the fixed gain update x += K*(z - x) runs as a first-order
+ *  section of the biquad kernel over all the channels, until the params are changed.)
+ */
+class NoiseStage : public UnrolledStage<NoiseStage>
+{
+public:
+	NoiseStage(MotionFilter* filter) : UnrolledStage<NoiseStage>(filter)
+	{
+		memset(m_r, 0, sizeof(m_r));
+		memset(m_steady_p, 0, sizeof(m_steady_p));
+		im_biquad_reset(&m_cascade);
+		Reset();
+	}
+
+	virtual void Setup()
+	{
+		// steady state of p = (p + q) * r / (p + q + r) : the prior P = (q + sqrt(q*q + 4*q*r)) / 2, K = P / (P + r)
+		const double q = 1.0;
+		float s1[IM_FORMAT_CHANNELS_MAX];
+		memcpy(s1, m_cascade.s1[0], sizeof(s1));
+		im_biquad_reset(&m_cascade);
+		memcpy(m_cascade.s1[0], s1, sizeof(s1));
+		m_cascade.nSections = 1;
+
+		bool changed = false;
+		for(int32 c=0; c<m_channels; c++) {
+			const IM_FILTER_NOISE_PARAMS* params = (const IM_FILTER_NOISE_PARAMS*)m_filter->GetParam(c);
+			float r = params ? (float)MOTION_CLAMP(params->nCovariance, 0, 100) : 0.0f;
+			changed = changed || (r != m_r[c]);
+			m_r[c] = r;
+			m_steady_p[c] = 0;
+			if(r == 0)
+				continue; // identity
+			double prior = (q + sqrt(q * q + 4.0 * q * r)) / 2.0;
+			double gain = prior / (prior + r);
+			m_steady_p[c] = (float)((1.0 - gain) * prior);
+			// y = K*z + s, s = (1 - K)*y
+			float section[3] = { (float)gain, 0, (float)(gain - 1.0) };
+			im_biquad_set(&m_cascade, 0, c, section, 0);
+		}
+		if(changed)
+			m_steady = false; // the full update until the new steady state
+	}
+	virtual void Reset()
+	{
+		memset(m_x, 0, sizeof(m_x));
+		for(int32 c=0; c<IM_FORMAT_CHANNELS_MAX; c++)
+			m_p[c] = 1.0f;
+		memset(m_cascade.s1, 0, sizeof(m_cascade.s1));
+		m_init = false;
+		m_steady = false;
+	}
+	template<int32 N> int32 Run(float* data, int32 frames)
+	{
+		const int32 channels = N ? N : m_channels;
+		const float q = 1.0f;
+		if(!m_init && frames > 0) {
+			memcpy(m_x, data, sizeof(float) * channels);
+			m_init = true;
+		}
+		int32 f = 0;
+		if(!m_steady) {
+			float x[IM_FORMAT_CHANNELS_MAX], p[IM_FORMAT_CHANNELS_MAX], r[IM_FORMAT_CHANNELS_MAX];
+			for(int32 c=0; c<channels; c++) {
+				x[c] = m_x[c];
+				p[c] = m_p[c];
+				r[c] = m_r[c];
+			}
+			bool steady = false;
+			for(; f<frames && !steady; f++) {
+				float* frame = data + f * channels;
+				steady = true;
+				for(int32 c=0; c<channels; c++) {
+					if(r[c] == 0)
+						continue;
+					p[c] += q;
+					float k = p[c] / (p[c] + r[c]);
+					x[c] += k * (frame[c] - x[c]);
+					p[c] *= 1.0f - k;
+					frame[c] = x[c];
+					steady = steady && fabsf(p[c] - m_steady_p[c]) <= m_steady_p[c] * IM_FILTER_NOISE_TOLERANCE;
+				}
+			}
+			for(int32 c=0; c<channels; c++) {
+				m_x[c] = x[c];
+				m_p[c] = p[c];
+			}
+			if(steady) {
+				for(int32 c=0; c<channels; c++)
+					m_cascade.s1[0][c] = -m_cascade.a1[0][c] * x[c];
+				m_steady = true;
+			}
+		}
+		if(m_steady && f < frames) {
+			im_simd()->biquad(data + f * channels, frames - f, channels, &m_cascade);
+			const float* last = data + (frames - 1) * channels;
+			for(int32 c=0; c<channels; c++) {
+				if(m_r[c] != 0)
+					m_x[c] = last[c];
+			}
+		}
+		return channels;
+	}
+
+	float	m_r[IM_FORMAT_CHANNELS_MAX];	/**< measurement noise (0 : bypass) */
+	float	m_x[IM_FORMAT_CHANNELS_MAX];
+	float	m_p[IM_FORMAT_CHANNELS_MAX];
+	float	m_steady_p[IM_FORMAT_CHANNELS_MAX];	/**< covariance at the steady state */
+	IM_SIMD_BIQUAD m_cascade;		/**< fixed gain update */
+	bool	m_init;
+	bool	m_steady;
+};
+
+/************************************
+ * MEAN (moving average)
+ ************************************/
+#define IM_FILTER_MEAN_MAX	16
+#define IM_FILTER_MEAN_SCALE	65536.0			/**< fixed point of the sums (the S32 grid, S16 samples are integers) */
+#define IM_FILTER_MEAN_ROUND	6755399441055744.0	/**< 1.5 * 2^52 : (x + round) - round is x rounded to an integer */
+
+/**
+ * Moving average with a running sum per channel, so a sample costs the same for any count.
+ * (The samples are kept as integers of the S32 grid in doubles, so the sums of S16 and S32 sources are
+ *  exact and never drift. The history is written twice, so the sample that leaves the window of a
+ *  channel is at a fixed offset from the current row and the channel loops are vectorized. The sums
+ *  are recounted from the history when the counts are changed.)
+ */
+class MeanStage : public UnrolledStage<MeanStage>
+{
+public:
+	MeanStage(MotionFilter* filter) : UnrolledStage<MeanStage>(filter)
+	{
+		memset(m_count, 0, sizeof(m_count));
+		Reset();
+	}
+
+	virtual void Setup()
+	{
+		for(int32 c=0; c<m_channels; c++) {
+			const IM_FILTER_MEAN_PARAMS* params = (const IM_FILTER_MEAN_PARAMS*)m_filter->GetParam(c);
+			m_count[c] = params ? MOTION_CLAMP(params->nCount, 0, IM_FILTER_MEAN_MAX) : 0;
+		}
+		Recount();
+	}
+	virtual void Reset()
+	{
+		memset(m_history, 0, sizeof(m_history));
+		memset(m_sum, 0, sizeof(m_sum));
+		m_index = 0;
+		m_filled = 0;
+	}
+	template<int32 N> int32 Run(float* data, int32 frames)
+	{
+		const int32 channels = N ? N : m_channels;
+		double sum[IM_FORMAT_CHANNELS_MAX], q[IM_FORMAT_CHANNELS_MAX];
+		float count[IM_FORMAT_CHANNELS_MAX];
+		int32 leave[IM_FORMAT_CHANNELS_MAX];	// offset of the sample of 'count' frames ago (count 0 : the sum is not used)
+		memcpy(sum, m_sum, sizeof(double) * channels);
+		for(int32 c=0; c<channels; c++) {
+			count[c] = (float)MOTION_MIN(m_count[c], m_filled);
+			leave[c] = (IM_FILTER_MEAN_MAX - m_count[c]) * IM_FORMAT_CHANNELS_MAX + c;
+		}
+		for(int32 f=0; f<frames; f++) {
+			float* frame = data + f * channels;
+			double* row = m_history[m_index];
+			if(m_filled < IM_FILTER_MEAN_MAX) {
+				m_filled++;
+				for(int32 c=0; c<channels; c++)
+					count[c] = (float)MOTION_MIN(m_count[c], m_filled);
+			}
+			for(int32 c=0; c<channels; c++)
+				q[c] = ((double)frame[c] * IM_FILTER_MEAN_SCALE + IM_FILTER_MEAN_ROUND) - IM_FILTER_MEAN_ROUND;
+			for(int32 c=0; c<channels; c++)
+				sum[c] += q[c] - row[leave[c]];
+			for(int32 c=0; c<channels; c++) {
+				row[c] = q[c];
+				row[IM_FILTER_MEAN_MAX * IM_FORMAT_CHANNELS_MAX + c] = q[c];
+			}
+			for(int32 c=0; c<channels; c++) {
+				float mean = (float)(sum[c] * (1.0 / IM_FILTER_MEAN_SCALE)) / count[c];
+				frame[c] = (count[c] > 1) ? mean : frame[c];
+			}
+			m_index = (m_index + 1) & (IM_FILTER_MEAN_MAX - 1);
+		}
+		memcpy(m_sum, sum, sizeof(double) * channels);
+		return channels;
+	}
+
+	/**
+	 * This function sums the last 'count' samples of the history.
+	 */
+	void Recount()
+	{
+		for(int32 c=0; c<IM_FORMAT_CHANNELS_MAX; c++) {
+			double sum = 0;
+			for(int32 i=1; i<=m_count[c]; i++)
+				sum += m_history[(m_index - i) & (IM_FILTER_MEAN_MAX - 1)][c];
+			m_sum[c] = sum;
+		}
+	}
+
+	int32	m_count[IM_FORMAT_CHANNELS_MAX];
+	double	m_history[IM_FILTER_MEAN_MAX * 2][IM_FORMAT_CHANNELS_MAX];	/**< samples of the S32 grid (row i + 16 is row i) */
+	double	m_sum[IM_FORMAT_CHANNELS_MAX];	/**< sum of the last 'count' samples */
+	int32	m_index;
+	int32	m_filled;
+};
+
+/************************************
+ * HIGHPASS & LOWPASS (cascade of first-order sections)
+ ************************************/
+/**
+ * The first-order sections of a channel are paired into biquads, so order 3 is a biquad and a
+ * first-order section. The cascade runs all the channels in the lanes of one vector group per frame.
+ */
+class PassStage : public MotionFilterStage
+{
+public:
+	PassStage(MotionFilter* filter, bool highpass) : MotionFilterStage(filter), m_highpass(highpass)
+	{
+		im_biquad_reset(&m_cascade);
+	}
+
+	virtual void Setup()
+	{
+		// the coefficients are replaced, the state is kept
+		float s1[IM_SIMD_BIQUAD_MAX][IM_FORMAT_CHANNELS_MAX], s2[IM_SIMD_BIQUAD_MAX][IM_FORMAT_CHANNELS_MAX];
+		memcpy(s1, m_cascade.s1, sizeof(s1));
+		memcpy(s2, m_cascade.s2, sizeof(s2));
+		im_biquad_reset(&m_cascade);
+		memcpy(m_cascade.s1, s1, sizeof(s1));
+		memcpy(m_cascade.s2, s2, sizeof(s2));
+
+		for(int32 c=0; c<m_channels; c++) {
+			// HIGHPASS and LOWPASS params have the same layout
+			const IM_FILTER_HIGHPASS_PARAMS* params = (const IM_FILTER_HIGHPASS_PARAMS*)m_filter->GetParam(c);
+			int32 order = params ? MOTION_CLAMP(params->nOrder, 0, IM_FILTER_ORDER_MAX) : 0;
+			IM_FILTER_SECTION sections[IM_FILTER_ORDER_MAX];
+			for(int32 i=0; i<order; i++) {
+				float cutoff = params->fCutoffFrequency[i];
+				if(cutoff <= 0)
+					cutoff = params->fCutoffFrequency[0];
+				if(cutoff <= 0)
+					cutoff = 5;
+				section_setup(&sections[i], cutoff, m_rate, m_highpass);
+			}
+			for(int32 i=0; i * 2 < order; i++) {
+				const IM_FILTER_SECTION* s = &sections[i * 2];
+				float first[3] = { s->b0, s->b1, s->a1 };
+				if(i * 2 + 1 < order) {
+					s = &sections[i * 2 + 1];
+					float second[3] = { s->b0, s->b1, s->a1 };
+					im_biquad_set(&m_cascade, i, c, first, second);
+				}
+				else
+					im_biquad_set(&m_cascade, i, c, first, 0);
+			}
+			if(m_cascade.nSections < (order + 1) / 2)
+				m_cascade.nSections = (order + 1) / 2;
+		}
+	}
+	virtual void Reset()
+	{
+		memset(m_cascade.s1, 0, sizeof(m_cascade.s1));
+		memset(m_cascade.s2, 0, sizeof(m_cascade.s2));
+	}
+	virtual int32 Process(float* data, int32 frames)
+	{
+		if(m_cascade.nSections > 0)
+			im_simd()->biquad(data, frames, m_channels, &m_cascade);
+		return m_channels;
+	}
+
+	bool	m_highpass;
+	IM_SIMD_BIQUAD m_cascade;
+};
+
+/************************************
+ * INTEGRAL
+ ************************************/
+class IntegralStage : public UnrolledStage<IntegralStage>
+{
+public:
+	IntegralStage(MotionFilter* filter) : UnrolledStage<IntegralStage>(filter) { Reset(); }
+
+	virtual void Setup()
+	{
+		for(int32 c=0; c<m_channels; c++) {
+			const IM_FILTER_INTEGRAL_PARAMS* params = (const IM_FILTER_INTEGRAL_PARAMS*)m_filter->GetParam(c);
+			m_order[c] = params ? MOTION_CLAMP(params->nOrder, 0, IM_FILTER_ORDER_MAX) : 0;
+		}
+	}
+	virtual void Reset()
+	{
+		memset(m_sum, 0, sizeof(m_sum));
+	}
+	template<int32 N> int32 Run(float* data, int32 frames)
+	{
+		const int32 channels = N ? N : m_channels;
+		float sum[IM_FORMAT_CHANNELS_MAX][IM_FILTER_ORDER_MAX];
+		memcpy(sum, m_sum, sizeof(float) * IM_FILTER_ORDER_MAX * channels);
+		for(int32 f=0; f<frames; f++) {
+			float* frame = data + f * channels;
+			for(int32 c=0; c<channels; c++) {
+				float x = frame[c];
+				for(int32 i=0; i<m_order[c]; i++) {
+					sum[c][i] += x * m_dt;
+					x = sum[c][i];
+				}
+				frame[c] = x;
+			}
+		}
+		memcpy(m_sum, sum, sizeof(float) * IM_FILTER_ORDER_MAX * channels);
+		return channels;
+	}
+
+	int32	m_order[IM_FORMAT_CHANNELS_MAX];
+	float	m_sum[IM_FORMAT_CHANNELS_MAX][IM_FILTER_ORDER_MAX];
+};
+
+/************************************
+ * TILT (tilt-coordination)
+ ************************************/
+/**
+ * The low-pass of the sustained acceleration, the tilt angle of the gravity and the tilt rate limit of
+ * surge and sway run in one update per frame, so the chain needs no LOWPASS and RATELIMIT for the tilt.
+ */
+class TiltStage : public MotionFilterStage
+{
+public:
+	TiltStage(MotionFilter* filter) : MotionFilterStage(filter)
+	{
+		memset(m_order, 0, sizeof(m_order));
+		memset(m_sections, 0, sizeof(m_sections));
+		Reset();
+	}
+
+	virtual void Setup()
+	{
+		// 90 degree = full scale
+		const float degree_scale = IM_SAMPLE_FULL_SCALE / 90.0f;
+		for(int32 t=0; t<2; t++) {
+			const IM_FILTER_TILT_PARAMS* params = (const IM_FILTER_TILT_PARAMS*)m_filter->GetParam(t);
+			m_order[t] = params ? MOTION_CLAMP(params->nOrder, 0, IM_FILTER_ORDER_MAX) : 0;
+			for(int32 i=0; i<m_order[t]; i++) {
+				IM_FILTER_SECTION section;
+				section_setup(&section, params->fCutoffFrequency > 0 ? params->fCutoffFrequency : 5, m_rate, false);
+				m_sections[t][i].b0 = section.b0; // the state is kept
+				m_sections[t][i].b1 = section.b1;
+				m_sections[t][i].a1 = section.a1;
+			}
+			m_threshold[t] = params ? MOTION_MAX(params->fThreshold, 0.0f) : 0;
+			m_rate_max[t] = (params && params->fRateMax > 0) ? params->fRateMax * m_dt * degree_scale : INFINITY;
+			m_angle_max[t] = (params && params->fAngleMax > 0) ? MOTION_MIN(params->fAngleMax, 90.0f) * degree_scale : IM_SAMPLE_FULL_SCALE;
+		}
+	}
+	virtual void Reset()
+	{
+		for(int32 t=0; t<2; t++) {
+			for(int32 i=0; i<IM_FILTER_ORDER_MAX; i++)
+				m_sections[t][i].x1 = m_sections[t][i].y1 = 0;
+		}
+		memset(m_angle, 0, sizeof(m_angle));
+	}
+	virtual int32 Process(float* data, int32 frames)
+	{
+		if(m_channels <= IM_DOF_PITCH)
+			return m_channels; // needs surge, sway, roll and pitch
+
+		// specific force of the gravity : tilt angle = asin(a/g), 1g = full scale, 90 degree = full scale
+		const float angle_scale = (float)(2.0 / IM_PI) * IM_SAMPLE_FULL_SCALE;
+		static const int32 s_target[2] = { IM_DOF_PITCH, IM_DOF_ROLL };
+		static const float s_sign[2] = { 1.0f, -1.0f };
+		// the state of the paths stays in registers over the frames
+		IM_FILTER_SECTION sections[2][IM_FILTER_ORDER_MAX];
+		float last[2] = { m_angle[0], m_angle[1] };
+		memcpy(sections, m_sections, sizeof(sections));
+		for(int32 f=0; f<frames; f++) {
+			float* frame = data + f * m_channels;
+			for(int32 t=0; t<2; t++) {
+				float force = frame[t];
+				for(int32 i=0; i<m_order[t]; i++)
+					force = section_process(&sections[t][i], force);
+				float sustained = MOTION_MAX(fabsf(force) - m_threshold[t], 0.0f) / IM_SAMPLE_FULL_SCALE;
+				float angle = MOTION_MIN((float)asin(MOTION_MIN(sustained, 1.0f)) * angle_scale, m_angle_max[t]);
+				angle = (force < 0) ? -angle : angle;
+				last[t] = MOTION_CLAMP(angle, last[t] - m_rate_max[t], last[t] + m_rate_max[t]);
+				frame[s_target[t]] += s_sign[t] * last[t];
+				frame[t] = 0;
+			}
+		}
+		memcpy(m_sections, sections, sizeof(sections));
+		m_angle[0] = last[0];
+		m_angle[1] = last[1];
+		return m_channels;
+	}
+
+	int32	m_order[2];				/**< low-pass sections of surge and sway */
+	IM_FILTER_SECTION m_sections[2][IM_FILTER_ORDER_MAX];
+	float	m_threshold[2];
+	float	m_rate_max[2];			/**< per frame (working range) */
+	float	m_angle_max[2];			/**< (working range) */
+	float	m_angle[2];				/**< last tilt angle (working range) */
+};
+
+/************************************
+ * SCALE, OFFSET & LIMIT (vector kernels of InnoML_simd.h)
+ ************************************/
+class ScaleStage : public MotionFilterStage
+{
+public:
+	ScaleStage(MotionFilter* filter) : MotionFilterStage(filter) {}
+
+	virtual void Setup()
+	{
+		for(int32 c=0; c<m_channels; c++) {
+			const IM_FILTER_SCALE_PARAMS* params = (const IM_FILTER_SCALE_PARAMS*)m_filter->GetParam(c);
+			m_scale[c] = params ? params->fScaleFactor : 1.0f;
+		}
+	}
+	virtual int32 Process(float* data, int32 frames)
+	{
+		im_simd()->scale(data, frames, m_channels, m_scale);
+		return m_channels;
+	}
+
+	float	m_scale[IM_FORMAT_CHANNELS_MAX];
+};
+
+class OffsetStage : public MotionFilterStage
+{
+public:
+	OffsetStage(MotionFilter* filter) : MotionFilterStage(filter) {}
+
+	virtual void Setup()
+	{
+		for(int32 c=0; c<m_channels; c++) {
+			const IM_FILTER_OFFSET_PARAMS* params = (const IM_FILTER_OFFSET_PARAMS*)m_filter->GetParam(c);
+			m_offset[c] = params ? params->fOffset : 0.0f;
+		}
+	}
+	virtual int32 Process(float* data, int32 frames)
+	{
+		im_simd()->offset(data, frames, m_channels, m_offset);
+		return m_channels;
+	}
+
+	float	m_offset[IM_FORMAT_CHANNELS_MAX];
+};
+
+class LimitStage : public MotionFilterStage
+{
+public:
+	LimitStage(MotionFilter* filter) : MotionFilterStage(filter) {}
+
+	virtual void Setup()
+	{
+		for(int32 c=0; c<m_channels; c++) {
+			const IM_FILTER_LIMIT_PARAMS* params = (const IM_FILTER_LIMIT_PARAMS*)m_filter->GetParam(c);
+			m_min[c] = params ? (float)params->nMin : IM_SAMPLE_MIN;
+			m_max[c] = params ? (float)params->nMax : IM_SAMPLE_MAX;
+		}
+	}
+	virtual int32 Process(float* data, int32 frames)
+	{
+		im_simd()->limit(data, frames, m_channels, m_min, m_max);
+		return m_channels;
+	}
+
+	float	m_min[IM_FORMAT_CHANNELS_MAX];
+	float	m_max[IM_FORMAT_CHANNELS_MAX];
+};
+
+/************************************
+ * RATELIMIT
+ ************************************/
+/**
+ * The rate of a channel is bounded by the movement per sample at the sample rate of the build.
+ * (A bypassed channel has an infinite bound, so the kernel clamps all the channels with one operation.)
+ */
+class RateLimitStage : public MotionFilterStage
+{
+public:
+	RateLimitStage(MotionFilter* filter) : MotionFilterStage(filter) { Reset(); }
+
+	virtual void Setup()
+	{
+		const float msec = m_dt * 1000.0f;
+		for(int32 c=0; c<IM_FORMAT_CHANNELS_MAX; c++) {
+			const IM_FILTER_RATELIMIT_PARAMS* params = (c < m_channels) ? (const IM_FILTER_RATELIMIT_PARAMS*)m_filter->GetParam(c) : 0;
+			int32 rate_max = params ? MOTION_CLAMP(params->nRateMax, 0, MOTION_MAX_16) : 0;
+			m_bound[c] = (rate_max > 0) ? rate_max * msec : INFINITY; // movement per sample
+		}
+	}
+	virtual void Reset()
+	{
+		memset(m_last, 0, sizeof(m_last));
+	}
+	virtual int32 Process(float* data, int32 frames)
+	{
+		im_simd()->ratelimit(data, frames, m_channels, m_bound, m_last);
+		return m_channels;
+	}
+
+	float	m_bound[IM_FORMAT_CHANNELS_MAX];	/**< INFINITY : bypass */
+	float	m_last[IM_FORMAT_CHANNELS_MAX];
+};
+
+/************************************
+ * WASHOUT (classical washout, high-pass of each DOF)
+ ************************************/
+class WashoutStage : public UnrolledStage<WashoutStage>
+{
+public:
+	WashoutStage(MotionFilter* filter) : UnrolledStage<WashoutStage>(filter)
+	{
+		memset(m_bypass, 0, sizeof(m_bypass));
+		memset(m_sections, 0, sizeof(m_sections));
+	}
+
+	virtual void Setup()
+	{
+		for(int32 c=0; c<m_channels; c++) {
+			const IM_FILTER_WASHOUT_PARAMS* params = (const IM_FILTER_WASHOUT_PARAMS*)m_filter->GetParam(c);
+			m_bypass[c] = (params == 0 || params->fCutoffFrequency <= 0);
+			if(m_bypass[c])
+				continue;
+			section_setup(&m_sections[c][0], params->fCutoffFrequency, m_rate, true);
+			section_setup(&m_sections[c][1], params->fCutoffFrequency, m_rate, true);
+		}
+	}
+	virtual void Reset()
+	{
+		for(int32 c=0; c<IM_FORMAT_CHANNELS_MAX; c++) {
+			m_sections[c][0].x1 = m_sections[c][0].y1 = 0;
+			m_sections[c][1].x1 = m_sections[c][1].y1 = 0;
+		}
+	}
+	template<int32 N> int32 Run(float* data, int32 frames)
+	{
+		const int32 channels = N ? N : m_channels;
+		IM_FILTER_SECTION sections[IM_FORMAT_CHANNELS_MAX][2];
+		memcpy(sections, m_sections, sizeof(IM_FILTER_SECTION) * 2 * channels);
+		for(int32 f=0; f<frames; f++) {
+			float* frame = data + f * channels;
+			for(int32 c=0; c<channels; c++) {
+				if(m_bypass[c])
+					continue;
+				frame[c] = section_process(&sections[c][1], section_process(&sections[c][0], frame[c]));
+			}
+		}
+		memcpy(m_sections, sections, sizeof(IM_FILTER_SECTION) * 2 * channels);
+		return channels;
+	}
+
+	bool	m_bypass[IM_FORMAT_CHANNELS_MAX];
+	IM_FILTER_SECTION m_sections[IM_FORMAT_CHANNELS_MAX][2];
+};
+
+/************************************
+ * CLASSIC (classical washout)
+ ************************************/
+/**
+ * The onset cue of a channel (high-pass and integrals) is one biquad cascade, and surge and sway have
+ * a low-pass cascade of the tilt path, whose angle is added to pitch and roll (IM_FILTER_TILT).
+ * (The coefficients are discretized at build time and all the channels run in one kernel pass.
+ *  The high-pass sections are paired together and the integrals are one exact biquad (poles at z = 1),
+ *  so a high-pass zero is never paired with an integral pole.)
+ */
+class ClassicStage : public MotionFilterStage
+{
+public:
+	ClassicStage(MotionFilter* filter) : MotionFilterStage(filter)
+	{
+		im_biquad_reset(&m_main);
+		im_biquad_reset(&m_tilt);
+		memset(m_cue, 0, sizeof(m_cue));
+		memset(m_tilted, 0, sizeof(m_tilted));
+	}
+
+	virtual void Setup()
+	{
+		// the coefficients are replaced, the state is kept
+		IM_SIMD_BIQUAD main = m_main, tilt = m_tilt;
+		im_biquad_reset(&m_main);
+		im_biquad_reset(&m_tilt);
+		memcpy(m_main.s1, main.s1, sizeof(main.s1));
+		memcpy(m_main.s2, main.s2, sizeof(main.s2));
+		memcpy(m_tilt.s1, tilt.s1, sizeof(tilt.s1));
+		memcpy(m_tilt.s2, tilt.s2, sizeof(tilt.s2));
+
+		for(int32 c=0; c<m_channels; c++) {
+			const IM_FILTER_CLASSIC_PARAMS* params = (const IM_FILTER_CLASSIC_PARAMS*)m_filter->GetParam(c);
+			int32 order = params ? MOTION_CLAMP(params->nHighpassOrder, 0, IM_FILTER_ORDER_MAX) : 0;
+			int32 sections = SetCascade(&m_main, c, order, params ? params->fHighpassCutoff : 0, true);
+			int32 integrals = params ? MOTION_CLAMP(params->nIntegralOrder, 0, 2) : 0;
+			if(integrals > 0) {
+				// y = dt*x + s, s = y
+				float integral[3] = { m_dt, 0, -1.0f };
+				im_biquad_set(&m_main, sections++, c, integral, (integrals > 1) ? integral : 0);
+			}
+			if(m_main.nSections < sections)
+				m_main.nSections = sections;
+
+			// tilt path (surge and sway)
+			int32 tilt = (params && c < 2 && m_channels > IM_DOF_PITCH) ? MOTION_CLAMP(params->nTiltOrder, 0, IM_FILTER_ORDER_MAX) : 0;
+			if(c < 2) {
+				int32 tilt_sections = SetCascade(&m_tilt, c, tilt, params ? params->fTiltCutoff : 0, false);
+				if(m_tilt.nSections < tilt_sections)
+					m_tilt.nSections = tilt_sections;
+				m_tilted[c] = (tilt > 0);
+			}
+			m_cue[c] = (order > 0 || integrals > 0 || tilt == 0);
+		}
+	}
+	virtual void Reset()
+	{
+		memset(m_main.s1, 0, sizeof(m_main.s1));
+		memset(m_main.s2, 0, sizeof(m_main.s2));
+		memset(m_tilt.s1, 0, sizeof(m_tilt.s1));
+		memset(m_tilt.s2, 0, sizeof(m_tilt.s2));
+	}
+	virtual int32 Process(float* data, int32 frames)
+	{
+		// specific force of the gravity : tilt angle = asin(a/g), 1g = full scale, 90 degree = full scale
+		const float angle_scale = (float)(2.0 / IM_PI) * IM_SAMPLE_FULL_SCALE;
+		const bool tilt = m_tilt.nSections > 0;
+		if(tilt) {
+			m_force.resize(frames * 2);
+			for(int32 f=0; f<frames; f++) {
+				m_force[f * 2 + IM_DOF_SURGE] = data[f * m_channels + IM_DOF_SURGE];
+				m_force[f * 2 + IM_DOF_SWAY] = data[f * m_channels + IM_DOF_SWAY];
+			}
+			im_simd()->biquad(&m_force[0], frames, 2, &m_tilt);
+		}
+		if(m_main.nSections > 0)
+			im_simd()->biquad(data, frames, m_channels, &m_main);
+		if(!tilt && m_cue[IM_DOF_SURGE] && m_cue[IM_DOF_SWAY])
+			return m_channels;
+
+		for(int32 f=0; f<frames; f++) {
+			float* frame = data + f * m_channels;
+			for(int32 c=0; c<2 && c<m_channels; c++) {
+				if(!m_cue[c])
+					frame[c] = 0;
+			}
+			if(!tilt)
+				continue;
+			float surge = MOTION_CLAMP(m_force[f * 2 + IM_DOF_SURGE] / IM_SAMPLE_FULL_SCALE, -1.0f, 1.0f);
+			float sway = MOTION_CLAMP(m_force[f * 2 + IM_DOF_SWAY] / IM_SAMPLE_FULL_SCALE, -1.0f, 1.0f);
+			if(m_tilted[IM_DOF_SURGE])
+				frame[IM_DOF_PITCH] += (float)asin(surge) * angle_scale;
+			if(m_tilted[IM_DOF_SWAY])
+				frame[IM_DOF_ROLL] += (float)asin(-sway) * angle_scale;
+		}
+		return m_channels;
+	}
+
+	/**
+	 * This function sets the first-order sections of a channel as biquads from the first section. (sections used)
+	 */
+	int32 SetCascade(IM_SIMD_BIQUAD* cascade, int32 channel, int32 order, float cutoff, bool highpass)
+	{
+		IM_FILTER_SECTION section;
+		section_setup(&section, cutoff > 0 ? cutoff : 5, m_rate, highpass);
+		float first[3] = { section.b0, section.b1, section.a1 };
+		for(int32 i=0; i * 2 < order; i++)
+			im_biquad_set(cascade, i, channel, first, (i * 2 + 1 < order) ? first : 0);
+		return (order + 1) / 2;
+	}
+
+	IM_SIMD_BIQUAD m_main;			/**< onset cue of the channels */
+	IM_SIMD_BIQUAD m_tilt;			/**< tilt low-pass of surge and sway */
+	bool	m_cue[IM_FORMAT_CHANNELS_MAX];	/**< false : the channel is only the tilt path (0) */
+	bool	m_tilted[2];
+	std::vector<float> m_force;		/**< tilt paths of surge and sway */
+};
+
+/************************************
+ * KINEMATICS (6-6 stewart platform, inverse kinematics)
+ ************************************/
+typedef struct {
+	int32	nVersion;
+	float	fBaseRadius;		/**< mm */
+	float	fPlatformRadius;	/**< mm */
+	float	fHeight;			/**< neutral height (mm) */
+	float	fStroke;			/**< actuator stroke (mm) */
+	float	fAngleMax;			/**< full scale rotation (degree) */
+} IM_KINEMATICS_GEOMETRY;
+
+static const IM_KINEMATICS_GEOMETRY s_geometry[] = {
+	{ 700, 350, 250, 600, 150, 15 },
+	{ 800, 400, 300, 650, 200, 18 },
+	{ 1000, 500, 380, 750, 250, 20 },
+};
+
+#define IM_KINEMATICS_BLOCK		64		/**< poses of a kernel call */
+#define IM_KINEMATICS_ITERATIONS	8		/**< newton iterations of the forward kinematics */
+#define IM_KINEMATICS_TOLERANCE		0.01	/**< step of a converged pose (working range) */
+
+MotionKinematics::MotionKinematics() : m_version(IM_FAIL)
+{
+	memset(&m_kinematics, 0, sizeof(m_kinematics));
+	memset(m_scale, 0, sizeof(m_scale));
+	memset(m_command, 0, sizeof(m_command));
+	memset(m_pose, 0, sizeof(m_pose));
+}
+
+void MotionKinematics::Setup(int32 version)
+{
+	const IM_KINEMATICS_GEOMETRY* geometry = &s_geometry[0];
+	for(size_t i=0; i<sizeof(s_geometry)/sizeof(s_geometry[0]); i++) {
+		if(s_geometry[i].nVersion == version)
+			geometry = &s_geometry[i];
+	}
+	m_version = version;
+	IM_SIMD_KINEMATICS* k = &m_kinematics;
+	for(int32 i=0; i<IM_DOF_COUNT; i++) {
+		// joint pairs around 0, 120 and 240 degree
+		double angle = (i >> 1) * 120.0;
+		double sign = (i & 1) ? 1.0 : -1.0;
+		double base = (angle + sign * 15.0) * IM_PI / 180.0;
+		double platform = (angle + sign * 45.0) * IM_PI / 180.0;
+		k->fBase[0][i] = (float)(geometry->fBaseRadius * cos(base));
+		k->fBase[1][i] = (float)(geometry->fBaseRadius * sin(base));
+		k->fPlatform[0][i] = (float)(geometry->fPlatformRadius * cos(platform));
+		k->fPlatform[1][i] = (float)(geometry->fPlatformRadius * sin(platform));
+		k->fNeutral[i] = 0;
+	}
+	k->fHeight = geometry->fHeight;
+	k->fLengthScale = 1.0f;
+	for(int32 i=0; i<IM_DOF_COUNT; i++)
+		m_scale[i] = (i < IM_DOF_ROLL) ? (geometry->fStroke * 0.5f) / IM_SAMPLE_FULL_SCALE : (float)(geometry->fAngleMax * IM_PI / 180.0) / IM_SAMPLE_FULL_SCALE;
+
+	// actuator lengths of the neutral pose
+	float neutral[IM_DOF_COUNT] = {0,}, length[IM_DOF_COUNT];
+	im_simd()->kinematics(k, neutral, length, 1, 1);
+	memcpy(k->fNeutral, length, sizeof(length));
+	k->fLengthScale = IM_SAMPLE_FULL_SCALE / (geometry->fStroke * 0.5f);
+	Reset();
+}
+
+void MotionKinematics::Reset()
+{
+	memset(m_command, 0, sizeof(m_command));
+	memset(m_pose, 0, sizeof(m_pose));
+}
+
+/**
+ * Gaussian elimination with partial pivoting of the augmented matrix. (the solution replaces the last column)
+ */
+static bool im_kinematics_eliminate(double m[IM_DOF_COUNT][IM_DOF_COUNT + 1])
+{
+	for(int32 c=0; c<IM_DOF_COUNT; c++) {
+		int32 pivot = c;
+		for(int32 r=c+1; r<IM_DOF_COUNT; r++) {
+			if(fabs(m[r][c]) > fabs(m[pivot][c]))
+				pivot = r;
+		}
+		if(fabs(m[pivot][c]) < 1e-12)
+			return false; // singular pose
+		if(pivot != c) {
+			for(int32 k=c; k<=IM_DOF_COUNT; k++) {
+				double t = m[c][k];
+				m[c][k] = m[pivot][k];
+				m[pivot][k] = t;
+			}
+		}
+		for(int32 r=c+1; r<IM_DOF_COUNT; r++) {
+			double f = m[r][c] / m[c][c];
+			for(int32 k=c; k<=IM_DOF_COUNT; k++)
+				m[r][k] -= f * m[c][k];
+		}
+	}
+	for(int32 r=IM_DOF_COUNT-1; r>=0; r--) {
+		double x = m[r][IM_DOF_COUNT];
+		for(int32 k=r+1; k<IM_DOF_COUNT; k++)
+			x -= m[r][k] * m[k][IM_DOF_COUNT];
+		m[r][IM_DOF_COUNT] = x / m[r][r];
+	}
+	return true;
+}
+
+/**
+ * The leg length l = |R p + t - b| gives dl/dt = n (unit leg vector) and dl/dw = (R p) x n for the angular
+ * velocity w, and the euler rates of R = Rz(yaw) * Ry(pitch) * Rx(roll) turn around Rz Ry x, Rz y and z.
+ */
+int32 MotionKinematics::Solve(const float* axis, float* pose)
+{
+	const IM_SIMD_KINEMATICS* k = &m_kinematics;
+	double* x = m_pose;
+	double length[IM_DOF_COUNT];
+	for(int32 i=0; i<IM_DOF_COUNT; i++)
+		length[i] = k->fNeutral[i] + (double)axis[i] / k->fLengthScale;
+
+	int32 iterations = 0;
+	bool converged = false;
+	while(!converged && iterations < IM_KINEMATICS_ITERATIONS) {
+		iterations++;
+		double sr = sin(x[IM_DOF_ROLL]), cr = cos(x[IM_DOF_ROLL]);
+		double sp = sin(x[IM_DOF_PITCH]), cp = cos(x[IM_DOF_PITCH]);
+		double sy = sin(x[IM_DOF_YAW]), cy = cos(x[IM_DOF_YAW]);
+		const double r[3][2] = {
+			{ cy*cp, cy*sp*sr - sy*cr },
+			{ sy*cp, sy*sp*sr + cy*cr },
+			{ -sp,   cp*sr },
+		};
+		const double e[3][3] = { { cy*cp, sy*cp, -sp }, { -sy, cy, 0 }, { 0, 0, 1 } }; // roll, pitch, yaw
+		double m[IM_DOF_COUNT][IM_DOF_COUNT + 1];
+		for(int32 i=0; i<IM_DOF_COUNT; i++) {
+			double p[3], d[3], w[3];
+			for(int32 j=0; j<3; j++)
+				p[j] = r[j][0] * k->fPlatform[0][i] + r[j][1] * k->fPlatform[1][i];
+			d[0] = p[0] + x[IM_DOF_SURGE] - k->fBase[0][i];
+			d[1] = p[1] + x[IM_DOF_SWAY] - k->fBase[1][i];
+			d[2] = p[2] + x[IM_DOF_HEAVE] + k->fHeight;
+			double l = sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+			for(int32 j=0; j<3; j++)
+				m[i][j] = d[j] / l;
+			w[0] = p[1]*m[i][2] - p[2]*m[i][1];
+			w[1] = p[2]*m[i][0] - p[0]*m[i][2];
+			w[2] = p[0]*m[i][1] - p[1]*m[i][0];
+			for(int32 j=0; j<3; j++)
+				m[i][IM_DOF_ROLL + j] = w[0]*e[j][0] + w[1]*e[j][1] + w[2]*e[j][2];
+			m[i][IM_DOF_COUNT] = length[i] - l;
+		}
+		if(!im_kinematics_eliminate(m))
+			break;
+		double step = 0;
+		for(int32 i=0; i<IM_DOF_COUNT; i++) {
+			x[i] += m[i][IM_DOF_COUNT];
+			step = MOTION_MAX(step, fabs(m[i][IM_DOF_COUNT] / m_scale[i]));
+		}
+		converged = step < IM_KINEMATICS_TOLERANCE;
+	}
+	for(int32 i=0; i<IM_DOF_COUNT; i++)
+		pose[i] = (float)(x[i] / m_scale[i]);
+	if(!converged) {
+		memset(m_pose, 0, sizeof(m_pose)); // the next solve starts from the neutral pose
+		return IM_FAIL;
+	}
+	return iterations;
+}
+
+/**
+ * The poses of a block are transposed to structure of arrays and solved by the kinematics kernel,
+ * so the trigonometry and the square roots of the poses run in the lanes of the vectors.
+ */
+class KinematicsStage : public MotionFilterStage
+{
+public:
+	KinematicsStage(MotionFilter* filter) : MotionFilterStage(filter) {}
+
+	virtual bool Build(IM_FORMAT* format, const IM_FORMAT* dst)
+	{
+		if(format->nChannels != IM_FORMAT_CHANNELS_DEFAULT && format->nChannels < IM_DOF_COUNT)
+			return false;
+		MotionFilterStage::Build(format, dst);
+		im_channel_map(m_channels, IM_DOF_COUNT, m_map);
+		im_format_set(format, IM_FORMAT_TYPE_AXIS, format->nSampleRate, IM_DOF_COUNT, format->nDataFormat);
+		return true;
+	}
+	virtual void Setup()
+	{
+		const IM_FILTER_KINEMATICS_PARAMS* params = (const IM_FILTER_KINEMATICS_PARAMS*)m_filter->GetParam(0);
+		m_platform.Setup(params ? params->nVersion : 0);
+	}
+	virtual void Reset()
+	{
+		m_platform.Reset();
+	}
+	virtual const MotionKinematics* GetKinematics() const
+	{
+		return &m_platform;
+	}
+	virtual int32 Process(float* data, int32 frames)
+	{
+		const float* scale = m_platform.m_scale;
+		if(frames > 0) {
+			const float* frame = data + (frames - 1) * m_channels;
+			for(int32 i=0; i<IM_DOF_COUNT; i++)
+				m_platform.m_command[i] = (m_map[i] >= 0) ? frame[m_map[i]] : 0.0f;
+		}
+		// in place : 3 channels are expanded to 6 axes from the last block, 6~8 channels are packed from the first block
+		const int32 blocks = (frames + IM_KINEMATICS_BLOCK - 1) / IM_KINEMATICS_BLOCK;
+		for(int32 b=0; b<blocks; b++) {
+			const int32 first = ((m_channels < IM_DOF_COUNT) ? blocks - 1 - b : b) * IM_KINEMATICS_BLOCK;
+			const int32 count = MOTION_MIN(frames - first, IM_KINEMATICS_BLOCK);
+			for(int32 f=0; f<count; f++) {
+				const float* frame = data + (first + f) * m_channels;
+				for(int32 i=0; i<IM_DOF_COUNT; i++)
+					m_pose[i][f] = (m_map[i] >= 0) ? frame[m_map[i]] * scale[i] : 0.0f;
+			}
+			im_simd()->kinematics(&m_platform.m_kinematics, m_pose[0], m_axis[0], count, IM_KINEMATICS_BLOCK);
+			for(int32 f=0; f<count; f++) {
+				float* axis = data + (first + f) * IM_DOF_COUNT;
+				for(int32 i=0; i<IM_DOF_COUNT; i++)
+					axis[i] = m_axis[i][f];
+			}
+		}
+		return IM_DOF_COUNT;
+	}
+
+	int32	m_map[IM_DOF_COUNT];
+	MotionKinematics m_platform;
+	float	m_pose[IM_DOF_COUNT][IM_KINEMATICS_BLOCK];	/**< poses of a block (structure of arrays) */
+	float	m_axis[IM_DOF_COUNT][IM_KINEMATICS_BLOCK];
+};
+
+/************************************
+ * FORMAT, CHANNEL & COMBINE
+ ************************************/
+class FormatStage : public MotionFilterStage
+{
+public:
+	FormatStage(MotionFilter* filter) : MotionFilterStage(filter) {}
+
+	virtual bool Build(IM_FORMAT* format, const IM_FORMAT* dst)
+	{
+		const IM_FILTER_FORMAT_PARAMS* params = (const IM_FILTER_FORMAT_PARAMS*)m_filter->GetParam(0);
+		if(params == 0 || !im_format_is_valid(params->nDataFormat))
+			return false;
+		MotionFilterStage::Build(format, dst);
+		im_format_set(format, format->nType, format->nSampleRate, format->nChannels, params->nDataFormat);
+		return true;
+	}
+	virtual int32 Process(float* data, int32 frames)
+	{
+		return m_channels; // the working range is the same for all formats
+	}
+};
+
+class ChannelStage : public MotionFilterStage
+{
+public:
+	ChannelStage(MotionFilter* filter, bool combine) : MotionFilterStage(filter), m_combine(combine) {}
+
+	virtual void Setup()
+	{
+		for(int32 c=0; c<m_channels; c++) {
+			m_axis1[c] = c;
+			m_axis2[c] = -1;
+			if(m_combine) {
+				const IM_FILTER_COMBINE_PARAMS* params = (const IM_FILTER_COMBINE_PARAMS*)m_filter->GetParam(c);
+				if(params) {
+					m_axis1[c] = params->nAxis1 - 1;
+					m_axis2[c] = params->nAxis2 - 1;
+				}
+			}
+			else {
+				const IM_FILTER_CHANNEL_PARAMS* params = (const IM_FILTER_CHANNEL_PARAMS*)m_filter->GetParam(c);
+				if(params)
+					m_axis1[c] = params->nAxis - 1;
+			}
+		}
+	}
+	virtual int32 Process(float* data, int32 frames)
+	{
+		float frame[IM_FORMAT_CHANNELS_MAX];
+		for(int32 f=0; f<frames; f++) {
+			float* out = data + f * m_channels;
+			memcpy(frame, out, sizeof(float) * m_channels);
+			for(int32 c=0; c<m_channels; c++) {
+				float value = (m_axis1[c] >= 0 && m_axis1[c] < m_channels) ? frame[m_axis1[c]] : 0.0f;
+				if(m_axis2[c] >= 0 && m_axis2[c] < m_channels)
+					value += frame[m_axis2[c]];
+				out[c] = value;
+			}
+		}
+		return m_channels;
+	}
+
+	bool	m_combine;
+	int32	m_axis1[IM_FORMAT_CHANNELS_MAX];	/**< source channel (0-based) */
+	int32	m_axis2[IM_FORMAT_CHANNELS_MAX];	/**< second source channel of COMBINE or -1 */
+};
+
+/************************************
+ * RESAMPLE (params of the stream converter)
+ ************************************/
+class ResampleStage : public MotionFilterStage
+{
+public:
+	ResampleStage(MotionFilter* filter) : MotionFilterStage(filter) {}
+
+	virtual int32 Process(float* data, int32 frames)
+	{
+		return m_channels; // rate conversion is done by the stream converter
+	}
+};
+
+/************************************
+ * CUSTOM (user filter function)
+ ************************************/
+class CustomStage : public MotionFilterStage
+{
+public:
+	CustomStage(MotionFilter* filter) : MotionFilterStage(filter) {}
+
+	virtual bool Build(IM_FORMAT* format, const IM_FORMAT* dst)
+	{
+		MotionFilterStage::Build(format, dst);
+		m_src = *format;
+		m_dst = *dst;
+		if(m_filter->m_processor(m_filter->m_processor_obj, 0, 0, format, dst) == 0)
+			return false;
+		if(format->nChannels < 1 || format->nChannels > IM_FORMAT_CHANNELS_MAX || !im_format_is_valid(format->nDataFormat))
+			return false;
+		im_format_set(format, format->nType, format->nSampleRate, format->nChannels, format->nDataFormat);
+		return true;
+	}
+	virtual int32 Process(float* data, int32 frames)
+	{
+		IM_FORMAT format = m_src;
+		m_stream.resize(frames * IM_FORMAT_CHANNELS_MAX * sizeof(double));
+		im_frames_store(data, &m_stream[0], &m_src, frames);
+		m_filter->m_processor(m_filter->m_processor_obj, &m_stream[0], frames * m_src.nBlockAlign, &format, &m_dst);
+		if(format.nChannels < 1 || format.nChannels > IM_FORMAT_CHANNELS_MAX)
+			format.nChannels = m_src.nChannels;
+		im_frames_load(&m_stream[0], &format, data, frames);
+		return format.nChannels;
+	}
+	virtual bool IsFusable() const
+	{
+		return false; // the user function gets the whole buffer
+	}
+
+	IM_FORMAT	m_src;
+	IM_FORMAT	m_dst;
+	std::vector<uint8> m_stream;
+};
+
+MotionFilterStage* im_filter_create_stage(MotionFilter* filter)
+{
+	switch(filter->m_type) {
+	case IM_FILTER_NOISE:		return new NoiseStage(filter);
+	case IM_FILTER_MEAN:		return new MeanStage(filter);
+	case IM_FILTER_HIGHPASS:	return new PassStage(filter, true);
+	case IM_FILTER_LOWPASS:		return new PassStage(filter, false);
+	case IM_FILTER_INTEGRAL:	return new IntegralStage(filter);
+	case IM_FILTER_TILT:		return new TiltStage(filter);
+	case IM_FILTER_SCALE:		return new ScaleStage(filter);
+	case IM_FILTER_OFFSET:		return new OffsetStage(filter);
+	case IM_FILTER_COMBINE:		return new ChannelStage(filter, true);
+	case IM_FILTER_LIMIT:		return new LimitStage(filter);
+	case IM_FILTER_RATELIMIT:	return new RateLimitStage(filter);
+	case IM_FILTER_WASHOUT:		return new WashoutStage(filter);
+	case IM_FILTER_KINEMATICS:	return new KinematicsStage(filter);
+	case IM_FILTER_FORMAT:		return new FormatStage(filter);
+	case IM_FILTER_CHANNEL:		return new ChannelStage(filter, false);
+	case IM_FILTER_RESAMPLE:	return new ResampleStage(filter);
+	case IM_FILTER_CUSTOM:		return new CustomStage(filter);
+	case IM_FILTER_CLASSIC:		return new ClassicStage(filter);
+	default:
+		break;
+	}
+	return 0;
+}
@@ -0,0 +1,412 @@
+/********************************************************************************//**
+\file      InnoML_simd.cpp
+\brief     Scalar and SSE2 kernels of the built-in filters, and the run time selection.
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#include "InnoML_simd.h"
+#include <math.h>		// for lrintf, sqrtf
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	define IM_SIMD_HAS_SSE2
+#	include <emmintrin.h>
+#endif
+#if defined(_MSC_VER)
+#	include <intrin.h>
+#endif
+
+#if defined(INNO_ML_SIMD_AVX2)
+extern const IM_SIMD_KERNELS g_im_simd_avx2;	/**< InnoML_simd_avx2.cpp */
+#endif
+
+/************************************
+ * Scalar (reference)
+ ************************************/
+static void scalar_scale(float* data, int32 frames, int32 channels, const float* scale)
+{
+	for(int32 f=0; f<frames; f++) {
+		float* frame = data + f * channels;
+		for(int32 c=0; c<channels; c++)
+			frame[c] *= scale[c];
+	}
+}
+
+static void scalar_offset(float* data, int32 frames, int32 channels, const float* offset)
+{
+	for(int32 f=0; f<frames; f++) {
+		float* frame = data + f * channels;
+		for(int32 c=0; c<channels; c++)
+			frame[c] += offset[c];
+	}
+}
+
+static void scalar_limit(float* data, int32 frames, int32 channels, const float* min, const float* max)
+{
+	for(int32 f=0; f<frames; f++) {
+		float* frame = data + f * channels;
+		for(int32 c=0; c<channels; c++)
+			frame[c] = MOTION_CLAMP(frame[c], min[c], max[c]);
+	}
+}
+
+static void scalar_biquad(float* data, int32 frames, int32 channels, IM_SIMD_BIQUAD* q)
+{
+	float s1[IM_SIMD_BIQUAD_MAX][IM_FORMAT_CHANNELS_MAX];
+	float s2[IM_SIMD_BIQUAD_MAX][IM_FORMAT_CHANNELS_MAX];
+	memcpy(s1, q->s1, sizeof(s1));
+	memcpy(s2, q->s2, sizeof(s2));
+	for(int32 f=0; f<frames; f++) {
+		float* frame = data + f * channels;
+		for(int32 i=0; i<q->nSections; i++) {
+			for(int32 c=0; c<channels; c++) {
+				float x = frame[c];
+				float y = q->b0[i][c] * x + s1[i][c];
+				s1[i][c] = (q->b1[i][c] * x - q->a1[i][c] * y) + s2[i][c];
+				s2[i][c] = q->b2[i][c] * x - q->a2[i][c] * y;
+				frame[c] = y;
+			}
+		}
+	}
+	memcpy(q->s1, s1, sizeof(s1));
+	memcpy(q->s2, s2, sizeof(s2));
+}
+
+static void scalar_mix(float* acc, const float* src, int32 count, float gain)
+{
+	for(int32 i=0; i<count; i++)
+		acc[i] += src[i] * gain;
+}
+
+static void scalar_ratelimit(float* data, int32 frames, int32 channels, const float* bound, float* last)
+{
+	float prev[IM_FORMAT_CHANNELS_MAX];
+	memcpy(prev, last, sizeof(float) * channels);
+	for(int32 f=0; f<frames; f++) {
+		float* frame = data + f * channels;
+		for(int32 c=0; c<channels; c++) {
+			float x = frame[c];
+			float delta = x - prev[c];
+			if(delta > bound[c])
+				x = prev[c] + bound[c];
+			else if(delta < -bound[c])
+				x = prev[c] - bound[c];
+			frame[c] = prev[c] = x;
+		}
+	}
+	memcpy(last, prev, sizeof(float) * channels);
+}
+
+/**
+ * sin and cos of the kinematics, with the same operations as the vector levels. (not sinf and cosf)
+ */
+static inline void scalar_sincos(float x, float* s, float* c)
+{
+	int32 k = (int32)lrintf(x * IM_SIMD_2_PI);
+	float kf = (float)k;
+	float r = ((x - kf * IM_SIMD_PI_2A) - kf * IM_SIMD_PI_2B) - kf * IM_SIMD_PI_2C;
+	float z = r * r;
+	float ps = ((IM_SIMD_SIN1 * z + IM_SIMD_SIN2) * z + IM_SIMD_SIN3) * z * r + r;
+	float pc = ((IM_SIMD_COS1 * z + IM_SIMD_COS2) * z + IM_SIMD_COS3) * z * z - 0.5f * z + 1.0f;
+	*s = (k & 1) ? pc : ps;
+	*c = (k & 1) ? ps : pc;
+	if(k & 2)
+		*s = -*s;
+	if((k + 1) & 2)
+		*c = -*c;
+}
+
+static void scalar_kinematics(const IM_SIMD_KINEMATICS* k, const float* pose, float* axis, int32 count, int32 stride)
+{
+	for(int32 n=0; n<count; n++) {
+		float sr, cr, sp, cp, sy, cy;
+		scalar_sincos(pose[IM_DOF_ROLL * stride + n], &sr, &cr);
+		scalar_sincos(pose[IM_DOF_PITCH * stride + n], &sp, &cp);
+		scalar_sincos(pose[IM_DOF_YAW * stride + n], &sy, &cy);
+		// R = Rz(yaw) * Ry(pitch) * Rx(roll), the columns of x and y
+		float r00 = cy * cp, r01 = (cy * sp) * sr - sy * cr;
+		float r10 = sy * cp, r11 = (sy * sp) * sr + cy * cr;
+		float r20 = -sp, r21 = cp * sr;
+		float tx = pose[IM_DOF_SURGE * stride + n];
+		float ty = pose[IM_DOF_SWAY * stride + n];
+		float tz = pose[IM_DOF_HEAVE * stride + n] + k->fHeight;
+		for(int32 i=0; i<IM_DOF_COUNT; i++) {
+			float px = k->fPlatform[0][i], py = k->fPlatform[1][i];
+			float dx = ((r00 * px + r01 * py) + tx) - k->fBase[0][i];
+			float dy = ((r10 * px + r11 * py) + ty) - k->fBase[1][i];
+			float dz = (r20 * px + r21 * py) + tz;
+			float length = sqrtf((dx * dx + dy * dy) + dz * dz);
+			axis[i * stride + n] = (length - k->fNeutral[i]) * k->fLengthScale;
+		}
+	}
+}
+
+static const IM_SIMD_KERNELS s_scalar = { scalar_scale, scalar_offset, scalar_limit, scalar_biquad, scalar_mix, scalar_ratelimit, scalar_kinematics };
+
+/************************************
+ * SSE2
+ * (The pattern of the per channel factors covers 'channels' vectors, which is 4 frames.
+ *  MOTION_CLAMP is max(min, min(x, max)) with the operand order of minps/maxps, so NaN and
+ *  signed zeros give the scalar results too.)
+ ************************************/
+#if defined(IM_SIMD_HAS_SSE2)
+static void sse2_scale(float* data, int32 frames, int32 channels, const float* scale)
+{
+	float pattern[IM_FORMAT_CHANNELS_MAX * 4];
+	im_simd_pattern(pattern, scale, channels, 4);
+	const int32 group = channels * 4;
+	const int32 count = frames * channels;
+	int32 i = 0;
+	for(; i + group <= count; i += group) {
+		for(int32 j=0; j<group; j+=4)
+			_mm_storeu_ps(data + i + j, _mm_mul_ps(_mm_loadu_ps(data + i + j), _mm_loadu_ps(pattern + j)));
+	}
+	scalar_scale(data + i, (count - i) / channels, channels, scale);
+}
+
+static void sse2_offset(float* data, int32 frames, int32 channels, const float* offset)
+{
+	float pattern[IM_FORMAT_CHANNELS_MAX * 4];
+	im_simd_pattern(pattern, offset, channels, 4);
+	const int32 group = channels * 4;
+	const int32 count = frames * channels;
+	int32 i = 0;
+	for(; i + group <= count; i += group) {
+		for(int32 j=0; j<group; j+=4)
+			_mm_storeu_ps(data + i + j, _mm_add_ps(_mm_loadu_ps(data + i + j), _mm_loadu_ps(pattern + j)));
+	}
+	scalar_offset(data + i, (count - i) / channels, channels, offset);
+}
+
+static void sse2_limit(float* data, int32 frames, int32 channels, const float* min, const float* max)
+{
+	float lower[IM_FORMAT_CHANNELS_MAX * 4];
+	float upper[IM_FORMAT_CHANNELS_MAX * 4];
+	im_simd_pattern(lower, min, channels, 4);
+	im_simd_pattern(upper, max, channels, 4);
+	const int32 group = channels * 4;
+	const int32 count = frames * channels;
+	int32 i = 0;
+	for(; i + group <= count; i += group) {
+		for(int32 j=0; j<group; j+=4) {
+			__m128 x = _mm_min_ps(_mm_loadu_ps(data + i + j), _mm_loadu_ps(upper + j));
+			_mm_storeu_ps(data + i + j, _mm_max_ps(_mm_loadu_ps(lower + j), x));
+		}
+	}
+	scalar_limit(data + i, (count - i) / channels, channels, min, max);
+}
+
+/**
+ * The channels of a frame are the lanes, in groups of 4. The lanes past the channels are masked to
+ * zero on the load and are not stored, so they run the identity and never touch the next frame.
+ * (The last frames, whose groups would read past the data, are loaded through a padded copy.)
+ */
+static inline void sse2_store_lanes(float* p, __m128 x, int32 count)
+{
+	switch(count) {
+	case 1:	_mm_store_ss(p, x); break;
+	case 2:	_mm_storel_pi((__m64*)p, x); break;
+	case 3:	_mm_storel_pi((__m64*)p, x); _mm_store_ss(p + 2, _mm_movehl_ps(x, x)); break;
+	default: _mm_storeu_ps(p, x); break;
+	}
+}
+
+static void sse2_biquad(float* data, int32 frames, int32 channels, IM_SIMD_BIQUAD* q)
+{
+	const int32 groups = (channels + 3) / 4;
+	const int32 sections = q->nSections;
+	const int32 count = frames * channels;
+	__m128 s1[IM_SIMD_BIQUAD_MAX][IM_FORMAT_CHANNELS_MAX / 4];
+	__m128 s2[IM_SIMD_BIQUAD_MAX][IM_FORMAT_CHANNELS_MAX / 4];
+	__m128 mask[IM_FORMAT_CHANNELS_MAX / 4];
+	for(int32 g=0; g<groups; g++) {
+		for(int32 i=0; i<sections; i++) {
+			s1[i][g] = _mm_loadu_ps(&q->s1[i][g * 4]);
+			s2[i][g] = _mm_loadu_ps(&q->s2[i][g * 4]);
+		}
+		int32 lanes = channels - g * 4;
+		mask[g] = _mm_castsi128_ps(_mm_set_epi32(lanes > 3 ? -1 : 0, lanes > 2 ? -1 : 0, lanes > 1 ? -1 : 0, -1));
+	}
+	float padded[IM_FORMAT_CHANNELS_MAX + 4] = {0};
+	for(int32 f=0; f<frames; f++) {
+		float* frame = data + f * channels;
+		const float* src = frame;
+		if(f * channels + groups * 4 > count) {
+			memcpy(padded, frame, sizeof(float) * channels);
+			src = padded;
+		}
+		for(int32 g=0; g<groups; g++) {
+			__m128 x = _mm_and_ps(_mm_loadu_ps(src + g * 4), mask[g]);
+			for(int32 i=0; i<sections; i++) {
+				__m128 y = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&q->b0[i][g * 4]), x), s1[i][g]);
+				s1[i][g] = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(&q->b1[i][g * 4]), x), _mm_mul_ps(_mm_loadu_ps(&q->a1[i][g * 4]), y)), s2[i][g]);
+				s2[i][g] = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(&q->b2[i][g * 4]), x), _mm_mul_ps(_mm_loadu_ps(&q->a2[i][g * 4]), y));
+				x = y;
+			}
+			sse2_store_lanes(frame + g * 4, x, channels - g * 4);
+		}
+	}
+	for(int32 i=0; i<sections; i++) {
+		for(int32 g=0; g<groups; g++) {
+			_mm_storeu_ps(&q->s1[i][g * 4], s1[i][g]);
+			_mm_storeu_ps(&q->s2[i][g * 4], s2[i][g]);
+		}
+	}
+}
+
+static void sse2_mix(float* acc, const float* src, int32 count, float gain)
+{
+	const __m128 g = _mm_set1_ps(gain);
+	int32 i = 0;
+	for(; i + 8 <= count; i += 8) {
+		_mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(_mm_loadu_ps(src + i), g)));
+		_mm_storeu_ps(acc + i + 4, _mm_add_ps(_mm_loadu_ps(acc + i + 4), _mm_mul_ps(_mm_loadu_ps(src + i + 4), g)));
+	}
+	scalar_mix(acc + i, src + i, count - i, gain);
+}
+
+/**
+ * The steps above the bound are selected with the compare masks, as the scalar branches.
+ * (bound is not negative, so at most one of the masks is set.)
+ */
+static inline __m128 sse2_ratelimit_step(__m128 x, __m128 prev, __m128 bound, __m128 sign)
+{
+	__m128 delta = _mm_sub_ps(x, prev);
+	__m128 over = _mm_cmpgt_ps(delta, bound);
+	__m128 under = _mm_cmplt_ps(delta, _mm_xor_ps(bound, sign));
+	x = _mm_or_ps(_mm_and_ps(under, _mm_sub_ps(prev, bound)), _mm_andnot_ps(under, x));
+	return _mm_or_ps(_mm_and_ps(over, _mm_add_ps(prev, bound)), _mm_andnot_ps(over, x));
+}
+
+static void sse2_ratelimit(float* data, int32 frames, int32 channels, const float* bound, float* last)
+{
+	const int32 groups = (channels + 3) / 4;
+	const int32 count = frames * channels;
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	__m128 prev[IM_FORMAT_CHANNELS_MAX / 4], limit[IM_FORMAT_CHANNELS_MAX / 4];
+	float padded[IM_FORMAT_CHANNELS_MAX + 4] = {0};
+	float lanes[IM_FORMAT_CHANNELS_MAX];
+	memcpy(padded, bound, sizeof(float) * channels);
+	memcpy(lanes, last, sizeof(float) * channels);
+	for(int32 c=channels; c<IM_FORMAT_CHANNELS_MAX; c++)
+		lanes[c] = 0;
+	for(int32 g=0; g<groups; g++) {
+		prev[g] = _mm_loadu_ps(lanes + g * 4);
+		limit[g] = _mm_loadu_ps(padded + g * 4);
+	}
+	for(int32 f=0; f<frames; f++) {
+		float* frame = data + f * channels;
+		const float* src = frame;
+		if(f * channels + groups * 4 > count) {
+			memcpy(padded, frame, sizeof(float) * channels);
+			src = padded;
+		}
+		for(int32 g=0; g<groups; g++) {
+			prev[g] = sse2_ratelimit_step(_mm_loadu_ps(src + g * 4), prev[g], limit[g], sign);
+			sse2_store_lanes(frame + g * 4, prev[g], channels - g * 4);
+		}
+	}
+	for(int32 g=0; g<groups; g++)
+		_mm_storeu_ps(lanes + g * 4, prev[g]);
+	memcpy(last, lanes, sizeof(float) * channels);
+}
+
+static inline void sse2_sincos(__m128 x, __m128* s, __m128* c)
+{
+	__m128i k = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(IM_SIMD_2_PI)));
+	__m128 kf = _mm_cvtepi32_ps(k);
+	__m128 r = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(x, _mm_mul_ps(kf, _mm_set1_ps(IM_SIMD_PI_2A))), _mm_mul_ps(kf, _mm_set1_ps(IM_SIMD_PI_2B))), _mm_mul_ps(kf, _mm_set1_ps(IM_SIMD_PI_2C)));
+	__m128 z = _mm_mul_ps(r, r);
+	__m128 ps = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(IM_SIMD_SIN1), z), _mm_set1_ps(IM_SIMD_SIN2)), z), _mm_set1_ps(IM_SIMD_SIN3)), z), r), r);
+	__m128 pc = _mm_mul_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(IM_SIMD_COS1), z), _mm_set1_ps(IM_SIMD_COS2)), z), _mm_set1_ps(IM_SIMD_COS3)), z), z);
+	pc = _mm_add_ps(_mm_sub_ps(pc, _mm_mul_ps(_mm_set1_ps(0.5f), z)), _mm_set1_ps(1.0f));
+	__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(k, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+	__m128 sin_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(k, _mm_set1_epi32(2)), 30));
+	__m128 cos_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(k, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+	*s = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, pc), _mm_andnot_ps(swap, ps)), sin_sign);
+	*c = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, ps), _mm_andnot_ps(swap, pc)), cos_sign);
+}
+
+static void sse2_kinematics(const IM_SIMD_KINEMATICS* k, const float* pose, float* axis, int32 count, int32 stride)
+{
+	const __m128 height = _mm_set1_ps(k->fHeight);
+	const __m128 scale = _mm_set1_ps(k->fLengthScale);
+	int32 n = 0;
+	for(; n + 4 <= count; n += 4) {
+		__m128 sr, cr, sp, cp, sy, cy;
+		sse2_sincos(_mm_loadu_ps(pose + IM_DOF_ROLL * stride + n), &sr, &cr);
+		sse2_sincos(_mm_loadu_ps(pose + IM_DOF_PITCH * stride + n), &sp, &cp);
+		sse2_sincos(_mm_loadu_ps(pose + IM_DOF_YAW * stride + n), &sy, &cy);
+		__m128 r00 = _mm_mul_ps(cy, cp), r01 = _mm_sub_ps(_mm_mul_ps(_mm_mul_ps(cy, sp), sr), _mm_mul_ps(sy, cr));
+		__m128 r10 = _mm_mul_ps(sy, cp), r11 = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sy, sp), sr), _mm_mul_ps(cy, cr));
+		__m128 r20 = _mm_xor_ps(sp, _mm_set1_ps(-0.0f)), r21 = _mm_mul_ps(cp, sr);
+		__m128 tx = _mm_loadu_ps(pose + IM_DOF_SURGE * stride + n);
+		__m128 ty = _mm_loadu_ps(pose + IM_DOF_SWAY * stride + n);
+		__m128 tz = _mm_add_ps(_mm_loadu_ps(pose + IM_DOF_HEAVE * stride + n), height);
+		for(int32 i=0; i<IM_DOF_COUNT; i++) {
+			__m128 px = _mm_set1_ps(k->fPlatform[0][i]), py = _mm_set1_ps(k->fPlatform[1][i]);
+			__m128 dx = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(r00, px), _mm_mul_ps(r01, py)), tx), _mm_set1_ps(k->fBase[0][i]));
+			__m128 dy = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(r10, px), _mm_mul_ps(r11, py)), ty), _mm_set1_ps(k->fBase[1][i]));
+			__m128 dz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r20, px), _mm_mul_ps(r21, py)), tz);
+			__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+			_mm_storeu_ps(axis + i * stride + n, _mm_mul_ps(_mm_sub_ps(length, _mm_set1_ps(k->fNeutral[i])), scale));
+		}
+	}
+	scalar_kinematics(k, pose + n, axis + n, count - n, stride);
+}
+
+static const IM_SIMD_KERNELS s_sse2 = { sse2_scale, sse2_offset, sse2_limit, sse2_biquad, sse2_mix, sse2_ratelimit, sse2_kinematics };
+#endif
+
+/************************************
+ * Selection
+ ************************************/
+#if defined(INNO_ML_SIMD_AVX2)
+static bool cpu_has_avx2()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") != 0;
+#else
+	return false;
+#endif
+}
+#endif
+
+const IM_SIMD_KERNELS* im_simd_kernels(IM_SIMD_LEVEL level)
+{
+	switch(level) {
+	case IM_SIMD_SCALAR:
+		return &s_scalar;
+#if defined(IM_SIMD_HAS_SSE2)
+	case IM_SIMD_SSE2:
+		return &s_sse2;
+#endif
+#if defined(INNO_ML_SIMD_AVX2)
+	case IM_SIMD_AVX2:
+		return cpu_has_avx2() ? &g_im_simd_avx2 : 0;
+#endif
+	default:
+		break;
+	}
+	return 0;
+}
+
+static const IM_SIMD_KERNELS* simd_select()
+{
+	for(int32 level=IM_SIMD_COUNT-1; level>IM_SIMD_SCALAR; level--) {
+		const IM_SIMD_KERNELS* kernels = im_simd_kernels((IM_SIMD_LEVEL)level);
+		if(kernels)
+			return kernels;
+	}
+	return &s_scalar;
+}
+
+const IM_SIMD_KERNELS* im_simd()
+{
+	static const IM_SIMD_KERNELS* s_kernels = simd_select();
+	return s_kernels;
+}
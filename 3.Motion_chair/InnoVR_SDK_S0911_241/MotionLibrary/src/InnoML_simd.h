@@ -0,0 +1,138 @@
+/********************************************************************************//**
+\file      InnoML_simd.h
+\brief     Vector kernels of the built-in filters (scalar, SSE2 and AVX2).
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#ifndef INNO_ML_SIMD_H
+#define INNO_ML_SIMD_H
+
+#include <InnoML.h>
+#include <string.h>		// for memset
+
+/**
+ *  \name IM_SIMD_*
+ *
+ *  Declare the instruction sets of the kernels.
+ *  (SSE2 is the baseline of x86 builds, AVX2 is selected at run time if the cpu supports it.)
+ */
+typedef enum {
+	IM_SIMD_SCALAR = 0,
+	IM_SIMD_SSE2,
+	IM_SIMD_AVX2,
+	IM_SIMD_COUNT,
+} IM_SIMD_LEVEL;
+
+#define IM_SIMD_BIQUAD_MAX		3	/**< biquads of a cascade (order 3 and the integrals of IM_FILTER_CLASSIC) */
+
+/**
+ * Cascade of transposed direct form II biquads, structure of arrays over the channels.
+ * (y = b0*x + s1, s1 = b1*x - a1*y + s2, s2 = b2*x - a2*y. Unused channels and sections are
+ *  the identity b0 = 1, so every channel runs all 'nSections' in the same lanes.)
+ */
+typedef struct {
+	int32	nSections;
+	float	b0[IM_SIMD_BIQUAD_MAX][IM_FORMAT_CHANNELS_MAX];
+	float	b1[IM_SIMD_BIQUAD_MAX][IM_FORMAT_CHANNELS_MAX];
+	float	b2[IM_SIMD_BIQUAD_MAX][IM_FORMAT_CHANNELS_MAX];
+	float	a1[IM_SIMD_BIQUAD_MAX][IM_FORMAT_CHANNELS_MAX];
+	float	a2[IM_SIMD_BIQUAD_MAX][IM_FORMAT_CHANNELS_MAX];
+	float	s1[IM_SIMD_BIQUAD_MAX][IM_FORMAT_CHANNELS_MAX];	/**< state */
+	float	s2[IM_SIMD_BIQUAD_MAX][IM_FORMAT_CHANNELS_MAX];	/**< state */
+} IM_SIMD_BIQUAD;
+
+/**
+ * Reduction of sin and cos by pi/2 in three parts, and their polynomials on [-pi/4, pi/4] (cephes sinf/cosf)
+ * of the kinematics kernels.
+ */
+#define IM_SIMD_2_PI	0.636619772367581343f	/**< 2/pi */
+#define IM_SIMD_PI_2A	1.5703125f				/**< pi/2 = a + b + c */
+#define IM_SIMD_PI_2B	4.837512969970703125e-4f
+#define IM_SIMD_PI_2C	7.54978995489188216e-8f
+#define IM_SIMD_SIN1	-1.9515295891e-4f
+#define IM_SIMD_SIN2	8.3321608736e-3f
+#define IM_SIMD_SIN3	-1.6666654611e-1f
+#define IM_SIMD_COS1	2.443315711809948e-5f
+#define IM_SIMD_COS2	-1.388731625493765e-3f
+#define IM_SIMD_COS3	4.166664568298827e-2f
+
+/**
+ * Joint geometry of a 6-6 stewart platform for the inverse kinematics.
+ * (The joints are in the planes of the base and the platform, so their z is 0.)
+ */
+typedef struct {
+	float	fBase[2][IM_DOF_COUNT];			/**< x, y of the base joints (mm) */
+	float	fPlatform[2][IM_DOF_COUNT];		/**< x, y of the platform joints (mm) */
+	float	fHeight;						/**< height of the platform at the neutral pose (mm) */
+	float	fNeutral[IM_DOF_COUNT];			/**< actuator lengths at the neutral pose (mm) */
+	float	fLengthScale;					/**< mm -> working range */
+} IM_SIMD_KINEMATICS;
+
+/**
+ * Kernels on interleaved frames in the working range.
+ * (The factors are per channel. All levels give bit-exact results of the scalar kernels.)
+ */
+typedef struct {
+	void	(*scale)(float* data, int32 frames, int32 channels, const float* scale);
+	void	(*offset)(float* data, int32 frames, int32 channels, const float* offset);
+	void	(*limit)(float* data, int32 frames, int32 channels, const float* min, const float* max);
+	void	(*biquad)(float* data, int32 frames, int32 channels, IM_SIMD_BIQUAD* cascade);
+	void	(*mix)(float* acc, const float* src, int32 count, float gain);	/**< acc += src * gain (not saturated) */
+	void	(*ratelimit)(float* data, int32 frames, int32 channels, const float* bound, float* last);	/**< |x - last| <= bound (last is the previous output) */
+	void	(*kinematics)(const IM_SIMD_KINEMATICS* k, const float* pose, float* axis, int32 count, int32 stride);	/**< poses (mm, radians) -> axes, structure of arrays [IM_DOF_COUNT][stride] */
+} IM_SIMD_KERNELS;
+
+/**
+ * This function gets the kernels of an instruction set. (0 if the build or the cpu does not support it)
+ */
+const IM_SIMD_KERNELS*	im_simd_kernels(IM_SIMD_LEVEL level);
+
+/**
+ * This function gets the kernels of the best instruction set. (selected once)
+ */
+const IM_SIMD_KERNELS*	im_simd();
+
+/**
+ * This function repeats the per channel factors to fill 'lanes' vectors of the channel count.
+ * (pattern[i] = factor[i % channels], so 'channels' vectors from a frame boundary take the pattern as is.)
+ */
+inline void im_simd_pattern(float* pattern, const float* factor, int32 channels, int32 lanes)
+{
+	for(int32 i=0; i<channels * lanes; i++)
+		pattern[i] = factor[i % channels];
+}
+
+/**
+ * This function sets all the sections of a cascade to the identity and clears the state.
+ */
+inline void im_biquad_reset(IM_SIMD_BIQUAD* cascade)
+{
+	memset(cascade, 0, sizeof(IM_SIMD_BIQUAD));
+	for(int32 i=0; i<IM_SIMD_BIQUAD_MAX; i++) {
+		for(int32 c=0; c<IM_FORMAT_CHANNELS_MAX; c++)
+			cascade->b0[i][c] = 1.0f;
+	}
+}
+
+/**
+ * This function sets a biquad of a channel to the product of two first-order sections
+ * (b0 + b1/z) / (1 + a1/z), given as { b0, b1, a1 }. (second = 0 for a single first-order section)
+ */
+inline void im_biquad_set(IM_SIMD_BIQUAD* cascade, int32 section, int32 channel, const float* first, const float* second)
+{
+	const double one[3] = { 1.0, 0.0, 0.0 };	// b0, b1, a1 of the identity
+	double f[3] = { first[0], first[1], first[2] };
+	double s[3] = { one[0], one[1], one[2] };
+	if(second) {
+		s[0] = second[0];
+		s[1] = second[1];
+		s[2] = second[2];
+	}
+	cascade->b0[section][channel] = (float)(f[0] * s[0]);
+	cascade->b1[section][channel] = (float)(f[0] * s[1] + f[1] * s[0]);
+	cascade->b2[section][channel] = (float)(f[1] * s[1]);
+	cascade->a1[section][channel] = (float)(f[2] + s[2]);
+	cascade->a2[section][channel] = (float)(f[2] * s[2]);
+}
+
+#endif // INNO_ML_SIMD_H
@@ -0,0 +1,247 @@
+/********************************************************************************//**
+\file      InnoML_simd_avx2.cpp
+\brief     AVX2 kernels of the built-in filters. (built with AVX2 code generation, selected at run time)
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#include "InnoML_simd.h"
+#include <immintrin.h>
+
+/**
+ * The pattern of the per channel factors covers 'channels' vectors, which is 8 frames.
+ * (The tail that does not fill a pattern is done with SSE-width vectors and then one frame at a time.)
+ */
+static void avx2_scale(float* data, int32 frames, int32 channels, const float* scale)
+{
+	float pattern[IM_FORMAT_CHANNELS_MAX * 8];
+	im_simd_pattern(pattern, scale, channels, 8);
+	const int32 group = channels * 8;
+	const int32 count = frames * channels;
+	int32 i = 0;
+	for(; i + group <= count; i += group) {
+		for(int32 j=0; j<group; j+=8)
+			_mm256_storeu_ps(data + i + j, _mm256_mul_ps(_mm256_loadu_ps(data + i + j), _mm256_loadu_ps(pattern + j)));
+	}
+	for(; i + channels * 4 <= count; i += channels * 4) {
+		for(int32 j=0; j<channels * 4; j+=4)
+			_mm_storeu_ps(data + i + j, _mm_mul_ps(_mm_loadu_ps(data + i + j), _mm_loadu_ps(pattern + j)));
+	}
+	for(; i<count; i++)
+		data[i] *= pattern[i % channels];
+}
+
+static void avx2_offset(float* data, int32 frames, int32 channels, const float* offset)
+{
+	float pattern[IM_FORMAT_CHANNELS_MAX * 8];
+	im_simd_pattern(pattern, offset, channels, 8);
+	const int32 group = channels * 8;
+	const int32 count = frames * channels;
+	int32 i = 0;
+	for(; i + group <= count; i += group) {
+		for(int32 j=0; j<group; j+=8)
+			_mm256_storeu_ps(data + i + j, _mm256_add_ps(_mm256_loadu_ps(data + i + j), _mm256_loadu_ps(pattern + j)));
+	}
+	for(; i + channels * 4 <= count; i += channels * 4) {
+		for(int32 j=0; j<channels * 4; j+=4)
+			_mm_storeu_ps(data + i + j, _mm_add_ps(_mm_loadu_ps(data + i + j), _mm_loadu_ps(pattern + j)));
+	}
+	for(; i<count; i++)
+		data[i] += pattern[i % channels];
+}
+
+static void avx2_limit(float* data, int32 frames, int32 channels, const float* min, const float* max)
+{
+	float lower[IM_FORMAT_CHANNELS_MAX * 8];
+	float upper[IM_FORMAT_CHANNELS_MAX * 8];
+	im_simd_pattern(lower, min, channels, 8);
+	im_simd_pattern(upper, max, channels, 8);
+	const int32 group = channels * 8;
+	const int32 count = frames * channels;
+	int32 i = 0;
+	for(; i + group <= count; i += group) {
+		for(int32 j=0; j<group; j+=8) {
+			__m256 x = _mm256_min_ps(_mm256_loadu_ps(data + i + j), _mm256_loadu_ps(upper + j));
+			_mm256_storeu_ps(data + i + j, _mm256_max_ps(_mm256_loadu_ps(lower + j), x));
+		}
+	}
+	for(; i + channels * 4 <= count; i += channels * 4) {
+		for(int32 j=0; j<channels * 4; j+=4) {
+			__m128 x = _mm_min_ps(_mm_loadu_ps(data + i + j), _mm_loadu_ps(upper + j));
+			_mm_storeu_ps(data + i + j, _mm_max_ps(_mm_loadu_ps(lower + j), x));
+		}
+	}
+	for(; i<count; i++)
+		data[i] = MOTION_CLAMP(data[i], lower[i % channels], upper[i % channels]);
+}
+
+/**
+ * All the channels of a frame are the lanes of one vector. The lanes past the channels are masked to
+ * zero on the load and are not stored, so they run the identity and never touch the next frame.
+ * (The stores are 128-bit, as a masked store would stall the load of the next frame. The last frames,
+ *  whose vector would read past the data, are loaded with a masked load.)
+ */
+static inline void avx2_store_lanes(float* p, __m128 x, int32 count)
+{
+	switch(count) {
+	case 1:	_mm_store_ss(p, x); break;
+	case 2:	_mm_storel_pi((__m64*)p, x); break;
+	case 3:	_mm_storel_pi((__m64*)p, x); _mm_store_ss(p + 2, _mm_movehl_ps(x, x)); break;
+	default: _mm_storeu_ps(p, x); break;
+	}
+}
+
+static void avx2_biquad(float* data, int32 frames, int32 channels, IM_SIMD_BIQUAD* q)
+{
+	const int32 sections = q->nSections;
+	const int32 count = frames * channels;
+	__m256 b0[IM_SIMD_BIQUAD_MAX], b1[IM_SIMD_BIQUAD_MAX], b2[IM_SIMD_BIQUAD_MAX], a1[IM_SIMD_BIQUAD_MAX], a2[IM_SIMD_BIQUAD_MAX];
+	__m256 s1[IM_SIMD_BIQUAD_MAX], s2[IM_SIMD_BIQUAD_MAX];
+	for(int32 i=0; i<sections; i++) {
+		b0[i] = _mm256_loadu_ps(q->b0[i]);
+		b1[i] = _mm256_loadu_ps(q->b1[i]);
+		b2[i] = _mm256_loadu_ps(q->b2[i]);
+		a1[i] = _mm256_loadu_ps(q->a1[i]);
+		a2[i] = _mm256_loadu_ps(q->a2[i]);
+		s1[i] = _mm256_loadu_ps(q->s1[i]);
+		s2[i] = _mm256_loadu_ps(q->s2[i]);
+	}
+	const __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(channels), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+	for(int32 f=0; f<frames; f++) {
+		float* frame = data + f * channels;
+		__m256 x;
+		if(f * channels + 8 <= count)
+			x = _mm256_and_ps(_mm256_loadu_ps(frame), _mm256_castsi256_ps(mask));
+		else
+			x = _mm256_maskload_ps(frame, mask);
+		for(int32 i=0; i<sections; i++) {
+			__m256 y = _mm256_add_ps(_mm256_mul_ps(b0[i], x), s1[i]);
+			s1[i] = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(b1[i], x), _mm256_mul_ps(a1[i], y)), s2[i]);
+			s2[i] = _mm256_sub_ps(_mm256_mul_ps(b2[i], x), _mm256_mul_ps(a2[i], y));
+			x = y;
+		}
+		if(channels > 4) {
+			_mm_storeu_ps(frame, _mm256_castps256_ps128(x));
+			avx2_store_lanes(frame + 4, _mm256_extractf128_ps(x, 1), channels - 4);
+		}
+		else
+			avx2_store_lanes(frame, _mm256_castps256_ps128(x), channels);
+	}
+	for(int32 i=0; i<sections; i++) {
+		_mm256_storeu_ps(q->s1[i], s1[i]);
+		_mm256_storeu_ps(q->s2[i], s2[i]);
+	}
+}
+
+static void avx2_mix(float* acc, const float* src, int32 count, float gain)
+{
+	const __m256 g = _mm256_set1_ps(gain);
+	int32 i = 0;
+	for(; i + 16 <= count; i += 16) {
+		_mm256_storeu_ps(acc + i, _mm256_add_ps(_mm256_loadu_ps(acc + i), _mm256_mul_ps(_mm256_loadu_ps(src + i), g)));
+		_mm256_storeu_ps(acc + i + 8, _mm256_add_ps(_mm256_loadu_ps(acc + i + 8), _mm256_mul_ps(_mm256_loadu_ps(src + i + 8), g)));
+	}
+	for(; i + 4 <= count; i += 4)
+		_mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(_mm_loadu_ps(src + i), _mm256_castps256_ps128(g))));
+	for(; i<count; i++)
+		acc[i] += src[i] * gain;
+}
+
+/**
+ * The steps above the bound are selected with the compare masks, as the scalar branches.
+ * (The lanes past the channels have a zero bound and are not stored.)
+ */
+static void avx2_ratelimit(float* data, int32 frames, int32 channels, const float* bound, float* last)
+{
+	const int32 count = frames * channels;
+	const __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(channels), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+	const __m256 sign = _mm256_set1_ps(-0.0f);
+	const __m256 limit = _mm256_maskload_ps(bound, mask);
+	const __m256 lower = _mm256_xor_ps(limit, sign);
+	__m256 prev = _mm256_maskload_ps(last, mask);
+	for(int32 f=0; f<frames; f++) {
+		float* frame = data + f * channels;
+		__m256 x;
+		if(f * channels + 8 <= count)
+			x = _mm256_loadu_ps(frame);
+		else
+			x = _mm256_maskload_ps(frame, mask);
+		__m256 delta = _mm256_sub_ps(x, prev);
+		__m256 over = _mm256_cmp_ps(delta, limit, _CMP_GT_OQ);
+		__m256 under = _mm256_cmp_ps(delta, lower, _CMP_LT_OQ);
+		x = _mm256_blendv_ps(x, _mm256_sub_ps(prev, limit), under);
+		prev = _mm256_blendv_ps(x, _mm256_add_ps(prev, limit), over);
+		if(channels > 4) {
+			_mm_storeu_ps(frame, _mm256_castps256_ps128(prev));
+			avx2_store_lanes(frame + 4, _mm256_extractf128_ps(prev, 1), channels - 4);
+		}
+		else
+			avx2_store_lanes(frame, _mm256_castps256_ps128(prev), channels);
+	}
+	_mm256_maskstore_ps(last, mask, prev);
+}
+
+static inline void avx2_sincos(__m256 x, __m256* s, __m256* c)
+{
+	__m256i k = _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(IM_SIMD_2_PI)));
+	__m256 kf = _mm256_cvtepi32_ps(k);
+	__m256 r = _mm256_sub_ps(_mm256_sub_ps(_mm256_sub_ps(x, _mm256_mul_ps(kf, _mm256_set1_ps(IM_SIMD_PI_2A))), _mm256_mul_ps(kf, _mm256_set1_ps(IM_SIMD_PI_2B))), _mm256_mul_ps(kf, _mm256_set1_ps(IM_SIMD_PI_2C)));
+	__m256 z = _mm256_mul_ps(r, r);
+	__m256 ps = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(IM_SIMD_SIN1), z), _mm256_set1_ps(IM_SIMD_SIN2)), z), _mm256_set1_ps(IM_SIMD_SIN3)), z), r), r);
+	__m256 pc = _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(IM_SIMD_COS1), z), _mm256_set1_ps(IM_SIMD_COS2)), z), _mm256_set1_ps(IM_SIMD_COS3)), z), z);
+	pc = _mm256_add_ps(_mm256_sub_ps(pc, _mm256_mul_ps(_mm256_set1_ps(0.5f), z)), _mm256_set1_ps(1.0f));
+	__m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(k, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+	__m256 sin_sign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(k, _mm256_set1_epi32(2)), 30));
+	__m256 cos_sign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(k, _mm256_set1_epi32(1)), _mm256_set1_epi32(2)), 30));
+	*s = _mm256_xor_ps(_mm256_blendv_ps(ps, pc, swap), sin_sign);
+	*c = _mm256_xor_ps(_mm256_blendv_ps(pc, ps, swap), cos_sign);
+}
+
+/**
+ * The poses are one per lane, 8 at a time. (The rest, less than 8, is done through a padded copy.)
+ */
+static void avx2_kinematics(const IM_SIMD_KINEMATICS* k, const float* pose, float* axis, int32 count, int32 stride)
+{
+	const __m256 height = _mm256_set1_ps(k->fHeight);
+	const __m256 scale = _mm256_set1_ps(k->fLengthScale);
+	for(int32 n=0; n<count; n+=8) {
+		float padded[IM_DOF_COUNT][8], result[IM_DOF_COUNT][8];
+		const float* src = pose + n;
+		int32 src_stride = stride;
+		float* dst = axis + n;
+		int32 dst_stride = stride;
+		const int32 lanes = MOTION_MIN(count - n, 8);
+		if(lanes < 8) {
+			memset(padded, 0, sizeof(padded));
+			for(int32 i=0; i<IM_DOF_COUNT; i++)
+				memcpy(padded[i], pose + i * stride + n, sizeof(float) * lanes);
+			src = padded[0];
+			src_stride = 8;
+			dst = result[0];
+			dst_stride = 8;
+		}
+		__m256 sr, cr, sp, cp, sy, cy;
+		avx2_sincos(_mm256_loadu_ps(src + IM_DOF_ROLL * src_stride), &sr, &cr);
+		avx2_sincos(_mm256_loadu_ps(src + IM_DOF_PITCH * src_stride), &sp, &cp);
+		avx2_sincos(_mm256_loadu_ps(src + IM_DOF_YAW * src_stride), &sy, &cy);
+		__m256 r00 = _mm256_mul_ps(cy, cp), r01 = _mm256_sub_ps(_mm256_mul_ps(_mm256_mul_ps(cy, sp), sr), _mm256_mul_ps(sy, cr));
+		__m256 r10 = _mm256_mul_ps(sy, cp), r11 = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(sy, sp), sr), _mm256_mul_ps(cy, cr));
+		__m256 r20 = _mm256_xor_ps(sp, _mm256_set1_ps(-0.0f)), r21 = _mm256_mul_ps(cp, sr);
+		__m256 tx = _mm256_loadu_ps(src + IM_DOF_SURGE * src_stride);
+		__m256 ty = _mm256_loadu_ps(src + IM_DOF_SWAY * src_stride);
+		__m256 tz = _mm256_add_ps(_mm256_loadu_ps(src + IM_DOF_HEAVE * src_stride), height);
+		for(int32 i=0; i<IM_DOF_COUNT; i++) {
+			__m256 px = _mm256_set1_ps(k->fPlatform[0][i]), py = _mm256_set1_ps(k->fPlatform[1][i]);
+			__m256 dx = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r00, px), _mm256_mul_ps(r01, py)), tx), _mm256_set1_ps(k->fBase[0][i]));
+			__m256 dy = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r10, px), _mm256_mul_ps(r11, py)), ty), _mm256_set1_ps(k->fBase[1][i]));
+			__m256 dz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r20, px), _mm256_mul_ps(r21, py)), tz);
+			__m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz)));
+			_mm256_storeu_ps(dst + i * dst_stride, _mm256_mul_ps(_mm256_sub_ps(length, _mm256_set1_ps(k->fNeutral[i])), scale));
+		}
+		if(lanes < 8) {
+			for(int32 i=0; i<IM_DOF_COUNT; i++)
+				memcpy(axis + i * stride + n, result[i], sizeof(float) * lanes);
+		}
+	}
+}
+
+extern const IM_SIMD_KERNELS g_im_simd_avx2 = { avx2_scale, avx2_offset, avx2_limit, avx2_biquad, avx2_mix, avx2_ratelimit, avx2_kinematics };
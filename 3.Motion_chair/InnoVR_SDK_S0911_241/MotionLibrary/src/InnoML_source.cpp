@@ -0,0 +1,395 @@
+/********************************************************************************//**
+\file      InnoML_source.cpp
+\brief     Motion source objects (IMSource) of the InnoML reference engine.
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#include "InnoML_internal.h"
+#include "InnoML_simd.h"
+
+MotionSource::MotionSource()
+	: MotionObject(IM_OBJECT_SOURCE), m_buffer(0), m_filter(0), m_context(0), m_volume(100), m_speed(1),
+	m_loop_count(0), m_loops(0), m_paused(false), m_listener(0), m_listener_obj(0), m_pos(0), m_step((uint64)1<<IM_SOURCE_PHASE_BITS),
+	m_step_target(0), m_step_delta(0), m_ramp(0), m_frame(IM_SOURCE_FRAME_NONE), m_stream_base(0), m_decoded(0), m_cached(0)
+{
+	memset(m_pair, 0, sizeof(m_pair));
+}
+
+MotionSource::~MotionSource()
+{
+	if(m_buffer && m_buffer->m_stream && m_buffer->m_stream->m_source == this)
+		m_buffer->m_stream->m_source = 0;
+	im_object_release(m_buffer);
+	im_object_release(m_filter);
+}
+
+int32 MotionSource::SetBuffer(MotionBuffer* buffer)
+{
+	// a stream buffer is consumed by one source
+	MotionStream* stream = buffer ? buffer->m_stream : 0;
+	if(stream && stream->m_source && stream->m_source != this)
+		return IM_FAIL;
+	if(m_buffer && m_buffer->m_stream && m_buffer->m_stream->m_source == this)
+		m_buffer->m_stream->m_source = 0;
+	if(stream) {
+		stream->m_source = this;
+		if(m_context && !stream->IsPristine(m_loop_count))
+			stream->Restart(buffer, m_loop_count);
+	}
+	m_stream_base = 0;
+	im_object_retain(buffer);
+	im_object_release(m_buffer);
+	m_buffer = buffer;
+	m_pos = 0;
+	m_frame = IM_SOURCE_FRAME_NONE;
+	m_decoded = 0;
+	if(m_context)
+		return Prepare(&m_context->m_master->m_format);
+	return IM_OK;
+}
+
+int32 MotionSource::SetFilter(MotionFilter* filter)
+{
+	im_object_retain(filter);
+	im_object_release(m_filter);
+	m_filter = filter;
+	m_frame = IM_SOURCE_FRAME_NONE;
+	m_decoded = 0;
+	if(m_context)
+		return Prepare(&m_context->m_master->m_format);
+	return IM_OK;
+}
+
+int32 MotionSource::Prepare(const IM_FORMAT* master)
+{
+	if(m_buffer == 0)
+		return IM_FAIL;
+
+	// the filter chain runs at the source rate, the play position steps to the master rate
+	const IM_FORMAT& format = m_buffer->m_format;
+	IM_FORMAT dst;
+	im_format_set(&dst, master->nType, format.nSampleRate, master->nChannels, IM_FORMAT_DATA_F32);
+	if(m_converter.Build(m_filter, &format, &dst) == 0)
+		return IM_FAIL;
+	m_step = (uint64)((double)format.nSampleRate * m_speed / master->nSampleRate * ((uint64)1 << IM_SOURCE_PHASE_BITS) + 0.5);
+	m_ramp = 0;
+	m_frame = IM_SOURCE_FRAME_NONE;
+	if(m_buffer->m_stream == 0)
+		m_decoded = 0; // (the frames of a stream before m_decoded are consumed)
+	return IM_OK;
+}
+
+int32 MotionSource::SetSpeed(float speed, int32 ramp)
+{
+	if(!(speed > 0 && speed <= IM_SOURCE_SPEED_MAX) || ramp < 0)
+		return IM_FAIL;
+	m_speed = speed;
+	if(m_context == 0 || m_buffer == 0)
+		return IM_OK; // the step is set by Prepare
+
+	// the step moves linearly to the new speed over the ramp (the position stays continuous)
+	const IM_FORMAT& master = m_context->m_master->m_format;
+	const uint64 step = (uint64)((double)m_buffer->m_format.nSampleRate * speed / master.nSampleRate * ((uint64)1 << IM_SOURCE_PHASE_BITS) + 0.5);
+	const uint32 frames = (uint32)((uint64)ramp * master.nSampleRate / 1000);
+	if(frames == 0) {
+		m_step = step;
+		m_ramp = 0;
+		return IM_OK;
+	}
+	m_step_target = step;
+	m_step_delta = ((int64)step - (int64)m_step) / (int64)frames;
+	m_ramp = frames;
+	return IM_OK;
+}
+
+/**
+ * The frames of the tick are rendered first and added to the mix in one pass. (The mix is the wide
+ * accumulator of the context, it is saturated once after all the sources and inputs are added.)
+ * A frame is interpolated between the two source frames around the play position, which are kept
+ * in m_pair, so a position that moves less than a frame per master frame fetches nothing.
+ * A stream buffer loops in its decoder, so the source plays the stream forward and passes the loop restarts.
+ * When the decoder is late, the last frame is held and the position waits for the next mixer period.
+ */
+int32 MotionSource::Mix(float* mix, int32 frames, int32 channels, float gain, std::vector<IM_NOTIFY>& notify)
+{
+	if(m_paused || m_buffer == 0 || !m_converter.IsValid())
+		return 0;
+
+	MotionStream* stream = m_buffer->m_stream;
+	const uint32 duration = stream ? stream->m_end.load(std::memory_order_acquire) : m_buffer->GetQueuedCount();
+	uint32 loop_begin = 0, loop_end = duration; // loop points of the buffer (the whole buffer without them)
+	if(stream == 0 && m_buffer->m_loop_end && m_buffer->m_loop_end <= duration) {
+		loop_begin = m_buffer->m_loop_begin;
+		loop_end = m_buffer->m_loop_end;
+	}
+	gain *= m_volume / 100.0f;
+	m_render.resize(frames * channels);
+	const float fraction = 1.0f / (float)((uint64)1 << IM_SOURCE_PHASE_BITS);
+	int32 result = 0;
+	int32 f = 0;
+	for(; f<frames; f++) {
+		uint32 index = (uint32)(m_pos >> IM_SOURCE_PHASE_BITS);
+		uint32 mark;
+		while(stream && stream->PopMark(index, &mark)) {
+			m_loops++;
+			m_stream_base = mark - (stream->m_loop_end ? stream->m_loop_begin : 0);
+			if(m_listener) {
+				IM_NOTIFY msg = { m_listener, m_listener_obj, IM_END_OF_LOOP };
+				notify.push_back(msg);
+			}
+		}
+		bool looping = stream == 0 && duration && (m_loop_count == IM_LOOP_INFINITE || m_loops < m_loop_count);
+		if(looping && index >= loop_end) {
+			// a step longer than the loop passes several loops in a frame (up to the loops left)
+			const uint32 length = loop_end - loop_begin;
+			int32 loops = (int32)((index - loop_begin) / length);
+			if(m_loop_count != IM_LOOP_INFINITE)
+				loops = MOTION_MIN(loops, m_loop_count - m_loops);
+			m_loops += loops;
+			m_pos -= (uint64)loops * length << IM_SOURCE_PHASE_BITS;
+			index = (uint32)(m_pos >> IM_SOURCE_PHASE_BITS);
+			for(int32 i=0; i<loops && m_listener; i++) {
+				IM_NOTIFY msg = { m_listener, m_listener_obj, IM_END_OF_LOOP };
+				notify.push_back(msg);
+			}
+			looping = m_loop_count == IM_LOOP_INFINITE || m_loops < m_loop_count; // (the last pass plays on to the end)
+		}
+		if(index >= duration) {
+			m_pos = (uint64)duration << IM_SOURCE_PHASE_BITS;
+			if(m_listener) {
+				IM_NOTIFY msg = { m_listener, m_listener_obj, IM_END_OF_STREAM };
+				notify.push_back(msg);
+			}
+			result = IM_END_OF_STREAM;
+			break;
+		}
+		if(index != m_frame && !Pair(index, duration, looping ? loop_begin : 0, looping ? loop_end : 0, channels)) {
+			// underrun of a stream
+			const float* held = (f > 0) ? &m_render[(f - 1) * channels] : m_pair[1];
+			for(; f<frames; f++)
+				memcpy(&m_render[f * channels], held, sizeof(float) * channels);
+			stream->m_underruns++;
+			break;
+		}
+		const float t = (float)(uint32)m_pos * fraction;
+		float* out = &m_render[f * channels];
+		for(int32 c=0; c<channels; c++)
+			out[c] = m_pair[0][c] + (m_pair[1][c] - m_pair[0][c]) * t;
+
+		m_pos += m_step;
+		if(m_ramp) {
+			m_step = (uint64)((int64)m_step + m_step_delta);
+			if(--m_ramp == 0)
+				m_step = m_step_target;
+		}
+	}
+	if(f > 0)
+		im_simd()->mix(mix, &m_render[0], f * channels, gain);
+	return result;
+}
+
+/**
+ * This function loads the two source frames around the play position. (false : the decoder of a stream is late)
+ * (loop_end 0 : not looping. At the loop end the next frame is the loop begin, the frame the loop plays next.)
+ */
+bool MotionSource::Pair(uint32 index, uint32 duration, uint32 loop_begin, uint32 loop_end, int32 channels)
+{
+	const float* frame = (m_frame != IM_SOURCE_FRAME_NONE && index == m_frame + 1) ? m_pair[1] : Fetch(index);
+	if(frame == 0)
+		return false;
+	memcpy(m_pair[0], frame, sizeof(float) * channels);
+	// the last frame is held without a loop
+	const float* next;
+	if(loop_end && index + 1 == loop_end)
+		next = Fetch(loop_begin);
+	else
+		next = (index + 1 < duration) ? Fetch(index + 1) : m_pair[0];
+	if(next == 0)
+		return false;
+	memcpy(m_pair[1], next, sizeof(float) * channels);
+	m_frame = index;
+	return true;
+}
+
+int32 MotionSource::GetPosition() const
+{
+	if(m_buffer == 0)
+		return 0;
+	if(m_buffer->m_stream) // frame of the file
+		return (int32)((uint64)((uint32)(m_pos >> IM_SOURCE_PHASE_BITS) - m_stream_base) * 1000 / m_buffer->m_format.nSampleRate);
+	uint64 frames = MOTION_MIN(m_pos >> IM_SOURCE_PHASE_BITS, (uint64)m_buffer->GetQueuedCount());
+	return (int32)(frames * 1000 / m_buffer->m_format.nSampleRate);
+}
+
+const float* MotionSource::Fetch(uint32 index)
+{
+	// the filter chain keeps the state of the previous frames, so the frames are decoded in order,
+	// a block at a time (m_frames holds the frames [m_decoded - m_cached, m_decoded))
+	const int32 channels = m_converter.m_dst.nChannels;
+	if(index < m_decoded && index + m_cached >= m_decoded)
+		return &m_frames[(index + m_cached - m_decoded) * channels];
+	MotionStream* stream = m_buffer->m_stream;
+	if(index < m_decoded && stream)
+		return 0; // (a stream is played forward)
+	if(index < m_decoded) { // back to a loop point : the filter chain restarts there
+		m_converter.Reset();
+		m_decoded = index;
+	}
+	const uint32 block = m_buffer->m_format.nBlockAlign;
+	const uint32 queued = m_buffer->GetQueuedCount();
+	m_work.resize(IM_SOURCE_DECODE_FRAMES * IM_FORMAT_CHANNELS_MAX);
+	m_frames.resize(IM_SOURCE_DECODE_FRAMES * channels);
+	m_raw.resize(IM_SOURCE_DECODE_FRAMES * block);
+	while(m_decoded <= index) {
+		uint32 count;
+		if(stream) {
+			// the frames of a stream are consumed as they are decoded (0 : the decoder is late)
+			count = MOTION_MIN(m_buffer->GetQueuedCount(), (uint32)IM_SOURCE_DECODE_FRAMES);
+			if(count == 0)
+				return 0;
+			m_buffer->Dequeue(&m_raw[0], (int32)(count * block));
+			stream->Consume(count);
+		}
+		else {
+			count = MOTION_MIN(queued > m_decoded ? queued - m_decoded : 1, (uint32)IM_SOURCE_DECODE_FRAMES);
+			for(uint32 i=0; i<count; i++)
+				memcpy(&m_raw[i * block], m_buffer->GetFrame(m_decoded + i), block);
+		}
+		int32 decoded = m_converter.Decode(&m_raw[0], (int32)count, &m_work[0]);
+		im_frames_remap(&m_work[0], decoded, &m_frames[0], channels, m_converter.m_map, (int32)count);
+		m_decoded += count;
+		m_cached = count;
+	}
+	return &m_frames[(index + m_cached - m_decoded) * channels];
+}
+
+/************************************
+ * @section IMSource (Motion Source)
+ ************************************/
+IM_API IMSource imCreateSource(IMBuffer buffer)
+{
+	IM_API_LOCK();
+	MotionBuffer* obj = im_lookup<MotionBuffer>(buffer);
+	if(buffer && obj == 0)
+		return 0;
+	MotionSource* source = new MotionSource();
+	if(source->SetBuffer(obj) != IM_OK) {
+		delete source;
+		return 0;
+	}
+	return im_object_register(source);
+}
+
+IM_API IMBuffer imSourceSetBuffer(IMSource source, IMBuffer buffer)
+{
+	IM_API_LOCK();
+	MotionSource* obj = im_lookup<MotionSource>(source);
+	MotionBuffer* buf = im_lookup<MotionBuffer>(buffer);
+	if(obj == 0 || (buffer && buf == 0))
+		return 0;
+	if(obj->SetBuffer(buf) != IM_OK)
+		return 0;
+	return buffer;
+}
+
+IM_API IMBuffer imSourceGetBuffer(IMSource source)
+{
+	IM_API_LOCK();
+	MotionSource* obj = im_lookup<MotionSource>(source);
+	return (obj && obj->m_buffer) ? obj->m_buffer->m_handle : 0;
+}
+
+IM_API int32 imSourceSetFilter(IMSource source, IMFilter filter)
+{
+	IM_API_LOCK();
+	MotionSource* obj = im_lookup<MotionSource>(source);
+	MotionFilter* flt = im_lookup<MotionFilter>(filter);
+	if(obj == 0 || (filter && flt == 0))
+		return IM_FAIL;
+	return obj->SetFilter(flt);
+}
+
+IM_API IMFilter imSourceGetFilter(IMSource source)
+{
+	IM_API_LOCK();
+	MotionSource* obj = im_lookup<MotionSource>(source);
+	return (obj && obj->m_filter) ? obj->m_filter->m_handle : 0;
+}
+
+IM_API int32 imSourcePlay(IMSource source, int32 loop_count, IMotionCallback listener_func, const void* listener_obj)
+{
+	IM_API_LOCK();
+	MotionSource* obj = im_lookup<MotionSource>(source);
+	MotionContext* context = im_context_current();
+	if(obj == 0 || context == 0 || obj->m_buffer == 0)
+		return IM_FAIL;
+	obj->m_loop_count = MOTION_CLAMP(loop_count, 0, IM_LOOP_INFINITE);
+	obj->m_listener = listener_func;
+	obj->m_listener_obj = (void*)listener_obj;
+	obj->m_paused = false;
+	return context->Play(obj);
+}
+
+IM_API int32 imSourceStop(IMSource source)
+{
+	IM_API_LOCK();
+	MotionSource* obj = im_lookup<MotionSource>(source);
+	if(obj == 0)
+		return IM_FAIL;
+	if(obj->m_context)
+		return obj->m_context->StopSource(obj);
+	return IM_OK;
+}
+
+IM_API int32 imSourcePause(IMSource source, int32 paused)
+{
+	IM_API_LOCK();
+	MotionSource* obj = im_lookup<MotionSource>(source);
+	if(obj == 0)
+		return IM_FAIL;
+	obj->m_paused = (paused != 0);
+	return IM_OK;
+}
+
+IM_API int32 imSourceSetVolume(IMSource source, int32 volume)
+{
+	IM_API_LOCK();
+	MotionSource* obj = im_lookup<MotionSource>(source);
+	if(obj == 0 || volume < 0)
+		return IM_FAIL;
+	obj->m_volume = volume;
+	return IM_OK;
+}
+
+IM_API int32 imSourceSetSpeed(IMSource source, int32 speed)
+{
+	IM_API_LOCK();
+	MotionSource* obj = im_lookup<MotionSource>(source);
+	return obj ? obj->SetSpeed(speed / 100.0f, 0) : IM_FAIL;
+}
+
+IM_API int32 imSourceSetSpeedFactor(IMSource source, float speed, int32 ramp)
+{
+	IM_API_LOCK();
+	MotionSource* obj = im_lookup<MotionSource>(source);
+	return obj ? obj->SetSpeed(speed, ramp) : IM_FAIL;
+}
+
+IM_API int32 imSourceGetPosition(IMSource source)
+{
+	IM_API_LOCK();
+	MotionSource* obj = im_lookup<MotionSource>(source);
+	return obj ? obj->GetPosition() : 0;
+}
+
+IM_API int32 imDeleteSource(IMSource source)
+{
+	IM_API_LOCK();
+	MotionSource* obj = im_lookup<MotionSource>(source);
+	if(obj == 0)
+		return IM_FAIL;
+	if(obj->m_context)
+		obj->m_context->StopSource(obj);
+	im_object_release(obj);
+	return IM_OK;
+}
@@ -0,0 +1,147 @@
+/********************************************************************************//**
+\file      InnoML_stream.cpp
+\brief     Motion file streams (imLoadBufferStream) of the InnoML reference engine.
+\copyright Copyright (C) 2016-2019 InnoSimulation Co., Ltd. All rights reserved.
+************************************************************************************/
+
+#include "InnoML_internal.h"
+#include <chrono>
+
+MotionStream::MotionStream()
+	: m_reader(0), m_file_loop_begin(0), m_file_loop_end(0), m_buffer(0), m_source(0), m_frames(0),
+	m_frame(0), m_loop_begin(0), m_loop_end(0), m_loops(0), m_wrapped(false), m_written(0), m_running(false),
+	m_end(IM_STREAM_END_NONE), m_mark_head(0), m_mark_tail(0), m_read(0), m_underruns(0)
+{
+	memset(&m_format, 0, sizeof(m_format));
+	memset(m_marks, 0, sizeof(m_marks));
+}
+
+MotionStream::~MotionStream()
+{
+	Stop();
+	IMotion_CloseMotion(m_reader);
+}
+
+bool MotionStream::Open(const char* url, const char* key)
+{
+	uint32 frames = 0;
+	m_reader = IMotion_OpenMotion(url, &m_format, &frames, &m_file_loop_begin, &m_file_loop_end, key);
+	if(m_reader == 0)
+		return false;
+	m_frames = frames;
+	m_chunk.resize(IM_STREAM_CHUNK_FRAMES * m_format.nBlockAlign);
+	return true;
+}
+
+/**
+ * The stream restarts from the first frame of the file with the loop points of the buffer.
+ * (Called with the api lock by the consumer side. The decoder thread is stopped while the ring is cleared,
+ *  and the first chunk is decoded before the thread starts again, so the source plays at once.)
+ */
+void MotionStream::Restart(MotionBuffer* buffer, int32 loops)
+{
+	Stop();
+	m_buffer = buffer;
+	m_buffer->Clear();
+	m_loop_begin = buffer->m_loop_begin;
+	m_loop_end = buffer->m_loop_end;
+	m_loops = loops;
+	m_wrapped = false;
+	m_written = 0;
+	m_read = 0;
+	m_end = IM_STREAM_END_NONE;
+	m_mark_head = 0;
+	m_mark_tail = 0;
+	if(m_frame && !IMotion_SeekMotion(m_reader, 0)) {
+		m_end = 0;
+		return;
+	}
+	m_frame = 0;
+
+	Decode();
+	m_running = true;
+	m_thread = std::thread(&MotionStream::Run, this);
+}
+
+void MotionStream::Stop()
+{
+	if(!m_thread.joinable())
+		return;
+	m_running = false;
+	m_wake.notify_one();
+	m_thread.join();
+}
+
+/**
+ * This function decodes a chunk into the ring and returns the frames. (0 : nothing to decode now)
+ * (The decoder stops at the loop end while loops are left, and at the end of the file otherwise.)
+ */
+int32 MotionStream::Decode()
+{
+	const uint32 block = m_format.nBlockAlign;
+	for(;;) {
+		const int32 loops = m_loops.load(std::memory_order_relaxed);
+		const uint32 stop = (loops && m_loop_end) ? m_loop_end : IM_STREAM_END_NONE;
+		const uint32 frames = MOTION_MIN((uint32)IM_STREAM_CHUNK_FRAMES, stop - MOTION_MIN(m_frame, stop));
+		const int read = frames ? IMotion_ReadMotion(m_reader, &m_chunk[0], frames) : 0;
+		if(read > 0) {
+			m_frame += (uint32)read;
+			m_written += (uint32)read;
+			m_wrapped = false;
+			m_buffer->Enqueue(&m_chunk[0], read * (int32)block);
+			return read;
+		}
+		if(read == 0 && frames && m_frames.load(std::memory_order_relaxed) == 0)
+			m_frames = m_frame; // the end of a csv file
+
+		// loop restart (a loop without frames ends the stream)
+		if(read == 0 && loops && !m_wrapped) {
+			const uint32 tail = m_mark_tail.load(std::memory_order_relaxed);
+			if(tail - m_mark_head.load(std::memory_order_acquire) >= IM_STREAM_MARKS)
+				return 0; // the source is behind by IM_STREAM_MARKS loops
+			const uint32 begin = m_loop_end ? m_loop_begin : 0;
+			if(IMotion_SeekMotion(m_reader, begin)) {
+				if(loops != IM_LOOP_INFINITE)
+					m_loops.store(loops - 1, std::memory_order_relaxed);
+				m_marks[tail % IM_STREAM_MARKS] = m_written;
+				m_mark_tail.store(tail + 1, std::memory_order_release);
+				m_frame = begin;
+				m_wrapped = true;
+				continue;
+			}
+		}
+		m_end.store(m_written, std::memory_order_release);
+		return 0;
+	}
+}
+
+void MotionStream::Run()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while(m_running.load(std::memory_order_acquire)) {
+		if(m_end.load(std::memory_order_acquire) == IM_STREAM_END_NONE && m_buffer->GetFreeCount() >= IM_STREAM_CHUNK_FRAMES && Decode() > 0)
+			continue;
+		m_wake.wait_for(lock, std::chrono::milliseconds(IM_STREAM_WAIT_MSEC));
+	}
+}
+
+/**
+ * This function pops the first loop restart if the source reached it.
+ */
+bool MotionStream::PopMark(uint32 frame, uint32* mark)
+{
+	const uint32 head = m_mark_head.load(std::memory_order_relaxed);
+	if(head == m_mark_tail.load(std::memory_order_acquire) || frame < m_marks[head % IM_STREAM_MARKS])
+		return false;
+	*mark = m_marks[head % IM_STREAM_MARKS];
+	m_mark_head.store(head + 1, std::memory_order_release);
+	m_wake.notify_one();
+	return true;
+}
+
+void MotionStream::Consume(uint32 frames)
+{
+	m_read += frames;
+	if(m_buffer->GetFreeCount() >= IM_STREAM_CHUNK_FRAMES)
+		m_wake.notify_one();
+}